@@ -37,6 +37,7 @@
 #include "winuser.h"
 #include "advapi32_misc.h"
 
+#include "wine/server.h"
 #include "wine/unicode.h"
 #include "wine/debug.h"
 
@@ -2931,6 +2932,74 @@ LSTATUS WINAPI RegDisablePredefinedCache(void)
     return ERROR_SUCCESS;
 }
 
+#define ENUM_BATCH_SIZE 16
+
+/******************************************************************************
+ * enum_names_batch
+ *
+ * Retrieve the names of the first subkeys or values of a key in a single
+ * round-trip to the server. Each name is stored in a slot of len WCHARs.
+ * If the first name doesn't fit, the needed slot size is returned in needed.
+ */
+static NTSTATUS enum_names_batch( HKEY hkey, BOOL values, WCHAR *names, DWORD len, DWORD *count,
+                                  DWORD *needed )
+{
+    struct __server_request_info info[ENUM_BATCH_SIZE];
+    void *reqs[ENUM_BATCH_SIZE];
+    data_size_t namelen, size = (len - 1) * sizeof(WCHAR);
+    NTSTATUS status = STATUS_SUCCESS;
+    DWORD i;
+
+    for (i = 0; i < *count; i++)
+    {
+        if (values)
+        {
+            struct enum_key_value_request *req = SERVER_INIT_REQ( &info[i], enum_key_value );
+            req->hkey       = wine_server_obj_handle( hkey );
+            req->index      = i;
+            req->info_class = KeyValueBasicInformation;
+        }
+        else
+        {
+            struct enum_key_request *req = SERVER_INIT_REQ( &info[i], enum_key );
+            req->hkey       = wine_server_obj_handle( hkey );
+            req->index      = i;
+            req->info_class = KeyBasicInformation;
+        }
+        wine_server_set_reply( &info[i], names + i * len, size );
+        reqs[i] = &info[i];
+    }
+    wine_server_call_batch( reqs, *count );
+
+    for (i = 0; i < *count; i++)
+    {
+        if ((status = info[i].u.reply.reply_header.error)) break;
+        /* the reply is clipped to the buffer size, only the total tells the real length */
+        if (values) namelen = info[i].u.reply.enum_key_value_reply.total;
+        else namelen = info[i].u.reply.enum_key_reply.total;
+        if (namelen > size)
+        {
+            *needed = namelen / sizeof(WCHAR) + 1;
+            status = STATUS_BUFFER_OVERFLOW;
+            break;
+        }
+        names[i * len + namelen / sizeof(WCHAR)] = 0;
+    }
+    *count = i;
+    return i ? STATUS_SUCCESS : status;
+}
+
+static LONG grow_names_buffer( WCHAR **names, DWORD *len, DWORD needed )
+{
+    WCHAR *new_names;
+
+    if (!(new_names = heap_realloc( *names, ENUM_BATCH_SIZE * needed * sizeof(WCHAR) )))
+        return ERROR_NOT_ENOUGH_MEMORY;
+    *names = new_names;
+    *len = needed;
+    return ERROR_SUCCESS;
+}
+
 /******************************************************************************
  * RegDeleteTreeW [ADVAPI32.@]
  *
@@ -2938,10 +3007,11 @@ LSTATUS WINAPI RegDisablePredefinedCache(void)
 LSTATUS WINAPI RegDeleteTreeW(HKEY hKey, LPCWSTR lpszSubKey)
 {
     LONG ret;
-    DWORD dwMaxSubkeyLen, dwMaxValueLen;
-    DWORD dwMaxLen, dwSize;
-    WCHAR szNameBuf[MAX_PATH], *lpszName = szNameBuf;
+    DWORD dwSubkeys, dwMaxSubkeyLen, dwValues, dwMaxValueLen;
+    DWORD dwMaxLen, dwNeeded, dwCount, i;
+    WCHAR *lpszNames = NULL;
     HKEY hSubKey = hKey;
+    NTSTATUS status;
 
     TRACE("(hkey=%p,%p %s)\n", hKey, lpszSubKey, debugstr_w(lpszSubKey));
 
@@ -2950,54 +3020,69 @@ LSTATUS WINAPI RegDeleteTreeW(HKEY hKey, LPCWSTR lpszSubKey)
         ret = RegOpenKeyExW(hKey, lpszSubKey, 0, KEY_READ, &hSubKey);
         if (ret) return ret;
     }
+    else if (!(hSubKey = get_special_root_hkey( hKey, 0 ))) return ERROR_INVALID_HANDLE;
 
-    /* Get highest length for keys, values */
-    ret = RegQueryInfoKeyW(hSubKey, NULL, NULL, NULL, NULL,
-            &dwMaxSubkeyLen, NULL, NULL, &dwMaxValueLen, NULL, NULL, NULL);
+    /* Get count and highest length for keys, values */
+    ret = RegQueryInfoKeyW(hSubKey, NULL, NULL, NULL, &dwSubkeys,
+            &dwMaxSubkeyLen, NULL, &dwValues, &dwMaxValueLen, NULL, NULL, NULL);
     if (ret) goto cleanup;
 
     dwMaxSubkeyLen++;
     dwMaxValueLen++;
     dwMaxLen = max(dwMaxSubkeyLen, dwMaxValueLen);
-    if (dwMaxLen > sizeof(szNameBuf)/sizeof(WCHAR))
+    /* the names are enumerated in batches to save server round-trips */
+    if (!(lpszNames = heap_alloc( ENUM_BATCH_SIZE * dwMaxLen * sizeof(WCHAR) )))
     {
-        /* Name too big: alloc a buffer for it */
-        if (!(lpszName = heap_alloc( dwMaxLen*sizeof(WCHAR))))
-        {
-            ret = ERROR_NOT_ENOUGH_MEMORY;
-            goto cleanup;
-        }
+        ret = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
     }
 
-
     /* Recursively delete all the subkeys */
-    while (TRUE)
+    while (dwSubkeys)
     {
-        dwSize = dwMaxLen;
-        if (RegEnumKeyExW(hSubKey, 0, lpszName, &dwSize, NULL,
-                          NULL, NULL, NULL)) break;
+        dwCount = min( dwSubkeys, ENUM_BATCH_SIZE );
+        status = enum_names_batch( hSubKey, FALSE, lpszNames, dwMaxLen, &dwCount, &dwNeeded );
+        if (status == STATUS_BUFFER_OVERFLOW)
+        {
+            /* a longer name was added in the meantime */
+            if ((ret = grow_names_buffer( &lpszNames, &dwMaxLen, dwNeeded ))) goto cleanup;
+            continue;
+        }
+        if (status) break;
 
-        ret = RegDeleteTreeW(hSubKey, lpszName);
-        if (ret) goto cleanup;
+        for (i = 0; i < dwCount; i++)
+        {
+            ret = RegDeleteTreeW(hSubKey, lpszNames + i * dwMaxLen);
+            if (ret) goto cleanup;
+        }
+        /* keep going in case subkeys were added in the meantime */
+        dwSubkeys = max( dwSubkeys - dwCount, 1 );
     }
 
     if (lpszSubKey)
         ret = RegDeleteKeyW(hKey, lpszSubKey);
     else
-        while (TRUE)
+        while (dwValues)
         {
-            dwSize = dwMaxLen;
-            if (RegEnumValueW(hKey, 0, lpszName, &dwSize,
-                  NULL, NULL, NULL, NULL)) break;
+            dwCount = min( dwValues, ENUM_BATCH_SIZE );
+            status = enum_names_batch( hSubKey, TRUE, lpszNames, dwMaxLen, &dwCount, &dwNeeded );
+            if (status == STATUS_BUFFER_OVERFLOW)
+            {
+                if ((ret = grow_names_buffer( &lpszNames, &dwMaxLen, dwNeeded ))) goto cleanup;
+                continue;
+            }
+            if (status) break;
 
-            ret = RegDeleteValueW(hKey, lpszName);
-            if (ret) goto cleanup;
+            for (i = 0; i < dwCount; i++)
+            {
+                ret = RegDeleteValueW(hKey, lpszNames + i * dwMaxLen);
+                if (ret) goto cleanup;
+            }
+            dwValues = max( dwValues - dwCount, 1 );
         }
 
 cleanup:
-    /* Free buffer if allocated */
-    if (lpszName != szNameBuf)
-        heap_free( lpszName);
+    heap_free( lpszNames );
     if(lpszSubKey)
         RegCloseKey(hSubKey);
     return ret;
@@ -2050,8 +2050,9 @@ static void test_string_termination(void)
 
 static void test_reg_delete_tree(void)
 {
-    CHAR buffer[MAX_PATH];
+    CHAR buffer[MAX_PATH], name[16];
     HKEY subkey, subkey2;
+    DWORD i, subkeys, values;
     LONG size, ret;
 
     if(!pRegDeleteTreeA) {
@@ -2116,6 +2117,26 @@ static void test_reg_delete_tree(void)
     ok(RegQueryValueA(subkey, "value", buffer, &size),
         "Value is still present\n");
 
+    /* more entries than fit in a single enumeration batch */
+    for (i = 0; i < 40; i++)
+    {
+        sprintf(name, "subkey%u", i);
+        ret = RegCreateKeyA(subkey, name, &subkey2);
+        ok(ret == ERROR_SUCCESS, "Expected ERROR_SUCCESS, got %d\n", ret);
+        ret = RegSetValueExA(subkey2, name, 0, REG_SZ, (const BYTE *)"data", 5);
+        ok(ret == ERROR_SUCCESS, "Expected ERROR_SUCCESS, got %d\n", ret);
+        RegCloseKey(subkey2);
+        ret = RegSetValueExA(subkey, name, 0, REG_SZ, (const BYTE *)"data", 5);
+        ok(ret == ERROR_SUCCESS, "Expected ERROR_SUCCESS, got %d\n", ret);
+    }
+    ret = pRegDeleteTreeA(subkey, NULL);
+    ok(ret == ERROR_SUCCESS, "Expected ERROR_SUCCESS, got %d\n", ret);
+    ret = RegQueryInfoKeyA(subkey, NULL, NULL, NULL, &subkeys, NULL, NULL, &values, NULL, NULL, NULL, NULL);
+    ok(ret == ERROR_SUCCESS, "Expected ERROR_SUCCESS, got %d\n", ret);
+    ok(!subkeys, "Expected no subkeys, got %u\n", subkeys);
+    ok(!values, "Expected no values, got %u\n", values);
+    RegCloseKey(subkey);
+
     ret = pRegDeleteTreeA(hkey_main, "not-here");
     ok(ret == ERROR_FILE_NOT_FOUND,
         "Expected ERROR_FILE_NOT_FOUND, got %d\n", ret);
@@ -3247,11 +3268,212 @@ static void test_delete_key_value(void)
     RegCloseKey(subkey);
 }
 
+/* With WINEREGSNAPSHOT=2, the server checks on each flush that the registry
+ * snapshot and journal load back to the current contents. */
+static void test_flush_key(void)
+{
+    static BYTE data[0x10000];
+    char buffer[8];
+    HKEY hkey, subkey;
+    DWORD i, size;
+    LONG ret;
+
+    ret = RegCreateKeyA( hkey_main, "flush\\a\\b", &hkey );
+    ok( !ret, "RegCreateKeyA failed: %d\n", ret );
+    ret = RegSetValueExA( hkey, "value", 0, REG_SZ, (const BYTE *)"b", 2 );
+    ok( !ret, "RegSetValueExA failed: %d\n", ret );
+    ret = RegFlushKey( hkey );
+    ok( !ret, "RegFlushKey failed: %d\n", ret );
+
+    /* only the modified keys are journaled, their siblings and parents must be preserved */
+    ret = RegCreateKeyA( hkey_main, "flush\\a\\c", &subkey );
+    ok( !ret, "RegCreateKeyA failed: %d\n", ret );
+    ret = RegSetValueExA( subkey, "value", 0, REG_SZ, (const BYTE *)"c", 2 );
+    ok( !ret, "RegSetValueExA failed: %d\n", ret );
+    RegCloseKey( subkey );
+    ret = RegSetValueExA( hkey, "value", 0, REG_SZ, (const BYTE *)"bb", 3 );
+    ok( !ret, "RegSetValueExA failed: %d\n", ret );
+    ret = RegFlushKey( hkey );
+    ok( !ret, "RegFlushKey failed: %d\n", ret );
+    RegCloseKey( hkey );
+
+    ret = RegDeleteKeyA( hkey_main, "flush\\a\\b" );
+    ok( !ret, "RegDeleteKeyA failed: %d\n", ret );
+    ret = RegFlushKey( hkey_main );
+    ok( !ret, "RegFlushKey failed: %d\n", ret );
+
+    /* grow the journal until it gets merged into a new snapshot */
+    ret = RegCreateKeyA( hkey_main, "flush\\big", &hkey );
+    ok( !ret, "RegCreateKeyA failed: %d\n", ret );
+    for (i = 0; i < 32; i++)
+    {
+        memset( data, 'a' + i, sizeof(data) );
+        ret = RegSetValueExA( hkey, "data", 0, REG_BINARY, data, sizeof(data) );
+        if (ret) break;
+        ret = RegFlushKey( hkey );
+        if (ret) break;
+    }
+    ok( !ret, "iteration %u failed: %d\n", i, ret );
+    RegCloseKey( hkey );
+
+    ret = RegOpenKeyA( hkey_main, "flush\\a\\c", &hkey );
+    ok( !ret, "RegOpenKeyA failed: %d\n", ret );
+    size = sizeof(buffer);
+    ret = RegQueryValueExA( hkey, "value", NULL, NULL, (BYTE *)buffer, &size );
+    ok( !ret, "RegQueryValueExA failed: %d\n", ret );
+    ok( !strcmp( buffer, "c" ), "wrong value %s\n", buffer );
+    RegCloseKey( hkey );
+
+    ret = RegOpenKeyA( hkey_main, "flush", &hkey );
+    ok( !ret, "RegOpenKeyA failed: %d\n", ret );
+    delete_key( hkey );
+    RegCloseKey( hkey );
+    ret = RegFlushKey( hkey_main );
+    ok( !ret, "RegFlushKey failed: %d\n", ret );
+}
+
+#define THROUGHPUT_ITERATIONS 5000
+
+/* child process of test_server_throughput */
+static void run_throughput_child( const char *name )
+{
+    char buffer[32];
+    DWORD i, size, type;
+    HKEY hkey;
+    LONG ret;
+
+    ret = RegCreateKeyA( hkey_main, name, &hkey );
+    ok( !ret, "RegCreateKeyA failed: %d\n", ret );
+    if (ret) return;
+
+    for (i = 0; i < THROUGHPUT_ITERATIONS; i++)
+    {
+        sprintf( buffer, "%u", i );
+        ret = RegSetValueExA( hkey, "value", 0, REG_SZ, (const BYTE *)buffer, strlen(buffer) + 1 );
+        if (ret) break;
+        size = sizeof(buffer);
+        ret = RegQueryValueExA( hkey, "value", NULL, &type, (BYTE *)buffer, &size );
+        if (ret) break;
+    }
+    ok( !ret, "iteration %u failed: %d\n", i, ret );
+    RegCloseKey( hkey );
+    RegDeleteKeyA( hkey_main, name );
+}
+
+/* measure the request throughput of the server with several processes hammering the registry */
+static void test_server_throughput( const char *argv0 )
+{
+    static const int counts[] = { 1, 4, 16 };
+    PROCESS_INFORMATION info[16];
+    STARTUPINFOA si = { sizeof(si) };
+    HANDLE handles[16];
+    char cmdline[MAX_PATH + 64];
+    DWORD start, elapsed, ret;
+    int i, j, count;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        start = GetTickCount();
+        for (count = 0; count < counts[i]; count++)
+        {
+            sprintf( cmdline, "\"%s\" registry throughput throughput%u", argv0, count );
+            if (!CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &info[count] )) break;
+            handles[count] = info[count].hProcess;
+        }
+        ok( count == counts[i], "CreateProcess failed: %u\n", GetLastError() );
+        if (!count) return;
+
+        ret = WaitForMultipleObjects( count, handles, TRUE, 120000 );
+        elapsed = GetTickCount() - start;
+        ok( ret < WAIT_OBJECT_0 + count, "wait failed: %u\n", ret );
+        for (j = 0; j < count; j++)
+        {
+            winetest_wait_child_process( info[j].hProcess );
+            CloseHandle( info[j].hProcess );
+            CloseHandle( info[j].hThread );
+        }
+        trace( "%d processes: %u requests in %u ms (%u requests/s)\n", count,
+               count * THROUGHPUT_ITERATIONS * 2, elapsed,
+               elapsed ? (DWORD)((ULONGLONG)count * THROUGHPUT_ITERATIONS * 2 * 1000 / elapsed) : 0 );
+    }
+}
+
+/* measure how long requests are stalled while the server saves a large registry;
+ * run with and without WINEASYNCREGSAVE to compare */
+static void test_save_stall(void)
+{
+    static const DWORD duration = 40000;  /* longer than the periodic save interval */
+    LARGE_INTEGER freq, start, end;
+    double latency, max_latency = 0;
+    DWORD i, size, type, begin, count = 0;
+    char name[32], data[128];
+    HKEY hkey;
+    LONG ret;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+
+    ret = RegCreateKeyA( hkey_main, "save_stall", &hkey );
+    ok( !ret, "RegCreateKeyA failed: %d\n", ret );
+    if (ret) return;
+
+    /* make the registry large enough for saving it to take a while */
+    memset( data, 'x', sizeof(data) - 1 );
+    data[sizeof(data) - 1] = 0;
+    for (i = 0; i < 50000; i++)
+    {
+        sprintf( name, "value%u", i );
+        if ((ret = RegSetValueExA( hkey, name, 0, REG_SZ, (const BYTE *)data, sizeof(data) ))) break;
+    }
+    ok( !ret, "RegSetValueExA failed: %d\n", ret );
+
+    QueryPerformanceFrequency( &freq );
+    begin = GetTickCount();
+    while (GetTickCount() - begin < duration)
+    {
+        /* keep the registry dirty so that every periodic save has to write it */
+        sprintf( name, "%u", count );
+        QueryPerformanceCounter( &start );
+        RegSetValueExA( hkey, "counter", 0, REG_SZ, (const BYTE *)name, strlen(name) + 1 );
+        size = sizeof(data);
+        RegQueryValueExA( hkey, "value0", NULL, &type, (BYTE *)data, &size );
+        QueryPerformanceCounter( &end );
+        latency = (end.QuadPart - start.QuadPart) * 1000.0 / freq.QuadPart;
+        if (latency > max_latency) max_latency = latency;
+        count++;
+    }
+    trace( "%u request pairs, worst latency %.1f ms\n", count, max_latency );
+
+    delete_key( hkey );
+    RegCloseKey( hkey );
+}
+
 START_TEST(registry)
 {
+    char **argv;
+    int argc;
+
     /* Load pointers for functions that are not available in all Windows versions */
     InitFunctionPtrs();
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 4 && !strcmp( argv[2], "throughput" ))
+    {
+        RegCreateKeyA( HKEY_CURRENT_USER, "Software\\Wine\\Test", &hkey_main );
+        run_throughput_child( argv[3] );
+        RegCloseKey( hkey_main );
+        return;
+    }
+
     setup_main_key();
     check_user_privs();
     test_set_value();
@@ -3289,6 +3511,9 @@ START_TEST(registry)
     test_deleted_key();
     test_delete_value();
     test_delete_key_value();
+    test_flush_key();
+    test_server_throughput( argv[0] );
+    test_save_stall();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -29,6 +29,7 @@
  */
 
 #include <math.h>
+#include <stdio.h>
 
 #define COBJMACROS
 #include <d3d9.h>
@@ -19796,11 +19797,151 @@ done:
     DestroyWindow(window);
 }
 
+static void cs_benchmark_child(void)
+{
+    static const struct
+    {
+        struct vec3 position;
+        DWORD diffuse;
+    }
+    quad[] =
+    {
+        {{-1.0f, -1.0f, 0.1f}, 0xff00ff00},
+        {{-1.0f,  1.0f, 0.1f}, 0xff00ff00},
+        {{ 1.0f, -1.0f, 0.1f}, 0xff00ff00},
+        {{ 1.0f,  1.0f, 0.1f}, 0xff00ff00},
+    };
+    IDirect3DVertexBuffer9 *vb;
+    IDirect3DDevice9 *device;
+    DWORD start, elapsed;
+    unsigned int i, j;
+    IDirect3D9 *d3d;
+    HWND window;
+    HRESULT hr;
+    void *data;
+
+    window = create_window();
+    d3d = Direct3DCreate9(D3D_SDK_VERSION);
+    ok(!!d3d, "Failed to create a D3D object.\n");
+    if (!(device = create_device(d3d, window, window, TRUE)))
+    {
+        skip("Failed to create a D3D device, skipping tests.\n");
+        goto done;
+    }
+
+    hr = IDirect3DDevice9_CreateVertexBuffer(device, sizeof(quad), D3DUSAGE_WRITEONLY, 0,
+            D3DPOOL_DEFAULT, &vb, NULL);
+    ok(SUCCEEDED(hr), "Failed to create vertex buffer, hr %#x.\n", hr);
+    hr = IDirect3DVertexBuffer9_Lock(vb, 0, sizeof(quad), &data, 0);
+    ok(SUCCEEDED(hr), "Failed to lock vertex buffer, hr %#x.\n", hr);
+    memcpy(data, quad, sizeof(quad));
+    hr = IDirect3DVertexBuffer9_Unlock(vb);
+    ok(SUCCEEDED(hr), "Failed to unlock vertex buffer, hr %#x.\n", hr);
+
+    hr = IDirect3DDevice9_SetRenderState(device, D3DRS_LIGHTING, FALSE);
+    ok(SUCCEEDED(hr), "Failed to disable lighting, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetFVF(device, D3DFVF_XYZ | D3DFVF_DIFFUSE);
+    ok(SUCCEEDED(hr), "Failed to set FVF, hr %#x.\n", hr);
+    hr = IDirect3DDevice9_SetStreamSource(device, 0, vb, 0, sizeof(*quad));
+    ok(SUCCEEDED(hr), "Failed to set stream source, hr %#x.\n", hr);
+
+    start = GetTickCount();
+    for (i = 0; i < 100; ++i)
+    {
+        hr = IDirect3DDevice9_Clear(device, 0, NULL, D3DCLEAR_TARGET, 0xff000000, 0.0f, 0);
+        ok(SUCCEEDED(hr), "Failed to clear, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_BeginScene(device);
+        ok(SUCCEEDED(hr), "Failed to begin scene, hr %#x.\n", hr);
+        for (j = 0; j < 1000; ++j)
+        {
+            /* Small draws with a state change in between are the case the
+             * command stream is meant to help with. */
+            IDirect3DDevice9_SetRenderState(device, D3DRS_CULLMODE, (j & 1) ? D3DCULL_NONE : D3DCULL_CW);
+            IDirect3DDevice9_DrawPrimitive(device, D3DPT_TRIANGLESTRIP, 0, 2);
+        }
+        hr = IDirect3DDevice9_EndScene(device);
+        ok(SUCCEEDED(hr), "Failed to end scene, hr %#x.\n", hr);
+        hr = IDirect3DDevice9_Present(device, NULL, NULL, NULL, NULL);
+        ok(SUCCEEDED(hr), "Failed to present, hr %#x.\n", hr);
+    }
+    elapsed = GetTickCount() - start;
+    trace("%u draws in %u ms, %.0f draws/s.\n", 100 * 1000, elapsed,
+            elapsed ? 100.0 * 1000.0 * 1000.0 / elapsed : 0.0);
+
+    IDirect3DVertexBuffer9_Release(vb);
+    IDirect3DDevice9_Release(device);
+done:
+    IDirect3D9_Release(d3d);
+    DestroyWindow(window);
+}
+
+static void cs_benchmark(void)
+{
+    static const char *modes[] = {"disabled", "enabled"};
+    char path[MAX_PATH], key_name[MAX_PATH + 64], cmdline[MAX_PATH + 32];
+    PROCESS_INFORMATION pi;
+    STARTUPINFOA si = {0};
+    const char *exe;
+    unsigned int i;
+    char **argv;
+    HKEY key;
+    LONG ret;
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+
+    /* wined3d reads its settings at load time, so each mode gets its own
+     * child process. Force llvmpipe so the numbers don't depend on the
+     * host GPU. */
+    winetest_get_mainargs(&argv);
+    GetModuleFileNameA(NULL, path, sizeof(path));
+    exe = strrchr(path, '\\') ? strrchr(path, '\\') + 1 : path;
+    sprintf(key_name, "Software\\Wine\\AppDefaults\\%s\\Direct3D", exe);
+    ret = RegCreateKeyA(HKEY_CURRENT_USER, key_name, &key);
+    ok(!ret, "Failed to create key, ret %d.\n", ret);
+    if (ret) return;
+
+    SetEnvironmentVariableA("LIBGL_ALWAYS_SOFTWARE", "1");
+    SetEnvironmentVariableA("GALLIUM_DRIVER", "llvmpipe");
+    si.cb = sizeof(si);
+    for (i = 0; i < sizeof(modes) / sizeof(*modes); ++i)
+    {
+        ret = RegSetValueExA(key, "CSMT", 0, REG_SZ, (const BYTE *)modes[i], strlen(modes[i]) + 1);
+        ok(!ret, "Failed to set value, ret %d.\n", ret);
+        trace("CSMT %s:\n", modes[i]);
+        sprintf(cmdline, "\"%s\" visual cs_benchmark", argv[0]);
+        ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+        ok(ret, "Failed to create process, error %u.\n", GetLastError());
+        if (!ret) break;
+        winetest_wait_child_process(pi.hProcess);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+    }
+    SetEnvironmentVariableA("LIBGL_ALWAYS_SOFTWARE", NULL);
+    SetEnvironmentVariableA("GALLIUM_DRIVER", NULL);
+
+    RegDeleteValueA(key, "CSMT");
+    RegCloseKey(key);
+    RegDeleteKeyA(HKEY_CURRENT_USER, key_name);
+}
+
 START_TEST(visual)
 {
     D3DADAPTER_IDENTIFIER9 identifier;
     IDirect3D9 *d3d;
     HRESULT hr;
+    char **argv;
+    int argc;
+
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 3 && !strcmp(argv[2], "cs_benchmark"))
+    {
+        cs_benchmark_child();
+        return;
+    }
 
     if (!(d3d = Direct3DCreate9(D3D_SDK_VERSION)))
     {
@@ -19914,4 +20055,5 @@ START_TEST(visual)
     test_vertex_blending();
     test_updatetexture();
     test_depthbias();
+    cs_benchmark();
 }
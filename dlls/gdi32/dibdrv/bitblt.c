@@ -492,7 +492,7 @@ static void copy_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     case R2_WHITE: xor = ~0u;
         /* fall through */
     case R2_BLACK:
-        dst->funcs->solid_rects( dst, count, rects, and, xor );
+        render_solid_rects( dst, count, rects, and, xor );
         /* fall through */
     case R2_NOP:
         return;
@@ -564,7 +564,7 @@ static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *sr
     {
         origin.x = src_rect->left + clipped_rects.rects[i].left - dst_rect->left;
         origin.y = src_rect->top  + clipped_rects.rects[i].top  - dst_rect->top;
-        dst->funcs->blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
+        render_blend_rect( dst, &clipped_rects.rects[i], src, &origin, blend );
     }
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -658,7 +658,7 @@ static BOOL gradient_rect( dib_info *dib, TRIVERTEX *v, int mode, HRGN clip, con
     if (!get_clipped_rects( dib, bounds, clip, &clipped_rects )) return TRUE;
     for (i = 0; i < clipped_rects.count; i++)
     {
-        if (!(ret = dib->funcs->gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
+        if (!(ret = render_gradient_rect( dib, &clipped_rects.rects[i], v, mode ))) break;
     }
     free_clipped_rects( &clipped_rects );
     return ret;
@@ -1145,6 +1145,154 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
     return ERROR_SUCCESS;
 }
 
+struct stretch_band
+{
+    POINT dst_start;
+    POINT src_start;
+    int   err;
+    int   length;
+};
+
+struct stretch_job
+{
+    dib_info             *dst_dib;
+    const dib_info       *src_dib;
+    struct stretch_params v_params;
+    struct stretch_params h_params;
+    void                (*row_fn)(const dib_info *dst_dib, const POINT *dst_start,
+                                  const dib_info *src_dib, const POINT *src_start,
+                                  const struct stretch_params *params, int mode, BOOL keep_dst);
+    int                   mode;
+    BOOL                  vstretch;
+    int                   width;
+    struct stretch_band   bands[MAX_RENDER_BANDS];
+};
+
+static void stretch_rows( const struct stretch_job *job, const struct stretch_band *band )
+{
+    const struct stretch_params *v_params = &job->v_params;
+    POINT dst_start = band->dst_start, src_start = band->src_start;
+    int err = band->err, length = band->length;
+
+    if (job->vstretch)
+    {
+        BOOL need_row = TRUE;
+        RECT last_row, this_row;
+        last_row.left = 0;
+        last_row.right = job->width;
+
+        while (length--)
+        {
+            if (need_row)
+            {
+                job->row_fn( job->dst_dib, &dst_start, job->src_dib, &src_start, &job->h_params, job->mode, FALSE );
+                need_row = FALSE;
+            }
+            else
+            {
+                last_row.top = dst_start.y - v_params->dst_inc;
+                last_row.bottom = last_row.top + 1;
+                this_row = last_row;
+                offset_rect( &this_row, 0, v_params->dst_inc );
+                copy_rect( job->dst_dib, &this_row, job->dst_dib, &last_row, NULL, R2_COPYPEN );
+            }
+
+            if (err > 0)
+            {
+                src_start.y += v_params->src_inc;
+                need_row = TRUE;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            dst_start.y += v_params->dst_inc;
+        }
+    }
+    else
+    {
+        int merged_rows = 0;
+
+        while (length--)
+        {
+            if (job->mode != STRETCH_DELETESCANS || !merged_rows)
+                job->row_fn( job->dst_dib, &dst_start, job->src_dib, &src_start, &job->h_params,
+                             job->mode, merged_rows != 0 );
+            merged_rows++;
+
+            if (err > 0)
+            {
+                dst_start.y += v_params->dst_inc;
+                merged_rows = 0;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            src_start.y += v_params->src_inc;
+        }
+    }
+}
+
+static void stretch_rows_band( void *ctx, int band )
+{
+    struct stretch_job *job = ctx;
+    stretch_rows( job, &job->bands[band] );
+}
+
+/* Split the rows into bands that can be rendered independently. Each band
+ * starts with a freshly computed row, and when shrinking it starts on a new
+ * destination row, so that no destination row is touched by two bands. */
+static int init_stretch_bands( struct stretch_job *job, const POINT *dst_start, const POINT *src_start )
+{
+    const struct stretch_params *v_params = &job->v_params;
+    struct stretch_band *band = job->bands;
+    POINT dst = *dst_start, src = *src_start;
+    int i, count, start = 0, err = v_params->err_start;
+    BOOL new_row = TRUE;
+
+    band->dst_start = dst;
+    band->src_start = src;
+    band->err       = err;
+    band->length    = v_params->length;
+
+    count = get_render_bands( v_params->length, (LONGLONG)v_params->length * job->h_params.length );
+    if (count <= 1) return 1;
+
+    for (i = 0; i < v_params->length; i++)
+    {
+        if (new_row && i >= (LONGLONG)v_params->length * (band - job->bands + 1) / count &&
+            band - job->bands + 1 < count)
+        {
+            band->length = i - start;
+            start = i;
+            band++;
+            band->dst_start = dst;
+            band->src_start = src;
+            band->err       = err;
+        }
+
+        if (job->vstretch)
+        {
+            if (err > 0)
+            {
+                src.y += v_params->src_inc;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            dst.y += v_params->dst_inc;
+        }
+        else
+        {
+            new_row = err > 0;
+            if (err > 0)
+            {
+                dst.y += v_params->dst_inc;
+                err += v_params->err_add_1;
+            }
+            else err += v_params->err_add_2;
+            src.y += v_params->src_inc;
+        }
+    }
+    band->length = v_params->length - start;
+    return band - job->bands + 1;
+}
 
 DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                           const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
@@ -1155,11 +1303,9 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     RECT rect;
     BOOL hstretch, vstretch;
     struct stretch_params v_params, h_params;
-    int err;
     DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
+    struct stretch_job job;
+    int count;
 
     TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
           dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
@@ -1193,64 +1339,20 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     dst_start.x -= dst->visrect.left;
     dst_start.y -= dst->visrect.top;
 
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
-
-    if (vstretch)
-    {
-        BOOL need_row = TRUE;
-        RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
-        last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
-
-        while (v_params.length--)
-        {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
-            {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                offset_rect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
-        }
-    }
+    job.dst_dib  = &dst_dib;
+    job.src_dib  = &src_dib;
+    job.v_params = v_params;
+    job.h_params = h_params;
+    job.row_fn   = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+    job.mode     = (vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    job.vstretch = vstretch;
+    job.width    = dst->visrect.right - dst->visrect.left;
+
+    count = init_stretch_bands( &job, &dst_start, &src_start );
+    if (count > 1)
+        render_bands( stretch_rows_band, &job, count );
     else
-    {
-        int merged_rows = 0;
-
-        while (v_params.length--)
-        {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
-        }
-    }
+        stretch_rows( &job, &job.bands[0] );
 
     /* update coordinates, the destination rectangle is always stored at 0,0 */
     *src = *dst;
@@ -213,6 +213,23 @@ extern const primitive_funcs funcs_4    DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_1    DECLSPEC_HIDDEN;
 extern const primitive_funcs funcs_null DECLSPEC_HIDDEN;
 
+/* optional vectorized scanline kernels, they return the number of pixels processed */
+typedef struct
+{
+    int   (* solid_line_32)(DWORD *dst, int len, DWORD and, DWORD xor);
+    int (* pattern_line_32)(DWORD *dst, const DWORD *and, const DWORD *xor, int len);
+    int      (* blend_argb)(DWORD *dst, const DWORD *src, int len);
+    int (* blend_argb_alpha)(DWORD *dst, const DWORD *src, int len, DWORD alpha);
+    int (* blend_constant_alpha)(DWORD *dst, const DWORD *src, int len, DWORD alpha, DWORD src_or);
+    int (* convert_555_to_8888)(DWORD *dst, const WORD *src, int len);
+    int (* convert_masks_to_8888)(DWORD *dst, const DWORD *src, int len,
+                                  int red_shift, int green_shift, int blue_shift);
+    int (* convert_24_to_8888)(DWORD *dst, const BYTE *src, int len);
+    int (* convert_8888_to_24)(BYTE *dst, const DWORD *src, int len);
+} simd_primitive_funcs;
+
+extern simd_primitive_funcs simd_funcs DECLSPEC_HIDDEN;
+
 struct rop_codes
 {
     DWORD a1, a2, x1, x2;
@@ -253,6 +270,17 @@ extern int clip_line(const POINT *start, const POINT *end, const RECT *clip,
                      const bres_params *params, POINT *pt1, POINT *pt2) DECLSPEC_HIDDEN;
 extern void release_cached_font( struct cached_font *font ) DECLSPEC_HIDDEN;
 
+#define MAX_RENDER_BANDS 128
+
+extern int get_render_bands( int rows, LONGLONG pixels ) DECLSPEC_HIDDEN;
+extern void render_bands( void (*func)( void *ctx, int band ), void *ctx, int count ) DECLSPEC_HIDDEN;
+extern void render_solid_rects( const dib_info *dib, int num, const RECT *rects, DWORD and, DWORD xor ) DECLSPEC_HIDDEN;
+extern void render_pattern_rects( const dib_info *dib, int num, const RECT *rects, const POINT *origin,
+                                  const dib_info *brush, const rop_mask_bits *bits ) DECLSPEC_HIDDEN;
+extern void render_blend_rect( const dib_info *dst, const RECT *rect, const dib_info *src,
+                               const POINT *origin, BLENDFUNCTION blend ) DECLSPEC_HIDDEN;
+extern BOOL render_gradient_rect( const dib_info *dib, const RECT *rect, const TRIVERTEX *vert, int mode ) DECLSPEC_HIDDEN;
+
 static inline void init_clipped_rects( struct clipped_rects *clip_rects )
 {
     clip_rects->count = 0;
@@ -0,0 +1,310 @@
+/*
+ * DIB driver banded rendering on the thread pool
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdlib.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "gdi_private.h"
+#include "dibdrv.h"
+#include "winreg.h"
+#include "winternl.h"
+
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dib);
+
+/* Large operations are split into horizontal bands which are rendered
+ * concurrently. Every band writes a disjoint set of destination rows, so the
+ * result is the same as when rendering on a single thread. This is disabled
+ * by default and can be enabled with the following values under
+ * HKCU\Software\Wine\DIB Driver:
+ *   RenderThreads    number of threads to use, including the calling one
+ *   RenderThreshold  minimum number of pixels of an operation to split it
+ */
+
+#define MIN_BAND_ROWS 16
+
+static INIT_ONCE render_init_once = INIT_ONCE_STATIC_INIT;
+static DWORD render_threads;
+static DWORD render_threshold = 1024 * 1024;
+static TP_CALLBACK_ENVIRON render_environment;
+
+static DWORD get_config_dword( HKEY hkey, const char *name, DWORD def )
+{
+    char buffer[16];
+    DWORD type, size = sizeof(buffer);
+
+    if (RegQueryValueExA( hkey, name, NULL, &type, (BYTE *)buffer, &size )) return def;
+    if (type == REG_DWORD && size == sizeof(DWORD)) return *(DWORD *)buffer;
+    if (type == REG_SZ)
+    {
+        buffer[min( size, sizeof(buffer) - 1 )] = 0;
+        return strtoul( buffer, NULL, 0 );
+    }
+    return def;
+}
+
+static BOOL WINAPI init_render_threads( INIT_ONCE *once, void *param, void **context )
+{
+    TP_POOL *pool;
+    HKEY hkey;
+
+    if (!RegOpenKeyA( HKEY_CURRENT_USER, "Software\\Wine\\DIB Driver", &hkey ))
+    {
+        render_threads   = get_config_dword( hkey, "RenderThreads", 0 );
+        render_threshold = get_config_dword( hkey, "RenderThreshold", render_threshold );
+        RegCloseKey( hkey );
+    }
+    render_threads = min( render_threads, 64 );
+    if (render_threads <= 1) return TRUE;
+
+    if (TpAllocPool( &pool, NULL ))
+    {
+        render_threads = 0;
+        return TRUE;
+    }
+    TpSetPoolMaxThreads( pool, render_threads - 1 );
+    memset( &render_environment, 0, sizeof(render_environment) );
+    render_environment.Version = 1;
+    render_environment.Pool = pool;
+
+    TRACE( "using %u render threads for operations above %u pixels\n", render_threads, render_threshold );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           get_render_bands
+ *
+ * Return the number of bands an operation of the given size should be split into.
+ */
+int get_render_bands( int rows, LONGLONG pixels )
+{
+    int bands;
+
+    InitOnceExecuteOnce( &render_init_once, init_render_threads, NULL, NULL );
+    if (render_threads <= 1 || pixels < render_threshold) return 1;
+
+    /* use a few more bands than threads to even out the load */
+    bands = min( min( render_threads * 2, MAX_RENDER_BANDS ), rows / MIN_BAND_ROWS );
+    return max( bands, 1 );
+}
+
+struct render_job
+{
+    void (*func)( void *ctx, int band );
+    void *ctx;
+    LONG  next;
+    int   count;
+};
+
+static void CALLBACK render_band_callback( TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work )
+{
+    struct render_job *job = userdata;
+    LONG band;
+
+    while ((band = InterlockedIncrement( &job->next ) - 1) < job->count)
+        job->func( job->ctx, band );
+}
+
+/***********************************************************************
+ *           render_bands
+ *
+ * Call func for all bands on the render threads, and wait until they are done.
+ */
+void render_bands( void (*func)( void *ctx, int band ), void *ctx, int count )
+{
+    struct render_job job;
+    TP_WORK *work;
+    int i;
+
+    job.func  = func;
+    job.ctx   = ctx;
+    job.next  = 0;
+    job.count = count;
+
+    if (count > 1 && !TpAllocWork( &work, render_band_callback, &job, &render_environment ))
+    {
+        for (i = 1; i < min( count, render_threads ); i++) TpPostWork( work );
+        /* the calling thread takes part as well */
+        render_band_callback( NULL, &job, work );
+        /* all bands have been claimed, callbacks that didn't start yet have nothing left to do */
+        TpWaitForWork( work, TRUE );
+        TpReleaseWork( work );
+    }
+    else render_band_callback( NULL, &job, NULL );
+}
+
+/* helpers for primitives operating on lists of rectangles */
+
+struct rects_job
+{
+    const dib_info       *dib;
+    int                   num;
+    const RECT           *rects;
+    int                   top;
+    int                   height;
+    int                   count;
+    /* primitive specific parameters */
+    DWORD                 and, xor;
+    const POINT          *origin;
+    const dib_info       *src;
+    const rop_mask_bits  *bits;
+    BLENDFUNCTION         blend;
+    const TRIVERTEX      *vert;
+    int                   mode;
+    BOOL                  ret;
+};
+
+static int init_rects_job( struct rects_job *job, const dib_info *dib, int num, const RECT *rects )
+{
+    LONGLONG pixels = 0;
+    int i, bottom;
+
+    if (!num) return 1;
+
+    job->dib   = dib;
+    job->num   = num;
+    job->rects = rects;
+    job->top   = rects[0].top;
+    bottom     = rects[0].bottom;
+    for (i = 0; i < num; i++)
+    {
+        job->top = min( job->top, rects[i].top );
+        bottom   = max( bottom, rects[i].bottom );
+        pixels  += (LONGLONG)(rects[i].right - rects[i].left) * (rects[i].bottom - rects[i].top);
+    }
+    job->height = bottom - job->top;
+    job->count  = get_render_bands( job->height, pixels );
+    job->ret    = TRUE;
+    return job->count;
+}
+
+/* clip a rectangle to the rows of a band */
+static BOOL get_band_rect( const struct rects_job *job, int band, const RECT *rect, RECT *ret )
+{
+    int top    = job->top + (LONGLONG)job->height * band / job->count;
+    int bottom = job->top + (LONGLONG)job->height * (band + 1) / job->count;
+
+    *ret = *rect;
+    ret->top    = max( ret->top, top );
+    ret->bottom = min( ret->bottom, bottom );
+    return ret->top < ret->bottom;
+}
+
+static void solid_rects_band( void *ctx, int band )
+{
+    struct rects_job *job = ctx;
+    RECT rect;
+    int i;
+
+    for (i = 0; i < job->num; i++)
+        if (get_band_rect( job, band, &job->rects[i], &rect ))
+            job->dib->funcs->solid_rects( job->dib, 1, &rect, job->and, job->xor );
+}
+
+void render_solid_rects( const dib_info *dib, int num, const RECT *rects, DWORD and, DWORD xor )
+{
+    struct rects_job job;
+
+    if (init_rects_job( &job, dib, num, rects ) <= 1)
+    {
+        dib->funcs->solid_rects( dib, num, rects, and, xor );
+        return;
+    }
+    job.and = and;
+    job.xor = xor;
+    render_bands( solid_rects_band, &job, job.count );
+}
+
+static void pattern_rects_band( void *ctx, int band )
+{
+    struct rects_job *job = ctx;
+    RECT rect;
+    int i;
+
+    for (i = 0; i < job->num; i++)
+        if (get_band_rect( job, band, &job->rects[i], &rect ))
+            job->dib->funcs->pattern_rects( job->dib, 1, &rect, job->origin, job->src, job->bits );
+}
+
+void render_pattern_rects( const dib_info *dib, int num, const RECT *rects, const POINT *origin,
+                           const dib_info *brush, const rop_mask_bits *bits )
+{
+    struct rects_job job;
+
+    if (init_rects_job( &job, dib, num, rects ) <= 1)
+    {
+        dib->funcs->pattern_rects( dib, num, rects, origin, brush, bits );
+        return;
+    }
+    job.origin = origin;
+    job.src    = brush;
+    job.bits   = bits;
+    render_bands( pattern_rects_band, &job, job.count );
+}
+
+static void blend_rect_band( void *ctx, int band )
+{
+    struct rects_job *job = ctx;
+    POINT origin;
+    RECT rect;
+
+    if (!get_band_rect( job, band, job->rects, &rect )) return;
+    origin.x = job->origin->x;
+    origin.y = job->origin->y + rect.top - job->rects->top;
+    job->dib->funcs->blend_rect( job->dib, &rect, job->src, &origin, job->blend );
+}
+
+void render_blend_rect( const dib_info *dst, const RECT *rect, const dib_info *src,
+                        const POINT *origin, BLENDFUNCTION blend )
+{
+    struct rects_job job;
+
+    if (init_rects_job( &job, dst, 1, rect ) <= 1)
+    {
+        dst->funcs->blend_rect( dst, rect, src, origin, blend );
+        return;
+    }
+    job.origin = origin;
+    job.src    = src;
+    job.blend  = blend;
+    render_bands( blend_rect_band, &job, job.count );
+}
+
+static void gradient_rect_band( void *ctx, int band )
+{
+    struct rects_job *job = ctx;
+    RECT rect;
+
+    if (!get_band_rect( job, band, job->rects, &rect )) return;
+    if (!job->dib->funcs->gradient_rect( job->dib, &rect, job->vert, job->mode )) job->ret = FALSE;
+}
+
+BOOL render_gradient_rect( const dib_info *dib, const RECT *rect, const TRIVERTEX *vert, int mode )
+{
+    struct rects_job job;
+
+    if (init_rects_job( &job, dib, 1, rect ) <= 1)
+        return dib->funcs->gradient_rect( dib, rect, vert, mode );
+
+    job.vert = vert;
+    job.mode = mode;
+    render_bands( gradient_rect_band, &job, job.count );
+    return job.ret;
+}
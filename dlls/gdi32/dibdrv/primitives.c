@@ -292,8 +292,11 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
-                for(x = rc->left, ptr = start; x < rc->right; x++)
+            {
+                x = simd_funcs.solid_line_32 ? simd_funcs.solid_line_32( start, rc->right - rc->left, and, xor ) : 0;
+                for(ptr = start + x, x += rc->left; x < rc->right; x++)
                     do_rop_32(ptr++, and, xor);
+            }
         else
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 memset_32( start, xor, rc->right - rc->left );
@@ -836,7 +839,7 @@ static void pattern_rects_32(const dib_info *dib, int num, const RECT *rc, const
                              const dib_info *brush, const rop_mask_bits *bits)
 {
     DWORD *ptr, *start, *start_and, *and_ptr, *start_xor, *xor_ptr;
-    int x, y, i, len, brush_x;
+    int x, y, i, len, brush_x, done;
     POINT offset;
 
     for(i = 0; i < num; i++, rc++)
@@ -851,17 +854,17 @@ static void pattern_rects_32(const dib_info *dib, int num, const RECT *rc, const
 
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
             {
-                and_ptr = start_and + offset.x;
-                xor_ptr = start_xor + offset.x;
-
-                for(x = rc->left, ptr = start; x < rc->right; x++)
+                for (x = rc->left, brush_x = offset.x; x < rc->right; x += len)
                 {
-                    do_rop_32(ptr++, *and_ptr++, *xor_ptr++);
-                    if(and_ptr == start_and + brush->width)
-                    {
-                        and_ptr = start_and;
-                        xor_ptr = start_xor;
-                    }
+                    len = min( rc->right - x, brush->width - brush_x );
+                    ptr = start + x - rc->left;
+                    and_ptr = start_and + brush_x;
+                    xor_ptr = start_xor + brush_x;
+
+                    done = simd_funcs.pattern_line_32 ? simd_funcs.pattern_line_32( ptr, and_ptr, xor_ptr, len ) : 0;
+                    for ( ; done < len; done++)
+                        do_rop_32(ptr + done, and_ptr[done], xor_ptr[done]);
+                    brush_x = 0;
                 }
 
                 offset.y++;
@@ -1830,9 +1833,12 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
+                x = simd_funcs.convert_masks_to_8888 ?
+                    simd_funcs.convert_masks_to_8888( dst_start, src_start, src_rect->right - src_rect->left,
+                                                      src->red_shift, src->green_shift, src->blue_shift ) : 0;
+                dst_pixel = dst_start + x;
+                src_pixel = src_start + x;
+                for(x += src_rect->left; x < src_rect->right; x++)
                 {
                     src_val = *src_pixel++;
                     *dst_pixel++ = (((src_val >> src->red_shift)   & 0xff) << 16) |
@@ -1871,9 +1877,11 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
 
         for(y = src_rect->top; y < src_rect->bottom; y++)
         {
-            dst_pixel = dst_start;
-            src_pixel = src_start;
-            for(x = src_rect->left; x < src_rect->right; x++)
+            x = simd_funcs.convert_24_to_8888 ?
+                simd_funcs.convert_24_to_8888( dst_start, src_start, src_rect->right - src_rect->left ) : 0;
+            dst_pixel = dst_start + x;
+            src_pixel = src_start + x * 3;
+            for(x += src_rect->left; x < src_rect->right; x++)
             {
                 RGBQUAD rgb;
                 rgb.rgbBlue  = *src_pixel++;
@@ -1896,9 +1904,11 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
+                x = simd_funcs.convert_555_to_8888 ?
+                    simd_funcs.convert_555_to_8888( dst_start, src_start, src_rect->right - src_rect->left ) : 0;
+                dst_pixel = dst_start + x;
+                src_pixel = src_start + x;
+                for(x += src_rect->left; x < src_rect->right; x++)
                 {
                     src_val = *src_pixel++;
                     *dst_pixel++ = ((src_val << 9) & 0xf80000) | ((src_val << 4) & 0x070000) |
@@ -2322,9 +2332,11 @@ static void convert_to_24(dib_info *dst, const dib_info *src, const RECT *src_re
         {
             for(y = src_rect->top; y < src_rect->bottom; y++)
             {
-                dst_pixel = dst_start;
-                src_pixel = src_start;
-                for(x = src_rect->left; x < src_rect->right; x++)
+                x = simd_funcs.convert_8888_to_24 ?
+                    simd_funcs.convert_8888_to_24( dst_start, src_start, src_rect->right - src_rect->left ) : 0;
+                dst_pixel = dst_start + x * 3;
+                src_pixel = src_start + x;
+                for(x += src_rect->left; x < src_rect->right; x++)
                 {
                     src_val = *src_pixel++;
                     *dst_pixel++ =  src_val        & 0xff;
@@ -4187,27 +4199,42 @@ static void blend_rect_8888(const dib_info *dst, const RECT *rc,
 {
     DWORD *src_ptr = get_pixel_ptr_32( src, origin->x, origin->y );
     DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
-    int x, y;
+    int x, y, len = rc->right - rc->left;
 
     if (blend.AlphaFormat & AC_SRC_ALPHA)
     {
-	if (blend.SourceConstantAlpha == 255)
-	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
-		    dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+        if (blend.SourceConstantAlpha == 255)
+            for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+            {
+                x = simd_funcs.blend_argb ? simd_funcs.blend_argb( dst_ptr, src_ptr, len ) : 0;
+                for ( ; x < len; x++)
+                    dst_ptr[x] = blend_argb( dst_ptr[x], src_ptr[x] );
+            }
         else
-	    for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-		for (x = 0; x < rc->right - rc->left; x++)
-		    dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+            for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+            {
+                x = simd_funcs.blend_argb_alpha ?
+                    simd_funcs.blend_argb_alpha( dst_ptr, src_ptr, len, blend.SourceConstantAlpha ) : 0;
+                for ( ; x < len; x++)
+                    dst_ptr[x] = blend_argb_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+            }
     }
     else if (src->compression == BI_RGB)
-	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
-		dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+        {
+            x = simd_funcs.blend_constant_alpha ?
+                simd_funcs.blend_constant_alpha( dst_ptr, src_ptr, len, blend.SourceConstantAlpha, 0 ) : 0;
+            for ( ; x < len; x++)
+                dst_ptr[x] = blend_argb_constant_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        }
     else
-	for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
-	    for (x = 0; x < rc->right - rc->left; x++)
-		dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+        {
+            x = simd_funcs.blend_constant_alpha ?
+                simd_funcs.blend_constant_alpha( dst_ptr, src_ptr, len, blend.SourceConstantAlpha, 0xff000000 ) : 0;
+            for ( ; x < len; x++)
+                dst_ptr[x] = blend_argb_no_src_alpha( dst_ptr[x], src_ptr[x], blend.SourceConstantAlpha );
+        }
 }
 
 static void blend_rect_32(const dib_info *dst, const RECT *rc,
@@ -0,0 +1,432 @@
+/*
+ * DIB driver vectorized primitives.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "gdi_private.h"
+#include "dibdrv.h"
+
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(dib);
+
+/* The kernels below process the bulk of a scanline and return the number of
+ * pixels they handled, the caller finishes the remaining pixels with the
+ * generic code. They have to produce exactly the same results. */
+
+simd_primitive_funcs simd_funcs;
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && !defined(__clang__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+/* (v + 127) / 255, valid for v <= 255 * 255 */
+static inline SSE2_FUNC __m128i div255_sse2( __m128i v )
+{
+    v = _mm_add_epi16( v, _mm_set1_epi16( 128 ));
+    return _mm_srli_epi16( _mm_add_epi16( v, _mm_srli_epi16( v, 8 )), 8 );
+}
+
+/* Pack 16-bit channel values of up to 9 bits back into pixels. The generic code
+ * combines the channels with |, so bit 8 of a channel ends up in bit 0 of the next one. */
+static inline SSE2_FUNC __m128i pack_argb_sse2( __m128i lo, __m128i hi )
+{
+    __m128i mask = _mm_set1_epi16( 0xff );
+    __m128i low = _mm_packus_epi16( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ));
+    __m128i carry = _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ));
+    return _mm_or_si128( low, _mm_slli_epi32( carry, 8 ));
+}
+
+static inline SSE2_FUNC __m128i broadcast_alpha_sse2( __m128i v )
+{
+    return _mm_shufflehi_epi16( _mm_shufflelo_epi16( v, 0xff ), 0xff );
+}
+
+/* src + dst * (255 - src alpha) / 255 on 16-bit channels */
+static inline SSE2_FUNC __m128i blend_premultiplied_sse2( __m128i dst, __m128i src )
+{
+    __m128i inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), broadcast_alpha_sse2( src ));
+    return _mm_add_epi16( src, div255_sse2( _mm_mullo_epi16( dst, inv )));
+}
+
+static int SSE2_FUNC solid_line_32_sse2( DWORD *dst, int len, DWORD and, DWORD xor )
+{
+    __m128i and_vec = _mm_set1_epi32( and ), xor_vec = _mm_set1_epi32( xor );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i d = _mm_loadu_si128( (__m128i *)(dst + x) );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_xor_si128( _mm_and_si128( d, and_vec ), xor_vec ));
+    }
+    return x;
+}
+
+static int SSE2_FUNC pattern_line_32_sse2( DWORD *dst, const DWORD *and, const DWORD *xor, int len )
+{
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i d = _mm_loadu_si128( (__m128i *)(dst + x) );
+        d = _mm_and_si128( d, _mm_loadu_si128( (const __m128i *)(and + x) ));
+        d = _mm_xor_si128( d, _mm_loadu_si128( (const __m128i *)(xor + x) ));
+        _mm_storeu_si128( (__m128i *)(dst + x), d );
+    }
+    return x;
+}
+
+static int SSE2_FUNC blend_argb_sse2( DWORD *dst, const DWORD *src, int len )
+{
+    __m128i zero = _mm_setzero_si128();
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i d = _mm_loadu_si128( (__m128i *)(dst + x) );
+        __m128i lo = blend_premultiplied_sse2( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( s, zero ));
+        __m128i hi = blend_premultiplied_sse2( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( s, zero ));
+        _mm_storeu_si128( (__m128i *)(dst + x), pack_argb_sse2( lo, hi ));
+    }
+    return x;
+}
+
+static int SSE2_FUNC blend_argb_alpha_sse2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    __m128i zero = _mm_setzero_si128(), a = _mm_set1_epi16( alpha );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i d = _mm_loadu_si128( (__m128i *)(dst + x) );
+        __m128i s_lo = div255_sse2( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), a ));
+        __m128i s_hi = div255_sse2( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), a ));
+        __m128i lo = blend_premultiplied_sse2( _mm_unpacklo_epi8( d, zero ), s_lo );
+        __m128i hi = blend_premultiplied_sse2( _mm_unpackhi_epi8( d, zero ), s_hi );
+        _mm_storeu_si128( (__m128i *)(dst + x), pack_argb_sse2( lo, hi ));
+    }
+    return x;
+}
+
+static int SSE2_FUNC blend_constant_alpha_sse2( DWORD *dst, const DWORD *src, int len,
+                                                DWORD alpha, DWORD src_or )
+{
+    __m128i zero = _mm_setzero_si128(), or = _mm_set1_epi32( src_or );
+    __m128i a = _mm_set1_epi16( alpha ), inv = _mm_set1_epi16( 255 - alpha );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)(src + x) ), or );
+        __m128i d = _mm_loadu_si128( (__m128i *)(dst + x) );
+        __m128i lo = div255_sse2( _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( s, zero ), a ),
+                                                 _mm_mullo_epi16( _mm_unpacklo_epi8( d, zero ), inv )));
+        __m128i hi = div255_sse2( _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( s, zero ), a ),
+                                                 _mm_mullo_epi16( _mm_unpackhi_epi8( d, zero ), inv )));
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_packus_epi16( lo, hi ));
+    }
+    return x;
+}
+
+static inline SSE2_FUNC __m128i convert_555_to_8888_sse2( __m128i v )
+{
+    return _mm_or_si128(
+        _mm_or_si128( _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 9 ), _mm_set1_epi32( 0xf80000 )),
+                                    _mm_and_si128( _mm_slli_epi32( v, 4 ), _mm_set1_epi32( 0x070000 ))),
+                      _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 6 ), _mm_set1_epi32( 0x00f800 )),
+                                    _mm_and_si128( _mm_slli_epi32( v, 1 ), _mm_set1_epi32( 0x000700 )))),
+        _mm_or_si128( _mm_and_si128( _mm_slli_epi32( v, 3 ), _mm_set1_epi32( 0x0000f8 )),
+                      _mm_and_si128( _mm_srli_epi32( v, 2 ), _mm_set1_epi32( 0x000007 ))));
+}
+
+static int SSE2_FUNC convert_555_to_8888_line_sse2( DWORD *dst, const WORD *src, int len )
+{
+    __m128i zero = _mm_setzero_si128();
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        _mm_storeu_si128( (__m128i *)(dst + x), convert_555_to_8888_sse2( _mm_unpacklo_epi16( s, zero )));
+        _mm_storeu_si128( (__m128i *)(dst + x + 4), convert_555_to_8888_sse2( _mm_unpackhi_epi16( s, zero )));
+    }
+    return x;
+}
+
+static int SSE2_FUNC convert_masks_to_8888_line_sse2( DWORD *dst, const DWORD *src, int len,
+                                                      int red_shift, int green_shift, int blue_shift )
+{
+    __m128i r_shift = _mm_cvtsi32_si128( red_shift );
+    __m128i g_shift = _mm_cvtsi32_si128( green_shift );
+    __m128i b_shift = _mm_cvtsi32_si128( blue_shift );
+    __m128i mask = _mm_set1_epi32( 0xff );
+    int x;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        __m128i r = _mm_slli_epi32( _mm_and_si128( _mm_srl_epi32( s, r_shift ), mask ), 16 );
+        __m128i g = _mm_slli_epi32( _mm_and_si128( _mm_srl_epi32( s, g_shift ), mask ), 8 );
+        __m128i b = _mm_and_si128( _mm_srl_epi32( s, b_shift ), mask );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_or_si128( _mm_or_si128( r, g ), b ));
+    }
+    return x;
+}
+
+/* AVX2 versions, the in-lane unpack and pack instructions keep the pixel order intact */
+
+static inline AVX2_FUNC __m256i div255_avx2( __m256i v )
+{
+    v = _mm256_add_epi16( v, _mm256_set1_epi16( 128 ));
+    return _mm256_srli_epi16( _mm256_add_epi16( v, _mm256_srli_epi16( v, 8 )), 8 );
+}
+
+static inline AVX2_FUNC __m256i pack_argb_avx2( __m256i lo, __m256i hi )
+{
+    __m256i mask = _mm256_set1_epi16( 0xff );
+    __m256i low = _mm256_packus_epi16( _mm256_and_si256( lo, mask ), _mm256_and_si256( hi, mask ));
+    __m256i carry = _mm256_packus_epi16( _mm256_srli_epi16( lo, 8 ), _mm256_srli_epi16( hi, 8 ));
+    return _mm256_or_si256( low, _mm256_slli_epi32( carry, 8 ));
+}
+
+static inline AVX2_FUNC __m256i blend_premultiplied_avx2( __m256i dst, __m256i src )
+{
+    __m256i alpha = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( src, 0xff ), 0xff );
+    __m256i inv = _mm256_sub_epi16( _mm256_set1_epi16( 255 ), alpha );
+    return _mm256_add_epi16( src, div255_avx2( _mm256_mullo_epi16( dst, inv )));
+}
+
+static int AVX2_FUNC solid_line_32_avx2( DWORD *dst, int len, DWORD and, DWORD xor )
+{
+    __m256i and_vec = _mm256_set1_epi32( and ), xor_vec = _mm256_set1_epi32( xor );
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i d = _mm256_loadu_si256( (__m256i *)(dst + x) );
+        _mm256_storeu_si256( (__m256i *)(dst + x), _mm256_xor_si256( _mm256_and_si256( d, and_vec ), xor_vec ));
+    }
+    return x;
+}
+
+static int AVX2_FUNC pattern_line_32_avx2( DWORD *dst, const DWORD *and, const DWORD *xor, int len )
+{
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i d = _mm256_loadu_si256( (__m256i *)(dst + x) );
+        d = _mm256_and_si256( d, _mm256_loadu_si256( (const __m256i *)(and + x) ));
+        d = _mm256_xor_si256( d, _mm256_loadu_si256( (const __m256i *)(xor + x) ));
+        _mm256_storeu_si256( (__m256i *)(dst + x), d );
+    }
+    return x;
+}
+
+static int AVX2_FUNC blend_argb_avx2( DWORD *dst, const DWORD *src, int len )
+{
+    __m256i zero = _mm256_setzero_si256();
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)(src + x) );
+        __m256i d = _mm256_loadu_si256( (__m256i *)(dst + x) );
+        __m256i lo = blend_premultiplied_avx2( _mm256_unpacklo_epi8( d, zero ), _mm256_unpacklo_epi8( s, zero ));
+        __m256i hi = blend_premultiplied_avx2( _mm256_unpackhi_epi8( d, zero ), _mm256_unpackhi_epi8( s, zero ));
+        _mm256_storeu_si256( (__m256i *)(dst + x), pack_argb_avx2( lo, hi ));
+    }
+    return x;
+}
+
+static int AVX2_FUNC blend_argb_alpha_avx2( DWORD *dst, const DWORD *src, int len, DWORD alpha )
+{
+    __m256i zero = _mm256_setzero_si256(), a = _mm256_set1_epi16( alpha );
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)(src + x) );
+        __m256i d = _mm256_loadu_si256( (__m256i *)(dst + x) );
+        __m256i s_lo = div255_avx2( _mm256_mullo_epi16( _mm256_unpacklo_epi8( s, zero ), a ));
+        __m256i s_hi = div255_avx2( _mm256_mullo_epi16( _mm256_unpackhi_epi8( s, zero ), a ));
+        __m256i lo = blend_premultiplied_avx2( _mm256_unpacklo_epi8( d, zero ), s_lo );
+        __m256i hi = blend_premultiplied_avx2( _mm256_unpackhi_epi8( d, zero ), s_hi );
+        _mm256_storeu_si256( (__m256i *)(dst + x), pack_argb_avx2( lo, hi ));
+    }
+    return x;
+}
+
+static int AVX2_FUNC blend_constant_alpha_avx2( DWORD *dst, const DWORD *src, int len,
+                                                DWORD alpha, DWORD src_or )
+{
+    __m256i zero = _mm256_setzero_si256(), or = _mm256_set1_epi32( src_or );
+    __m256i a = _mm256_set1_epi16( alpha ), inv = _mm256_set1_epi16( 255 - alpha );
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i s = _mm256_or_si256( _mm256_loadu_si256( (const __m256i *)(src + x) ), or );
+        __m256i d = _mm256_loadu_si256( (__m256i *)(dst + x) );
+        __m256i lo = div255_avx2( _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpacklo_epi8( s, zero ), a ),
+                                                    _mm256_mullo_epi16( _mm256_unpacklo_epi8( d, zero ), inv )));
+        __m256i hi = div255_avx2( _mm256_add_epi16( _mm256_mullo_epi16( _mm256_unpackhi_epi8( s, zero ), a ),
+                                                    _mm256_mullo_epi16( _mm256_unpackhi_epi8( d, zero ), inv )));
+        _mm256_storeu_si256( (__m256i *)(dst + x), _mm256_packus_epi16( lo, hi ));
+    }
+    return x;
+}
+
+static int AVX2_FUNC convert_555_to_8888_line_avx2( DWORD *dst, const WORD *src, int len )
+{
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)(src + x) ));
+        v = _mm256_or_si256(
+            _mm256_or_si256( _mm256_or_si256( _mm256_and_si256( _mm256_slli_epi32( v, 9 ), _mm256_set1_epi32( 0xf80000 )),
+                                              _mm256_and_si256( _mm256_slli_epi32( v, 4 ), _mm256_set1_epi32( 0x070000 ))),
+                             _mm256_or_si256( _mm256_and_si256( _mm256_slli_epi32( v, 6 ), _mm256_set1_epi32( 0x00f800 )),
+                                              _mm256_and_si256( _mm256_slli_epi32( v, 1 ), _mm256_set1_epi32( 0x000700 )))),
+            _mm256_or_si256( _mm256_and_si256( _mm256_slli_epi32( v, 3 ), _mm256_set1_epi32( 0x0000f8 )),
+                             _mm256_and_si256( _mm256_srli_epi32( v, 2 ), _mm256_set1_epi32( 0x000007 ))));
+        _mm256_storeu_si256( (__m256i *)(dst + x), v );
+    }
+    return x;
+}
+
+static int AVX2_FUNC convert_masks_to_8888_line_avx2( DWORD *dst, const DWORD *src, int len,
+                                                      int red_shift, int green_shift, int blue_shift )
+{
+    __m128i r_shift = _mm_cvtsi32_si128( red_shift );
+    __m128i g_shift = _mm_cvtsi32_si128( green_shift );
+    __m128i b_shift = _mm_cvtsi32_si128( blue_shift );
+    __m256i mask = _mm256_set1_epi32( 0xff );
+    int x;
+
+    for (x = 0; x + 8 <= len; x += 8)
+    {
+        __m256i s = _mm256_loadu_si256( (const __m256i *)(src + x) );
+        __m256i r = _mm256_slli_epi32( _mm256_and_si256( _mm256_srl_epi32( s, r_shift ), mask ), 16 );
+        __m256i g = _mm256_slli_epi32( _mm256_and_si256( _mm256_srl_epi32( s, g_shift ), mask ), 8 );
+        __m256i b = _mm256_and_si256( _mm256_srl_epi32( s, b_shift ), mask );
+        _mm256_storeu_si256( (__m256i *)(dst + x), _mm256_or_si256( _mm256_or_si256( r, g ), b ));
+    }
+    return x;
+}
+
+/* 24-bpp conversions need a byte shuffle, which AVX2 capable cpus always have */
+
+static int AVX2_FUNC convert_24_to_8888_line_avx2( DWORD *dst, const BYTE *src, int len )
+{
+    __m128i shuffle = _mm_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+    int x;
+
+    /* each load reads 16 bytes for 4 pixels, stay within the source line */
+    for (x = 0; x + 6 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x * 3) );
+        _mm_storeu_si128( (__m128i *)(dst + x), _mm_shuffle_epi8( s, shuffle ));
+    }
+    return x;
+}
+
+static int AVX2_FUNC convert_8888_to_24_line_avx2( BYTE *dst, const DWORD *src, int len )
+{
+    __m128i shuffle = _mm_setr_epi8( 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 );
+    int x;
+
+    /* each store writes 16 bytes for 4 pixels, the excess is overwritten by the next pixels */
+    for (x = 0; x + 6 <= len; x += 4)
+    {
+        __m128i s = _mm_loadu_si128( (const __m128i *)(src + x) );
+        _mm_storeu_si128( (__m128i *)(dst + x * 3), _mm_shuffle_epi8( s, shuffle ));
+    }
+    return x;
+}
+
+static const simd_primitive_funcs simd_funcs_sse2 =
+{
+    solid_line_32_sse2,
+    pattern_line_32_sse2,
+    blend_argb_sse2,
+    blend_argb_alpha_sse2,
+    blend_constant_alpha_sse2,
+    convert_555_to_8888_line_sse2,
+    convert_masks_to_8888_line_sse2,
+    NULL,
+    NULL
+};
+
+static const simd_primitive_funcs simd_funcs_avx2 =
+{
+    solid_line_32_avx2,
+    pattern_line_32_avx2,
+    blend_argb_avx2,
+    blend_argb_alpha_avx2,
+    blend_constant_alpha_avx2,
+    convert_555_to_8888_line_avx2,
+    convert_masks_to_8888_line_avx2,
+    convert_24_to_8888_line_avx2,
+    convert_8888_to_24_line_avx2
+};
+
+static BOOL have_avx2(void)
+{
+    unsigned int eax, ebx, ecx, edx, xcr0;
+
+    if (__get_cpuid_max( 0, NULL ) < 7) return FALSE;
+
+    __cpuid( 1, eax, ebx, ecx, edx );
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) return FALSE;
+
+    /* check that the OS saves the ymm registers */
+    __asm__( ".byte 0x0f, 0x01, 0xd0" /* xgetbv */ : "=a" (xcr0), "=d" (edx) : "c" (0) );
+    if ((xcr0 & 6) != 6) return FALSE;
+
+    __cpuid_count( 7, 0, eax, ebx, ecx, edx );
+    return (ebx & (1 << 5)) != 0;
+}
+
+void init_simd_funcs(void)
+{
+    if (have_avx2())
+    {
+        TRACE( "using AVX2 primitives\n" );
+        simd_funcs = simd_funcs_avx2;
+    }
+    else if (IsProcessorFeaturePresent( PF_XMMI64_INSTRUCTIONS_AVAILABLE ))
+    {
+        TRACE( "using SSE2 primitives\n" );
+        simd_funcs = simd_funcs_sse2;
+    }
+}
+
+#else  /* __i386__ || __x86_64__ */
+
+void init_simd_funcs(void)
+{
+}
+
+#endif  /* __i386__ || __x86_64__ */
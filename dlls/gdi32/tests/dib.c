@@ -20,12 +20,14 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include "windef.h"
 #include "winbase.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "wincrypt.h"
 #include "mmsystem.h" /* DIBINDEX */
 
@@ -3330,16 +3332,497 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static const struct
+{
+    const char *name;
+    WORD bpp;
+    DWORD compression;
+    DWORD masks[3];
+} perf_formats[] =
+{
+    { "8888",  32, BI_RGB },
+    { "32bgr", 32, BI_BITFIELDS, { 0x0000ff, 0x00ff00, 0xff0000 } },
+    { "24",    24, BI_RGB },
+    { "555",   16, BI_RGB },
+    { "565",   16, BI_BITFIELDS, { 0xf800, 0x07e0, 0x001f } },
+    { "8",      8, BI_RGB },
+};
+
+static HBITMAP create_perf_dib( int format, int width, int height, void **bits )
+{
+    char bmibuf[sizeof(BITMAPINFO) + 256 * sizeof(RGBQUAD)];
+    BITMAPINFO *bmi = (BITMAPINFO *)bmibuf;
+    int i;
+
+    memset( bmibuf, 0, sizeof(bmibuf) );
+    bmi->bmiHeader.biSize = sizeof(bmi->bmiHeader);
+    bmi->bmiHeader.biWidth = width;
+    bmi->bmiHeader.biHeight = -height;
+    bmi->bmiHeader.biPlanes = 1;
+    bmi->bmiHeader.biBitCount = perf_formats[format].bpp;
+    bmi->bmiHeader.biCompression = perf_formats[format].compression;
+    if (perf_formats[format].compression == BI_BITFIELDS)
+        memcpy( bmi->bmiColors, perf_formats[format].masks, sizeof(perf_formats[format].masks) );
+    else if (perf_formats[format].bpp == 8)
+        for (i = 0; i < 256; i++)
+        {
+            bmi->bmiColors[i].rgbRed   = i;
+            bmi->bmiColors[i].rgbGreen = i * 3;
+            bmi->bmiColors[i].rgbBlue  = i * 7;
+        }
+    return CreateDIBSection( 0, bmi, DIB_RGB_COLORS, bits, NULL, 0 );
+}
+
+static void trace_perf( const char *format, const char *op, LARGE_INTEGER *start, int pixels )
+{
+    LARGE_INTEGER end, freq;
+    double seconds;
+
+    QueryPerformanceCounter( &end );
+    QueryPerformanceFrequency( &freq );
+    seconds = (double)(end.QuadPart - start->QuadPart) / freq.QuadPart;
+    trace( "%-6s %-28s %8.1f Mpixels/s\n", format, op, pixels / seconds / 1000000.0 );
+}
+
+static void test_performance(void)
+{
+    static const int width = 1024, height = 768, iterations = 20;
+    const int pixels = width * height * iterations;
+    HBITMAP dib, src_dib, orig_bm, orig_src_bm;
+    HBRUSH solid_brush, hatch_brush, orig_brush;
+    BLENDFUNCTION blend;
+    TRIVERTEX vertices[2];
+    GRADIENT_RECT rect = { 0, 1 };
+    LARGE_INTEGER start;
+    HDC mem_dc, src_dc;
+    DWORD *src_bits;
+    void *bits;
+    char name[32];
+    int i, j, k;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+
+    mem_dc = CreateCompatibleDC( NULL );
+    src_dc = CreateCompatibleDC( NULL );
+    solid_brush = CreateSolidBrush( RGB( 0x12, 0x34, 0x56 ) );
+    hatch_brush = CreateHatchBrush( HS_DIAGCROSS, RGB( 0xab, 0xcd, 0xef ) );
+
+    vertices[0].x = 0;
+    vertices[0].y = 0;
+    vertices[0].Red = 0x1000;
+    vertices[0].Green = 0x8000;
+    vertices[0].Blue = 0xff00;
+    vertices[0].Alpha = 0x4000;
+    vertices[1].x = width;
+    vertices[1].y = height;
+    vertices[1].Red = 0xff00;
+    vertices[1].Green = 0x2000;
+    vertices[1].Blue = 0x0000;
+    vertices[1].Alpha = 0xc000;
+
+    for (i = 0; i < sizeof(perf_formats) / sizeof(perf_formats[0]); i++)
+    {
+        dib = create_perf_dib( i, width, height, &bits );
+        ok( dib != NULL, "failed to create %s dib\n", perf_formats[i].name );
+        orig_bm = SelectObject( mem_dc, dib );
+
+        orig_brush = SelectObject( mem_dc, solid_brush );
+        QueryPerformanceCounter( &start );
+        for (k = 0; k < iterations; k++) PatBlt( mem_dc, 0, 0, width, height, PATCOPY );
+        trace_perf( perf_formats[i].name, "solid fill", &start, pixels );
+
+        QueryPerformanceCounter( &start );
+        for (k = 0; k < iterations; k++) PatBlt( mem_dc, 0, 0, width, height, PATINVERT );
+        trace_perf( perf_formats[i].name, "solid invert", &start, pixels );
+
+        SelectObject( mem_dc, hatch_brush );
+        QueryPerformanceCounter( &start );
+        for (k = 0; k < iterations; k++) PatBlt( mem_dc, 0, 0, width, height, PATCOPY );
+        trace_perf( perf_formats[i].name, "pattern fill", &start, pixels );
+
+        QueryPerformanceCounter( &start );
+        for (k = 0; k < iterations; k++) PatBlt( mem_dc, 0, 0, width, height, PATINVERT );
+        trace_perf( perf_formats[i].name, "pattern invert", &start, pixels );
+        SelectObject( mem_dc, orig_brush );
+
+        if (pGdiGradientFill)
+        {
+            QueryPerformanceCounter( &start );
+            for (k = 0; k < iterations; k++) pGdiGradientFill( mem_dc, vertices, 2, &rect, 1, GRADIENT_FILL_RECT_H );
+            trace_perf( perf_formats[i].name, "gradient fill", &start, pixels );
+        }
+
+        if (pGdiAlphaBlend)
+        {
+            src_dib = create_perf_dib( 0, width, height, (void **)&src_bits );
+            orig_src_bm = SelectObject( src_dc, src_dib );
+            for (k = 0; k < width * height; k++)
+            {
+                /* premultiplied pixels with varying alpha */
+                DWORD alpha = (BYTE)(k * 7);
+                src_bits[k] = alpha << 24 | (BYTE)(k * 3) * alpha / 255 << 16 |
+                              (BYTE)(k * 5) * alpha / 255 << 8 | (BYTE)(k * 11) * alpha / 255;
+            }
+
+            blend.BlendOp = AC_SRC_OVER;
+            blend.BlendFlags = 0;
+            blend.SourceConstantAlpha = 255;
+            blend.AlphaFormat = AC_SRC_ALPHA;
+            QueryPerformanceCounter( &start );
+            for (k = 0; k < iterations; k++)
+                pGdiAlphaBlend( mem_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+            trace_perf( perf_formats[i].name, "alpha blend per-pixel", &start, pixels );
+
+            blend.SourceConstantAlpha = 128;
+            QueryPerformanceCounter( &start );
+            for (k = 0; k < iterations; k++)
+                pGdiAlphaBlend( mem_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+            trace_perf( perf_formats[i].name, "alpha blend both", &start, pixels );
+
+            blend.AlphaFormat = 0;
+            QueryPerformanceCounter( &start );
+            for (k = 0; k < iterations; k++)
+                pGdiAlphaBlend( mem_dc, 0, 0, width, height, src_dc, 0, 0, width, height, blend );
+            trace_perf( perf_formats[i].name, "alpha blend constant", &start, pixels );
+
+            SelectObject( src_dc, orig_src_bm );
+            DeleteObject( src_dib );
+        }
+
+        /* format conversions from all the other formats */
+        for (j = 0; j < sizeof(perf_formats) / sizeof(perf_formats[0]); j++)
+        {
+            if (j == i) continue;
+            src_dib = create_perf_dib( j, width, height, (void **)&src_bits );
+            orig_src_bm = SelectObject( src_dc, src_dib );
+            PatBlt( src_dc, 0, 0, width, height, WHITENESS );
+
+            QueryPerformanceCounter( &start );
+            for (k = 0; k < iterations; k++)
+                BitBlt( mem_dc, 0, 0, width, height, src_dc, 0, 0, SRCCOPY );
+            sprintf( name, "convert from %s", perf_formats[j].name );
+            trace_perf( perf_formats[i].name, name, &start, pixels );
+
+            SelectObject( src_dc, orig_src_bm );
+            DeleteObject( src_dib );
+        }
+
+        SelectObject( mem_dc, orig_bm );
+        DeleteObject( dib );
+    }
+
+    DeleteObject( solid_brush );
+    DeleteObject( hatch_brush );
+    DeleteDC( src_dc );
+    DeleteDC( mem_dc );
+}
+
+static DWORD checksum_bits( const void *bits, int size )
+{
+    const BYTE *ptr = bits;
+    DWORD sum = 0;
+    int i;
+
+    for (i = 0; i < size; i++) sum = (sum << 5) + (sum >> 27) + ptr[i];
+    return sum;
+}
+
+#define RENDER_OPS 5
+
+static const char * const render_op_names[RENDER_OPS] =
+{
+    "pattern fill", "gradient fill", "stretch blt", "shrink blt", "alpha blend"
+};
+
+/* runs in a child process, as the render thread count is only read once */
+static void render_child( int width, int height, int iterations, const char *name, DWORD *sums )
+{
+    const int pixels = width * height * iterations;
+    HBITMAP dib, src_dib, orig_bm, orig_src_bm;
+    HBRUSH hatch_brush, orig_brush;
+    BLENDFUNCTION blend;
+    TRIVERTEX vertices[2];
+    GRADIENT_RECT rect = { 0, 1 };
+    LARGE_INTEGER start;
+    HDC mem_dc, src_dc;
+    DWORD *src_bits;
+    void *bits;
+    int i, k;
+
+    mem_dc = CreateCompatibleDC( NULL );
+    src_dc = CreateCompatibleDC( NULL );
+    hatch_brush = CreateHatchBrush( HS_DIAGCROSS, RGB( 0xab, 0xcd, 0xef ) );
+    dib = create_perf_dib( 0, width, height, &bits );
+    src_dib = create_perf_dib( 0, width / 3, height / 3, (void **)&src_bits );
+    orig_bm = SelectObject( mem_dc, dib );
+    orig_src_bm = SelectObject( src_dc, src_dib );
+    for (i = 0; i < width / 3 * (height / 3); i++) src_bits[i] = (i * 0x01020304) | 0x40000000;
+
+    orig_brush = SelectObject( mem_dc, hatch_brush );
+    QueryPerformanceCounter( &start );
+    for (k = 0; k < iterations; k++) PatBlt( mem_dc, 0, 0, width, height, PATCOPY );
+    if (name) trace_perf( name, "pattern fill", &start, pixels );
+    sums[0] = checksum_bits( bits, width * height * 4 );
+    SelectObject( mem_dc, orig_brush );
+
+    vertices[0].x = 0;
+    vertices[0].y = 0;
+    vertices[0].Red = 0x1000;
+    vertices[0].Green = 0x8000;
+    vertices[0].Blue = 0xff00;
+    vertices[0].Alpha = 0x4000;
+    vertices[1].x = width;
+    vertices[1].y = height;
+    vertices[1].Red = 0xff00;
+    vertices[1].Green = 0x2000;
+    vertices[1].Blue = 0x0000;
+    vertices[1].Alpha = 0xc000;
+    if (pGdiGradientFill)
+    {
+        QueryPerformanceCounter( &start );
+        for (k = 0; k < iterations; k++)
+            pGdiGradientFill( mem_dc, vertices, 2, &rect, 1, GRADIENT_FILL_RECT_V );
+        if (name) trace_perf( name, "gradient fill", &start, pixels );
+        sums[1] = checksum_bits( bits, width * height * 4 );
+    }
+
+    QueryPerformanceCounter( &start );
+    for (k = 0; k < iterations; k++)
+        StretchBlt( mem_dc, 0, 0, width, height, src_dc, 0, 0, width / 3, height / 3, SRCCOPY );
+    if (name) trace_perf( name, "stretch blt", &start, pixels );
+    sums[2] = checksum_bits( bits, width * height * 4 );
+
+    SetStretchBltMode( src_dc, HALFTONE );
+    QueryPerformanceCounter( &start );
+    for (k = 0; k < iterations; k++)
+        StretchBlt( src_dc, 0, 0, width / 3, height / 3, mem_dc, 0, 0, width, height, SRCCOPY );
+    if (name) trace_perf( name, "shrink blt", &start, pixels );
+    sums[3] = checksum_bits( src_bits, width / 3 * (height / 3) * 4 );
+
+    if (pGdiAlphaBlend)
+    {
+        blend.BlendOp = AC_SRC_OVER;
+        blend.BlendFlags = 0;
+        blend.SourceConstantAlpha = 0x80;
+        blend.AlphaFormat = AC_SRC_ALPHA;
+        QueryPerformanceCounter( &start );
+        for (k = 0; k < iterations; k++)
+            pGdiAlphaBlend( mem_dc, 0, 0, width, height, src_dc, 0, 0, width / 3, height / 3, blend );
+        if (name) trace_perf( name, "alpha blend", &start, pixels );
+        sums[4] = checksum_bits( bits, width * height * 4 );
+    }
+
+    SelectObject( src_dc, orig_src_bm );
+    SelectObject( mem_dc, orig_bm );
+    DeleteObject( src_dib );
+    DeleteObject( dib );
+    DeleteObject( hatch_brush );
+    DeleteDC( src_dc );
+    DeleteDC( mem_dc );
+}
+
+static void render_child_main( const char *mode, int threads, const char *handle )
+{
+    HANDLE mapping = NULL;
+    DWORD *sums;
+    char name[16];
+
+    sscanf( handle, "%p", &mapping );
+    sums = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+
+    ok( sums != NULL, "MapViewOfFile failed, error %u\n", GetLastError() );
+    if (!sums) return;
+
+    if (!strcmp( mode, "perf_scaling" ))
+    {
+        sprintf( name, "%2d thr", threads );
+        render_child( 8192, 2048, 5, name, sums );
+    }
+    else render_child( 256, 192, 1, NULL, sums );
+
+    UnmapViewOfFile( sums );
+    CloseHandle( mapping );
+}
+
+static const char render_key[] = "Software\\Wine\\DIB Driver";
+static const char * const render_values[] = { "RenderThreads", "RenderThreshold" };
+
+/* the user configuration, restored once the test is done */
+struct render_config
+{
+    HKEY  hkey;
+    BOOL  created;
+    DWORD type[2];
+    DWORD size[2];
+    BYTE  data[2][64];
+};
+
+static BOOL save_render_config( struct render_config *config )
+{
+    DWORD disposition;
+    int i;
+
+    if (RegCreateKeyExA( HKEY_CURRENT_USER, render_key, 0, NULL, 0, KEY_ALL_ACCESS, NULL,
+                         &config->hkey, &disposition ))
+        return FALSE;
+    config->created = disposition == REG_CREATED_NEW_KEY;
+    for (i = 0; i < 2; i++)
+    {
+        config->size[i] = sizeof(config->data[i]);
+        if (RegQueryValueExA( config->hkey, render_values[i], NULL, &config->type[i],
+                              config->data[i], &config->size[i] ))
+            config->size[i] = ~0u;
+    }
+    return TRUE;
+}
+
+static void restore_render_config( struct render_config *config )
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (config->size[i] == ~0u) RegDeleteValueA( config->hkey, render_values[i] );
+        else RegSetValueExA( config->hkey, render_values[i], 0, config->type[i],
+                             config->data[i], config->size[i] );
+    }
+    RegCloseKey( config->hkey );
+    if (config->created) RegDeleteKeyA( HKEY_CURRENT_USER, render_key );
+}
+
+static BOOL run_render_child( HKEY hkey, const char *mode, DWORD threads, DWORD timeout, DWORD *sums )
+{
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH + 64];
+    char **argv;
+    HANDLE mapping;
+    DWORD *view, ret;
+
+    RegSetValueExA( hkey, "RenderThreads", 0, REG_DWORD, (const BYTE *)&threads, sizeof(threads) );
+
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, &sa, PAGE_READWRITE, 0,
+                                  RENDER_OPS * sizeof(DWORD), NULL );
+    ok( mapping != NULL, "CreateFileMapping failed, error %u\n", GetLastError() );
+    if (!mapping) return FALSE;
+
+    winetest_get_mainargs( &argv );
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( cmdline, "\"%s\" dib %s %u %p", argv[0], mode, threads, mapping );
+    ret = CreateProcessA( NULL, cmdline, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "CreateProcess failed, error %u\n", GetLastError() );
+    if (!ret)
+    {
+        CloseHandle( mapping );
+        return FALSE;
+    }
+
+    ret = WaitForSingleObject( info.hProcess, timeout );
+    ok( ret == WAIT_OBJECT_0, "%s child with %u threads timed out\n", mode, threads );
+    if (ret != WAIT_OBJECT_0) TerminateProcess( info.hProcess, 1 );
+    else winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+
+    if ((view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 )))
+    {
+        memcpy( sums, view, RENDER_OPS * sizeof(DWORD) );
+        UnmapViewOfFile( view );
+    }
+    CloseHandle( mapping );
+    return ret == WAIT_OBJECT_0 && view;
+}
+
+static void test_render_bands(void)
+{
+    static const DWORD threshold = 1;
+    DWORD serial[RENDER_OPS], banded[RENDER_OPS];
+    struct render_config config;
+    int i;
+
+    if (!save_render_config( &config ))
+    {
+        skip( "can't configure the render threads\n" );
+        return;
+    }
+    RegSetValueExA( config.hkey, "RenderThreshold", 0, REG_DWORD, (const BYTE *)&threshold, sizeof(threshold) );
+
+    /* the output of banded rendering must match the serial one */
+    if (run_render_child( config.hkey, "render_bands", 1, 60000, serial ) &&
+        run_render_child( config.hkey, "render_bands", 4, 60000, banded ))
+    {
+        for (i = 0; i < RENDER_OPS; i++)
+            ok( banded[i] == serial[i], "%s: got checksum %08x, expected %08x\n",
+                render_op_names[i], banded[i], serial[i] );
+    }
+
+    restore_render_config( &config );
+}
+
+static void test_performance_scaling(void)
+{
+    static const DWORD thread_counts[] = { 1, 2, 4, 8, 16 };
+    static const DWORD threshold = 64 * 1024;
+    DWORD serial[RENDER_OPS], sums[RENDER_OPS];
+    struct render_config config;
+    int i, j;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+
+    if (!save_render_config( &config ))
+    {
+        skip( "can't configure the render threads\n" );
+        return;
+    }
+    RegSetValueExA( config.hkey, "RenderThreshold", 0, REG_DWORD, (const BYTE *)&threshold, sizeof(threshold) );
+
+    for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+    {
+        if (!run_render_child( config.hkey, "perf_scaling", thread_counts[i], INFINITE, i ? sums : serial ))
+            break;
+        if (!i) continue;
+
+        /* the output must not depend on the number of threads */
+        for (j = 0; j < RENDER_OPS; j++)
+            ok( sums[j] == serial[j], "%u threads: %s: got checksum %08x, expected %08x\n",
+                thread_counts[i], render_op_names[j], sums[j], serial[j] );
+    }
+
+    restore_render_config( &config );
+}
+
 START_TEST(dib)
 {
     HMODULE mod = GetModuleHandleA("gdi32.dll");
+    char **argv;
+    int argc;
     pSetLayout = (void *)GetProcAddress( mod, "SetLayout" );
     pGdiAlphaBlend = (void *)GetProcAddress( mod, "GdiAlphaBlend" );
     pGdiGradientFill = (void *)GetProcAddress( mod, "GdiGradientFill" );
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 5 && (!strcmp( argv[2], "perf_scaling" ) || !strcmp( argv[2], "render_bands" )))
+    {
+        render_child_main( argv[2], atoi( argv[3] ), argv[4] );
+        return;
+    }
+
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
     test_simple_graphics();
+    test_render_bands();
+    test_performance();
+    test_performance_scaling();
 
     CryptReleaseContext(crypt_prov, 0);
 }
@@ -20,6 +20,7 @@
 #include "wine/port.h"
 
 #include <math.h>
+#include <limits.h>
 
 #include "jscript.h"
 
@@ -27,10 +28,21 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(jscript);
 
+/*
+ * Elements [0, elems_cnt) are stored in the dense elems vector. Elements past
+ * it (holes, large indices) are stored as named properties. Once the array has
+ * such a property it becomes sparse and the vector stops growing, so that an
+ * index is never stored in both places.
+ */
 typedef struct {
     jsdisp_t dispex;
 
     DWORD length;
+
+    jsval_t *elems;
+    DWORD elems_cnt;
+    DWORD elems_size;
+    BOOL sparse;
 } ArrayInstance;
 
 static const WCHAR lengthW[] = {'l','e','n','g','t','h',0};
@@ -118,6 +130,30 @@ static WCHAR *idx_to_str(DWORD idx, WCHAR *ptr)
     return ptr+1;
 }
 
+static HRESULT array_reserve(ArrayInstance *array, DWORD size)
+{
+    jsval_t *new_elems;
+    DWORD new_size;
+
+    if(size <= array->elems_size)
+        return S_OK;
+
+    new_size = max(size, array->elems_size ? array->elems_size*2 : 8);
+    if(new_size > UINT_MAX/sizeof(jsval_t))
+        return E_OUTOFMEMORY;
+
+    if(array->elems)
+        new_elems = heap_realloc(array->elems, new_size*sizeof(jsval_t));
+    else
+        new_elems = heap_alloc(new_size*sizeof(jsval_t));
+    if(!new_elems)
+        return E_OUTOFMEMORY;
+
+    array->elems = new_elems;
+    array->elems_size = new_size;
+    return S_OK;
+}
+
 static HRESULT Array_get_length(script_ctx_t *ctx, jsdisp_t *jsthis, jsval_t *r)
 {
     TRACE("%p\n", jsthis);
@@ -143,10 +179,15 @@ static HRESULT Array_set_length(script_ctx_t *ctx, jsdisp_t *jsthis, jsval_t val
     if(len!=(DWORD)len)
         return throw_range_error(ctx, JS_E_INVALID_LENGTH, NULL);
 
-    for(i=len; i < This->length; i++) {
-        hres = jsdisp_delete_idx(&This->dispex, i);
-        if(FAILED(hres))
-            return hres;
+    while(This->elems_cnt > len)
+        jsval_release(This->elems[--This->elems_cnt]);
+
+    if(This->sparse) {
+        for(i=len; i < This->length; i++) {
+            hres = jsdisp_delete_idx(&This->dispex, i);
+            if(FAILED(hres))
+                return hres;
+        }
     }
 
     This->length = len;
@@ -489,6 +530,7 @@ static HRESULT Array_reverse(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsi
 static HRESULT Array_shift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsigned argc, jsval_t *argv,
         jsval_t *r)
 {
+    ArrayInstance *array;
     jsdisp_t *jsthis;
     DWORD length = 0, i;
     jsval_t v, ret;
@@ -510,6 +552,20 @@ static HRESULT Array_shift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsign
         return S_OK;
     }
 
+    array = array_this(vthis);
+    if(array && !array->sparse && array->elems_cnt == length) {
+        ret = array->elems[0];
+        memmove(array->elems, array->elems+1, (length-1)*sizeof(*array->elems));
+        array->elems_cnt--;
+        array->length--;
+
+        if(r)
+            *r = ret;
+        else
+            jsval_release(ret);
+        return S_OK;
+    }
+
     hres = jsdisp_get_idx(jsthis, 0, &ret);
     if(hres == DISP_E_UNKNOWNNAME) {
         ret = jsval_undefined();
@@ -943,8 +999,9 @@ static HRESULT Array_unshift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsi
         jsval_t *r)
 {
     jsdisp_t *jsthis;
+    ArrayInstance *array;
     WCHAR buf[14], *buf_end, *str;
-    DWORD i, length;
+    DWORD i, length, argc_done = 0;
     jsval_t val;
     DISPID id;
     HRESULT hres;
@@ -955,7 +1012,41 @@ static HRESULT Array_unshift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsi
     if(FAILED(hres))
         return hres;
 
-    if(argc) {
+    array = array_this(vthis);
+    if(argc && array && !array->sparse && array->elems_cnt == length) {
+        hres = array_reserve(array, length+argc);
+        if(FAILED(hres))
+            return hres;
+
+        for(i=0; i < argc; i++) {
+            hres = jsval_copy(argv[i], array->elems+length+i);
+            if(FAILED(hres)) {
+                while(i--)
+                    jsval_release(array->elems[length+i]);
+                return hres;
+            }
+        }
+
+        /* Rotate the new elements to the front. */
+        if(length) {
+            jsval_t *tmp;
+
+            tmp = heap_alloc(argc*sizeof(*tmp));
+            if(!tmp) {
+                for(i=0; i < argc; i++)
+                    jsval_release(array->elems[length+i]);
+                return E_OUTOFMEMORY;
+            }
+
+            memcpy(tmp, array->elems+length, argc*sizeof(*tmp));
+            memmove(array->elems+argc, array->elems, length*sizeof(*tmp));
+            memcpy(array->elems, tmp, argc*sizeof(*tmp));
+            heap_free(tmp);
+        }
+
+        array->elems_cnt += argc;
+        argc_done = argc;
+    }else if(argc) {
         buf_end = buf + sizeof(buf)/sizeof(WCHAR)-1;
         *buf_end-- = 0;
         i = length;
@@ -972,7 +1063,7 @@ static HRESULT Array_unshift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsi
                 hres = jsdisp_propput_idx(jsthis, i+argc, val);
                 jsval_release(val);
             }else if(hres == DISP_E_UNKNOWNNAME) {
-                hres = IDispatchEx_DeleteMemberByDispID(vthis->u.dispex, id);
+                hres = jsdisp_delete_idx(jsthis, i+argc);
             }
         }
 
@@ -980,7 +1071,7 @@ static HRESULT Array_unshift(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsi
             return hres;
     }
 
-    for(i=0; i<argc; i++) {
+    for(i=argc_done; i<argc; i++) {
         hres = jsdisp_propput_idx(jsthis, i, argv[i]);
         if(FAILED(hres))
             return hres;
@@ -1009,7 +1100,13 @@ static HRESULT Array_get_value(script_ctx_t *ctx, jsdisp_t *jsthis, jsval_t *r)
 
 static void Array_destructor(jsdisp_t *dispex)
 {
-    heap_free(dispex);
+    ArrayInstance *array = array_from_jsdisp(dispex);
+    DWORD i;
+
+    for(i=0; i < array->elems_cnt; i++)
+        jsval_release(array->elems[i]);
+    heap_free(array->elems);
+    heap_free(array);
 }
 
 static void Array_on_put(jsdisp_t *dispex, const WCHAR *name)
@@ -1021,6 +1118,9 @@ static void Array_on_put(jsdisp_t *dispex, const WCHAR *name)
     if(!isdigitW(*ptr))
         return;
 
+    /* An element is stored as a named property. */
+    array->sparse = TRUE;
+
     while(*ptr && isdigitW(*ptr)) {
         id = id*10 + (*ptr-'0');
         ptr++;
@@ -1033,6 +1133,86 @@ static void Array_on_put(jsdisp_t *dispex, const WCHAR *name)
         array->length = id+1;
 }
 
+static unsigned Array_idx_length(jsdisp_t *jsdisp)
+{
+    return array_from_jsdisp(jsdisp)->elems_cnt;
+}
+
+static HRESULT Array_idx_get(jsdisp_t *jsdisp, unsigned idx, jsval_t *r)
+{
+    ArrayInstance *array = array_from_jsdisp(jsdisp);
+
+    TRACE("%p[%u]\n", array, idx);
+
+    return jsval_copy(array->elems[idx], r);
+}
+
+static HRESULT Array_idx_put(jsdisp_t *jsdisp, unsigned idx, jsval_t val)
+{
+    ArrayInstance *array = array_from_jsdisp(jsdisp);
+    jsval_t copy;
+    HRESULT hres;
+
+    TRACE("%p[%u] = %s\n", array, idx, debugstr_jsval(val));
+
+    hres = jsval_copy(val, &copy);
+    if(FAILED(hres))
+        return hres;
+
+    jsval_release(array->elems[idx]);
+    array->elems[idx] = copy;
+    return S_OK;
+}
+
+static HRESULT Array_idx_append(jsdisp_t *jsdisp, jsval_t val)
+{
+    ArrayInstance *array = array_from_jsdisp(jsdisp);
+    HRESULT hres;
+
+    if(array->sparse)
+        return S_FALSE;
+
+    hres = array_reserve(array, array->elems_cnt+1);
+    if(FAILED(hres))
+        return hres;
+
+    hres = jsval_copy(val, array->elems+array->elems_cnt);
+    if(FAILED(hres))
+        return hres;
+
+    if(++array->elems_cnt > array->length)
+        array->length = array->elems_cnt;
+    return S_OK;
+}
+
+static HRESULT Array_idx_delete(jsdisp_t *jsdisp, unsigned idx)
+{
+    ArrayInstance *array = array_from_jsdisp(jsdisp);
+    DWORD i, cnt = array->elems_cnt;
+    HRESULT hres = S_OK;
+
+    TRACE("%p[%u]\n", array, idx);
+
+    /* Deleting an element other than the last one leaves a hole, so the
+     * elements following it are moved to named properties. */
+    array->elems_cnt = idx;
+    jsval_release(array->elems[idx]);
+
+    for(i=idx+1; i < cnt; i++) {
+        if(SUCCEEDED(hres)) {
+            WCHAR name[12];
+
+            static const WCHAR formatW[] = {'%','u',0};
+
+            sprintfW(name, formatW, i);
+            hres = jsdisp_propput_name(jsdisp, name, array->elems[i]);
+        }
+        jsval_release(array->elems[i]);
+    }
+
+    return hres;
+}
+
 static const builtin_prop_t Array_props[] = {
     {concatW,                Array_concat,               PROPF_METHOD|1},
     {joinW,                  Array_join,                 PROPF_METHOD|1},
@@ -1055,7 +1235,12 @@ static const builtin_info_t Array_info = {
     sizeof(Array_props)/sizeof(*Array_props),
     Array_props,
     Array_destructor,
-    Array_on_put
+    Array_on_put,
+    Array_idx_length,
+    Array_idx_get,
+    Array_idx_put,
+    Array_idx_append,
+    Array_idx_delete
 };
 
 static const builtin_prop_t ArrayInst_props[] = {
@@ -1068,7 +1253,12 @@ static const builtin_info_t ArrayInst_info = {
     sizeof(ArrayInst_props)/sizeof(*ArrayInst_props),
     ArrayInst_props,
     Array_destructor,
-    Array_on_put
+    Array_on_put,
+    Array_idx_length,
+    Array_idx_get,
+    Array_idx_put,
+    Array_idx_append,
+    Array_idx_delete
 };
 
 static HRESULT ArrayConstr_value(script_ctx_t *ctx, vdisp_t *vthis, WORD flags, unsigned argc, jsval_t *argv,
@@ -335,6 +335,25 @@ static HRESULT push_instr_uint(compiler_ctx_t *ctx, jsop_t op, unsigned arg)
     return S_OK;
 }
 
+static HRESULT push_instr_uint_uint(compiler_ctx_t *ctx, jsop_t op, unsigned arg1, unsigned arg2)
+{
+    unsigned instr;
+
+    instr = push_instr(ctx, op);
+    if(!instr)
+        return E_OUTOFMEMORY;
+
+    instr_ptr(ctx, instr)->u.arg[0].uint = arg1;
+    instr_ptr(ctx, instr)->u.arg[1].uint = arg2;
+    return S_OK;
+}
+
+/* Inline caches are numbered from 1, 0 means no cache. */
+static unsigned alloc_prop_cache(compiler_ctx_t *ctx)
+{
+    return ++ctx->code->prop_cache_cnt;
+}
+
 static HRESULT compile_binary_expression(compiler_ctx_t *ctx, binary_expression_t *expr, jsop_t op)
 {
     HRESULT hres;
@@ -370,7 +389,7 @@ static HRESULT compile_member_expression(compiler_ctx_t *ctx, member_expression_
     if(FAILED(hres))
         return hres;
 
-    return push_instr_bstr(ctx, OP_member, expr->identifier);
+    return push_instr_bstr_uint(ctx, OP_member, expr->identifier, alloc_prop_cache(ctx));
 }
 
 #define LABEL_FLAG 0x80000000
@@ -429,7 +448,7 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
         if(FAILED(hres))
             return hres;
 
-        hres = push_instr_uint(ctx, OP_memberid, flags);
+        hres = push_instr_uint_uint(ctx, OP_memberid, flags, 0);
         break;
     }
     case EXPR_MEMBER: {
@@ -444,7 +463,8 @@ static HRESULT compile_memberid_expression(compiler_ctx_t *ctx, expression_t *ex
         if(FAILED(hres))
             return hres;
 
-        hres = push_instr_uint(ctx, OP_memberid, flags);
+        /* The name is constant, so the lookup may be cached. */
+        hres = push_instr_uint_uint(ctx, OP_memberid, flags, alloc_prop_cache(ctx));
         break;
     }
     DEFAULT_UNREACHABLE;
@@ -1805,6 +1825,7 @@ void release_bytecode(bytecode_t *code)
     heap_pool_free(&code->heap);
     heap_free(code->bstr_pool);
     heap_free(code->str_pool);
+    heap_free(code->prop_caches);
     heap_free(code->instrs);
     heap_free(code);
 }
@@ -2029,6 +2050,11 @@ HRESULT compile_script(script_ctx_t *ctx, const WCHAR *code, const WCHAR *args,
 
     hres = compile_function(&compiler, compiler.parser->source, NULL, from_eval, &compiler.code->global_code);
     parser_release(compiler.parser);
+    if(SUCCEEDED(hres)) {
+        compiler.code->prop_caches = heap_alloc_zero((compiler.code->prop_cache_cnt+1) * sizeof(prop_cache_t));
+        if(!compiler.code->prop_caches)
+            hres = E_OUTOFMEMORY;
+    }
     if(FAILED(hres)) {
         release_bytecode(compiler.code);
         return hres;
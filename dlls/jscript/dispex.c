@@ -17,6 +17,7 @@
  */
 
 #include <assert.h>
+#include <limits.h>
 
 #include "jscript.h"
 
@@ -35,6 +36,14 @@ static const IID IID_IDispatchJS =
 #define FDEX_VERSION_MASK 0xf0000000
 #define GOLDEN_RATIO 0x9E3779B9U
 
+#define MAX_SHAPE_DEPTH 64
+#define MAX_SHAPE_CNT   0x10000
+
+/* The interpreter addresses elements of objects with indexed properties by
+ * DISPIDs from this range, so that no named properties need to be created
+ * for them. Such DISPIDs are never exposed outside of the script engine. */
+#define IDX_DISPID_BASE 0x40000000
+
 typedef enum {
     PROP_JSVAL,
     PROP_BUILTIN,
@@ -65,9 +74,73 @@ static inline DISPID prop_to_id(jsdisp_t *This, dispex_prop_t *prop)
     return prop - This->props;
 }
 
+static inline BOOL is_idx_dispid(DISPID id)
+{
+    return id >= IDX_DISPID_BASE;
+}
+
+static BOOL is_idx_name(const WCHAR *name, unsigned *ret)
+{
+    const WCHAR *ptr = name;
+    unsigned idx = 0;
+
+    if(!isdigitW(*ptr) || (*ptr == '0' && ptr[1]))
+        return FALSE;
+
+    while(isdigitW(*ptr)) {
+        if(idx > (UINT_MAX-9)/10)
+            return FALSE;
+        idx = idx*10 + (*ptr++ - '0');
+    }
+
+    if(*ptr)
+        return FALSE;
+
+    *ret = idx;
+    return TRUE;
+}
+
+static DWORD get_idx_prop_flags(jsdisp_t *This)
+{
+    if(!This->builtin_info->idx_put)
+        return PROPF_CONST;
+
+    /* Array elements are enumerable, arguments object elements are not. */
+    return This->builtin_info->class == JSCLASS_ARRAY ? PROPF_ENUM : 0;
+}
+
+/*
+ * Objects may grow and shrink their indexed properties (like arrays do), so
+ * PROP_IDX props past the current idx_length are deleted and deleted props
+ * inside of it are indexed again. A named property shadowing an index can't
+ * exist inside of idx_length, because objects don't grow past such props.
+ */
+static void update_idx_prop(jsdisp_t *This, dispex_prop_t *prop)
+{
+    unsigned idx;
+
+    if(!This->builtin_info->idx_length)
+        return;
+
+    if(prop->type == PROP_IDX) {
+        if(prop->u.idx >= This->builtin_info->idx_length(This))
+            prop->type = PROP_DELETED;
+    }else if(prop->type == PROP_DELETED && prop->name && is_idx_name(prop->name, &idx)
+            && idx < This->builtin_info->idx_length(This)) {
+        prop->type = PROP_IDX;
+        prop->flags = get_idx_prop_flags(This);
+        prop->u.idx = idx;
+    }
+}
+
 static inline dispex_prop_t *get_prop(jsdisp_t *This, DISPID id)
 {
-    if(id < 0 || id >= This->prop_cnt || This->props[id].type == PROP_DELETED)
+    if(id < 0 || id >= This->prop_cnt)
+        return NULL;
+
+    if(This->props[id].type == PROP_IDX || This->props[id].type == PROP_DELETED)
+        update_idx_prop(This, This->props+id);
+    if(This->props[id].type == PROP_DELETED)
         return NULL;
 
     return This->props+id;
@@ -117,6 +190,99 @@ static inline unsigned string_hash(const WCHAR *name)
     return h;
 }
 
+/*
+ * Named properties are stored in the order they are allocated, so objects
+ * that allocated the same names in the same order map each name to the same
+ * DISPID. Such objects share a shape. Shapes form a transition tree owned by
+ * the script context. Objects with too many properties (typically used as
+ * dictionaries or arrays) don't have a shape and are never cached.
+ */
+struct _jsshape_t {
+    unsigned id;
+    unsigned depth;
+    WCHAR *name;
+    unsigned hash;
+    jsshape_t *children;
+    jsshape_t *next;
+};
+
+static LONG shape_id;
+
+static jsshape_t *alloc_shape(script_ctx_t *ctx, jsshape_t *parent, const WCHAR *name, unsigned hash)
+{
+    jsshape_t *shape;
+
+    if(ctx->shape_cnt >= MAX_SHAPE_CNT)
+        return NULL;
+
+    shape = heap_alloc_zero(sizeof(*shape));
+    if(!shape)
+        return NULL;
+
+    if(name) {
+        shape->name = heap_strdupW(name);
+        if(!shape->name) {
+            heap_free(shape);
+            return NULL;
+        }
+    }
+
+    shape->id = InterlockedIncrement(&shape_id);
+    shape->hash = hash;
+    if(parent) {
+        shape->depth = parent->depth+1;
+        shape->next = parent->children;
+        parent->children = shape;
+    }
+
+    ctx->shape_cnt++;
+    return shape;
+}
+
+static jsshape_t *get_empty_shape(script_ctx_t *ctx)
+{
+    if(!ctx->empty_shape)
+        ctx->empty_shape = alloc_shape(ctx, NULL, NULL, 0);
+    return ctx->empty_shape;
+}
+
+static jsshape_t *shape_add_prop(script_ctx_t *ctx, jsshape_t *shape, const WCHAR *name, unsigned hash)
+{
+    jsshape_t *iter;
+
+    if(!shape || shape->depth >= MAX_SHAPE_DEPTH)
+        return NULL;
+
+    for(iter = shape->children; iter; iter = iter->next) {
+        if(iter->hash == hash && !strcmpW(iter->name, name))
+            return iter;
+    }
+
+    return alloc_shape(ctx, shape, name, hash);
+}
+
+static void free_shape(jsshape_t *shape)
+{
+    jsshape_t *iter, *next;
+
+    for(iter = shape->children; iter; iter = next) {
+        next = iter->next;
+        free_shape(iter);
+    }
+
+    heap_free(shape->name);
+    heap_free(shape);
+}
+
+void release_shapes(script_ctx_t *ctx)
+{
+    if(ctx->empty_shape) {
+        free_shape(ctx->empty_shape);
+        ctx->empty_shape = NULL;
+    }
+    ctx->shape_cnt = 0;
+}
+
 static inline unsigned get_props_idx(jsdisp_t *This, unsigned hash)
 {
     return (hash*GOLDEN_RATIO) & (This->buf_size-1);
@@ -171,6 +337,8 @@ static inline dispex_prop_t* alloc_prop(jsdisp_t *This, const WCHAR *name, prop_
     bucket = get_props_idx(This, prop->hash);
     prop->bucket_next = This->props[bucket].bucket_head;
     This->props[bucket].bucket_head = This->prop_cnt++;
+
+    This->shape = shape_add_prop(This->ctx, This->shape, name, prop->hash);
     return prop;
 }
 
@@ -202,6 +370,7 @@ static HRESULT find_prop_name(jsdisp_t *This, unsigned hash, const WCHAR *name,
                 This->props[bucket].bucket_head = pos;
             }
 
+            update_idx_prop(This, This->props+pos);
             *ret = &This->props[pos];
             return S_OK;
         }
@@ -222,13 +391,10 @@ static HRESULT find_prop_name(jsdisp_t *This, unsigned hash, const WCHAR *name,
     }
 
     if(This->builtin_info->idx_length) {
-        const WCHAR *ptr;
-        unsigned idx = 0;
+        unsigned idx;
 
-        for(ptr = name; isdigitW(*ptr) && idx < 0x10000; ptr++)
-            idx = idx*10 + (*ptr-'0');
-        if(!*ptr && idx < This->builtin_info->idx_length(This)) {
-            prop = alloc_prop(This, name, PROP_IDX, This->builtin_info->idx_put ? 0 : PROPF_CONST);
+        if(is_idx_name(name, &idx) && idx < This->builtin_info->idx_length(This)) {
+            prop = alloc_prop(This, name, PROP_IDX, get_idx_prop_flags(This));
             if(!prop)
                 return E_OUTOFMEMORY;
 
@@ -362,6 +528,28 @@ static HRESULT convert_params(const DISPPARAMS *dp, jsval_t *buf, unsigned *argc
     return S_OK;
 }
 
+static HRESULT invoke_idx(jsdisp_t *This, IDispatch *jsthis, unsigned idx, WORD flags,
+        unsigned argc, jsval_t *argv, jsval_t *r)
+{
+    jsval_t val;
+    HRESULT hres;
+
+    hres = This->builtin_info->idx_get(This, idx, &val);
+    if(FAILED(hres))
+        return hres;
+
+    if(is_object_instance(val)) {
+        TRACE("call [%u] %p\n", idx, get_object(val));
+        hres = disp_call_value(This->ctx, get_object(val), jsthis, flags, argc, argv, r);
+    }else {
+        FIXME("invoke %s\n", debugstr_jsval(val));
+        hres = E_FAIL;
+    }
+
+    jsval_release(val);
+    return hres;
+}
+
 static HRESULT invoke_prop_func(jsdisp_t *This, IDispatch *jsthis, dispex_prop_t *prop, WORD flags,
         unsigned argc, jsval_t *argv, jsval_t *r, IServiceProvider *caller)
 {
@@ -403,8 +591,7 @@ static HRESULT invoke_prop_func(jsdisp_t *This, IDispatch *jsthis, dispex_prop_t
         return disp_call_value(This->ctx, get_object(prop->u.val), jsthis, flags, argc, argv, r);
     }
     case PROP_IDX:
-        FIXME("Invoking PROP_IDX not yet supported\n");
-        return E_NOTIMPL;
+        return invoke_idx(This, jsthis, prop->u.idx, flags, argc, argv, r);
     case PROP_DELETED:
         assert(0);
     }
@@ -545,6 +732,29 @@ static HRESULT fill_protrefs(jsdisp_t *This)
     return S_OK;
 }
 
+static HRESULT fill_idx_props(jsdisp_t *This)
+{
+    unsigned i, length;
+    dispex_prop_t *prop;
+    WCHAR name[12];
+    HRESULT hres;
+
+    static const WCHAR formatW[] = {'%','u',0};
+
+    if(!This->builtin_info->idx_length || !(get_idx_prop_flags(This) & PROPF_ENUM))
+        return S_OK;
+
+    length = This->builtin_info->idx_length(This);
+    for(i=0; i < length; i++) {
+        sprintfW(name, formatW, i);
+        hres = find_prop_name(This, string_hash(name), name, &prop);
+        if(FAILED(hres))
+            return hres;
+    }
+
+    return S_OK;
+}
+
 static inline jsdisp_t *impl_from_IDispatchEx(IDispatchEx *iface)
 {
     return CONTAINING_RECORD(iface, jsdisp_t, IDispatchEx_iface);
@@ -743,7 +953,7 @@ static HRESULT WINAPI DispatchEx_InvokeEx(IDispatchEx *iface, DISPID id, LCID lc
     return hres;
 }
 
-static HRESULT delete_prop(dispex_prop_t *prop, BOOL *ret)
+static HRESULT delete_prop(jsdisp_t *This, dispex_prop_t *prop, BOOL *ret)
 {
     if(prop->flags & PROPF_DONTDELETE) {
         *ret = FALSE;
@@ -752,6 +962,9 @@ static HRESULT delete_prop(dispex_prop_t *prop, BOOL *ret)
 
     *ret = TRUE; /* FIXME: not exactly right */
 
+    if(prop->type == PROP_IDX && This->builtin_info->idx_delete)
+        return This->builtin_info->idx_delete(This, prop->u.idx);
+
     if(prop->type == PROP_JSVAL) {
         jsval_release(prop->u.val);
         prop->type = PROP_DELETED;
@@ -779,7 +992,7 @@ static HRESULT WINAPI DispatchEx_DeleteMemberByName(IDispatchEx *iface, BSTR bst
         return S_OK;
     }
 
-    return delete_prop(prop, &b);
+    return delete_prop(This, prop, &b);
 }
 
 static HRESULT WINAPI DispatchEx_DeleteMemberByDispID(IDispatchEx *iface, DISPID id)
@@ -796,7 +1009,7 @@ static HRESULT WINAPI DispatchEx_DeleteMemberByDispID(IDispatchEx *iface, DISPID
         return DISP_E_MEMBERNOTFOUND;
     }
 
-    return delete_prop(prop, &b);
+    return delete_prop(This, prop, &b);
 }
 
 static HRESULT WINAPI DispatchEx_GetMemberProperties(IDispatchEx *iface, DISPID id, DWORD grfdexFetch, DWORD *pgrfdex)
@@ -833,7 +1046,9 @@ static HRESULT WINAPI DispatchEx_GetNextDispID(IDispatchEx *iface, DWORD grfdex,
     TRACE("(%p)->(%x %x %p)\n", This, grfdex, id, pid);
 
     if(id == DISPID_STARTENUM) {
-        hres = fill_protrefs(This);
+        hres = fill_idx_props(This);
+        if(SUCCEEDED(hres))
+            hres = fill_protrefs(This);
         if(FAILED(hres))
             return hres;
     }
@@ -846,6 +1061,7 @@ static HRESULT WINAPI DispatchEx_GetNextDispID(IDispatchEx *iface, DWORD grfdex,
     }
 
     while(iter < This->props + This->prop_cnt) {
+        update_idx_prop(This, iter);
         if(iter->name && (get_flags(This, iter) & PROPF_ENUM) && iter->type!=PROP_DELETED) {
             *pid = prop_to_id(This, iter);
             return S_OK;
@@ -919,6 +1135,7 @@ HRESULT init_dispex(jsdisp_t *dispex, script_ctx_t *ctx, const builtin_info_t *b
 
     script_addref(ctx);
     dispex->ctx = ctx;
+    dispex->shape = get_empty_shape(ctx);
 
     return S_OK;
 }
@@ -1056,6 +1273,38 @@ HRESULT jsdisp_get_id(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, DISPID *
     return DISP_E_UNKNOWNNAME;
 }
 
+HRESULT jsdisp_get_id_cached(jsdisp_t *jsdisp, const WCHAR *name, DWORD flags, prop_cache_t *cache, DISPID *id)
+{
+    HRESULT hres;
+
+    if(jsdisp->shape && jsdisp->shape->id == cache->shape_id && get_prop(jsdisp, cache->id)) {
+        *id = cache->id;
+        return S_OK;
+    }
+
+    hres = jsdisp_get_id(jsdisp, name, flags, id);
+    if(hres == S_OK && jsdisp->shape) {
+        cache->shape_id = jsdisp->shape->id;
+        cache->id = *id;
+    }
+    return hres;
+}
+
+HRESULT jsdisp_get_idx_id(jsdisp_t *jsdisp, DWORD idx, DWORD flags, DISPID *id)
+{
+    unsigned length;
+
+    if(!jsdisp->builtin_info->idx_length || idx >= IDX_DISPID_BASE)
+        return DISP_E_UNKNOWNNAME;
+
+    length = jsdisp->builtin_info->idx_length(jsdisp);
+    if(idx > length || (idx == length && (!(flags & fdexNameEnsure) || !jsdisp->builtin_info->idx_append)))
+        return DISP_E_UNKNOWNNAME;
+
+    *id = IDX_DISPID_BASE + idx;
+    return S_OK;
+}
+
 HRESULT jsdisp_call_value(jsdisp_t *jsfunc, IDispatch *jsthis, WORD flags, unsigned argc, jsval_t *argv, jsval_t *r)
 {
     HRESULT hres;
@@ -1083,6 +1332,12 @@ HRESULT jsdisp_call(jsdisp_t *disp, DISPID id, WORD flags, unsigned argc, jsval_
 {
     dispex_prop_t *prop;
 
+    if(is_idx_dispid(id)) {
+        if(id - IDX_DISPID_BASE >= disp->builtin_info->idx_length(disp))
+            return DISP_E_MEMBERNOTFOUND;
+        return invoke_idx(disp, to_disp(disp), id - IDX_DISPID_BASE, flags, argc, argv, r);
+    }
+
     prop = get_prop(disp, id);
     if(!prop)
         return DISP_E_MEMBERNOTFOUND;
@@ -1328,9 +1583,25 @@ HRESULT jsdisp_propput_dontenum(jsdisp_t *obj, const WCHAR *name, jsval_t val)
 HRESULT jsdisp_propput_idx(jsdisp_t *obj, DWORD idx, jsval_t val)
 {
     WCHAR buf[12];
+    HRESULT hres;
 
     static const WCHAR formatW[] = {'%','d',0};
 
+    if(obj->builtin_info->idx_put) {
+        unsigned length = obj->builtin_info->idx_length(obj);
+
+        if(idx < length)
+            return obj->builtin_info->idx_put(obj, idx, val);
+
+        /* S_FALSE means that the object can't store the element in its
+         * indexed storage and it has to be stored as a named property. */
+        if(idx == length && obj->builtin_info->idx_append) {
+            hres = obj->builtin_info->idx_append(obj, val);
+            if(hres != S_FALSE)
+                return hres;
+        }
+    }
+
     sprintfW(buf, formatW, idx);
     return jsdisp_propput_name(obj, buf, val);
 }
@@ -1344,11 +1615,15 @@ HRESULT disp_propput(script_ctx_t *ctx, IDispatch *disp, DISPID id, jsval_t val)
     if(jsdisp) {
         dispex_prop_t *prop;
 
-        prop = get_prop(jsdisp, id);
-        if(prop)
-            hres = prop_put(jsdisp, prop, val, NULL);
-        else
-            hres = DISP_E_MEMBERNOTFOUND;
+        if(is_idx_dispid(id)) {
+            hres = jsdisp_propput_idx(jsdisp, id - IDX_DISPID_BASE, val);
+        }else {
+            prop = get_prop(jsdisp, id);
+            if(prop)
+                hres = prop_put(jsdisp, prop, val, NULL);
+            else
+                hres = DISP_E_MEMBERNOTFOUND;
+        }
 
         jsdisp_release(jsdisp);
     }else {
@@ -1411,6 +1686,9 @@ HRESULT jsdisp_get_idx(jsdisp_t *obj, DWORD idx, jsval_t *r)
 
     static const WCHAR formatW[] = {'%','d',0};
 
+    if(obj->builtin_info->idx_length && idx < obj->builtin_info->idx_length(obj))
+        return obj->builtin_info->idx_get(obj, idx, r);
+
     sprintfW(name, formatW, idx);
 
     hres = find_prop_name_prot(obj, string_hash(name), name, &prop);
@@ -1430,6 +1708,17 @@ HRESULT jsdisp_propget(jsdisp_t *jsdisp, DISPID id, jsval_t *val)
     DISPPARAMS dp  = {NULL,NULL,0,0};
     dispex_prop_t *prop;
 
+    if(is_idx_dispid(id)) {
+        HRESULT hres;
+
+        hres = jsdisp_get_idx(jsdisp, id - IDX_DISPID_BASE, val);
+        if(hres == DISP_E_UNKNOWNNAME) {
+            *val = jsval_undefined();
+            hres = S_OK;
+        }
+        return hres;
+    }
+
     prop = get_prop(jsdisp, id);
     if(!prop)
         return DISP_E_MEMBERNOTFOUND;
@@ -1481,13 +1770,16 @@ HRESULT jsdisp_delete_idx(jsdisp_t *obj, DWORD idx)
     BOOL b;
     HRESULT hres;
 
+    if(obj->builtin_info->idx_delete && idx < obj->builtin_info->idx_length(obj))
+        return obj->builtin_info->idx_delete(obj, idx);
+
     sprintfW(buf, formatW, idx);
 
     hres = find_prop_name(obj, string_hash(buf), buf, &prop);
     if(FAILED(hres) || !prop)
         return hres;
 
-    return delete_prop(prop, &b);
+    return delete_prop(obj, prop, &b);
 }
 
 HRESULT disp_delete(IDispatch *disp, DISPID id, BOOL *ret)
@@ -1502,7 +1794,7 @@ HRESULT disp_delete(IDispatch *disp, DISPID id, BOOL *ret)
 
         prop = get_prop(jsdisp, id);
         if(prop)
-            hres = delete_prop(prop, ret);
+            hres = delete_prop(jsdisp, prop, ret);
         else
             hres = DISP_E_MEMBERNOTFOUND;
 
@@ -1545,7 +1837,7 @@ HRESULT disp_delete_name(script_ctx_t *ctx, IDispatch *disp, jsstr_t *name, BOOL
 
         hres = find_prop_name(jsdisp, string_hash(ptr), ptr, &prop);
         if(prop) {
-            hres = delete_prop(prop, ret);
+            hres = delete_prop(jsdisp, prop, ret);
         }else {
             *ret = TRUE;
             hres = S_OK;
@@ -1593,7 +1885,7 @@ HRESULT jsdisp_is_own_prop(jsdisp_t *obj, const WCHAR *name, BOOL *ret)
     if(FAILED(hres))
         return hres;
 
-    *ret = prop && (prop->type == PROP_JSVAL || prop->type == PROP_BUILTIN);
+    *ret = prop && (prop->type == PROP_JSVAL || prop->type == PROP_BUILTIN || prop->type == PROP_IDX);
     return S_OK;
 }
 
@@ -361,6 +361,22 @@ void exec_release(exec_ctx_t *ctx)
     heap_free(ctx);
 }
 
+/* Numbers that are valid array indexes address elements without converting them to property names. */
+static inline BOOL get_array_index(jsval_t v, DWORD *ret)
+{
+    double n;
+
+    if(!is_number(v))
+        return FALSE;
+
+    n = get_number(v);
+    if(!is_int32(n) || n < 0)
+        return FALSE;
+
+    *ret = n;
+    return TRUE;
+}
+
 static HRESULT disp_get_id(script_ctx_t *ctx, IDispatch *disp, const WCHAR *name, BSTR name_bstr, DWORD flags, DISPID *id)
 {
     IDispatchEx *dispex;
@@ -583,6 +599,10 @@ static inline jsstr_t *get_op_str(exec_ctx_t *ctx, int i){
     return ctx->code->instrs[ctx->ip].u.arg[i].str;
 }
 
+static inline prop_cache_t *get_op_prop_cache(exec_ctx_t *ctx, int i){
+    return ctx->code->prop_caches + ctx->code->instrs[ctx->ip].u.arg[i].uint;
+}
+
 static inline double get_op_double(exec_ctx_t *ctx){
     return ctx->code->instrs[ctx->ip].u.dbl;
 }
@@ -844,7 +864,9 @@ static HRESULT interp_array(exec_ctx_t *ctx)
     jsstr_t *name_str;
     const WCHAR *name;
     jsval_t v, namev;
+    jsdisp_t *jsdisp;
     IDispatch *obj;
+    DWORD idx;
     DISPID id;
     HRESULT hres;
 
@@ -858,6 +880,19 @@ static HRESULT interp_array(exec_ctx_t *ctx)
         return hres;
     }
 
+    if(get_array_index(namev, &idx) && (jsdisp = to_jsdisp(obj))) {
+        hres = jsdisp_get_idx(jsdisp, idx, &v);
+        IDispatch_Release(obj);
+        if(hres == DISP_E_UNKNOWNNAME) {
+            v = jsval_undefined();
+            hres = S_OK;
+        }
+        if(FAILED(hres))
+            return hres;
+
+        return stack_push(ctx, v);
+    }
+
     hres = to_flat_string(ctx->script, namev, &name_str, &name);
     jsval_release(namev);
     if(FAILED(hres)) {
@@ -885,6 +920,7 @@ static HRESULT interp_member(exec_ctx_t *ctx)
 {
     const BSTR arg = get_op_bstr(ctx, 0);
     IDispatch *obj;
+    jsdisp_t *jsdisp;
     jsval_t v;
     DISPID id;
     HRESULT hres;
@@ -895,9 +931,16 @@ static HRESULT interp_member(exec_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    hres = disp_get_id(ctx->script, obj, arg, arg, 0, &id);
+    jsdisp = to_jsdisp(obj);
+    if(jsdisp)
+        hres = jsdisp_get_id_cached(jsdisp, arg, 0, get_op_prop_cache(ctx, 1), &id);
+    else
+        hres = disp_get_id(ctx->script, obj, arg, arg, 0, &id);
     if(SUCCEEDED(hres)) {
-        hres = disp_propget(ctx->script, obj, id, &v);
+        if(jsdisp)
+            hres = jsdisp_propget(jsdisp, id, &v);
+        else
+            hres = disp_propget(ctx->script, obj, id, &v);
     }else if(hres == DISP_E_UNKNOWNNAME) {
         v = jsval_undefined();
         hres = S_OK;
@@ -913,10 +956,13 @@ static HRESULT interp_member(exec_ctx_t *ctx)
 static HRESULT interp_memberid(exec_ctx_t *ctx)
 {
     const unsigned arg = get_op_uint(ctx, 0);
+    const unsigned cache_idx = get_op_uint(ctx, 1);
     jsval_t objv, namev;
     const WCHAR *name;
     jsstr_t *name_str;
+    jsdisp_t *jsdisp;
     IDispatch *obj;
+    DWORD idx;
     DISPID id;
     HRESULT hres;
 
@@ -927,6 +973,9 @@ static HRESULT interp_memberid(exec_ctx_t *ctx)
 
     hres = to_object(ctx->script, objv, &obj);
     jsval_release(objv);
+    if(SUCCEEDED(hres) && get_array_index(namev, &idx) && (jsdisp = to_jsdisp(obj))
+            && jsdisp_get_idx_id(jsdisp, idx, arg, &id) == S_OK)
+        return stack_push_objid(ctx, obj, id);
     if(SUCCEEDED(hres)) {
         hres = to_flat_string(ctx->script, namev, &name_str, &name);
         if(FAILED(hres))
@@ -936,7 +985,10 @@ static HRESULT interp_memberid(exec_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    hres = disp_get_id(ctx->script, obj, name, NULL, arg, &id);
+    if(cache_idx && (jsdisp = to_jsdisp(obj)))
+        hres = jsdisp_get_id_cached(jsdisp, name, arg, get_op_prop_cache(ctx, 1), &id);
+    else
+        hres = disp_get_id(ctx->script, obj, name, NULL, arg, &id);
     jsstr_release(name_str);
     if(FAILED(hres)) {
         IDispatch_Release(obj);
@@ -1186,7 +1238,6 @@ static HRESULT interp_carray(exec_ctx_t *ctx)
 {
     const unsigned arg = get_op_uint(ctx, 0);
     jsdisp_t *array;
-    jsval_t val;
     unsigned i;
     HRESULT hres;
 
@@ -1196,17 +1247,16 @@ static HRESULT interp_carray(exec_ctx_t *ctx)
     if(FAILED(hres))
         return hres;
 
-    i = arg;
-    while(i--) {
-        val = stack_pop(ctx);
-        hres = jsdisp_propput_idx(array, i, val);
-        jsval_release(val);
+    /* Store the elements in order, so that they are appended to the array's dense storage. */
+    for(i=0; i < arg; i++) {
+        hres = jsdisp_propput_idx(array, i, stack_topn(ctx, arg-i-1));
         if(FAILED(hres)) {
             jsdisp_release(array);
             return hres;
         }
     }
 
+    stack_popn(ctx, arg);
     return stack_push(ctx, jsval_obj(array));
 }
 
@@ -41,6 +41,8 @@ typedef struct {
     jsdisp_t jsdisp;
     FunctionInstance *function;
     jsdisp_t *var_obj;
+    unsigned argc;
+    jsval_t *buf;
 } ArgumentsInstance;
 
 static inline FunctionInstance *function_from_jsdisp(jsdisp_t *jsdisp)
@@ -91,6 +93,13 @@ static HRESULT Arguments_value(script_ctx_t *ctx, vdisp_t *jsthis, WORD flags, u
 static void Arguments_destructor(jsdisp_t *jsdisp)
 {
     ArgumentsInstance *arguments = (ArgumentsInstance*)jsdisp;
+    unsigned i;
+
+    if(arguments->buf) {
+        for(i = arguments->function->length; i < arguments->argc; i++)
+            jsval_release(arguments->buf[i - arguments->function->length]);
+        heap_free(arguments->buf);
+    }
 
     jsdisp_release(&arguments->function->dispex);
     jsdisp_release(arguments->var_obj);
@@ -100,7 +109,7 @@ static void Arguments_destructor(jsdisp_t *jsdisp)
 static unsigned Arguments_idx_length(jsdisp_t *jsdisp)
 {
     ArgumentsInstance *arguments = (ArgumentsInstance*)jsdisp;
-    return arguments->function->length;
+    return max(arguments->function->length, arguments->argc);
 }
 
 static HRESULT Arguments_idx_get(jsdisp_t *jsdisp, unsigned idx, jsval_t *res)
@@ -109,6 +118,9 @@ static HRESULT Arguments_idx_get(jsdisp_t *jsdisp, unsigned idx, jsval_t *res)
 
     TRACE("%p[%u]\n", arguments, idx);
 
+    if(idx >= arguments->function->length)
+        return jsval_copy(arguments->buf[idx - arguments->function->length], res);
+
     /* FIXME: Accessing by name won't work for duplicated argument names */
     return jsdisp_propget_name(arguments->var_obj, arguments->function->func_code->params[idx], res);
 }
@@ -119,6 +131,19 @@ static HRESULT Arguments_idx_put(jsdisp_t *jsdisp, unsigned idx, jsval_t val)
 
     TRACE("%p[%u] = %s\n", arguments, idx, debugstr_jsval(val));
 
+    if(idx >= arguments->function->length) {
+        jsval_t copy;
+        HRESULT hres;
+
+        hres = jsval_copy(val, &copy);
+        if(FAILED(hres))
+            return hres;
+
+        jsval_release(arguments->buf[idx - arguments->function->length]);
+        arguments->buf[idx - arguments->function->length] = copy;
+        return S_OK;
+    }
+
     /* FIXME: Accessing by name won't work for duplicated argument names */
     return jsdisp_propput_name(arguments->var_obj, arguments->function->func_code->params[idx], val);
 }
@@ -158,15 +183,16 @@ static HRESULT create_arguments(script_ctx_t *ctx, FunctionInstance *calee, jsdi
     args->var_obj = jsdisp_addref(var_obj);
 
     /* Store unnamed arguments directly in arguments object */
-    for(i = calee->length; i < argc; i++) {
-        WCHAR buf[12];
-
-        static const WCHAR formatW[] = {'%','d',0};
+    if(argc > calee->length) {
+        args->buf = heap_alloc((argc - calee->length) * sizeof(*args->buf));
+        if(!args->buf)
+            hres = E_OUTOFMEMORY;
 
-        sprintfW(buf, formatW, i);
-        hres = jsdisp_propput_dontenum(&args->jsdisp, buf, argv[i]);
-        if(FAILED(hres))
-            break;
+        for(i = calee->length; SUCCEEDED(hres) && i < argc; i++) {
+            hres = jsval_copy(argv[i], args->buf + i - calee->length);
+            if(SUCCEEDED(hres))
+                args->argc = i+1;
+        }
     }
 
     if(SUCCEEDED(hres)) {
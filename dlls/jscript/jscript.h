@@ -92,6 +92,14 @@ static inline LPWSTR heap_strdupW(LPCWSTR str)
 }
 
 typedef struct jsdisp_t jsdisp_t;
+typedef struct _jsshape_t jsshape_t;
+
+/* Inline cache of a named property lookup, one for each bytecode instruction
+ * that supports it. Valid for objects of the cached shape. */
+typedef struct {
+    unsigned shape_id;
+    DISPID id;
+} prop_cache_t;
 
 extern HINSTANCE jscript_hinstance DECLSPEC_HIDDEN;
 
@@ -210,6 +218,8 @@ typedef struct {
     unsigned (*idx_length)(jsdisp_t*);
     HRESULT (*idx_get)(jsdisp_t*,unsigned,jsval_t*);
     HRESULT (*idx_put)(jsdisp_t*,unsigned,jsval_t);
+    HRESULT (*idx_append)(jsdisp_t*,jsval_t);
+    HRESULT (*idx_delete)(jsdisp_t*,unsigned);
 } builtin_info_t;
 
 struct jsdisp_t {
@@ -220,6 +230,7 @@ struct jsdisp_t {
     DWORD buf_size;
     DWORD prop_cnt;
     dispex_prop_t *props;
+    jsshape_t *shape;
     script_ctx_t *ctx;
 
     jsdisp_t *prototype;
@@ -264,6 +275,7 @@ void jsdisp_release(jsdisp_t*) DECLSPEC_HIDDEN;
 #endif
 
 HRESULT create_dispex(script_ctx_t*,const builtin_info_t*,jsdisp_t*,jsdisp_t**) DECLSPEC_HIDDEN;
+void release_shapes(script_ctx_t*) DECLSPEC_HIDDEN;
 HRESULT init_dispex(jsdisp_t*,script_ctx_t*,const builtin_info_t*,jsdisp_t*) DECLSPEC_HIDDEN;
 HRESULT init_dispex_from_constr(jsdisp_t*,script_ctx_t*,const builtin_info_t*,jsdisp_t*) DECLSPEC_HIDDEN;
 
@@ -283,6 +295,8 @@ HRESULT jsdisp_propput_idx(jsdisp_t*,DWORD,jsval_t) DECLSPEC_HIDDEN;
 HRESULT jsdisp_propget_name(jsdisp_t*,LPCWSTR,jsval_t*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_get_idx(jsdisp_t*,DWORD,jsval_t*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_get_id(jsdisp_t*,const WCHAR*,DWORD,DISPID*) DECLSPEC_HIDDEN;
+HRESULT jsdisp_get_id_cached(jsdisp_t*,const WCHAR*,DWORD,prop_cache_t*,DISPID*) DECLSPEC_HIDDEN;
+HRESULT jsdisp_get_idx_id(jsdisp_t*,DWORD,DWORD,DISPID*) DECLSPEC_HIDDEN;
 HRESULT disp_delete(IDispatch*,DISPID,BOOL*) DECLSPEC_HIDDEN;
 HRESULT disp_delete_name(script_ctx_t*,IDispatch*,jsstr_t*,BOOL*) DECLSPEC_HIDDEN;
 HRESULT jsdisp_delete_idx(jsdisp_t*,DWORD) DECLSPEC_HIDDEN;
@@ -313,6 +327,7 @@ HRESULT create_math(script_ctx_t*,jsdisp_t**) DECLSPEC_HIDDEN;
 HRESULT create_array(script_ctx_t*,DWORD,jsdisp_t**) DECLSPEC_HIDDEN;
 HRESULT create_regexp(script_ctx_t*,jsstr_t*,DWORD,jsdisp_t**) DECLSPEC_HIDDEN;
 HRESULT create_regexp_var(script_ctx_t*,jsval_t,jsval_t*,jsdisp_t**) DECLSPEC_HIDDEN;
+void release_regexp_cache(script_ctx_t*) DECLSPEC_HIDDEN;
 HRESULT create_string(script_ctx_t*,jsstr_t*,jsdisp_t**) DECLSPEC_HIDDEN;
 HRESULT create_bool(script_ctx_t*,BOOL,jsdisp_t**) DECLSPEC_HIDDEN;
 HRESULT create_number(script_ctx_t*,double,jsdisp_t**) DECLSPEC_HIDDEN;
@@ -395,6 +410,11 @@ struct _script_ctx_t {
 
     heap_pool_t tmp_heap;
 
+    jsshape_t *empty_shape;
+    unsigned shape_cnt;
+
+    struct regexp_cache_t *regexp_cache;
+
     IDispatch *host_global;
 
     jsstr_t *last_match;
@@ -592,7 +592,7 @@ static void RegExp_destructor(jsdisp_t *dispex)
     RegExpInstance *This = (RegExpInstance*)dispex;
 
     if(This->jsregexp)
-        regexp_destroy(This->jsregexp);
+        regexp_release(This->jsregexp);
     jsval_release(This->last_index_val);
     jsstr_release(This->str);
     heap_free(This);
@@ -677,7 +677,16 @@ HRESULT create_regexp(script_ctx_t *ctx, jsstr_t *src, DWORD flags, jsdisp_t **r
     regexp->str = jsstr_addref(src);
     regexp->last_index_val = jsval_number(0);
 
-    regexp->jsregexp = regexp_new(ctx, &ctx->tmp_heap, str, jsstr_length(regexp->str), flags, FALSE);
+    if(!ctx->regexp_cache) {
+        ctx->regexp_cache = heap_alloc_zero(sizeof(*ctx->regexp_cache));
+        if(!ctx->regexp_cache) {
+            jsdisp_release(&regexp->dispex);
+            return E_OUTOFMEMORY;
+        }
+    }
+
+    regexp->jsregexp = regexp_cache_get(ctx->regexp_cache, ctx, &ctx->tmp_heap, str,
+            jsstr_length(regexp->str), flags);
     if(!regexp->jsregexp) {
         WARN("regexp_new failed\n");
         jsdisp_release(&regexp->dispex);
@@ -1064,3 +1073,13 @@ HRESULT parse_regexp_flags(const WCHAR *str, DWORD str_len, DWORD *ret)
     *ret = flags;
     return S_OK;
 }
+
+void release_regexp_cache(script_ctx_t *ctx)
+{
+    if(!ctx->regexp_cache)
+        return;
+
+    regexp_cache_clear(ctx->regexp_cache);
+    heap_free(ctx->regexp_cache);
+    ctx->regexp_cache = NULL;
+}
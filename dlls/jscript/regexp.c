@@ -31,14 +31,27 @@
  * the Initial Developer. All Rights Reserved.
  */
 
+/*
+ * This file is shared with vbscript, which builds it with
+ * REGEXP_HOST_VBSCRIPT defined.
+ */
+
 #include <assert.h>
 
+#ifdef REGEXP_HOST_VBSCRIPT
+#include "vbscript.h"
+#else
 #include "jscript.h"
+#endif
 #include "regexp.h"
 
 #include "wine/debug.h"
 
+#ifdef REGEXP_HOST_VBSCRIPT
+WINE_DEFAULT_DEBUG_CHANNEL(vbscript);
+#else
 WINE_DEFAULT_DEBUG_CHANNEL(jscript);
+#endif
 
 /* FIXME: Better error handling */
 #define ReportRegExpError(a,b,c)
@@ -3070,6 +3083,209 @@ good:
     return x;
 }
 
+/*
+ * Start position analysis. AddStartChars collects a superset of characters
+ * a match of the node list t can begin with. It returns TRUE if the list can
+ * match the empty string, in which case the caller has to account for the
+ * nodes following it. Sets set->any if no useful restriction was found.
+ */
+#define START_ANALYSIS_DEPTH 32
+
+typedef struct REStartSet {
+    BYTE    bits[32];
+    BOOL    high;
+    BOOL    any;
+} REStartSet;
+
+static void
+AddStartChar(REStartSet *set, WCHAR c)
+{
+    if (c < 256)
+        set->bits[c >> 3] |= 1 << (c & 0x7);
+    else
+        set->high = TRUE;
+}
+
+static BOOL
+IsZeroWidth(REOp op)
+{
+    switch (op) {
+      case REOP_EMPTY:
+      case REOP_BOL:
+      case REOP_EOL:
+      case REOP_WBDRY:
+      case REOP_WNONBDRY:
+      case REOP_ASSERT:
+      case REOP_ASSERT_NOT:
+        return TRUE;
+      default:
+        return FALSE;
+    }
+}
+
+static BOOL
+AddStartChars(regexp_t *re, RENode *t, REStartSet *set, UINT depth)
+{
+    RECharSet *charSet;
+    BOOL nullable;
+    UINT i;
+
+    if (depth > START_ANALYSIS_DEPTH) {
+        set->any = TRUE;
+        return FALSE;
+    }
+
+    for (; t && !set->any; t = t->next) {
+        if (IsZeroWidth(t->op))
+            continue;
+
+        switch (t->op) {
+          case REOP_FLAT:
+            if (re->flags & REG_FOLD) {
+                /* Chars >= 256 may have the same upper case form as well. */
+                for (i = 0; i < 256; i++) {
+                    if (toupperW(i) == toupperW(t->u.flat.chr))
+                        AddStartChar(set, i);
+                }
+                set->high = TRUE;
+            } else {
+                AddStartChar(set, t->u.flat.chr);
+            }
+            return FALSE;
+          case REOP_DIGIT:
+            for (i = '0'; i <= '9'; i++)
+                AddStartChar(set, i);
+            return FALSE;
+          case REOP_ALNUM:
+            for (i = 0; i < 128; i++) {
+                if (JS_ISWORD(i))
+                    AddStartChar(set, i);
+            }
+            return FALSE;
+          case REOP_SPACE:
+            for (i = 0; i < 256; i++) {
+                if (isspaceW(i))
+                    AddStartChar(set, i);
+            }
+            set->high = TRUE;
+            return FALSE;
+          case REOP_CLASS:
+            charSet = &re->classList[t->u.ucclass.index];
+            assert(charSet->converted);
+            for (i = 0; i < 256; i++) {
+                BOOL in_class = charSet->length != 0 && i <= charSet->length &&
+                    (charSet->u.bits[i >> 3] & (1 << (i & 0x7)));
+                if (!in_class == !t->u.ucclass.sense)
+                    AddStartChar(set, i);
+            }
+            if (!t->u.ucclass.sense || charSet->length >= 256)
+                set->high = TRUE;
+            return FALSE;
+          case REOP_LPAREN:
+          case REOP_LPARENNON:
+            if (!AddStartChars(re, t->kid, set, depth + 1))
+                return FALSE;
+            break;
+          case REOP_ALT:
+          case REOP_ALTPREREQ:
+          case REOP_ALTPREREQ2:
+            nullable = AddStartChars(re, t->kid, set, depth + 1);
+            nullable |= AddStartChars(re, t->u.kid2, set, depth + 1);
+            if (!nullable)
+                return FALSE;
+            break;
+          case REOP_QUANT:
+            nullable = AddStartChars(re, t->kid, set, depth + 1);
+            if (!nullable && t->u.range.min)
+                return FALSE;
+            break;
+          default:
+            set->any = TRUE;
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Compute the start position filter used by MatchRegExp. Must be called
+ * after classes are converted and before the parse tree is released.
+ */
+static void
+AnalyzeStart(regexp_t *re, RENode *t)
+{
+    REStartSet set;
+    RENode *first;
+    UINT i, cnt = 0;
+    WCHAR c = 0;
+
+    re->start_bol = t->op == REOP_BOL;
+    re->start_type = REG_START_ANY;
+    re->prefix = NULL;
+    re->prefix_len = 0;
+
+    memset(&set, 0, sizeof(set));
+    if (AddStartChars(re, t, &set, 0) || set.any)
+        return;
+
+    for (first = t; first && IsZeroWidth(first->op); first = first->next);
+    if (first->op == REOP_FLAT && !(re->flags & REG_FOLD)) {
+        re->start_type = REG_START_CHAR;
+        re->start_char = first->u.flat.chr;
+        if (first->kid) {
+            re->prefix = first->kid;
+            re->prefix_len = first->u.flat.length;
+        }
+        return;
+    }
+
+    for (i = 0; i < 256; i++) {
+        if (set.bits[i >> 3] & (1 << (i & 0x7))) {
+            c = i;
+            cnt++;
+        }
+    }
+    if (cnt == 1 && !set.high) {
+        re->start_type = REG_START_CHAR;
+        re->start_char = c;
+        return;
+    }
+
+    re->start_type = REG_START_SET;
+    re->start_high = set.high;
+    memcpy(re->start_set, set.bits, sizeof(re->start_set));
+}
+
+/*
+ * Returns the first position at or after cp where a match may start, or NULL
+ * if there is none.
+ */
+static const WCHAR *
+FindStart(const regexp_t *re, const WCHAR *cp, const WCHAR *cpend)
+{
+    WCHAR c;
+
+    switch (re->start_type) {
+      case REG_START_CHAR:
+        while ((cp = memchrW(cp, re->start_char, cpend - cp))) {
+            if (re->prefix_len <= 1 ||
+                (re->prefix_len <= (size_t)(cpend - cp) &&
+                 !memcmp(cp + 1, re->prefix + 1, (re->prefix_len - 1) * sizeof(WCHAR))))
+                return cp;
+            cp++;
+        }
+        return NULL;
+      case REG_START_SET:
+        for (; cp < cpend; cp++) {
+            c = *cp;
+            if (c < 256 ? (re->start_set[c >> 3] & (1 << (c & 0x7))) : re->start_high)
+                return cp;
+        }
+        return NULL;
+    }
+    return cp;
+}
+
 static match_state_t *MatchRegExp(REGlobalData *gData, match_state_t *x)
 {
     match_state_t *result;
@@ -3082,6 +3298,16 @@ static match_state_t *MatchRegExp(REGlobalData *gData, match_state_t *x)
      * in order to detect end-of-input/line condition.
      */
     for (cp2 = cp; cp2 <= gData->cpend; cp2++) {
+        if (!(gData->regexp->flags & REG_STICKY)) {
+            if (gData->regexp->start_bol && !(gData->regexp->flags & REG_MULTILINE)) {
+                if (cp2 != gData->cpbegin)
+                    return NULL;
+            } else if (gData->regexp->start_type != REG_START_ANY) {
+                cp2 = FindStart(gData->regexp, cp2, gData->cpend);
+                if (!cp2)
+                    return NULL;
+            }
+        }
         gData->skipped = cp2 - cp;
         x->cp = cp2;
         for (j = 0; j < gData->regexp->parenCount; j++)
@@ -3178,8 +3404,11 @@ HRESULT regexp_execute(regexp_t *regexp, void *cx, heap_pool_t *pool,
     return S_OK;
 }
 
-void regexp_destroy(regexp_t *re)
+void regexp_release(regexp_t *re)
 {
+    if (--re->ref)
+        return;
+
     if (re->classList) {
         UINT i;
         for (i = 0; i < re->classCount; i++) {
@@ -3189,6 +3418,7 @@ void regexp_destroy(regexp_t *re)
         }
         heap_free(re->classList);
     }
+    heap_free((WCHAR*)re->source);
     heap_free(re);
 }
 
@@ -3198,8 +3428,10 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
     regexp_t *re;
     heap_pool_t *mark;
     CompilerState state;
+    REGlobalData gData;
     size_t resize;
     jsbytecode *endPC;
+    WCHAR *source;
     UINT i;
     size_t len;
 
@@ -3207,11 +3439,18 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
     mark = heap_pool_mark(pool);
     len = str_len;
 
+    if (!str)
+        goto out;
+
+    /* Bytecode and the start filter refer to the source, so keep a private copy. */
+    source = heap_alloc(len * sizeof(WCHAR));
+    if (!source)
+        goto out;
+    memcpy(source, str, len * sizeof(WCHAR));
+
     state.context = cx;
     state.pool = pool;
-    state.cp = str;
-    if (!state.cp)
-        goto out;
+    state.cp = source;
     state.cpbegin = state.cp;
     state.cpend = state.cp + len;
     state.flags = flags;
@@ -3234,20 +3473,29 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
         state.progLength += 1 + GetCompactIndexWidth(0)
                           + GetCompactIndexWidth(len);
     } else {
-        if (!ParseRegExp(&state))
+        if (!ParseRegExp(&state)) {
+            heap_free(source);
             goto out;
+        }
     }
     resize = offsetof(regexp_t, program) + state.progLength + 1;
     re = heap_alloc(resize);
-    if (!re)
+    if (!re) {
+        heap_free(source);
         goto out;
+    }
+
+    re->ref = 1;
+    re->flags = flags;
+    re->source = source;
+    re->source_len = str_len;
 
     assert(state.classBitmapsMem <= CLASS_BITMAPS_MEM_LIMIT);
     re->classCount = state.classCount;
     if (re->classCount) {
         re->classList = heap_alloc(re->classCount * sizeof(RECharSet));
         if (!re->classList) {
-            regexp_destroy(re);
+            regexp_release(re);
             re = NULL;
             goto out;
         }
@@ -3258,11 +3506,27 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
     }
     endPC = EmitREBytecode(&state, re, state.treeDepth, re->program, state.result);
     if (!endPC) {
-        regexp_destroy(re);
+        regexp_release(re);
         re = NULL;
         goto out;
     }
     *endPC++ = REOP_END;
+
+    /* Convert classes now, the start analysis needs their bitmaps. */
+    gData.cx = cx;
+    gData.regexp = re;
+    gData.ok = TRUE;
+    for (i = 0; i < re->classCount; i++) {
+        if (!re->classList[i].converted &&
+                !ProcessCharSet(&gData, &re->classList[i])) {
+            regexp_release(re);
+            re = NULL;
+            goto out;
+        }
+    }
+
+    AnalyzeStart(re, state.result);
+
     /*
      * Check whether size was overestimated and shrink using realloc.
      * This is safe since no pointers to newly parsed regexp or its parts
@@ -3277,12 +3541,64 @@ regexp_t* regexp_new(void *cx, heap_pool_t *pool, const WCHAR *str,
             re = tmp;
     }
 
-    re->flags = flags;
     re->parenCount = state.parenCount;
-    re->source = str;
-    re->source_len = str_len;
 
 out:
     heap_pool_clear(mark);
     return re;
 }
+
+HRESULT regexp_set_flags(regexp_t **regexp, void *cx, heap_pool_t *pool, WORD flags)
+{
+    if(((*regexp)->flags & REG_FOLD) != (flags & REG_FOLD)) {
+        regexp_t *new_regexp = regexp_new(cx, pool, (*regexp)->source,
+                (*regexp)->source_len, flags, FALSE);
+
+        if(!new_regexp)
+            return E_FAIL;
+
+        regexp_release(*regexp);
+        *regexp = new_regexp;
+    }else {
+        (*regexp)->flags = flags;
+    }
+
+    return S_OK;
+}
+
+regexp_t *regexp_cache_get(regexp_cache_t *cache, void *cx, heap_pool_t *pool,
+        const WCHAR *str, DWORD str_len, WORD flags)
+{
+    regexp_t *re;
+    unsigned i;
+
+    for(i = 0; i < cache->count; i++) {
+        re = cache->entries[i];
+        if(re->flags == flags && re->source_len == str_len
+           && !memcmp(re->source, str, str_len*sizeof(WCHAR))) {
+            memmove(cache->entries+1, cache->entries, i*sizeof(*cache->entries));
+            cache->entries[0] = re;
+            re->ref++;
+            return re;
+        }
+    }
+
+    re = regexp_new(cx, pool, str, str_len, flags, FALSE);
+    if(!re)
+        return NULL;
+
+    if(cache->count == REGEXP_CACHE_SIZE)
+        regexp_release(cache->entries[--cache->count]);
+    memmove(cache->entries+1, cache->entries, cache->count*sizeof(*cache->entries));
+    cache->entries[0] = re;
+    cache->count++;
+
+    re->ref++;
+    return re;
+}
+
+void regexp_cache_clear(regexp_cache_t *cache)
+{
+    while(cache->count)
+        regexp_release(cache->entries[--cache->count]);
+}
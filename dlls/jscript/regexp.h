@@ -51,20 +51,45 @@ typedef struct match_state_t {
 
 typedef BYTE jsbytecode;
 
+/* Start position filters, computed at compile time. */
+#define REG_START_ANY   0       /* a match may start anywhere */
+#define REG_START_CHAR  1       /* every match starts with start_char (and prefix) */
+#define REG_START_SET   2       /* every match starts with a char in start_set */
+
 typedef struct regexp_t {
+    LONG                ref;
     WORD                flags;         /* flags, see jsapi.h's REG_* defines */
     size_t              parenCount;    /* number of parenthesized submatches */
     size_t              classCount;    /* count [...] bitmaps */
     struct RECharSet    *classList;    /* list of [...] bitmaps */
-    const WCHAR         *source;       /* locked source string, sans // */
+    const WCHAR         *source;       /* copy of source string, sans // */
     DWORD               source_len;
+    BOOL                start_bol;     /* every match starts with ^ */
+    WORD                start_type;    /* REG_START_* */
+    WCHAR               start_char;    /* REG_START_CHAR first char */
+    BOOL                start_high;    /* REG_START_SET allows chars >= 256 */
+    const WCHAR         *prefix;       /* REG_START_CHAR literal, points into source */
+    DWORD               prefix_len;
+    BYTE                start_set[32]; /* REG_START_SET bitmap of chars < 256 */
     jsbytecode          program[1];    /* regular expression bytecode */
 } regexp_t;
 
+#define REGEXP_CACHE_SIZE 16
+
+/* Most recently used compiled regexps, keyed by source and flags. */
+typedef struct regexp_cache_t {
+    unsigned            count;
+    regexp_t            *entries[REGEXP_CACHE_SIZE];
+} regexp_cache_t;
+
 regexp_t* regexp_new(void*, heap_pool_t*, const WCHAR*, DWORD, WORD, BOOL) DECLSPEC_HIDDEN;
-void regexp_destroy(regexp_t*) DECLSPEC_HIDDEN;
+void regexp_release(regexp_t*) DECLSPEC_HIDDEN;
 HRESULT regexp_execute(regexp_t*, void*, heap_pool_t*, const WCHAR*,
         DWORD, match_state_t*) DECLSPEC_HIDDEN;
+HRESULT regexp_set_flags(regexp_t**, void*, heap_pool_t*, WORD) DECLSPEC_HIDDEN;
+regexp_t *regexp_cache_get(regexp_cache_t*, void*, heap_pool_t*, const WCHAR*,
+        DWORD, WORD) DECLSPEC_HIDDEN;
+void regexp_cache_clear(regexp_cache_t*) DECLSPEC_HIDDEN;
 
 static inline match_state_t* alloc_match_state(regexp_t *regexp,
         heap_pool_t *pool, const WCHAR *pos)
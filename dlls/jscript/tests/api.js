@@ -886,6 +886,59 @@ arr = new PseudoArray();
 Array.prototype.push.call(arr, 2);
 ok(arr.propertyIsEnumerable("length"), "arr.length is not enumerable");
 
+arr = [];
+for(i=0; i < 100; i++)
+    arr[i] = i;
+ok(arr.length === 100, "arr.length = " + arr.length);
+tmp = 0;
+for(i=0; i < arr.length; i++)
+    tmp += arr[i];
+ok(tmp === 4950, "sum = " + tmp);
+ok(arr["50"] === 50, "arr['50'] = " + arr["50"]);
+ok(arr.hasOwnProperty("99"), "arr.hasOwnProperty('99') is false");
+ok(!arr.hasOwnProperty("100"), "arr.hasOwnProperty('100') is true");
+arr[10]++;
+arr[20] += 5;
+ok(arr[10] === 11 && arr[20] === 25, "arr[10] = " + arr[10] + " arr[20] = " + arr[20]);
+tmp = 0;
+for(i in arr)
+    tmp++;
+ok(tmp === 100, "enumerated " + tmp + " elements");
+ok((delete arr[50]) === true, "delete arr[50] returned false");
+ok(!(50 in arr), "arr[50] not deleted");
+ok(arr[51] === 51 && arr["99"] === 99, "arr[51] = " + arr[51] + " arr[99] = " + arr[99]);
+ok(arr.length === 100, "arr.length = " + arr.length);
+arr.length = 60;
+ok(arr[59] === 59 && arr[60] === undefined, "arr[59] = " + arr[59] + " arr[60] = " + arr[60]);
+arr[50] = 50;
+ok(arr[50] === 50, "arr[50] = " + arr[50]);
+
+arr = [1,2,3];
+ok(arr["2"] === 3, "arr['2'] = " + arr["2"]);
+arr.pop();
+ok(!("2" in arr), "arr[2] not deleted");
+arr.push(4);
+ok(arr["2"] === 4, "arr['2'] = " + arr["2"]);
+arr.unshift(0);
+ok(arr.join() === "0,1,2,4", "arr = " + arr);
+ok(arr.shift() === 0, "shift did not return 0");
+ok(arr.join() === "1,2,4", "arr = " + arr);
+arr[5] = 6;
+ok(arr.length === 6, "arr.length = " + arr.length);
+ok(arr.join() === "1,2,4,,,6", "arr = " + arr);
+arr[3] = 5;
+ok(arr.join() === "1,2,4,5,,6", "arr = " + arr);
+
+function testArgumentsElements(a) {
+    ok(arguments.length === 3, "arguments.length = " + arguments.length);
+    ok(arguments[0] === 1 && arguments[2] === 3, "arguments = " + arguments[0] + "," + arguments[2]);
+    arguments[2] = 4;
+    ok(arguments[2] === 4, "arguments[2] = " + arguments[2]);
+    arguments[0] = 5;
+    ok(a === 5, "a = " + a);
+}
+testArgumentsElements(1, 2, 3);
+
 arr = [1,2,null,false,undefined,,"a"];
 
 tmp = arr.join();
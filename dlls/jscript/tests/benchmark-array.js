@@ -0,0 +1,41 @@
+/*
+ * Array fill, sum and sort benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+var size = 1000000;
+var arr = [], i, sum;
+
+/* fill */
+for(i = 0; i < size; i++)
+    arr[i] = (i * 7919) % size;
+
+/* sum */
+sum = 0;
+for(i = 0; i < arr.length; i++)
+    sum += arr[i];
+
+/* sort */
+arr.sort(function(a, b) { return a - b; });
+
+/* push/pop */
+var stack = [];
+for(i = 0; i < size; i++)
+    stack.push(i);
+while(stack.length)
+    stack.pop();
+
+var str = arr.slice(0, 1000).join(",");
@@ -0,0 +1,64 @@
+/*
+ * Named property access benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+var size = 1000000;
+var objs = [], o, i, sum;
+
+function Point(x, y) {
+    this.x = x;
+    this.y = y;
+    this.z = 0;
+}
+
+Point.prototype.length2 = function() {
+    return this.x * this.x + this.y * this.y + this.z * this.z;
+};
+
+for(i = 0; i < 16; i++)
+    objs.push(new Point(i, i + 1));
+
+/* loads */
+sum = 0;
+for(i = 0; i < size; i++) {
+    o = objs[i & 15];
+    sum += o.x + o.y + o.z;
+}
+
+/* stores */
+for(i = 0; i < size; i++) {
+    o = objs[i & 15];
+    o.z = o.x;
+    o.x = o.y;
+    o.y = o.z;
+}
+
+/* compound assignments */
+for(i = 0; i < size; i++)
+    objs[i & 15].z += 1;
+
+/* method calls through the prototype */
+sum = 0;
+for(i = 0; i < size; i++)
+    sum += objs[i & 15].length2();
+
+/* object literals sharing the same property order */
+sum = 0;
+for(i = 0; i < size; i++) {
+    o = {a: i, b: i + 1, c: i + 2};
+    sum += o.a + o.b + o.c;
+}
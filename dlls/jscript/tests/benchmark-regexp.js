@@ -0,0 +1,61 @@
+/*
+ * Regular expression log parsing benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+var levels = ["INFO", "DEBUG", "WARN", "ERROR"];
+var lines = [], log, i, m, cnt;
+
+for(i = 0; i < 20000; i++) {
+    lines.push("2015-09-" + (10 + i % 20) + " 12:" + (10 + i % 50) + ":" + (10 + i % 49) + " " +
+               levels[i % 4] + " [worker-" + (i % 8) + "] request " + i +
+               " from 10.0." + (i % 256) + "." + (i % 100) + " took " + (i % 997) + "ms" +
+               (i % 31 ? "" : " user=admin@example.com"));
+}
+log = lines.join("\n");
+
+/* literal prefix */
+cnt = 0;
+var re = /ERROR \[worker-3\]/g;
+while(re.exec(log))
+    cnt++;
+
+/* first character set */
+cnt = 0;
+re = /[a-z]+@[a-z]+\.com/g;
+while((m = re.exec(log)))
+    cnt++;
+
+/* case insensitive literal */
+cnt = log.match(/warn/gi).length;
+
+/* anchored multiline */
+cnt = log.match(/^2015-09-1\d 12:3/gm).length;
+
+/* replace */
+var ips = log.replace(/10\.0\.(\d+)\.(\d+)/g, "$2.$1.0.10");
+
+/* patterns compiled in a loop */
+cnt = 0;
+for(i = 0; i < lines.length; i += 10) {
+    if(/took 9\d\dms/.test(lines[i]))
+        cnt++;
+    if(lines[i].search(new RegExp("worker-" + (i % 8))) !== -1)
+        cnt++;
+}
+
+/* split */
+var fields = lines[0].split(/\s+/);
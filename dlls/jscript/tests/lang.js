@@ -1420,6 +1420,47 @@ tmp = (function() {
 })();
 ok(tmp, "tmp = " + tmp);
 
+/* Property lookups on objects with the same and different layouts */
+(function() {
+    function getX(o) { return o.x; }
+    function setX(o, v) { o.x = v; }
+    var objs = [{x: 1, y: 2}, {y: 3, x: 4}, {x: 5, y: 6}, {z: 7}], i, o;
+
+    for(i = 0; i < 2; i++) {
+        ok(getX(objs[0]) === 1, "getX(objs[0]) = " + getX(objs[0]));
+        ok(getX(objs[1]) === 4, "getX(objs[1]) = " + getX(objs[1]));
+        ok(getX(objs[2]) === 5, "getX(objs[2]) = " + getX(objs[2]));
+        ok(getX(objs[3]) === undefined, "getX(objs[3]) = " + getX(objs[3]));
+    }
+
+    setX(objs[0], 10);
+    setX(objs[2], 11);
+    ok(objs[0].x === 10 && objs[0].y === 2, "objs[0] = " + objs[0].x + "," + objs[0].y);
+    ok(objs[2].x === 11 && objs[2].y === 6, "objs[2] = " + objs[2].x + "," + objs[2].y);
+
+    delete objs[2].x;
+    ok(getX(objs[2]) === undefined, "getX(objs[2]) = " + getX(objs[2]));
+    ok(getX(objs[0]) === 10, "getX(objs[0]) = " + getX(objs[0]));
+    setX(objs[2], 12);
+    ok(getX(objs[2]) === 12, "getX(objs[2]) = " + getX(objs[2]));
+
+    function C() {}
+    o = new C();
+    ok(getX(o) === undefined, "getX(o) = " + getX(o));
+    C.prototype.x = 13;
+    ok(getX(o) === 13, "getX(o) = " + getX(o));
+    ok(getX(new C()) === 13, "getX(new C()) = " + getX(new C()));
+    setX(o, 14);
+    ok(getX(o) === 14, "getX(o) = " + getX(o));
+    ok(C.prototype.x === 13, "C.prototype.x = " + C.prototype.x);
+
+    o = {};
+    for(i = 0; i < 100; i++)
+        o["p" + i] = i;
+    o.x = 15;
+    ok(getX(o) === 15, "getX(o) = " + getX(o));
+})();
+
 /* NoNewline rule parser tests */
 while(true) {
     if(true) break
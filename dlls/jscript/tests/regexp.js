@@ -660,4 +660,30 @@ tmp = new RegExp("abc/", "mgi");
 ok(tmp.toString() === "/abc//igm", "(new RegExp(\"abc/\")).toString() = " + tmp.toString());
 ok(/abc/.toString(1, false, "3") === "/abc/", "/abc/.toString(1, false, \"3\") = " + /abc/.toString());
 
+
+tmp = "xxabdabc".search(/abc/);
+ok(tmp === 5, '"xxabdabc".search(/abc/) = ' + tmp);
+tmp = "xxaBC".search(/abc/i);
+ok(tmp === 2, '"xxaBC".search(/abc/i) = ' + tmp);
+tmp = "foo bar".search(/[^a-z]/);
+ok(tmp === 3, '"foo bar".search(/[^a-z]/) = ' + tmp);
+tmp = "x\u0150a".search(/[\u0100-\u0200]a/);
+ok(tmp === 1, '"x\\u0150a".search(/[\\u0100-\\u0200]a/) = ' + tmp);
+tmp = "xyz".search(/q*/);
+ok(tmp === 0, '"xyz".search(/q*/) = ' + tmp);
+tmp = "xyz".search(/(z|q)$/);
+ok(tmp === 2, '"xyz".search(/(z|q)$/) = ' + tmp);
+tmp = "a1b22c".replace(/\d+/g, "#");
+ok(tmp === "a#b#c", '"a1b22c".replace(/\\d+/g, "#") = ' + tmp);
+tmp = "ab\nab".replace(/^ab/g, "x");
+ok(tmp === "x\nab", '"ab\\nab".replace(/^ab/g, "x") = ' + tmp);
+tmp = "ab\nab".replace(/^ab/gm, "x");
+ok(tmp === "x\nx", '"ab\\nab".replace(/^ab/gm, "x") = ' + tmp);
+
+for(i = 0; i < 3; i++) {
+    ok(!/abc/.test("ABC"), "/abc/.test(\"ABC\") returned true");
+    ok(/abc/i.test("ABC"), "/abc/i.test(\"ABC\") returned false");
+    ok(new RegExp("abc", "i").test("ABC"), "new RegExp(\"abc\", \"i\").test(\"ABC\") returned false");
+}
+
 reportSuccess();
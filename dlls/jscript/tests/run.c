@@ -2843,6 +2843,9 @@ static void run_benchmarks(void)
     run_benchmark("dna.js");
     run_benchmark("base64.js");
     run_benchmark("validateinput.js");
+    run_benchmark("array.js");
+    run_benchmark("regexp_bench.js");
+    run_benchmark("property_bench.js");
 }
 
 static BOOL check_jscript(void)
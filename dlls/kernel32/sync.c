@@ -2231,6 +2231,29 @@ BOOL WINAPI GetQueuedCompletionStatus( HANDLE CompletionPort, LPDWORD lpNumberOf
 }
 
 
+/******************************************************************************
+ *		GetQueuedCompletionStatusEx (KERNEL32.@)
+ */
+BOOL WINAPI GetQueuedCompletionStatusEx( HANDLE CompletionPort, LPOVERLAPPED_ENTRY entries, ULONG count,
+                                         PULONG removed, DWORD dwMilliseconds, BOOL alertable )
+{
+    NTSTATUS status;
+    LARGE_INTEGER wait_time;
+
+    TRACE("(%p,%p,%u,%p,%d,%d)\n", CompletionPort, entries, count, removed, dwMilliseconds, alertable);
+
+    status = NtRemoveIoCompletionEx( CompletionPort, (FILE_IO_COMPLETION_INFORMATION *)entries, count,
+                                     removed, get_nt_timeout( &wait_time, dwMilliseconds ), alertable );
+    if (status == STATUS_SUCCESS) return TRUE;
+
+    *removed = 0;
+    if (status == STATUS_TIMEOUT) SetLastError( WAIT_TIMEOUT );
+    else if (status == STATUS_USER_APC) SetLastError( WAIT_IO_COMPLETION );
+    else SetLastError( RtlNtStatusToDosError(status) );
+    return FALSE;
+}
+
+
 /******************************************************************************
  *		PostQueuedCompletionStatus (KERNEL32.@)
  */
@@ -2430,6 +2453,24 @@ BOOL WINAPI SleepConditionVariableCS( CONDITION_VARIABLE *variable, CRITICAL_SEC
     return TRUE;
 }
 
+/***********************************************************************
+ *           WaitOnAddress   (KERNEL32.@)
+ */
+BOOL WINAPI WaitOnAddress( volatile void *addr, void *cmp, SIZE_T size, DWORD timeout )
+{
+    NTSTATUS status;
+    LARGE_INTEGER time;
+
+    status = RtlWaitOnAddress( (const void *)addr, cmp, size, get_nt_timeout( &time, timeout ) );
+
+    if (status != STATUS_SUCCESS)
+    {
+        SetLastError( status == STATUS_TIMEOUT ? ERROR_TIMEOUT : RtlNtStatusToDosError(status) );
+        return FALSE;
+    }
+    return TRUE;
+}
+
 /***********************************************************************
  *           SleepConditionVariableSRW   (KERNEL32.@)
  */
@@ -39,6 +39,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
 struct heap_layout
@@ -853,6 +854,169 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+#define LFH_THREAD_ITERATIONS 2000
+
+static DWORD WINAPI lfh_thread( void *arg )
+{
+    HANDLE heap = arg;
+    void *blocks[64];
+    unsigned int i, j;
+
+    for (i = 0; i < LFH_THREAD_ITERATIONS; i++)
+    {
+        for (j = 0; j < 64; j++) blocks[j] = HeapAlloc( heap, 0, 8 + (i * 64 + j) % 500 );
+        for (j = 0; j < 64; j++) HeapFree( heap, 0, blocks[(j * 7) % 64] );
+    }
+    return 0;
+}
+
+static DWORD lfh_benchmark( HANDLE heap, unsigned int count )
+{
+    HANDLE threads[16];
+    DWORD start = GetTickCount();
+    unsigned int i;
+
+    for (i = 0; i < count; i++) threads[i] = CreateThread( NULL, 0, lfh_thread, heap, 0, NULL );
+    WaitForMultipleObjects( count, threads, TRUE, INFINITE );
+    for (i = 0; i < count; i++) CloseHandle( threads[i] );
+    return GetTickCount() - start;
+}
+
+static void test_low_fragmentation_heap(void)
+{
+    HANDLE heap, std_heap;
+    ULONG info;
+    BYTE *p, *p2;
+    unsigned int i, count;
+    DWORD lfh_time, std_time;
+    BOOL ret;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( HEAP_NO_SERIALIZE, 0, 0 );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    ok( !ret, "low fragmentation heap enabled on a HEAP_NO_SERIALIZE heap\n" );
+    HeapDestroy( heap );
+
+    heap = HeapCreate( 0, 0, 0 );
+    info = 2;
+    ret = pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    if (!ret)
+    {
+        skip("low fragmentation heap not available\n");  /* e.g. running under a debugger */
+        HeapDestroy( heap );
+        return;
+    }
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation( heap, HeapCompatibilityInformation, &info, sizeof(info), NULL );
+    ok( ret, "HeapQueryInformation error %u\n", GetLastError() );
+    ok( info == 2, "expected 2, got %u\n", info );
+
+    p = HeapAlloc( heap, HEAP_ZERO_MEMORY, 100 );
+    ok( p != NULL, "HeapAlloc failed\n" );
+    ok( HeapSize( heap, 0, p ) == 100, "wrong size %lu\n", HeapSize( heap, 0, p ) );
+    ok( HeapValidate( heap, 0, p ), "HeapValidate failed\n" );
+    for (i = 0; i < 100; i++) if (p[i]) break;
+    ok( i == 100, "block not zeroed at %u\n", i );
+    memset( p, 0xcc, 100 );
+
+    p2 = HeapReAlloc( heap, HEAP_ZERO_MEMORY, p, 110 );
+    ok( p2 != NULL, "HeapReAlloc failed\n" );
+    ok( HeapSize( heap, 0, p2 ) == 110, "wrong size %lu\n", HeapSize( heap, 0, p2 ) );
+    ok( p2[99] == 0xcc && !p2[100] && !p2[109], "wrong contents\n" );
+    p = HeapReAlloc( heap, 0, p2, 100000 );
+    ok( p != NULL, "HeapReAlloc failed\n" );
+    ok( HeapSize( heap, 0, p ) == 100000, "wrong size %lu\n", HeapSize( heap, 0, p ) );
+    ok( p[0] == 0xcc && p[99] == 0xcc, "wrong contents\n" );
+    ok( HeapFree( heap, 0, p ), "HeapFree failed\n" );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+
+    lfh_benchmark( heap, 2 );
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapDestroy( heap );
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+
+    heap = HeapCreate( 0, 0, 0 );
+    info = 2;
+    pHeapSetInformation( heap, HeapCompatibilityInformation, &info, sizeof(info) );
+    std_heap = HeapCreate( 0, 0, 0 );
+    for (count = 1; count <= 16; count *= 2)
+    {
+        lfh_time = lfh_benchmark( heap, count );
+        std_time = lfh_benchmark( std_heap, count );
+        trace( "%2u threads: %u ms with the low fragmentation heap, %u ms without\n",
+               count, lfh_time, std_time );
+    }
+    ok( HeapValidate( heap, 0, NULL ), "HeapValidate failed\n" );
+    HeapDestroy( std_heap );
+    HeapDestroy( heap );
+}
+
+static void test_heap_statistics(void)
+{
+    HEAP_WINE_STATISTICS stats;
+    HANDLE heap;
+    void *small[10], *big;
+    SIZE_T size;
+    BOOL ret;
+    int i;
+
+    if (!pHeapQueryInformation)
+    {
+        win_skip("HeapQueryInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate( 0, 0, 0 );
+    ret = pHeapQueryInformation( heap, HeapWineStatistics, &stats, sizeof(stats), &size );
+    if (!ret)
+    {
+        win_skip("heap statistics not supported\n");
+        HeapDestroy( heap );
+        return;
+    }
+    ok( size == sizeof(stats), "wrong size %lu\n", size );
+    ok( stats.SubheapCount == 1, "wrong sub-heap count %u\n", stats.SubheapCount );
+    ok( !stats.BusyBlocks, "wrong busy blocks %lu\n", stats.BusyBlocks );
+    ok( stats.FreeBlocks == 1, "wrong free blocks %lu\n", stats.FreeBlocks );
+    ok( stats.CommittedBytes <= stats.ReservedBytes, "committed %lu reserved %lu\n",
+        stats.CommittedBytes, stats.ReservedBytes );
+
+    for (i = 0; i < 10; i++) small[i] = HeapAlloc( heap, 0, 100 );
+    big = HeapAlloc( heap, 0, 4 * 1024 * 1024 );
+    ret = pHeapQueryInformation( heap, HeapWineStatistics, &stats, sizeof(stats), NULL );
+    ok( ret, "HeapQueryInformation failed %u\n", GetLastError() );
+    ok( stats.BusyBlocks == 11, "wrong busy blocks %lu\n", stats.BusyBlocks );
+    ok( stats.BusyBytes == 10 * 100 + 4 * 1024 * 1024, "wrong busy bytes %lu\n", stats.BusyBytes );
+    ok( stats.LargeBlockCount == 1, "wrong large block count %u\n", stats.LargeBlockCount );
+    ok( stats.LargeBlockBytes >= 4 * 1024 * 1024, "wrong large block size %lu\n", stats.LargeBlockBytes );
+    ok( stats.AllocationCount == 11, "wrong allocation count %u\n", (DWORD)stats.AllocationCount );
+    ok( stats.SizeClassCount[3] == 10, "wrong count for 128 bytes %u\n", (DWORD)stats.SizeClassCount[3] );
+    ok( stats.SizeClassCount[HEAP_STATISTICS_SIZE_CLASSES - 1] == 1, "wrong count for large blocks %u\n",
+        (DWORD)stats.SizeClassCount[HEAP_STATISTICS_SIZE_CLASSES - 1] );
+
+    for (i = 0; i < 10; i++) HeapFree( heap, 0, small[i] );
+    HeapFree( heap, 0, big );
+    ret = pHeapQueryInformation( heap, HeapWineStatistics, &stats, sizeof(stats), NULL );
+    ok( ret, "HeapQueryInformation failed %u\n", GetLastError() );
+    ok( !stats.BusyBlocks, "wrong busy blocks %lu\n", stats.BusyBlocks );
+    ok( !stats.BusyBytes, "wrong busy bytes %lu\n", stats.BusyBytes );
+    ok( !stats.LargeBlockCount, "wrong large block count %u\n", stats.LargeBlockCount );
+    ok( stats.AllocationCount == 11, "wrong allocation count %u\n", (DWORD)stats.AllocationCount );
+    HeapDestroy( heap );
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -1173,6 +1337,8 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), (2 << 20));
     test_sized_HeapReAlloc((1 << 20), 1);
     test_HeapQueryInformation();
+    test_low_fragmentation_heap();
+    test_heap_statistics();
 
     if (pRtlGetNtGlobalFlags)
     {
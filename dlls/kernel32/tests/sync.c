@@ -57,6 +57,13 @@ static VOID   (WINAPI *pReleaseSRWLockShared)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockExclusive)(PSRWLOCK);
 static BOOLEAN (WINAPI *pTryAcquireSRWLockShared)(PSRWLOCK);
 static NTSTATUS (WINAPI *pNtWaitForMultipleObjects)(ULONG,const HANDLE*,BOOLEAN,BOOLEAN,const LARGE_INTEGER*);
+static BOOL   (WINAPI *pWaitOnAddress)(volatile void*,PVOID,SIZE_T,DWORD);
+static VOID   (WINAPI *pWakeByAddressAll)(PVOID);
+static VOID   (WINAPI *pWakeByAddressSingle)(PVOID);
+static NTSTATUS (WINAPI *pNtCreateKeyedEvent)(HANDLE*,ACCESS_MASK,const OBJECT_ATTRIBUTES*,ULONG);
+static NTSTATUS (WINAPI *pNtReleaseKeyedEvent)(HANDLE,const void*,BOOLEAN,const LARGE_INTEGER*);
+static NTSTATUS (WINAPI *pNtWaitForKeyedEvent)(HANDLE,const void*,BOOLEAN,const LARGE_INTEGER*);
+static BOOL   (WINAPI *pGetQueuedCompletionStatusEx)(HANDLE,OVERLAPPED_ENTRY*,ULONG,ULONG*,DWORD,BOOL);
 
 static void test_signalandwait(void)
 {
@@ -540,6 +547,90 @@ static void test_waitable_timer(void)
     CloseHandle( handle );
 }
 
+/* average time in microseconds to rearm and cancel a timer in the middle of the pending ones */
+static double time_timer_rearm( HANDLE timer, LONGLONG due_time, int count )
+{
+    LARGE_INTEGER due, start, end, freq;
+    int i;
+
+    QueryPerformanceFrequency( &freq );
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < count; i++)
+    {
+        due.QuadPart = due_time - i;
+        SetWaitableTimer( timer, &due, 0, NULL, NULL, FALSE );
+        CancelWaitableTimer( timer );
+    }
+    QueryPerformanceCounter( &end );
+    return (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart / count;
+}
+
+/* delay in microseconds between the due time of a short timer and the wakeup of its waiter */
+static double time_timer_latency( HANDLE timer )
+{
+    LARGE_INTEGER due, start, end, freq;
+    DWORD ret;
+
+    QueryPerformanceFrequency( &freq );
+    due.QuadPart = -20 * 10000;  /* 20 ms */
+    QueryPerformanceCounter( &start );
+    SetWaitableTimer( timer, &due, 0, NULL, NULL, FALSE );
+    ret = WaitForSingleObject( timer, 5000 );
+    QueryPerformanceCounter( &end );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    return (end.QuadPart - start.QuadPart) * 1000000.0 / freq.QuadPart - 20000;
+}
+
+static void test_many_timers(void)
+{
+    static const int count = 100000;
+    static const LONGLONG hour = (LONGLONG)3600 * 10000000;
+    HANDLE *timers, timer;
+    LARGE_INTEGER due;
+    DWORD ret, start;
+    int i, created;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+    if (!pCreateWaitableTimerA)
+    {
+        win_skip("CreateWaitableTimerA() is not available\n");
+        return;
+    }
+
+    timer = pCreateWaitableTimerA( NULL, TRUE, NULL );
+    trace( "no pending timers: rearm %.2f us, wakeup latency %.0f us\n",
+           time_timer_rearm( timer, -hour - (LONGLONG)count / 2 * 10000, 10000 ),
+           time_timer_latency( timer ));
+
+    timers = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*timers) );
+    start = GetTickCount();
+    for (created = 0; created < count; created++)
+    {
+        if (!(timers[created] = pCreateWaitableTimerA( NULL, TRUE, NULL ))) break;
+        /* spread the due times in a scrambled order, between one hour and one hour and 100 s */
+        due.QuadPart = -hour - (LONGLONG)(created * 7919 % count) * 10000;
+        ret = SetWaitableTimer( timers[created], &due, 0, NULL, NULL, FALSE );
+        ok( ret, "SetWaitableTimer failed with error %u\n", GetLastError() );
+    }
+    trace( "created %d pending timers in %u ms\n", created, GetTickCount() - start );
+
+    /* timeouts now have to be inserted among all the pending ones, and the
+     * main loop has to find the next one to expire on every iteration */
+    trace( "%d pending timers: rearm %.2f us, wakeup latency %.0f us\n", created,
+           time_timer_rearm( timer, -hour - (LONGLONG)count / 2 * 10000, 10000 ),
+           time_timer_latency( timer ));
+    CloseHandle( timer );
+
+    start = GetTickCount();
+    for (i = 0; i < created; i++) CloseHandle( timers[i] );
+    trace( "closed %d pending timers in %u ms\n", created, GetTickCount() - start );
+    HeapFree( GetProcessHeap(), 0, timers );
+}
+
 static HANDLE sem = 0;
 
 static void CALLBACK iocp_callback(DWORD dwErrorCode, DWORD dwNumberOfBytesTransferred, LPOVERLAPPED lpOverlapped)
@@ -2308,6 +2399,335 @@ static void test_srwlock_example(void)
     trace("number of total exclusive accesses is %d\n", srwlock_protected_value);
 }
 
+static volatile LONG address_value;
+
+static DWORD WINAPI address_wake_thread(LPVOID arg)
+{
+    Sleep(100);
+    InterlockedExchange(&address_value, 1);
+    pWakeByAddressSingle((void *)&address_value);
+    return 0;
+}
+
+static void test_WaitOnAddress(void)
+{
+    LONG compare;
+    DWORD ticks;
+    HANDLE thread;
+    BOOL ret;
+
+    if (!pWaitOnAddress)
+    {
+        win_skip("WaitOnAddress not available.\n");
+        return;
+    }
+
+    address_value = 0;
+    compare = 1;
+    ret = pWaitOnAddress(&address_value, &compare, sizeof(compare), INFINITE);
+    ok(ret, "WaitOnAddress with a different value failed, error %u\n", GetLastError());
+
+    compare = 0;
+    SetLastError(0xdeadbeef);
+    ret = pWaitOnAddress(&address_value, &compare, sizeof(compare), 50);
+    ok(!ret, "WaitOnAddress didn't time out\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+
+    SetLastError(0xdeadbeef);
+    ret = pWaitOnAddress(&address_value, &compare, 3, 0);
+    ok(!ret, "WaitOnAddress with invalid size succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+
+    /* nobody is waiting */
+    pWakeByAddressAll((void *)&address_value);
+    pWakeByAddressSingle((void *)&address_value);
+
+    thread = CreateThread(NULL, 0, address_wake_thread, NULL, 0, NULL);
+    ticks = GetTickCount();
+    while (address_value == compare)
+    {
+        ret = pWaitOnAddress(&address_value, &compare, sizeof(compare), 5000);
+        ok(ret, "WaitOnAddress failed, error %u\n", GetLastError());
+        if (!ret) break;
+    }
+    ticks = GetTickCount() - ticks;
+    ok(address_value == 1, "got value %d\n", address_value);
+    ok(ticks < 4000, "waiting took %u ms\n", ticks);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+/* Contention benchmark: hand a token back and forth between two threads with
+ * a condition variable, and compare against the same hand-off done directly
+ * with keyed events, which is what condition variables used to cost when
+ * every contended operation was a server round trip. */
+
+#define PINGPONG_ROUNDS 20000
+
+static SRWLOCK pingpong_lock;
+static CONDITION_VARIABLE pingpong_cv;
+static LONG pingpong_turn, pingpong_count;
+static HANDLE pingpong_keyed_event;
+
+static DWORD WINAPI condvar_pingpong_thread(LPVOID arg)
+{
+    LONG me = (LONG)(ULONG_PTR)arg;
+    int i;
+
+    for (i = 0; i < PINGPONG_ROUNDS; i++)
+    {
+        pAcquireSRWLockExclusive(&pingpong_lock);
+        while (pingpong_turn != me)
+            pSleepConditionVariableSRW(&pingpong_cv, &pingpong_lock, INFINITE, 0);
+        pingpong_turn = !me;
+        pingpong_count++;
+        pReleaseSRWLockExclusive(&pingpong_lock);
+        pWakeConditionVariable(&pingpong_cv);
+    }
+    return 0;
+}
+
+static DWORD WINAPI keyed_event_pingpong_thread(LPVOID arg)
+{
+    LONG me = (LONG)(ULONG_PTR)arg;
+    int i;
+
+    for (i = 0; i < PINGPONG_ROUNDS; i++)
+    {
+        if (i || me) pNtWaitForKeyedEvent(pingpong_keyed_event, &pingpong_turn + me, FALSE, NULL);
+        InterlockedIncrement(&pingpong_count);
+        if (i < PINGPONG_ROUNDS - 1 || !me)
+            pNtReleaseKeyedEvent(pingpong_keyed_event, &pingpong_turn + !me, FALSE, NULL);
+    }
+    return 0;
+}
+
+static DWORD WINAPI srwlock_contention_thread(LPVOID arg)
+{
+    int i;
+
+    for (i = 0; i < PINGPONG_ROUNDS * 5; i++)
+    {
+        if (i % 4)
+        {
+            pAcquireSRWLockExclusive(&pingpong_lock);
+            pingpong_count++;
+            pReleaseSRWLockExclusive(&pingpong_lock);
+        }
+        else
+        {
+            pAcquireSRWLockShared(&pingpong_lock);
+            if (pingpong_count < 0) pingpong_turn++;
+            pReleaseSRWLockShared(&pingpong_lock);
+        }
+    }
+    return 0;
+}
+
+static DWORD run_pingpong(LPTHREAD_START_ROUTINE func, int count)
+{
+    HANDLE threads[4];
+    DWORD ticks;
+    int i;
+
+    pingpong_turn = pingpong_count = 0;
+    ticks = GetTickCount();
+    for (i = 0; i < count; i++)
+        threads[i] = CreateThread(NULL, 0, func, (void *)(ULONG_PTR)i, 0, NULL);
+    WaitForMultipleObjects(count, threads, TRUE, INFINITE);
+    for (i = 0; i < count; i++) CloseHandle(threads[i]);
+    return GetTickCount() - ticks;
+}
+
+static void test_sync_contention(void)
+{
+    DWORD ticks;
+    NTSTATUS status;
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+    if (!pInitializeSRWLock || !pInitializeConditionVariable)
+    {
+        win_skip("no srw lock or condition variable support.\n");
+        return;
+    }
+
+    pInitializeSRWLock(&pingpong_lock);
+    pInitializeConditionVariable(&pingpong_cv);
+
+    ticks = run_pingpong(condvar_pingpong_thread, 2);
+    ok(pingpong_count == 2 * PINGPONG_ROUNDS, "got %d hand-offs\n", pingpong_count);
+    trace("condition variable: %u hand-offs in %u ms\n", pingpong_count, ticks);
+
+    ticks = run_pingpong(srwlock_contention_thread, 4);
+    ok(pingpong_count == 4 * PINGPONG_ROUNDS * 5 * 3 / 4, "got %d exclusive acquires\n", pingpong_count);
+    trace("srw lock: %u exclusive acquires by 4 threads in %u ms\n", pingpong_count, ticks);
+
+    if (!pNtCreateKeyedEvent)
+    {
+        win_skip("keyed events not supported.\n");
+        return;
+    }
+    status = pNtCreateKeyedEvent(&pingpong_keyed_event, GENERIC_ALL, NULL, 0);
+    ok(!status, "NtCreateKeyedEvent failed %x\n", status);
+    ticks = run_pingpong(keyed_event_pingpong_thread, 2);
+    ok(pingpong_count == 2 * PINGPONG_ROUNDS, "got %d hand-offs\n", pingpong_count);
+    trace("keyed event: %u hand-offs in %u ms\n", pingpong_count, ticks);
+    CloseHandle(pingpong_keyed_event);
+}
+
+static void CALLBACK iocp_user_apc(ULONG_PTR arg)
+{
+    *(BOOL *)arg = TRUE;
+}
+
+/* Throughput benchmark: push completions through a port drained by worker
+ * threads, either one at a time or in batches of up to 64 per call. */
+
+#define IOCP_WORKERS 8
+#define IOCP_STOP_KEY 0xdead
+
+static HANDLE iocp_port;
+static LONG iocp_received;
+
+static DWORD WINAPI iocp_worker_thread(LPVOID arg)
+{
+    OVERLAPPED_ENTRY entries[64];
+    OVERLAPPED *ovl;
+    ULONG_PTR key;
+    ULONG i, count;
+    DWORD size;
+    BOOL batch = (BOOL)(ULONG_PTR)arg;
+
+    for (;;)
+    {
+        if (batch)
+        {
+            if (!pGetQueuedCompletionStatusEx(iocp_port, entries, 64, &count, INFINITE, FALSE)) break;
+        }
+        else
+        {
+            if (!GetQueuedCompletionStatus(iocp_port, &size, &key, &ovl, INFINITE)) break;
+            entries[0].lpCompletionKey = key;
+            count = 1;
+        }
+        for (i = 0; i < count; i++)
+        {
+            if (entries[i].lpCompletionKey == IOCP_STOP_KEY)
+            {
+                /* pass the stop request on to the next worker */
+                PostQueuedCompletionStatus(iocp_port, 0, IOCP_STOP_KEY, NULL);
+                return 0;
+            }
+            InterlockedIncrement(&iocp_received);
+        }
+    }
+    return 1;
+}
+
+static DWORD run_iocp_workers(BOOL batch, int total)
+{
+    HANDLE threads[IOCP_WORKERS];
+    DWORD ticks, exit_code, size;
+    OVERLAPPED *ovl;
+    ULONG_PTR key;
+    int i;
+
+    iocp_received = 0;
+    ticks = GetTickCount();
+    for (i = 0; i < IOCP_WORKERS; i++)
+        threads[i] = CreateThread(NULL, 0, iocp_worker_thread, (void *)(ULONG_PTR)batch, 0, NULL);
+    for (i = 0; i < total; i++)
+        PostQueuedCompletionStatus(iocp_port, i, 1, NULL);
+    PostQueuedCompletionStatus(iocp_port, 0, IOCP_STOP_KEY, NULL);
+    WaitForMultipleObjects(IOCP_WORKERS, threads, TRUE, INFINITE);
+    ticks = GetTickCount() - ticks;
+    /* remove the stop request posted by the last worker */
+    GetQueuedCompletionStatus(iocp_port, &size, &key, &ovl, 0);
+    for (i = 0; i < IOCP_WORKERS; i++)
+    {
+        GetExitCodeThread(threads[i], &exit_code);
+        ok(!exit_code, "worker %d failed\n", i);
+        CloseHandle(threads[i]);
+    }
+    return ticks;
+}
+
+static void test_GetQueuedCompletionStatusEx(void)
+{
+    OVERLAPPED_ENTRY entries[4];
+    OVERLAPPED ovl[3];
+    BOOL ret, apc_called = FALSE;
+    ULONG count;
+    DWORD ticks;
+    int i, total = winetest_interactive ? 1000000 : 100000;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip("GetQueuedCompletionStatusEx not supported.\n");
+        return;
+    }
+
+    iocp_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(iocp_port != NULL, "CreateIoCompletionPort failed, error %u\n", GetLastError());
+
+    count = 0xdeadbeef;
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(iocp_port, entries, 4, &count, 0, FALSE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded on an empty port\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "got error %u\n", GetLastError());
+    ok(!count, "got count %u\n", count);
+
+    for (i = 0; i < 3; i++)
+    {
+        ret = PostQueuedCompletionStatus(iocp_port, 100 + i, 10 + i, &ovl[i]);
+        ok(ret, "PostQueuedCompletionStatus failed, error %u\n", GetLastError());
+    }
+
+    memset(entries, 0xcc, sizeof(entries));
+    ret = pGetQueuedCompletionStatusEx(iocp_port, entries, 2, &count, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed, error %u\n", GetLastError());
+    ok(count == 2, "got count %u\n", count);
+    for (i = 0; i < 2; i++)
+    {
+        ok(entries[i].lpCompletionKey == 10 + i, "%d: got key %lx\n", i, entries[i].lpCompletionKey);
+        ok(entries[i].lpOverlapped == &ovl[i], "%d: got overlapped %p\n", i, entries[i].lpOverlapped);
+        ok(entries[i].dwNumberOfBytesTransferred == 100 + i, "%d: got size %u\n", i,
+           entries[i].dwNumberOfBytesTransferred);
+        ok(!entries[i].Internal, "%d: got status %lx\n", i, entries[i].Internal);
+    }
+    ok(entries[2].lpCompletionKey == (ULONG_PTR)0xcccccccccccccccc, "entry 2 was modified\n");
+
+    ret = pGetQueuedCompletionStatusEx(iocp_port, entries, 4, &count, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed, error %u\n", GetLastError());
+    ok(count == 1, "got count %u\n", count);
+    ok(entries[0].lpCompletionKey == 12, "got key %lx\n", entries[0].lpCompletionKey);
+    ok(entries[0].lpOverlapped == &ovl[2], "got overlapped %p\n", entries[0].lpOverlapped);
+
+    ret = QueueUserAPC(iocp_user_apc, GetCurrentThread(), (ULONG_PTR)&apc_called);
+    ok(ret, "QueueUserAPC failed, error %u\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(iocp_port, entries, 4, &count, 1000, TRUE);
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_IO_COMPLETION, "got error %u\n", GetLastError());
+    ok(apc_called, "APC was not called\n");
+
+    ticks = run_iocp_workers(FALSE, total);
+    ok(iocp_received == total, "got %d completions\n", iocp_received);
+    trace("GetQueuedCompletionStatus: %u completions with %u threads in %u ms\n",
+          iocp_received, IOCP_WORKERS, ticks);
+
+    ticks = run_iocp_workers(TRUE, total);
+    ok(iocp_received == total, "got %d completions\n", iocp_received);
+    trace("GetQueuedCompletionStatusEx: %u completions with %u threads in %u ms\n",
+          iocp_received, IOCP_WORKERS, ticks);
+
+    CloseHandle(iocp_port);
+}
+
 START_TEST(sync)
 {
     HMODULE hdll = GetModuleHandleA("kernel32.dll");
@@ -2339,6 +2759,13 @@ START_TEST(sync)
     pTryAcquireSRWLockExclusive = (void *)GetProcAddress(hdll, "TryAcquireSRWLockExclusive");
     pTryAcquireSRWLockShared = (void *)GetProcAddress(hdll, "TryAcquireSRWLockShared");
     pNtWaitForMultipleObjects = (void *)GetProcAddress(hntdll, "NtWaitForMultipleObjects");
+    pWaitOnAddress = (void *)GetProcAddress(hdll, "WaitOnAddress");
+    pWakeByAddressAll = (void *)GetProcAddress(hdll, "WakeByAddressAll");
+    pWakeByAddressSingle = (void *)GetProcAddress(hdll, "WakeByAddressSingle");
+    pNtCreateKeyedEvent = (void *)GetProcAddress(hntdll, "NtCreateKeyedEvent");
+    pNtReleaseKeyedEvent = (void *)GetProcAddress(hntdll, "NtReleaseKeyedEvent");
+    pNtWaitForKeyedEvent = (void *)GetProcAddress(hntdll, "NtWaitForKeyedEvent");
+    pGetQueuedCompletionStatusEx = (void *)GetProcAddress(hdll, "GetQueuedCompletionStatusEx");
 
     test_signalandwait();
     test_mutex();
@@ -2346,6 +2773,7 @@ START_TEST(sync)
     test_event();
     test_semaphore();
     test_waitable_timer();
+    test_many_timers();
     test_iocp_callback();
     test_timer_queue();
     test_WaitForSingleObject();
@@ -2355,4 +2783,7 @@ START_TEST(sync)
     test_condvars_consumer_producer();
     test_srwlock_base();
     test_srwlock_example();
+    test_WaitOnAddress();
+    test_sync_contention();
+    test_GetQueuedCompletionStatusEx();
 }
@@ -3632,6 +3632,74 @@ static void test_shared_memory_ro(BOOL is_child, DWORD child_access)
     CloseHandle(mapping);
 }
 
+static void test_many_regions(void)
+{
+    static const DWORD count = 100000;
+    MEMORY_BASIC_INFORMATION info;
+    DWORD i, allocated, start, old_prot;
+    char **regions;
+    SIZE_T size;
+    BOOL ret;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+
+    regions = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*regions) );
+
+    start = GetTickCount();
+    for (allocated = 0; allocated < count; allocated++)
+    {
+        /* commit only the first page so that the views don't merge with anything */
+        if (!(regions[allocated] = VirtualAlloc( NULL, 0x10000, MEM_RESERVE, PAGE_NOACCESS ))) break;
+        if (!VirtualAlloc( regions[allocated], 0x1000, MEM_COMMIT, PAGE_READWRITE ))
+        {
+            VirtualFree( regions[allocated], 0, MEM_RELEASE );
+            break;
+        }
+    }
+    trace( "allocated %u regions in %u ms\n", allocated, GetTickCount() - start );
+    ok( allocated >= 1000, "only %u regions allocated, error %u\n", allocated, GetLastError() );
+
+    start = GetTickCount();
+    for (i = 0; i < allocated; i++)
+    {
+        regions[i][0] = 1;  /* make sure the pages are usable */
+        size = VirtualQuery( regions[i] + 0x1000, &info, sizeof(info) );
+        ok( size == sizeof(info), "VirtualQuery failed %u\n", GetLastError() );
+        ok( info.AllocationBase == regions[i], "%u: wrong allocation base %p/%p\n",
+            i, info.AllocationBase, regions[i] );
+        if (info.AllocationBase != regions[i]) break;
+    }
+    trace( "queried %u regions in %u ms\n", allocated, GetTickCount() - start );
+
+    start = GetTickCount();
+    for (i = 0; i < allocated; i++)
+    {
+        ret = VirtualProtect( regions[i], 0x1000, PAGE_READONLY, &old_prot );
+        ok( ret, "VirtualProtect failed %u\n", GetLastError() );
+        if (!ret) break;
+    }
+    trace( "protected %u regions in %u ms\n", allocated, GetTickCount() - start );
+
+    /* free in a scattered order */
+    start = GetTickCount();
+    for (i = 0; i < allocated; i += 2)
+    {
+        ret = VirtualFree( regions[i], 0, MEM_RELEASE );
+        ok( ret, "VirtualFree failed %u\n", GetLastError() );
+    }
+    for (i = 1; i < allocated; i += 2)
+    {
+        ret = VirtualFree( regions[i], 0, MEM_RELEASE );
+        ok( ret, "VirtualFree failed %u\n", GetLastError() );
+    }
+    trace( "freed %u regions in %u ms\n", allocated, GetTickCount() - start );
+    HeapFree( GetProcessHeap(), 0, regions );
+}
+
 START_TEST(virtual)
 {
     int argc;
@@ -3707,6 +3775,7 @@ START_TEST(virtual)
     test_IsBadWritePtr();
     test_IsBadCodePtr();
     test_write_watch();
+    test_many_regions();
 #ifdef __i386__
     test_guard_page();
     /* The following tests should be executed as a last step, and in exactly this
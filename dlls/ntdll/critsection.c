@@ -26,9 +26,6 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <sys/types.h>
-#ifdef HAVE_SYS_SYSCALL_H
-#include <sys/syscall.h>
-#endif
 #include <time.h>
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -61,37 +58,6 @@ static inline void small_pause(void)
 
 #ifdef __linux__
 
-static int wait_op = 128; /*FUTEX_WAIT|FUTEX_PRIVATE_FLAG*/
-static int wake_op = 129; /*FUTEX_WAKE|FUTEX_PRIVATE_FLAG*/
-
-static inline int futex_wait( int *addr, int val, struct timespec *timeout )
-{
-    return syscall( __NR_futex, addr, wait_op, val, timeout, 0, 0 );
-}
-
-static inline int futex_wake( int *addr, int val )
-{
-    return syscall( __NR_futex, addr, wake_op, val, NULL, 0, 0 );
-}
-
-static inline int use_futexes(void)
-{
-    static int supported = -1;
-
-    if (supported == -1)
-    {
-        futex_wait( &supported, 10, NULL );
-        if (errno == ENOSYS)
-        {
-            wait_op = 0; /*FUTEX_WAIT*/
-            wake_op = 1; /*FUTEX_WAKE*/
-            futex_wait( &supported, 10, NULL );
-        }
-        supported = (errno != ENOSYS);
-    }
-    return supported;
-}
-
 static inline NTSTATUS fast_wait( RTL_CRITICAL_SECTION *crit, int timeout )
 {
     int val;
@@ -2309,6 +2309,292 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* Cache of directory listings for case-insensitive lookups
+ *
+ * A directory gets a listing once it has been searched twice without
+ * being modified in between, so that directories that keep changing
+ * don't pay for building listings that won't be used. Listings are
+ * validated against the directory modification time. */
+
+#define DIR_CACHE_MAX_DIRS  32  /* max number of directories in the cache */
+
+struct dir_cache_name
+{
+    unsigned int  next;        /* next name in the hash chain, or ~0u */
+    unsigned int  name;        /* offset of the Unicode name in the pool */
+    unsigned int  unix_name;   /* offset of the Unix name in the pool */
+    USHORT        len;         /* length of the Unicode name */
+    BOOLEAN       short_name;  /* generated 8.3 name of a long file name */
+};
+
+struct dir_cache
+{
+    struct list            entry;      /* entry in the LRU list */
+    dev_t                  dev;        /* directory identity */
+    ino_t                  ino;
+    time_t                 mtime;      /* modification time the listing matches */
+    long                   mtime_nsec;
+    unsigned int           count;      /* number of names */
+    unsigned int           hash_size;  /* size of the hash table, a power of 2 */
+    unsigned int          *buckets;    /* hash table, NULL if there is no listing yet */
+    struct dir_cache_name *names;
+    char                  *pool;       /* storage for the names */
+};
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );
+static unsigned int dir_cache_count;
+
+static RTL_CRITICAL_SECTION dir_cache_section;
+static RTL_CRITICAL_SECTION_DEBUG dir_cache_critsect_debug =
+{
+    0, 0, &dir_cache_section,
+    { &dir_cache_critsect_debug.ProcessLocksList, &dir_cache_critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": dir_cache_section") }
+};
+static RTL_CRITICAL_SECTION dir_cache_section = { &dir_cache_critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline long get_mtime_nsec( const struct stat *st )
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    return st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    return st->st_mtimespec.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* check if a directory hasn't been modified recently, given the timestamp granularity;
+ * without sub-second timestamps a modification may not be visible for a second */
+static BOOL is_dir_settled( const struct stat *st )
+{
+    LARGE_INTEGER now, mtime;
+    long nsec = get_mtime_nsec( st );
+
+    NtQuerySystemTime( &now );
+    RtlSecondsSince1970ToTime( st->st_mtime, &mtime );
+    mtime.QuadPart += nsec / 100;
+    return now.QuadPart - mtime.QuadPart >= (nsec ? 50 * 10000 : 2 * 10000000);
+}
+
+static unsigned int hash_dir_name( const WCHAR *name, int len )
+{
+    unsigned int hash = 0x811c9dc5;
+
+    while (len--) hash = (hash ^ toupperW( *name++ )) * 0x01000193;
+    return hash;
+}
+
+static void free_dir_listing( struct dir_cache *cache )
+{
+    RtlFreeHeap( GetProcessHeap(), 0, cache->buckets );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->names );
+    RtlFreeHeap( GetProcessHeap(), 0, cache->pool );
+    cache->buckets = NULL;
+    cache->names = NULL;
+    cache->pool = NULL;
+    cache->count = 0;
+}
+
+/* append a name to the pool, growing it as needed; returns the offset or ~0u on failure */
+static unsigned int add_to_pool( char **pool, unsigned int *used, unsigned int *size,
+                                 const void *data, unsigned int len )
+{
+    unsigned int pos = (*used + sizeof(WCHAR) - 1) & ~(sizeof(WCHAR) - 1);
+
+    if (pos + len > *size)
+    {
+        unsigned int new_size = max( *size * 2, pos + len );
+        char *new_pool;
+
+        if (*pool) new_pool = RtlReAllocateHeap( GetProcessHeap(), 0, *pool, new_size );
+        else new_pool = RtlAllocateHeap( GetProcessHeap(), 0, new_size );
+        if (!new_pool) return ~0u;
+        *pool = new_pool;
+        *size = new_size;
+    }
+    memcpy( *pool + pos, data, len );
+    *used = pos + len;
+    return pos;
+}
+
+static BOOL add_dir_cache_name( struct dir_cache *cache, unsigned int *names_size,
+                                unsigned int *pool_used, unsigned int *pool_size,
+                                const WCHAR *name, int len, unsigned int unix_name, BOOLEAN short_name )
+{
+    struct dir_cache_name *entry;
+
+    if (cache->count == *names_size)
+    {
+        unsigned int new_size = max( 64, *names_size * 2 );
+        struct dir_cache_name *new_names;
+
+        if (cache->names)
+            new_names = RtlReAllocateHeap( GetProcessHeap(), 0, cache->names, new_size * sizeof(*new_names) );
+        else
+            new_names = RtlAllocateHeap( GetProcessHeap(), 0, new_size * sizeof(*new_names) );
+        if (!new_names) return FALSE;
+        cache->names = new_names;
+        *names_size = new_size;
+    }
+    entry = &cache->names[cache->count];
+    if ((entry->name = add_to_pool( &cache->pool, pool_used, pool_size, name, len * sizeof(WCHAR) )) == ~0u)
+        return FALSE;
+    entry->unix_name  = unix_name;
+    entry->len        = len;
+    entry->short_name = short_name;
+    cache->count++;
+    return TRUE;
+}
+
+/***********************************************************************
+ *           build_dir_listing
+ *
+ * Read a whole directory into the cache. Must be called with the cache lock held.
+ */
+static BOOL build_dir_listing( struct dir_cache *cache, const char *unix_name )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    DIR *dir;
+    struct dirent *de;
+    unsigned int i, hash, offset, names_size = 0, pool_used = 0, pool_size = 0;
+    int ret;
+
+    if (!(dir = opendir( unix_name ))) return FALSE;
+
+    str.Buffer = buffer;
+    str.MaximumLength = sizeof(buffer);
+    while ((de = readdir( dir )))
+    {
+        ret = ntdll_umbstowcs( 0, de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+        if (ret <= 0) continue;
+        if ((offset = add_to_pool( &cache->pool, &pool_used, &pool_size,
+                                   de->d_name, strlen(de->d_name) + 1 )) == ~0u)
+            goto failed;
+        if (!add_dir_cache_name( cache, &names_size, &pool_used, &pool_size, buffer, ret, offset, FALSE ))
+            goto failed;
+
+        str.Length = ret * sizeof(WCHAR);
+        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+        {
+            WCHAR short_nameW[12];
+            ret = hash_short_file_name( &str, short_nameW );
+            if (!add_dir_cache_name( cache, &names_size, &pool_used, &pool_size, short_nameW, ret, offset, TRUE ))
+                goto failed;
+        }
+    }
+    closedir( dir );
+
+    for (cache->hash_size = 64; cache->hash_size < cache->count; cache->hash_size *= 2) ;
+    if (!(cache->buckets = RtlAllocateHeap( GetProcessHeap(), 0, cache->hash_size * sizeof(*cache->buckets) )))
+    {
+        free_dir_listing( cache );
+        return FALSE;
+    }
+    memset( cache->buckets, 0xff, cache->hash_size * sizeof(*cache->buckets) );
+
+    /* insert in reverse order so that chains are walked in directory order */
+    for (i = cache->count; i > 0; i--)
+    {
+        struct dir_cache_name *entry = &cache->names[i - 1];
+
+        hash = hash_dir_name( (const WCHAR *)(cache->pool + entry->name), entry->len ) & (cache->hash_size - 1);
+        entry->next = cache->buckets[hash];
+        cache->buckets[hash] = i - 1;
+    }
+    TRACE( "%s: cached %u names\n", debugstr_a(unix_name), cache->count );
+    return TRUE;
+
+failed:
+    closedir( dir );
+    free_dir_listing( cache );
+    return FALSE;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Look for a file in the cached listing of a directory.
+ * unix_name contains the directory name, the file found is appended at pos.
+ * Returns 1 if found, 0 if the file doesn't exist, -1 if the directory has to be searched.
+ */
+static int lookup_dir_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                             BOOLEAN is_name_8_dot_3 )
+{
+    struct dir_cache *cache;
+    struct stat st;
+    unsigned int index;
+    int ret = -1;
+
+    if (stat( unix_name, &st ) == -1) return -1;
+
+    RtlEnterCriticalSection( &dir_cache_section );
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+        if (cache->dev == st.st_dev && cache->ino == st.st_ino) break;
+
+    if (&cache->entry == &dir_cache_list)
+    {
+        if (dir_cache_count < DIR_CACHE_MAX_DIRS)
+        {
+            if (!(cache = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache) ))) goto done;
+            dir_cache_count++;
+        }
+        else
+        {
+            cache = LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry );
+            list_remove( &cache->entry );
+            free_dir_listing( cache );
+        }
+        cache->dev = st.st_dev;
+        cache->ino = st.st_ino;
+        cache->mtime = st.st_mtime;
+        cache->mtime_nsec = get_mtime_nsec( &st );
+        list_add_head( &dir_cache_list, &cache->entry );
+        goto done;
+    }
+
+    list_remove( &cache->entry );
+    list_add_head( &dir_cache_list, &cache->entry );
+
+    if (cache->mtime != st.st_mtime || cache->mtime_nsec != get_mtime_nsec( &st ))
+    {
+        /* modified since the last search, wait until it settles down */
+        free_dir_listing( cache );
+        cache->mtime = st.st_mtime;
+        cache->mtime_nsec = get_mtime_nsec( &st );
+        goto done;
+    }
+
+    /* a listing read while the directory is still being modified within the
+     * timestamp granularity may already be stale, don't keep it */
+    if (!cache->buckets && is_dir_settled( &st ) && !build_dir_listing( cache, unix_name ))
+        goto done;
+    if (!cache->buckets) goto done;
+
+    for (index = cache->buckets[hash_dir_name( name, length ) & (cache->hash_size - 1)];
+         index != ~0u; index = cache->names[index].next)
+    {
+        const struct dir_cache_name *entry = &cache->names[index];
+
+        if (entry->len != length) continue;
+        if (entry->short_name && !is_name_8_dot_3) continue;
+        if (memicmpW( (const WCHAR *)(cache->pool + entry->name), name, length )) continue;
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, cache->pool + entry->unix_name );
+        ret = 1;
+        goto done;
+    }
+    ret = 0;
+
+done:
+    RtlLeaveCriticalSection( &dir_cache_section );
+    return ret;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2419,6 +2705,12 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+    switch (lookup_dir_cache( unix_name, pos, name, length, is_name_8_dot_3 ))
+    {
+    case 1: goto success;
+    case 0: goto not_found;
+    }
+
     if (!(dir = opendir( unix_name )))
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
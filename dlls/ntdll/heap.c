@@ -158,6 +158,10 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct lfh_heap *lfh;           /* Low fragmentation front end, if enabled */
+    SIZE_T           busy_bytes;    /* Bytes currently allocated */
+    SIZE_T           busy_blocks;   /* Blocks currently allocated */
+    ULONGLONG        alloc_count[HEAP_STATISTICS_SIZE_CLASSES]; /* Allocations per size class */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -173,6 +177,80 @@ typedef struct tagHEAP
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static HEAP *processHeap;  /* main process heap */
+static BOOL report_statistics;  /* dump heap statistics on exit */
+static int report_period;  /* period in seconds for dumping the heap statistics */
+
+/* Low fragmentation heap front end
+ *
+ * Small blocks are carved out of groups, which are ordinary in-use blocks of
+ * the heap. Each size class has one bin per shard, and threads are spread
+ * over the shards by thread id, so that threads allocating concurrently
+ * normally don't contend on the same lock, and never on the heap lock.
+ */
+
+typedef struct tagARENA_LFH
+{
+    WORD                  size;     /* Size of user data */
+    WORD                  group;    /* Offset back to the group header, in ALIGNMENT units */
+    DWORD                 magic;    /* Magic number, overlaps the ARENA_INUSE magic */
+} ARENA_LFH;
+
+C_ASSERT( sizeof(ARENA_LFH) == sizeof(ARENA_INUSE) );
+
+#define ARENA_LFH_MAGIC        ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('U'<<24)))
+#define ARENA_LFH_FREE_MAGIC   ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('F'<<24)))
+
+static const WORD lfh_class_sizes[] =
+{
+    0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0xa0, 0xc0, 0xe0, 0x100,
+    0x140, 0x180, 0x1c0, 0x200, 0x280, 0x300, 0x380, 0x400
+};
+#define LFH_NB_CLASSES      (sizeof(lfh_class_sizes)/sizeof(lfh_class_sizes[0]))
+#define LFH_MAX_BLOCK_SIZE  0x400   /* largest user size handled by the front end */
+#define LFH_NB_SHARDS       16      /* number of bins per size class */
+#define LFH_GROUP_SIZE      0x4000  /* size of the groups carved into small blocks */
+#define LFH_REGION_SIZE     0x400000 /* size of the address space regions holding the groups */
+#define LFH_MAX_REGIONS     64      /* maximum number of regions per heap */
+
+static BYTE lfh_size_class[LFH_MAX_BLOCK_SIZE / 0x10 + 1];
+
+struct lfh_bin
+{
+    int                   lock;         /* Spin lock protecting the bin and its groups */
+    struct list           groups;       /* Groups with free blocks */
+    ULONG                 group_count;  /* Number of groups owned by the bin */
+    ULONG                 contention;   /* Number of times the lock was found busy */
+    SIZE_T                busy_bytes;   /* Bytes currently allocated */
+    SIZE_T                busy_blocks;  /* Blocks currently allocated */
+    ULONGLONG             alloc_count;  /* Number of allocations */
+};
+
+struct lfh_group
+{
+    DWORD                 magic;      /* Magic number */
+    WORD                  count;      /* Total number of blocks */
+    WORD                  free_count; /* Number of free blocks */
+    WORD                  block_size; /* Size of a block including its arena */
+    WORD                  class;      /* Size class */
+    struct tagHEAP       *heap;       /* Heap the group belongs to */
+    struct lfh_bin       *bin;        /* Bin owning the group */
+    struct list           entry;      /* Entry in the bin group list */
+    ARENA_LFH            *free_list;  /* First free block */
+};
+
+#define LFH_GROUP_MAGIC  ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('G'<<24)))
+
+/* The groups live in separately reserved regions, so that a block can be
+ * recognized from its address alone, without walking the sub-heap list. */
+struct lfh_heap
+{
+    struct lfh_bin        bins[LFH_NB_CLASSES][LFH_NB_SHARDS];
+    int                   lock;                         /* Spin lock protecting the fields below */
+    struct list           free_groups;                  /* Entirely free groups, for any bin */
+    char                 *regions[LFH_MAX_REGIONS];     /* Reserved regions */
+    SIZE_T                committed[LFH_MAX_REGIONS];   /* Size committed in each region */
+    LONG                  nb_regions;                   /* Number of regions, never decreases */
+};
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
 
@@ -307,6 +385,30 @@ static inline unsigned int get_freelist_index( SIZE_T size )
     return i;
 }
 
+/* get the statistics size class for a given block size */
+static inline unsigned int get_stats_class( SIZE_T size )
+{
+    unsigned int i;
+
+    for (i = 0; i < HEAP_STATISTICS_SIZE_CLASSES - 1; i++) if (size <= (SIZE_T)0x10 << i) break;
+    return i;
+}
+
+/* update the statistics for a new block; must be called with the heap lock held */
+static inline void stats_alloc( HEAP *heap, SIZE_T size )
+{
+    heap->alloc_count[get_stats_class( size )]++;
+    heap->busy_bytes += size;
+    heap->busy_blocks++;
+}
+
+/* update the statistics for a freed block; must be called with the heap lock held */
+static inline void stats_free( HEAP *heap, SIZE_T size )
+{
+    heap->busy_bytes -= size;
+    heap->busy_blocks--;
+}
+
 /* get the memory protection type to use for a given heap */
 static inline ULONG get_protection_type( DWORD flags )
 {
@@ -1436,6 +1538,483 @@ static BOOL validate_block_pointer( HEAP *heap, SUBHEAP **ret_subheap, const ARE
 }
 
 
+/***********************************************************************
+ *           lfh_lock / lfh_unlock
+ */
+static inline BOOL lfh_spin_lock( int *lock )
+{
+    if (!interlocked_cmpxchg( lock, 1, 0 )) return FALSE;
+    do NtYieldExecution(); while (interlocked_cmpxchg( lock, 1, 0 ));
+    return TRUE;  /* contended */
+}
+
+static inline void lfh_spin_unlock( int *lock )
+{
+    interlocked_xchg( lock, 0 );
+}
+
+static inline void lfh_lock( struct lfh_bin *bin )
+{
+    if (lfh_spin_lock( &bin->lock )) bin->contention++;
+}
+
+static inline void lfh_unlock( struct lfh_bin *bin )
+{
+    lfh_spin_unlock( &bin->lock );
+}
+
+static inline ARENA_LFH *lfh_first_block( const struct lfh_group *group )
+{
+    return (ARENA_LFH *)((char *)group + ROUND_SIZE( sizeof(*group) ));
+}
+
+
+/***********************************************************************
+ *           lfh_enable
+ *
+ * Switch a heap to the low fragmentation front end.
+ */
+static BOOL lfh_enable( HEAP *heap )
+{
+    struct lfh_heap *lfh;
+    unsigned int i, j;
+
+    if (heap->lfh) return TRUE;
+    if (RUNNING_ON_VALGRIND) return FALSE;
+    if (heap->flags & (HEAP_NO_SERIALIZE | HEAP_SHARED | HEAP_PAGE_ALLOCS | HEAP_VALIDATE |
+                       HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED))
+        return FALSE;
+
+    for (i = j = 0; i < sizeof(lfh_size_class); i++)
+    {
+        while (lfh_class_sizes[j] < i * 0x10) j++;
+        lfh_size_class[i] = j;
+    }
+
+    if (!(lfh = RtlAllocateHeap( heap, 0, sizeof(*lfh) ))) return FALSE;
+    for (i = 0; i < LFH_NB_CLASSES; i++)
+        for (j = 0; j < LFH_NB_SHARDS; j++)
+        {
+            memset( &lfh->bins[i][j], 0, sizeof(lfh->bins[i][j]) );
+            list_init( &lfh->bins[i][j].groups );
+        }
+    lfh->lock = 0;
+    list_init( &lfh->free_groups );
+    lfh->nb_regions = 0;
+
+    if (interlocked_cmpxchg_ptr( (void **)&heap->lfh, lfh, NULL )) RtlFreeHeap( heap, 0, lfh );
+    TRACE( "enabled low fragmentation heap for %p\n", heap );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_find_group
+ *
+ * Find the group containing a block, if the block was allocated by the
+ * front end. The regions are never released while the heap exists, and
+ * only the committed part of each region is looked at, so this doesn't
+ * need any lock.
+ */
+static struct lfh_group *lfh_find_group( HEAP *heap, const void *ptr )
+{
+    struct lfh_heap *lfh = heap->lfh;
+    const ARENA_LFH *arena = (const ARENA_LFH *)ptr - 1;
+    struct lfh_group *group = NULL;
+    LONG i, count = *(volatile LONG *)&lfh->nb_regions;
+    SIZE_T offset;
+
+    for (i = 0; i < count; i++)
+    {
+        offset = (const char *)arena - lfh->regions[i];
+        if (offset >= ((volatile SIZE_T *)lfh->committed)[i]) continue;
+        group = (struct lfh_group *)(lfh->regions[i] + (offset & ~(SIZE_T)(LFH_GROUP_SIZE - 1)));
+        break;
+    }
+    if (!group) return NULL;
+
+    if (group->magic != LFH_GROUP_MAGIC || group->heap != heap) return NULL;
+    offset = (const char *)arena - (const char *)lfh_first_block( group );
+    if (offset % group->block_size || offset / group->block_size >= group->count) return NULL;
+    return group;
+}
+
+
+/***********************************************************************
+ *           lfh_alloc_group
+ *
+ * Get a free group, either a released one or a new one committed from
+ * the current region.
+ */
+static struct lfh_group *lfh_alloc_group( struct lfh_heap *lfh )
+{
+    struct lfh_group *group = NULL;
+    struct list *ptr;
+    SIZE_T size;
+    void *addr;
+
+    lfh_spin_lock( &lfh->lock );
+    if ((ptr = list_head( &lfh->free_groups )))
+    {
+        list_remove( ptr );
+        group = LIST_ENTRY( ptr, struct lfh_group, entry );
+        goto done;
+    }
+    if (!lfh->nb_regions || lfh->committed[lfh->nb_regions - 1] == LFH_REGION_SIZE)
+    {
+        if (lfh->nb_regions == LFH_MAX_REGIONS) goto done;
+        addr = NULL;
+        size = LFH_REGION_SIZE;
+        if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_RESERVE, PAGE_READWRITE ))
+            goto done;
+        lfh->regions[lfh->nb_regions] = addr;
+        lfh->committed[lfh->nb_regions] = 0;
+        interlocked_xchg_add( &lfh->nb_regions, 1 );
+    }
+    addr = lfh->regions[lfh->nb_regions - 1] + lfh->committed[lfh->nb_regions - 1];
+    size = LFH_GROUP_SIZE;
+    if (!NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+    {
+        group = addr;
+        lfh->committed[lfh->nb_regions - 1] += LFH_GROUP_SIZE;
+    }
+done:
+    lfh_spin_unlock( &lfh->lock );
+    return group;
+}
+
+
+/***********************************************************************
+ *           lfh_create_group
+ */
+static struct lfh_group *lfh_create_group( HEAP *heap, struct lfh_bin *bin, unsigned int class )
+{
+    struct lfh_group *group;
+    ARENA_LFH *arena;
+    SIZE_T block_size = sizeof(ARENA_LFH) + ROUND_SIZE( lfh_class_sizes[class] );
+    unsigned int i;
+
+    if (!(group = lfh_alloc_group( heap->lfh ))) return NULL;
+
+    group->magic      = LFH_GROUP_MAGIC;
+    group->count      = (LFH_GROUP_SIZE - ROUND_SIZE( sizeof(*group) )) / block_size;
+    group->free_count = group->count;
+    group->block_size = block_size;
+    group->class      = class;
+    group->heap       = heap;
+    group->bin        = bin;
+    group->free_list  = NULL;
+
+    for (i = group->count; i > 0; i--)
+    {
+        arena = (ARENA_LFH *)((char *)lfh_first_block( group ) + (i - 1) * block_size);
+        arena->size  = 0;
+        arena->group = ((char *)arena - (char *)group) / ALIGNMENT;
+        arena->magic = ARENA_LFH_FREE_MAGIC;
+        *(ARENA_LFH **)(arena + 1) = group->free_list;
+        group->free_list = arena;
+    }
+    return group;
+}
+
+
+/***********************************************************************
+ *           lfh_allocate
+ */
+static void *lfh_allocate( HEAP *heap, DWORD flags, SIZE_T size )
+{
+    unsigned int class = lfh_size_class[(size + 0x0f) / 0x10];
+    ULONG_PTR shard = (ULONG_PTR)NtCurrentTeb()->ClientId.UniqueThread / 4 % LFH_NB_SHARDS;
+    struct lfh_bin *bin = &heap->lfh->bins[class][shard];
+    struct lfh_group *group;
+    ARENA_LFH *arena;
+
+    lfh_lock( bin );
+    if (list_empty( &bin->groups ))
+    {
+        lfh_unlock( bin );
+        if (!(group = lfh_create_group( heap, bin, class ))) return NULL;
+        lfh_lock( bin );
+        list_add_head( &bin->groups, &group->entry );
+        bin->group_count++;
+    }
+    group = LIST_ENTRY( list_head( &bin->groups ), struct lfh_group, entry );
+    arena = group->free_list;
+    group->free_list = *(ARENA_LFH **)(arena + 1);
+    if (!--group->free_count) list_remove( &group->entry );
+    arena->size  = size;
+    arena->magic = ARENA_LFH_MAGIC;
+    bin->alloc_count++;
+    bin->busy_bytes += size;
+    bin->busy_blocks++;
+    lfh_unlock( bin );
+
+    if (flags & HEAP_ZERO_MEMORY) memset( arena + 1, 0, size );
+    return arena + 1;
+}
+
+
+/***********************************************************************
+ *           lfh_free
+ *
+ * Return a block to its group; the group itself is given back to the
+ * heap once it is entirely free, unless it is the last one of its bin.
+ */
+static BOOL lfh_free( HEAP *heap, struct lfh_group *group, void *ptr )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    struct lfh_bin *bin = group->bin;
+
+    lfh_lock( bin );
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        lfh_unlock( bin );
+        WARN( "Heap %p: block %p used after free\n", heap, ptr );
+        return FALSE;
+    }
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+    *(ARENA_LFH **)(arena + 1) = group->free_list;
+    group->free_list = arena;
+    bin->busy_bytes -= arena->size;
+    bin->busy_blocks--;
+    if (!group->free_count++) list_add_head( &bin->groups, &group->entry );
+
+    if (group->free_count == group->count && list_next( &bin->groups, list_head( &bin->groups ) ))
+    {
+        list_remove( &group->entry );
+        bin->group_count--;
+        group->magic = 0;
+        lfh_unlock( bin );
+        lfh_spin_lock( &heap->lfh->lock );
+        list_add_head( &heap->lfh->free_groups, &group->entry );
+        lfh_spin_unlock( &heap->lfh->lock );
+        return TRUE;
+    }
+    lfh_unlock( bin );
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           lfh_realloc
+ */
+static void *lfh_realloc( HEAP *heap, struct lfh_group *group, DWORD flags, void *ptr, SIZE_T size )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    SIZE_T old_size = arena->size;
+    void *ret;
+
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        WARN( "Heap %p: block %p used after free\n", heap, ptr );
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+        return NULL;
+    }
+
+    if (size <= group->block_size - sizeof(ARENA_LFH) &&
+        ((flags & HEAP_REALLOC_IN_PLACE_ONLY) || lfh_size_class[(size + 0x0f) / 0x10] == group->class))
+    {
+        if ((flags & HEAP_ZERO_MEMORY) && size > old_size)
+            memset( (char *)ptr + old_size, 0, size - old_size );
+        lfh_lock( group->bin );
+        group->bin->busy_bytes += size - old_size;
+        arena->size = size;
+        lfh_unlock( group->bin );
+        return ptr;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY)
+    {
+        if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        return NULL;
+    }
+
+    if (!(ret = RtlAllocateHeap( heap, flags & (HEAP_GENERATE_EXCEPTIONS | HEAP_ZERO_MEMORY), size )))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+        return NULL;
+    }
+    memcpy( ret, ptr, min( size, old_size ) );
+    lfh_free( heap, group, ptr );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           heap_get_statistics
+ */
+static void heap_get_statistics( HEAP *heap, HEAP_WINE_STATISTICS *stats )
+{
+    SUBHEAP *subheap;
+    ARENA_LARGE *large;
+    ARENA_FREE *arena;
+    struct lfh_group *group;
+    struct lfh_bin *bin;
+    unsigned int i, j;
+
+    memset( stats, 0, sizeof(*stats) );
+
+    if (!(heap->flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heap->critSection );
+
+    stats->Flags = heap->flags;
+    LIST_FOR_EACH_ENTRY( subheap, &heap->subheap_list, SUBHEAP, entry )
+    {
+        stats->SubheapCount++;
+        stats->ReservedBytes += subheap->size;
+        stats->CommittedBytes += subheap->commitSize;
+    }
+    LIST_FOR_EACH_ENTRY( large, &heap->large_list, ARENA_LARGE, entry )
+    {
+        stats->LargeBlockCount++;
+        stats->LargeBlockBytes += large->block_size;
+    }
+    stats->ReservedBytes += stats->LargeBlockBytes;
+    stats->CommittedBytes += stats->LargeBlockBytes;
+
+    /* all the free lists are chained together, with the list heads in between */
+    LIST_FOR_EACH_ENTRY( arena, &heap->freeList[0].arena.entry, ARENA_FREE, entry )
+    {
+        SIZE_T size = arena->size & ARENA_SIZE_MASK;
+
+        if ((FREE_LIST_ENTRY *)arena >= heap->freeList &&
+            (FREE_LIST_ENTRY *)arena < heap->freeList + HEAP_NB_FREE_LISTS) continue;
+        stats->FreeBlocks++;
+        stats->FreeBytes += size;
+        if (size > stats->LargestFreeBlock) stats->LargestFreeBlock = size;
+    }
+
+    stats->BusyBytes = heap->busy_bytes;
+    stats->BusyBlocks = heap->busy_blocks;
+    for (i = 0; i < HEAP_STATISTICS_SIZE_CLASSES; i++)
+    {
+        stats->SizeClassCount[i] = heap->alloc_count[i];
+        stats->AllocationCount += heap->alloc_count[i];
+    }
+    if (heap->critSection.DebugInfo) stats->ContentionCount = heap->critSection.DebugInfo->ContentionCount;
+
+    if (!(heap->flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heap->critSection );
+
+    if (!heap->lfh) return;
+
+    lfh_spin_lock( &heap->lfh->lock );
+    for (i = 0; i < heap->lfh->nb_regions; i++)
+    {
+        stats->ReservedBytes += LFH_REGION_SIZE;
+        stats->CommittedBytes += heap->lfh->committed[i];
+    }
+    lfh_spin_unlock( &heap->lfh->lock );
+
+    for (i = 0; i < LFH_NB_CLASSES; i++)
+    {
+        for (j = 0; j < LFH_NB_SHARDS; j++)
+        {
+            bin = &heap->lfh->bins[i][j];
+            lfh_lock( bin );
+            stats->LfhGroupCount += bin->group_count;
+            stats->BusyBytes += bin->busy_bytes;
+            stats->BusyBlocks += bin->busy_blocks;
+            stats->SizeClassCount[get_stats_class( lfh_class_sizes[i] )] += bin->alloc_count;
+            stats->AllocationCount += bin->alloc_count;
+            stats->ContentionCount += bin->contention;
+            LIST_FOR_EACH_ENTRY( group, &bin->groups, struct lfh_group, entry )
+                stats->LfhFreeBytes += group->free_count * (group->block_size - sizeof(ARENA_LFH));
+            lfh_unlock( bin );
+        }
+    }
+}
+
+
+/***********************************************************************
+ *           heap_dump_statistics
+ */
+static void heap_dump_statistics( HEAP *heap )
+{
+    HEAP_WINE_STATISTICS stats;
+    char buffer[HEAP_STATISTICS_SIZE_CLASSES * 32], *p = buffer;
+    unsigned int i;
+
+    heap_get_statistics( heap, &stats );
+
+    MESSAGE( "heap %p: flags %08x, %u sub-heaps, %lu bytes reserved, %lu committed\n",
+             heap, stats.Flags, stats.SubheapCount, stats.ReservedBytes, stats.CommittedBytes );
+    MESSAGE( "heap %p: %lu bytes in %lu busy blocks, %lu bytes in %lu free blocks, largest free %lu\n",
+             heap, stats.BusyBytes, stats.BusyBlocks, stats.FreeBytes, stats.FreeBlocks,
+             stats.LargestFreeBlock );
+    MESSAGE( "heap %p: %u large blocks using %lu bytes, %u LFH groups with %lu free bytes, %u contentions\n",
+             heap, stats.LargeBlockCount, stats.LargeBlockBytes, stats.LfhGroupCount, stats.LfhFreeBytes,
+             stats.ContentionCount );
+
+    for (i = 0; i < HEAP_STATISTICS_SIZE_CLASSES; i++)
+    {
+        if (!stats.SizeClassCount[i]) continue;
+        if (i < HEAP_STATISTICS_SIZE_CLASSES - 1)
+            p += sprintf( p, " <=%lu:%s", (SIZE_T)0x10 << i, wine_dbgstr_longlong( stats.SizeClassCount[i] ));
+        else
+            p += sprintf( p, " more:%s", wine_dbgstr_longlong( stats.SizeClassCount[i] ));
+    }
+    MESSAGE( "heap %p: %s allocations%s\n", heap, wine_dbgstr_longlong( stats.AllocationCount ), buffer );
+}
+
+
+/***********************************************************************
+ *           dump_process_heaps
+ *
+ * Heaps that are not serialized can only be inspected safely when no
+ * other thread is running.
+ */
+static void dump_process_heaps( BOOL unserialized )
+{
+    HEAP *heap;
+
+    RtlEnterCriticalSection( &processHeap->critSection );
+    heap_dump_statistics( processHeap );
+    LIST_FOR_EACH_ENTRY( heap, &processHeap->entry, HEAP, entry )
+        if (unserialized || !(heap->flags & HEAP_NO_SERIALIZE)) heap_dump_statistics( heap );
+    RtlLeaveCriticalSection( &processHeap->critSection );
+}
+
+
+/***********************************************************************
+ *           report_statistics_callback
+ */
+static void WINAPI report_statistics_callback( void *arg, BOOLEAN timeout )
+{
+    dump_process_heaps( FALSE );
+}
+
+
+/***********************************************************************
+ *           heap_start_statistics
+ *
+ * Start dumping the statistics periodically if requested. Called once
+ * the loader is initialized, since it needs the thread pool.
+ */
+void heap_start_statistics(void)
+{
+    HANDLE timer;
+
+    if (report_period > 0)
+        RtlCreateTimer( &timer, NULL, report_statistics_callback, NULL,
+                        report_period * 1000, report_period * 1000, WT_EXECUTELONGFUNCTION );
+}
+
+
+/***********************************************************************
+ *           heap_report_statistics
+ *
+ * Dump the statistics of all the process heaps on exit if WINEHEAPSTATS is set.
+ * Other threads may still be running at this point.
+ */
+void heap_report_statistics(void)
+{
+    BOOLEAN last = FALSE;
+
+    if (!report_statistics) return;
+    NtQueryInformationThread( GetCurrentThread(), ThreadAmILastThread, &last, sizeof(last), NULL );
+    dump_process_heaps( last );
+}
+
+
 /***********************************************************************
  *           heap_set_debug_flags
  */
@@ -1516,6 +2095,23 @@ void heap_set_debug_flags( HANDLE handle )
             heap->pending_pos = 0;
         }
     }
+
+    if (heap == processHeap && !heap->lfh)
+    {
+        const char *lfh = getenv( "WINEHEAPLFH" );
+        if (lfh && atoi( lfh )) lfh_enable( heap );
+    }
+
+    if (heap == processHeap && !report_statistics)
+    {
+        const char *stats = getenv( "WINEHEAPSTATS" );
+
+        if (stats)
+        {
+            report_statistics = TRUE;
+            report_period = atoi( stats );
+        }
+    }
 }
 
 
@@ -1604,6 +2200,17 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
     heapPtr->critSection.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &heapPtr->critSection );
 
+    if (heapPtr->lfh)
+    {
+        int i;
+        for (i = 0; i < heapPtr->lfh->nb_regions; i++)
+        {
+            size = 0;
+            addr = heapPtr->lfh->regions[i];
+            NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+        }
+    }
+
     LIST_FOR_EACH_ENTRY_SAFE( arena, arena_next, &heapPtr->large_list, ARENA_LARGE, entry )
     {
         list_remove( &arena->entry );
@@ -1672,11 +2279,22 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     }
     if (rounded_size < HEAP_MIN_DATA_SIZE) rounded_size = HEAP_MIN_DATA_SIZE;
 
+    if (heapPtr->lfh && size <= LFH_MAX_BLOCK_SIZE)
+    {
+        void *ret = lfh_allocate( heapPtr, flags, size );
+        if (ret)
+        {
+            TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+            return ret;
+        }
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
     {
         void *ret = allocate_large_block( heap, flags, size );
+        if (ret) stats_alloc( heapPtr, size );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         if (!ret && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( STATUS_NO_MEMORY );
         TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
@@ -1714,6 +2332,7 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 
     notify_alloc( pInUse + 1, size, flags & HEAP_ZERO_MEMORY );
     initialize_block( pInUse + 1, size, pInUse->unused_bytes, flags );
+    stats_alloc( heapPtr, size );
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
 
@@ -1741,6 +2360,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
     ARENA_INUSE *pInUse;
     SUBHEAP *subheap;
     HEAP *heapPtr;
+    struct lfh_group *group;
 
     /* Validate the parameters */
 
@@ -1755,6 +2375,19 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && (group = lfh_find_group( heapPtr, ptr )))
+    {
+        if (!lfh_free( heapPtr, group, ptr ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            TRACE("(%p,%08x,%p): returning FALSE\n", heap, flags, ptr );
+            return FALSE;
+        }
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1765,9 +2398,15 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
     if (!validate_block_pointer( heapPtr, &subheap, pInUse )) goto error;
 
     if (!subheap)
+    {
+        stats_free( heapPtr, ((ARENA_LARGE *)ptr - 1)->data_size );
         free_large_block( heapPtr, flags, ptr );
+    }
     else
+    {
+        stats_free( heapPtr, (pInUse->size & ARENA_SIZE_MASK) - pInUse->unused_bytes );
         HEAP_MakeInUseBlockFree( subheap, pInUse );
+    }
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
     TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
@@ -1802,6 +2441,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     HEAP *heapPtr;
     SUBHEAP *subheap;
     SIZE_T oldBlockSize, oldActualSize, rounded_size;
+    struct lfh_group *group;
     void *ret;
 
     if (!ptr) return NULL;
@@ -1816,6 +2456,14 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && (group = lfh_find_group( heapPtr, ptr )))
+    {
+        ret = lfh_realloc( heapPtr, group, flags, ptr, size );
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -1826,6 +2474,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     if (!validate_block_pointer( heapPtr, &subheap, pArena )) goto error;
     if (!subheap)
     {
+        oldActualSize = ((ARENA_LARGE *)ptr - 1)->data_size;
         if (!(ret = realloc_large_block( heapPtr, flags, ptr, size ))) goto oom;
         goto done;
     }
@@ -1910,6 +2559,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
 
     ret = pArena + 1;
 done:
+    heapPtr->busy_bytes += size - oldActualSize;
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
     TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
     return ret;
@@ -2025,6 +2675,20 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     }
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && lfh_find_group( heapPtr, ptr ))
+    {
+        const ARENA_LFH *arena = (const ARENA_LFH *)ptr - 1;
+
+        if (arena->magic == ARENA_LFH_MAGIC) ret = arena->size;
+        else
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            ret = ~0UL;
+        }
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     pArena = (const ARENA_INUSE *)ptr - 1;
@@ -2067,6 +2731,8 @@ BOOLEAN WINAPI RtlValidateHeap( HANDLE heap, ULONG flags, LPCVOID ptr )
 {
     HEAP *heapPtr = HEAP_GetPtr( heap );
     if (!heapPtr) return FALSE;
+    if (ptr && heapPtr->lfh && lfh_find_group( heapPtr, ptr ))
+        return ((const ARENA_LFH *)ptr - 1)->magic == ARENA_LFH_MAGIC;
     return HEAP_IsRealArena( heapPtr, flags, ptr, QUIET );
 }
 
@@ -2235,7 +2901,9 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
-    switch (info_class)
+    HEAP *heapPtr;
+
+    switch ((ULONG)info_class)
     {
     case HeapCompatibilityInformation:
         if (size_out) *size_out = sizeof(ULONG);
@@ -2243,7 +2911,18 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        *(ULONG *)info = heapPtr->lfh ? 2 : 0; /* low fragmentation or standard heap */
+        return STATUS_SUCCESS;
+
+    case HeapWineStatistics:
+        if (size_out) *size_out = sizeof(HEAP_WINE_STATISTICS);
+
+        if (size_in < sizeof(HEAP_WINE_STATISTICS))
+            return STATUS_BUFFER_TOO_SMALL;
+
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+        heap_get_statistics( heapPtr, info );
         return STATUS_SUCCESS;
 
     default:
@@ -2257,6 +2936,27 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class, PVOID info, SIZE_T size)
 {
-    FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
-    return STATUS_SUCCESS;
+    HEAP *heapPtr;
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap, there is no going back from the low fragmentation heap */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 2:  /* low fragmentation heap */
+            return lfh_enable( heapPtr ) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+        default:
+            FIXME("%p: unsupported compatibility mode %u\n", heap, *(ULONG *)info);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+    default:
+        FIXME("%p %d %p %ld stub\n", heap, info_class, info, size);
+        return STATUS_SUCCESS;
+    }
 }
@@ -76,6 +76,8 @@ extern void virtual_init(void) DECLSPEC_HIDDEN;
 extern void virtual_init_threading(void) DECLSPEC_HIDDEN;
 extern void fill_cpu_info(void) DECLSPEC_HIDDEN;
 extern void heap_set_debug_flags( HANDLE handle ) DECLSPEC_HIDDEN;
+extern void heap_start_statistics(void) DECLSPEC_HIDDEN;
+extern void heap_report_statistics(void) DECLSPEC_HIDDEN;
 
 /* server support */
 extern timeout_t server_start_time DECLSPEC_HIDDEN;
@@ -94,10 +96,21 @@ extern unsigned int server_select( const select_op_t *select_op, data_size_t siz
                                    UINT flags, const LARGE_INTEGER *timeout ) DECLSPEC_HIDDEN;
 extern unsigned int server_queue_process_apc( HANDLE process, const apc_call_t *call, apc_result_t *result ) DECLSPEC_HIDDEN;
 extern int server_remove_fd_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
+extern BOOL server_cancel_io( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread, NTSTATUS status ) DECLSPEC_HIDDEN;
+extern struct inproc_sync *server_get_inproc_sync_area( unsigned int *count ) DECLSPEC_HIDDEN;
+extern void inproc_sync_remove_from_cache( HANDLE handle ) DECLSPEC_HIDDEN;
 extern int server_get_unix_fd( HANDLE handle, unsigned int access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options ) DECLSPEC_HIDDEN;
 extern int server_pipe( int fd[2] ) DECLSPEC_HIDDEN;
 
+/* futexes, shared by the synchronization objects */
+#ifdef __linux__
+struct timespec;
+extern int use_futexes(void) DECLSPEC_HIDDEN;
+extern int futex_wait( const int *addr, int val, struct timespec *timeout ) DECLSPEC_HIDDEN;
+extern int futex_wake( const int *addr, int val ) DECLSPEC_HIDDEN;
+#endif
+
 /* security descriptors */
 NTSTATUS NTDLL_create_struct_sd(PSECURITY_DESCRIPTOR nt_sd, struct security_descriptor **server_sd,
                                 data_size_t *server_sd_len) DECLSPEC_HIDDEN;
@@ -240,6 +253,8 @@ struct ntdll_thread_data
     WINE_VM86_TEB_INFO vm86;          /* 1fc vm86 private data */
     void              *exit_frame;    /* 204 exit frame pointer */
 #endif
+    struct threadpool_worker *threadpool_worker; /* 208/318 thread pool worker running on this thread */
+    unsigned int       inproc_list;   /* 20c/320 index + 1 of the in-process owned mutexes list */
 };
 
 static inline struct ntdll_thread_data *ntdll_get_thread_data(void)
@@ -354,6 +354,10 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
                                    ACCESS_MASK access, ULONG attributes, ULONG options )
 {
     NTSTATUS ret;
+
+    if ((options & DUPLICATE_CLOSE_SOURCE) && source_process == NtCurrentProcess())
+        server_cancel_io( source, NULL, FALSE, STATUS_HANDLES_CLOSED );
+
     SERVER_START_REQ( dup_handle )
     {
         req->src_process = wine_server_obj_handle( source_process );
@@ -369,6 +373,7 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
             if (reply->closed && reply->self)
             {
                 int fd = server_remove_fd_from_cache( source );
+                inproc_sync_remove_from_cache( source );
                 if (fd != -1) close( fd );
             }
         }
@@ -381,8 +386,12 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
 NTSTATUS close_handle( HANDLE handle )
 {
     NTSTATUS ret;
-    int fd = server_remove_fd_from_cache( handle );
+    int fd;
 
+    /* the I/O done outside of the server must not outlive the handle */
+    server_cancel_io( handle, NULL, FALSE, STATUS_HANDLES_CLOSED );
+    fd = server_remove_fd_from_cache( handle );
+    inproc_sync_remove_from_cache( handle );
     SERVER_START_REQ( close_handle )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -93,6 +93,11 @@ WINE_DEFAULT_DEBUG_CHANNEL(server);
 #define MSG_CMSG_CLOEXEC 0
 #endif
 
+/* limits for batched requests; the replies of a batch must fit in the reply
+ * pipe, since the server stops reading requests when it cannot write a reply */
+#define SERVER_BATCH_MAX_REQUESTS 16
+#define SERVER_BATCH_MAX_REPLY    4096
+
 #define SOCKETNAME "socket"        /* name of the socket file */
 #define LOCKNAME   "lock"          /* name of the lock file */
 
@@ -313,6 +318,94 @@ unsigned int wine_server_call( void *req_ptr )
 }
 
 
+/***********************************************************************
+ *           send_request_batch
+ *
+ * Send several requests to the server with a single write.
+ * Returns the index of the first request that was not sent.
+ */
+static unsigned int send_request_batch( struct __server_request_info **reqs, unsigned int start,
+                                        unsigned int count, unsigned int *status )
+{
+    struct iovec vec[SERVER_BATCH_MAX_REQUESTS * (__SERVER_MAX_DATA + 1)];
+    unsigned int i, j, nb_vec = 0;
+    size_t size = 0, reply_size = 0;
+    int ret;
+
+    for (i = start; i < count && i - start < SERVER_BATCH_MAX_REQUESTS; i++)
+    {
+        const struct __server_request_info *req = reqs[i];
+
+        reply_size += sizeof(req->u.reply) + req->u.req.request_header.reply_size;
+        if (i > start && reply_size > SERVER_BATCH_MAX_REPLY) break;
+
+        vec[nb_vec].iov_base = (void *)&req->u.req;
+        vec[nb_vec++].iov_len = sizeof(req->u.req);
+        for (j = 0; j < req->data_count; j++)
+        {
+            vec[nb_vec].iov_base = (void *)req->data[j].ptr;
+            vec[nb_vec++].iov_len = req->data[j].size;
+        }
+        size += sizeof(req->u.req) + req->u.req.request_header.request_size;
+    }
+
+    if ((ret = writev( ntdll_get_thread_data()->request_fd, vec, nb_vec )) == size)
+    {
+        *status = STATUS_SUCCESS;
+        return i;
+    }
+
+    if (ret >= 0) server_protocol_error( "partial write %d\n", ret );
+    if (errno == EPIPE) abort_thread(0);
+    if (errno == EFAULT)
+    {
+        *status = STATUS_ACCESS_VIOLATION;
+        return i;
+    }
+    server_protocol_perror( "write" );
+}
+
+
+/***********************************************************************
+ *           wine_server_call_batch (NTDLL.@)
+ *
+ * Perform several server calls with a single round-trip to the server.
+ *
+ * PARAMS
+ *     reqs  [I/O] Array of request pointers
+ *     count [I]   Number of requests
+ *
+ * RETURNS
+ *     The status of the first failed request, or STATUS_SUCCESS.
+ *
+ * NOTES
+ *     Each request is set up as for wine_server_call, and receives its own
+ *     reply and status in reply_header.error. The server processes the
+ *     requests in order, so they must not depend on each other's replies.
+ *     Requests that wait or that transfer file descriptors can't be batched.
+ */
+unsigned int CDECL wine_server_call_batch( void **reqs, unsigned int count )
+{
+    struct __server_request_info **req = (struct __server_request_info **)reqs;
+    unsigned int i, end, status, ret = STATUS_SUCCESS;
+    sigset_t old_set;
+
+    pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
+    for (i = 0; i < count; i = end)
+    {
+        end = send_request_batch( req, i, count, &status );
+        for ( ; i < end; i++)
+        {
+            if (!status) req[i]->u.reply.reply_header.error = wait_reply( req[i] );
+            else req[i]->u.reply.reply_header.error = status;
+            if (!ret) ret = req[i]->u.reply.reply_header.error;
+        }
+    }
+    pthread_sigmask( SIG_SETMASK, &old_set, NULL );
+    return ret;
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -971,6 +1064,38 @@ done:
 }
 
 
+/***********************************************************************
+ *           server_get_inproc_sync_area
+ *
+ * Map the memory area holding the state of the in-process synchronization
+ * objects. Returns NULL if the server doesn't support them.
+ */
+struct inproc_sync *server_get_inproc_sync_area( unsigned int *count )
+{
+    sigset_t sigset;
+    obj_handle_t fd_handle;
+    void *ptr = NULL;
+    int fd;
+
+    /* the fd cache section also protects the fd socket */
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( get_inproc_sync_fd )
+    {
+        if (!wine_server_call( req ) && (fd = receive_fd( &fd_handle )) != -1)
+        {
+            ptr = mmap( NULL, reply->count * sizeof(struct inproc_sync), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0 );
+            if (ptr != MAP_FAILED) *count = reply->count;
+            else ptr = NULL;
+            close( fd );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ptr;
+}
+
+
 /***********************************************************************
  *           wine_server_fd_to_handle   (NTDLL.@)
  *
@@ -1049,6 +1174,41 @@ void CDECL wine_server_release_fd( HANDLE handle, int unix_fd )
 }
 
 
+static wine_io_cancel_handler io_cancel_handler;
+
+/***********************************************************************
+ *           __wine_set_io_cancel_handler   (NTDLL.@)
+ *
+ * Set the function that cancels the I/O which a dll performs on its own
+ * on a handle. It is called when the I/O of the handle is cancelled, and
+ * before the handle is closed so that the dll can release its resources.
+ *
+ * PARAMS
+ *     handler [I] Cancel function, or NULL to remove it.
+ *
+ * RETURNS
+ *     nothing
+ */
+void CDECL __wine_set_io_cancel_handler( wine_io_cancel_handler handler )
+{
+    io_cancel_handler = handler;
+}
+
+
+/***********************************************************************
+ *           server_cancel_io
+ *
+ * Cancel the I/O of a handle that isn't known to the server.
+ * Returns TRUE if an operation has been cancelled.
+ */
+BOOL server_cancel_io( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread, NTSTATUS status )
+{
+    wine_io_cancel_handler handler = io_cancel_handler;
+
+    return handler && handler( handle, iosb, only_thread, status );
+}
+
+
 /***********************************************************************
  *           server_pipe
  *
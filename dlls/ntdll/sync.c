@@ -26,6 +26,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <signal.h>
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
@@ -36,12 +37,18 @@
 #ifdef HAVE_SYS_POLL_H
 # include <sys/poll.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -53,6 +60,7 @@
 #define NONAMELESSUNION
 #include "windef.h"
 #include "winternl.h"
+#include "wine/library.h"
 #include "wine/server.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
@@ -72,6 +80,109 @@ static inline int interlocked_dec_if_nonzero( int *dest )
     return val;
 }
 
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+#ifdef __linux__
+
+#define FUTEX_WAIT         0
+#define FUTEX_WAKE         1
+#define FUTEX_WAIT_BITSET  9
+#define FUTEX_WAKE_BITSET  10
+#define FUTEX_PRIVATE      128
+
+static int futex_private = FUTEX_PRIVATE;
+
+int futex_wait( const int *addr, int val, struct timespec *timeout )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAIT | futex_private, val, timeout, 0, 0 );
+}
+
+int futex_wake( const int *addr, int val )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAKE | futex_private, val, NULL, 0, 0 );
+}
+
+/* note: the timeout of FUTEX_WAIT_BITSET is absolute, we only use it for infinite waits */
+static inline int futex_wait_bitset( const int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAIT_BITSET | futex_private, val, NULL, 0, mask );
+}
+
+static inline int futex_wake_bitset( const int *addr, int val, int mask )
+{
+    return syscall( __NR_futex, addr, FUTEX_WAKE_BITSET | futex_private, val, NULL, 0, mask );
+}
+
+/* check for futex support, including the bitset operations needed for SRW locks;
+ * also used by the critical sections */
+int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1)
+    {
+        futex_wait_bitset( &supported, 10, ~0 );
+        if (errno == ENOSYS)
+        {
+            futex_private = 0;
+            futex_wait_bitset( &supported, 10, ~0 );
+        }
+        supported = (errno != ENOSYS);
+    }
+    return supported;
+}
+
+/* convert an NT timeout to the relative timespec expected by the futex calls */
+static void timespec_from_timeout( struct timespec *timespec, const LARGE_INTEGER *timeout )
+{
+    LARGE_INTEGER now;
+    LONGLONG diff;
+
+    if (timeout->QuadPart > 0)
+    {
+        NtQuerySystemTime( &now );
+        diff = timeout->QuadPart - now.QuadPart;
+        if (diff < 0) diff = 0;
+    }
+    else diff = -timeout->QuadPart;
+
+    timespec->tv_sec  = diff / 10000000;
+    timespec->tv_nsec = (diff % 10000000) * 100;
+}
+
+static inline NTSTATUS futex_wait_timeout( const int *addr, int val, const LARGE_INTEGER *timeout )
+{
+    struct timespec timespec;
+    int ret;
+
+    if (timeout && timeout->QuadPart != TIMEOUT_INFINITE)
+    {
+        timespec_from_timeout( &timespec, timeout );
+        ret = futex_wait( addr, val, &timespec );
+    }
+    else ret = futex_wait( addr, val, NULL );
+
+    if (ret == -1 && errno == ETIMEDOUT) return STATUS_TIMEOUT;
+    return STATUS_SUCCESS;
+}
+
+#endif  /* __linux__ */
+
+/* number of iterations to busy-wait on a contended lock before going to sleep */
+#define SYNC_SPIN_COUNT 256
+
+static inline int spinning_allowed(void)
+{
+    return NtCurrentTeb()->Peb->NumberOfProcessors > 1;
+}
+
 /* creates a struct security_descriptor and contained information in one contiguous piece of memory */
 NTSTATUS NTDLL_create_struct_sd(PSECURITY_DESCRIPTOR nt_sd, struct security_descriptor **server_sd,
                                 data_size_t *server_sd_len)
@@ -142,6 +253,383 @@ void NTDLL_free_struct_sd(struct security_descriptor *server_sd)
     RtlFreeHeap(GetProcessHeap(), 0, server_sd);
 }
 
+/*
+ *	In-process synchronization objects
+ *
+ * When enabled in the server, the state of events, semaphores and mutexes
+ * lives in a memory area shared with the server. Uncontended operations are
+ * then performed directly on that state, and the server is only involved
+ * when a thread needs to block or when some thread is already waiting.
+ */
+
+#include "pshpack1.h"
+union inproc_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;        /* index in the shared area */
+        unsigned int type : 8;     /* object type + 1, so that 0 can be used as the unset value */
+        unsigned int access : 24;  /* handle access rights */
+    } s;
+};
+#include "poppack.h"
+
+C_ASSERT( sizeof(union inproc_sync_cache_entry) == sizeof(LONG64) );
+
+#define INPROC_SYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(union inproc_sync_cache_entry))
+#define INPROC_SYNC_CACHE_ENTRIES     128
+
+static union inproc_sync_cache_entry *inproc_sync_cache[INPROC_SYNC_CACHE_ENTRIES];
+static struct inproc_sync *inproc_sync_area;
+static unsigned int inproc_sync_count;
+static int inproc_sync_serial;  /* serial of remotely closed handles the cache is valid for */
+static RTL_RUN_ONCE inproc_sync_once = RTL_RUN_ONCE_INIT;
+
+static DWORD WINAPI init_inproc_sync( RTL_RUN_ONCE *once, void *param, void **context )
+{
+    inproc_sync_area = server_get_inproc_sync_area( &inproc_sync_count );
+    if (inproc_sync_area) TRACE( "using in-process synchronization\n" );
+    return TRUE;
+}
+
+static inline unsigned int inproc_sync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / INPROC_SYNC_CACHE_BLOCK_SIZE;
+    return idx % INPROC_SYNC_CACHE_BLOCK_SIZE;
+}
+
+/* atomically read the state and waiter count of an object */
+static inline struct inproc_sync read_inproc_sync( struct inproc_sync *sync )
+{
+    struct inproc_sync ret;
+    ret.u.data = interlocked_cmpxchg64( &sync->u.data, 0, 0 );
+    return ret;
+}
+
+/* update the state of an object, only allowed while nobody waits for it in the server */
+static inline BOOL update_inproc_sync( struct inproc_sync *sync, struct inproc_sync old, int value )
+{
+    struct inproc_sync new;
+
+    new.u.s.value = value;
+    new.u.s.waiters = 0;
+    old.u.s.waiters = 0;
+    return interlocked_cmpxchg64( &sync->u.data, new.u.data, old.u.data ) == old.u.data;
+}
+
+static inline int get_inproc_sync_serial(void)
+{
+    return *(volatile int *)&inproc_sync_area[INPROC_SYNC_SERIAL].u.s.value;
+}
+
+static inline void clear_inproc_sync_cache_entry( union inproc_sync_cache_entry *entry )
+{
+    LONG64 data;
+
+    do data = entry->data;
+    while (interlocked_cmpxchg64( &entry->data, 0, data ) != data);
+}
+
+/***********************************************************************
+ *           flush_inproc_sync_cache
+ *
+ * Another process closed one of our handles, so the handle values in the
+ * cache can't be trusted anymore.
+ */
+static void flush_inproc_sync_cache( int serial )
+{
+    unsigned int i, j;
+
+    TRACE( "handle closed remotely, flushing the cache\n" );
+    for (i = 0; i < INPROC_SYNC_CACHE_ENTRIES; i++)
+    {
+        if (!inproc_sync_cache[i]) continue;
+        for (j = 0; j < INPROC_SYNC_CACHE_BLOCK_SIZE; j++)
+            if (inproc_sync_cache[i][j].data) clear_inproc_sync_cache_entry( &inproc_sync_cache[i][j] );
+    }
+    inproc_sync_serial = serial;
+}
+
+/***********************************************************************
+ *           get_inproc_sync
+ *
+ * Retrieve the shared state of a synchronization object, if it has one.
+ */
+static enum inproc_sync_type get_inproc_sync( HANDLE handle, struct inproc_sync **sync,
+                                              unsigned int *access )
+{
+    unsigned int entry, idx = inproc_sync_handle_to_index( handle, &entry );
+    union inproc_sync_cache_entry cache;
+    NTSTATUS ret;
+    int serial;
+
+    RtlRunOnceExecuteOnce( &inproc_sync_once, init_inproc_sync, NULL, NULL );
+    if (!inproc_sync_area || entry >= INPROC_SYNC_CACHE_ENTRIES) return INPROC_SYNC_NONE;
+
+    if ((serial = get_inproc_sync_serial()) != inproc_sync_serial) flush_inproc_sync_cache( serial );
+
+    if (inproc_sync_cache[entry])
+    {
+        cache.data = interlocked_cmpxchg64( &inproc_sync_cache[entry][idx].data, 0, 0 );
+        if (cache.s.type) goto done;
+    }
+    else
+    {
+        void *ptr = wine_anon_mmap( NULL, INPROC_SYNC_CACHE_BLOCK_SIZE * sizeof(union inproc_sync_cache_entry),
+                                    PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return INPROC_SYNC_NONE;
+        if (interlocked_cmpxchg_ptr( (void **)&inproc_sync_cache[entry], ptr, NULL ))
+            munmap( ptr, INPROC_SYNC_CACHE_BLOCK_SIZE * sizeof(union inproc_sync_cache_entry) );
+    }
+
+    SERVER_START_REQ( get_inproc_sync )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        if (!(ret = wine_server_call( req )))
+        {
+            cache.s.index  = reply->index;
+            cache.s.type   = reply->type + 1;
+            cache.s.access = reply->access;
+            if (reply->index >= inproc_sync_count) cache.s.type = INPROC_SYNC_NONE + 1;
+        }
+    }
+    SERVER_END_REQ;
+    /* let the server report invalid handles */
+    if (ret) return INPROC_SYNC_NONE;
+    interlocked_cmpxchg64( &inproc_sync_cache[entry][idx].data, cache.data, 0 );
+    /* don't keep the entry if the handle may have been closed in the meantime */
+    if (get_inproc_sync_serial() != serial)
+        interlocked_cmpxchg64( &inproc_sync_cache[entry][idx].data, 0, cache.data );
+
+done:
+    *sync = &inproc_sync_area[cache.s.index];
+    *access = cache.s.access;
+    return cache.s.type - 1;
+}
+
+/***********************************************************************
+ *           inproc_sync_remove_from_cache
+ */
+void inproc_sync_remove_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = inproc_sync_handle_to_index( handle, &entry );
+
+    if (entry >= INPROC_SYNC_CACHE_ENTRIES || !inproc_sync_cache[entry]) return;
+    clear_inproc_sync_cache_entry( &inproc_sync_cache[entry][idx] );
+}
+
+/***********************************************************************
+ *           get_inproc_owned_list
+ *
+ * Retrieve the list of mutexes owned by the current thread, which the server
+ * walks to abandon them when the thread dies. Returns FALSE if not available.
+ */
+static BOOL get_inproc_owned_list( unsigned int *list )
+{
+    struct ntdll_thread_data *thread_data = ntdll_get_thread_data();
+
+    if (!thread_data->inproc_list)
+    {
+        SERVER_START_REQ( get_inproc_owned_list )
+        {
+            if (!wine_server_call( req )) thread_data->inproc_list = reply->index + 1;
+        }
+        SERVER_END_REQ;
+        if (!thread_data->inproc_list) return FALSE;
+    }
+    *list = thread_data->inproc_list - 1;
+    return TRUE;
+}
+
+/* only the owner thread adds or removes its mutexes, except for the server
+ * when the thread is blocked in a server call or dead */
+static void add_inproc_owned( unsigned int list, struct inproc_sync *sync )
+{
+    struct inproc_sync *head = &inproc_sync_area[list];
+    unsigned int index = sync - inproc_sync_area;
+
+    sync->owned_prev = list;
+    sync->owned_next = head->owned_next;
+    inproc_sync_area[head->owned_next].owned_prev = index;
+    head->owned_next = index;
+}
+
+static void remove_inproc_owned( struct inproc_sync *sync )
+{
+    unsigned int index = sync - inproc_sync_area;
+
+    inproc_sync_area[sync->owned_prev].owned_next = sync->owned_next;
+    inproc_sync_area[sync->owned_next].owned_prev = sync->owned_prev;
+    sync->owned_prev = sync->owned_next = index;
+}
+
+/***********************************************************************
+ *           inproc_try_wait
+ *
+ * Try to acquire an object without blocking. Returns STATUS_NOT_IMPLEMENTED
+ * if the server needs to be involved.
+ */
+static NTSTATUS inproc_try_wait( enum inproc_sync_type type, struct inproc_sync *sync, unsigned int access )
+{
+    int tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct inproc_sync old;
+    unsigned int list;
+
+    if (!(access & SYNCHRONIZE)) return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        old = read_inproc_sync( sync );
+        switch (type)
+        {
+        case INPROC_SYNC_EVENT:
+            if (old.u.s.waiters) return STATUS_NOT_IMPLEMENTED;
+            if (!old.u.s.value) return STATUS_TIMEOUT;
+            if (sync->max) return STATUS_SUCCESS;  /* manual reset */
+            if (update_inproc_sync( sync, old, 0 )) return STATUS_SUCCESS;
+            break;
+        case INPROC_SYNC_SEMAPHORE:
+            if (old.u.s.waiters) return STATUS_NOT_IMPLEMENTED;
+            if (!old.u.s.value) return STATUS_TIMEOUT;
+            if (update_inproc_sync( sync, old, old.u.s.value - 1 )) return STATUS_SUCCESS;
+            break;
+        case INPROC_SYNC_MUTEX:
+            if (old.u.s.value == tid)
+            {
+                /* only the owner modifies the recursion count */
+                if (sync->count >= MAXLONG) return STATUS_NOT_IMPLEMENTED;
+                sync->count++;
+                return STATUS_SUCCESS;
+            }
+            if (old.u.s.waiters || old.u.s.value == INPROC_SYNC_ABANDONED) return STATUS_NOT_IMPLEMENTED;
+            if (old.u.s.value) return STATUS_TIMEOUT;
+            if (!get_inproc_owned_list( &list )) return STATUS_NOT_IMPLEMENTED;
+            if (update_inproc_sync( sync, old, tid ))
+            {
+                sync->count = 1;
+                add_inproc_owned( list, sync );
+                return STATUS_SUCCESS;
+            }
+            break;
+        default:
+            return STATUS_NOT_IMPLEMENTED;
+        }
+    }
+}
+
+/***********************************************************************
+ *           inproc_wait
+ *
+ * Satisfy a wait-any on objects that are all available in-process.
+ * Returns STATUS_NOT_IMPLEMENTED if the wait has to go through the server.
+ */
+static NTSTATUS inproc_wait( DWORD count, const HANDLE *handles, const LARGE_INTEGER *timeout )
+{
+    enum inproc_sync_type types[MAXIMUM_WAIT_OBJECTS];
+    struct inproc_sync *syncs[MAXIMUM_WAIT_OBJECTS];
+    unsigned int access[MAXIMUM_WAIT_OBJECTS];
+    NTSTATUS ret;
+    DWORD i;
+
+    for (i = 0; i < count; i++)
+        if (!(types[i] = get_inproc_sync( handles[i], &syncs[i], &access[i] ))) return STATUS_NOT_IMPLEMENTED;
+
+    for (i = 0; i < count; i++)
+    {
+        ret = inproc_try_wait( types[i], syncs[i], access[i] );
+        if (ret == STATUS_SUCCESS) return STATUS_WAIT_0 + i;
+        if (ret != STATUS_TIMEOUT) return ret;
+    }
+    /* nothing is signaled, block in the server unless this is only a poll */
+    if (timeout && !timeout->QuadPart) return STATUS_TIMEOUT;
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+/***********************************************************************
+ *           inproc_set_event
+ */
+static NTSTATUS inproc_set_event( HANDLE handle, int value )
+{
+    struct inproc_sync *sync, old;
+    unsigned int access;
+
+    if (get_inproc_sync( handle, &sync, &access ) != INPROC_SYNC_EVENT) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & EVENT_MODIFY_STATE)) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = read_inproc_sync( sync );
+        if (old.u.s.waiters) return STATUS_NOT_IMPLEMENTED;
+    } while (!update_inproc_sync( sync, old, value ));
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           inproc_release_semaphore
+ */
+static NTSTATUS inproc_release_semaphore( HANDLE handle, ULONG count, ULONG *previous )
+{
+    struct inproc_sync *sync, old;
+    unsigned int access, current;
+
+    if (get_inproc_sync( handle, &sync, &access ) != INPROC_SYNC_SEMAPHORE) return STATUS_NOT_IMPLEMENTED;
+    if (!(access & SEMAPHORE_MODIFY_STATE)) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = read_inproc_sync( sync );
+        if (old.u.s.waiters) return STATUS_NOT_IMPLEMENTED;
+        current = old.u.s.value;
+        if (current + count < current || current + count > sync->max)
+            return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+    } while (!update_inproc_sync( sync, old, current + count ));
+    if (previous) *previous = current;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           inproc_release_mutex
+ */
+static NTSTATUS inproc_release_mutex( HANDLE handle, LONG *prev_count )
+{
+    int tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    struct inproc_sync *sync, old;
+    unsigned int access, list;
+
+    if (get_inproc_sync( handle, &sync, &access ) != INPROC_SYNC_MUTEX) return STATUS_NOT_IMPLEMENTED;
+
+    old = read_inproc_sync( sync );
+    if (old.u.s.value != tid || !sync->count) return STATUS_MUTANT_NOT_OWNED;
+    if (sync->count == 1)
+    {
+        /* the server keeps track of it, or has to wake up a waiter */
+        if (sync->owned_next == INPROC_SYNC_NO_LIST || old.u.s.waiters) return STATUS_NOT_IMPLEMENTED;
+        if (!get_inproc_owned_list( &list )) return STATUS_NOT_IMPLEMENTED;
+    }
+    if (prev_count) *prev_count = sync->count;
+    if (sync->count > 1)
+    {
+        sync->count--;
+        return STATUS_SUCCESS;
+    }
+    /* unlink it and clear the count first, a new owner will set them once it grabbed the mutex */
+    remove_inproc_owned( sync );
+    sync->count = 0;
+    for (;;)
+    {
+        if (old.u.s.waiters)
+        {
+            sync->count = 1;
+            add_inproc_owned( list, sync );
+            return STATUS_NOT_IMPLEMENTED;
+        }
+        if (update_inproc_sync( sync, old, 0 )) return STATUS_SUCCESS;
+        old = read_inproc_sync( sync );
+    }
+}
+
 /*
  *	Semaphores
  */
@@ -255,6 +743,10 @@ NTSTATUS WINAPI NtQuerySemaphore( HANDLE handle, SEMAPHORE_INFORMATION_CLASS cla
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
     NTSTATUS ret;
+
+    if ((ret = inproc_release_semaphore( handle, count, previous )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -352,6 +844,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if ((ret = inproc_set_event( handle, 1 )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -372,6 +866,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if ((ret = inproc_set_event( handle, 0 )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -406,6 +902,9 @@ NTSTATUS WINAPI NtPulseEvent( HANDLE handle, PULONG PulseCount )
     if (PulseCount)
       FIXME("(%p,%d)\n", handle, *PulseCount);
 
+    /* without any waiter, pulsing is the same as resetting */
+    if ((ret = inproc_set_event( handle, 0 )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -530,6 +1029,9 @@ NTSTATUS WINAPI NtReleaseMutant( IN HANDLE handle, OUT PLONG prev_count OPTIONAL
 {
     NTSTATUS    status;
 
+    if ((status = inproc_release_mutex( handle, prev_count )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
     SERVER_START_REQ( release_mutex )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -996,9 +1498,15 @@ static NTSTATUS wait_objects( DWORD count, const HANDLE *handles,
 {
     select_op_t select_op;
     UINT i, flags = SELECT_INTERRUPTIBLE;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    /* alertable waits need the server to check for user APCs */
+    if (wait_any && !alertable &&
+        (ret = inproc_wait( count, handles, timeout )) != STATUS_NOT_IMPLEMENTED)
+        return ret;
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1317,6 +1825,77 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE CompletionPort, PULONG_PTR Completi
     return status;
 }
 
+/******************************************************************
+ *              NtRemoveIoCompletionEx (NTDLL.@)
+ *              ZwRemoveIoCompletionEx (NTDLL.@)
+ *
+ * (Wait for and) retrieve several completion messages from completion object's queue
+ *
+ * PARAMS
+ *      CompletionPort  [I] HANDLE to I/O completion object
+ *      info            [O] array receiving the completion messages
+ *      count           [I] number of entries in the array
+ *      written         [O] number of messages retrieved
+ *      WaitTime        [I] optional wait time in NTDLL format
+ *      alertable       [I] whether the wait is alertable
+ *
+ * NOTES
+ *  All the messages already queued are retrieved with a single server call
+ *  as long as they fit in the reply buffer.
+ */
+NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE CompletionPort, FILE_IO_COMPLETION_INFORMATION *info,
+                                        ULONG count, ULONG *written, LARGE_INTEGER *WaitTime,
+                                        BOOLEAN alertable )
+{
+    completion_msg_t msgs[64];
+    NTSTATUS status;
+    ULONG i, ret = 0, batch;
+
+    TRACE("(%p, %p, %u, %p, %p, %u)\n", CompletionPort, info, count, written, WaitTime, alertable);
+
+    if (!count) return STATUS_INVALID_PARAMETER;
+
+    for (;;)
+    {
+        do
+        {
+            batch = min( count - ret, sizeof(msgs) / sizeof(msgs[0]) );
+            SERVER_START_REQ( remove_completions )
+            {
+                req->handle = wine_server_obj_handle( CompletionPort );
+                wine_server_set_reply( req, msgs, batch * sizeof(msgs[0]) );
+                if (!(status = wine_server_call( req )))
+                    batch = wine_server_reply_size( reply ) / sizeof(msgs[0]);
+            }
+            SERVER_END_REQ;
+            if (status) break;
+
+            for (i = 0; i < batch; i++, ret++)
+            {
+                info[ret].CompletionKey             = msgs[i].ckey;
+                info[ret].CompletionValue           = msgs[i].cvalue;
+                info[ret].IoStatusBlock.Information = msgs[i].information;
+                /* clear the whole field, it's the ULONG_PTR Internal of an OVERLAPPED_ENTRY */
+                info[ret].IoStatusBlock.u.Pointer   = NULL;
+                info[ret].IoStatusBlock.u.Status    = msgs[i].status;
+            }
+            /* a short batch means that the queue is empty now */
+        } while (ret < count && batch == sizeof(msgs) / sizeof(msgs[0]));
+
+        if (ret)
+        {
+            status = STATUS_SUCCESS;
+            break;
+        }
+        if (status != STATUS_PENDING) break;
+
+        status = NtWaitForSingleObject( CompletionPort, alertable, WaitTime );
+        if (status != WAIT_OBJECT_0) break;
+    }
+    if (written) *written = ret;
+    return status;
+}
+
 /******************************************************************
  *              NtOpenIoCompletion (NTDLL.@)
  *              ZwOpenIoCompletion (NTDLL.@)
@@ -1657,15 +2236,266 @@ static inline void srwlock_leave_shared( RTL_SRWLOCK *lock, unsigned int val )
         NtReleaseKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
 
-/***********************************************************************
- *              RtlInitializeSRWLock (NTDLL.@)
+#ifdef __linux__
+
+/* Futex based SRW lock implementation
+ *
+ * When futexes are available the lock word is used with a different layout:
+ *
+ * 32 31            16 15            0
+ *  ________________ ________________
+ * | S| #excl waiter| X|   #shared    |
+ *  ¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯¯
+ * X is set while the lock is owned exclusively, #shared counts the shared
+ * owners, #excl waiter counts the threads sleeping (or about to sleep) for
+ * exclusive access and S is set when threads are sleeping for shared access.
+ * Exclusive waiters are preferred: no new shared owner is admitted while
+ * #excl waiter is non-zero. Both kinds of waiters sleep on the same futex
+ * and are told apart with the futex bitsets, so that releasing an exclusive
+ * lock only wakes the threads that can actually make progress.
+ *
+ * The uncontended paths never enter the kernel, and contended acquires spin
+ * for a short while before sleeping as long as the lock is only held for a
+ * short time (i.e. nobody is sleeping on it yet).
+ */
+
+#define SRWLOCK_FUTEX_SHARED_OWNERS_MASK      0x00007fff
+#define SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT      0x00008000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK  0x7fff0000
+#define SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC   0x00010000
+#define SRWLOCK_FUTEX_SHARED_WAITERS_BIT      0x80000000
+
+#define SRWLOCK_FUTEX_BITSET_EXCLUSIVE  1
+#define SRWLOCK_FUTEX_BITSET_SHARED     2
+
+static inline int srwlock_futex_free_for_exclusive( int val )
+{
+    return !(val & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_SHARED_OWNERS_MASK));
+}
+
+static inline int srwlock_futex_free_for_shared( int val )
+{
+    return !(val & (SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT | SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK));
+}
+
+static inline int srwlock_futex_has_sleepers( int val )
+{
+    return val & (SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK | SRWLOCK_FUTEX_SHARED_WAITERS_BIT);
+}
+
+static NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *futex = (int *)&lock->Ptr;
+    int old;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    for (old = *futex; srwlock_futex_free_for_exclusive( old ); old = *futex)
+        if (interlocked_cmpxchg( futex, old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT, old ) == old)
+            return STATUS_SUCCESS;
+    return STATUS_TIMEOUT;
+}
+
+static NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *futex = (int *)&lock->Ptr;
+    int old, new, spin = spinning_allowed() ? SYNC_SPIN_COUNT : 0;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        old = *futex;
+        if (srwlock_futex_free_for_exclusive( old ))
+        {
+            if (interlocked_cmpxchg( futex, old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT, old ) == old)
+                return STATUS_SUCCESS;
+            continue;
+        }
+        if (!spin-- || srwlock_futex_has_sleepers( old )) break;
+        small_pause();
+    }
+
+    /* register as an exclusive waiter, this also stops new shared owners */
+    interlocked_xchg_add( futex, SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC );
+
+    for (;;)
+    {
+        old = *futex;
+        if (srwlock_futex_free_for_exclusive( old ))
+        {
+            new = (old | SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) - SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_INC;
+            if (interlocked_cmpxchg( futex, new, old ) == old) return STATUS_SUCCESS;
+            continue;
+        }
+        futex_wait_bitset( futex, old, SRWLOCK_FUTEX_BITSET_EXCLUSIVE );
+    }
+}
+
+static NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *futex = (int *)&lock->Ptr;
+    int old;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    for (old = *futex; srwlock_futex_free_for_shared( old ); old = *futex)
+    {
+        assert( (old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) != SRWLOCK_FUTEX_SHARED_OWNERS_MASK );
+        if (interlocked_cmpxchg( futex, old + 1, old ) == old) return STATUS_SUCCESS;
+    }
+    return STATUS_TIMEOUT;
+}
+
+static NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *futex = (int *)&lock->Ptr;
+    int old, spin = spinning_allowed() ? SYNC_SPIN_COUNT : 0;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    for (;;)
+    {
+        old = *futex;
+        if (srwlock_futex_free_for_shared( old ))
+        {
+            assert( (old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) != SRWLOCK_FUTEX_SHARED_OWNERS_MASK );
+            if (interlocked_cmpxchg( futex, old + 1, old ) == old) return STATUS_SUCCESS;
+            continue;
+        }
+        if (spin > 0 && !srwlock_futex_has_sleepers( old ))
+        {
+            spin--;
+            small_pause();
+            continue;
+        }
+        if (!(old & SRWLOCK_FUTEX_SHARED_WAITERS_BIT) &&
+            interlocked_cmpxchg( futex, old | SRWLOCK_FUTEX_SHARED_WAITERS_BIT, old ) != old)
+            continue;
+        futex_wait_bitset( futex, old | SRWLOCK_FUTEX_SHARED_WAITERS_BIT, SRWLOCK_FUTEX_BITSET_SHARED );
+    }
+}
+
+/* wake the threads that can make progress now that the lock is free */
+static void srwlock_futex_wake( int *futex, int old )
+{
+    int new, mask;
+
+    for (;;)
+    {
+        if (old & SRWLOCK_FUTEX_EXCLUSIVE_WAITERS_MASK)
+        {
+            mask = SRWLOCK_FUTEX_BITSET_EXCLUSIVE;
+            break;
+        }
+        if (!(old & SRWLOCK_FUTEX_SHARED_WAITERS_BIT)) return;
+        new = old & ~SRWLOCK_FUTEX_SHARED_WAITERS_BIT;
+        if ((new = interlocked_cmpxchg( futex, new, old )) == old)
+        {
+            mask = SRWLOCK_FUTEX_BITSET_SHARED;
+            break;
+        }
+        old = new;
+        /* somebody else grabbed the lock in the meantime, it will do the wakeup */
+        if (!srwlock_futex_free_for_exclusive( old )) return;
+    }
+
+    if (mask == SRWLOCK_FUTEX_BITSET_EXCLUSIVE)
+        futex_wake_bitset( futex, 1, mask );
+    else
+        futex_wake_bitset( futex, INT_MAX, mask );
+}
+
+static NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    int *futex = (int *)&lock->Ptr;
+    int old;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+        if (!(old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT))
+        {
+            ERR( "Lock %p is not owned exclusive! (%#x)\n", lock, old );
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+    } while (interlocked_cmpxchg( futex, old & ~SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT, old ) != old);
+
+    old &= ~SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT;
+    if (srwlock_futex_has_sleepers( old )) srwlock_futex_wake( futex, old );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    int *futex = (int *)&lock->Ptr;
+    int old;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+        if ((old & SRWLOCK_FUTEX_EXCLUSIVE_LOCK_BIT) || !(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK))
+        {
+            ERR( "Lock %p is not owned shared! (%#x)\n", lock, old );
+            return STATUS_RESOURCE_NOT_OWNED;
+        }
+    } while (interlocked_cmpxchg( futex, old - 1, old ) != old);
+
+    old -= 1;
+    /* the last shared owner wakes up the waiters */
+    if (!(old & SRWLOCK_FUTEX_SHARED_OWNERS_MASK) && srwlock_futex_has_sleepers( old ))
+        srwlock_futex_wake( futex, old );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static NTSTATUS fast_try_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_acquire_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_try_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_acquire_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_srw_exclusive( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_release_srw_shared( RTL_SRWLOCK *lock )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
+/***********************************************************************
+ *              RtlInitializeSRWLock (NTDLL.@)
  *
  * NOTES
  *  Please note that SRWLocks do not keep track of the owner of a lock.
  *  It doesn't make any difference which thread for example unlocks an
- *  SRWLock (see corresponding tests). This implementation uses two
- *  keyed events (one for the exclusive waiters and one for the shared
- *  waiters) and is limited to 2^15-1 waiting threads.
+ *  SRWLock (see corresponding tests). On Linux the lock is built directly
+ *  on a futex, elsewhere this implementation uses two keyed events (one for
+ *  the exclusive waiters and one for the shared waiters). Both are limited
+ *  to 2^15-1 waiting threads.
  */
 void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
 {
@@ -1682,6 +2512,9 @@ void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_acquire_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (srwlock_lock_exclusive( (unsigned int *)&lock->Ptr, SRWLOCK_RES_EXCLUSIVE ))
         NtWaitForKeyedEvent( keyed_event, srwlock_key_exclusive(lock), FALSE, NULL );
 }
@@ -1696,6 +2529,10 @@ void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+
+    if (fast_acquire_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     /* Acquires a shared lock. If it's currently not possible to add elements to
      * the shared queue, then request exclusive access instead. */
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
@@ -1726,6 +2563,9 @@ void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    if (fast_release_srw_exclusive( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     srwlock_leave_exclusive( lock, srwlock_unlock_exclusive( (unsigned int *)&lock->Ptr,
                              - SRWLOCK_RES_EXCLUSIVE ) - SRWLOCK_RES_EXCLUSIVE );
 }
@@ -1735,6 +2575,9 @@ void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
  */
 void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
 {
+    if (fast_release_srw_shared( lock ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     srwlock_leave_shared( lock, srwlock_lock_exclusive( (unsigned int *)&lock->Ptr,
                           - SRWLOCK_RES_SHARED ) - SRWLOCK_RES_SHARED );
 }
@@ -1748,6 +2591,11 @@ void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
  */
 BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 {
+    NTSTATUS ret;
+
+    if ((ret = fast_try_acquire_srw_exclusive( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (ret == STATUS_SUCCESS);
+
     return interlocked_cmpxchg( (int *)&lock->Ptr, SRWLOCK_MASK_IN_EXCLUSIVE |
                                 SRWLOCK_RES_EXCLUSIVE, 0 ) == 0;
 }
@@ -1758,6 +2606,11 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
 BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
 {
     unsigned int val, tmp;
+    NTSTATUS ret;
+
+    if ((ret = fast_try_acquire_srw_shared( lock )) != STATUS_NOT_IMPLEMENTED)
+        return (ret == STATUS_SUCCESS);
+
     for (val = *(unsigned int *)&lock->Ptr;; val = tmp)
     {
         if (val & SRWLOCK_MASK_EXCLUSIVE_QUEUE)
@@ -1768,6 +2621,84 @@ BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
     return TRUE;
 }
 
+#ifdef __linux__
+
+/* Futex based condition variables
+ *
+ * With futexes the condition variable holds a wakeup sequence number in
+ * bits 1-31 and a flag in bit 0 which is set once a thread went to sleep.
+ * Sleepers sample the sequence number while still holding the lock and wait
+ * for it to change; wakers bump it and only enter the kernel when the flag
+ * says that somebody may be sleeping. Waking a single thread leaves the flag
+ * set since other threads may still be sleeping, waking all clears it.
+ */
+
+#define CV_FUTEX_SLEEPERS  1
+#define CV_FUTEX_SEQ_INC   2
+
+static inline int fast_cv_supported(void)
+{
+    return use_futexes();
+}
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    int *futex = (int *)&variable->Ptr;
+    int spin;
+
+    /* the wakeup usually comes quickly when threads are handing work back and forth */
+    for (spin = spinning_allowed() ? SYNC_SPIN_COUNT : 0; spin > 0; spin--)
+    {
+        if (*(volatile int *)futex != val) return STATUS_SUCCESS;
+        small_pause();
+    }
+
+    if (!(val & CV_FUTEX_SLEEPERS))
+    {
+        if (interlocked_cmpxchg( futex, val | CV_FUTEX_SLEEPERS, val ) != val)
+            return STATUS_SUCCESS;
+        val |= CV_FUTEX_SLEEPERS;
+    }
+    return futex_wait_timeout( futex, val, timeout );
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    int *futex = (int *)&variable->Ptr;
+    int old, new;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    do
+    {
+        old = *futex;
+        new = old + CV_FUTEX_SEQ_INC;
+        if (count == INT_MAX) new &= ~CV_FUTEX_SLEEPERS;
+    } while (interlocked_cmpxchg( futex, new, old ) != old);
+
+    if (old & CV_FUTEX_SLEEPERS) futex_wake( futex, count );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static inline int fast_cv_supported(void)
+{
+    return 0;
+}
+
+static NTSTATUS fast_wait_cv( RTL_CONDITION_VARIABLE *variable, int val, const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wake_cv( RTL_CONDITION_VARIABLE *variable, int count )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
 /***********************************************************************
  *           RtlInitializeConditionVariable   (NTDLL.@)
  *
@@ -1801,6 +2732,9 @@ void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
+    if (fast_wake_cv( variable, 1 ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
     if (interlocked_dec_if_nonzero( (int *)&variable->Ptr ))
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1812,7 +2746,12 @@ void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
  */
 void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
 {
-    int val = interlocked_xchg( (int *)&variable->Ptr, 0 );
+    int val;
+
+    if (fast_wake_cv( variable, INT_MAX ) != STATUS_NOT_IMPLEMENTED)
+        return;
+
+    val = interlocked_xchg( (int *)&variable->Ptr, 0 );
     while (val-- > 0)
         NtReleaseKeyedEvent( keyed_event, &variable->Ptr, FALSE, NULL );
 }
@@ -1836,6 +2775,17 @@ NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, R
                                              const LARGE_INTEGER *timeout )
 {
     NTSTATUS status;
+
+    if (fast_cv_supported())
+    {
+        int val = *(int *)&variable->Ptr;
+
+        RtlLeaveCriticalSection( crit );
+        status = fast_wait_cv( variable, val, timeout );
+        RtlEnterCriticalSection( crit );
+        return status;
+    }
+
     interlocked_xchg_add( (int *)&variable->Ptr, 1 );
     RtlLeaveCriticalSection( crit );
 
@@ -1873,6 +2823,25 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
                                               const LARGE_INTEGER *timeout, ULONG flags )
 {
     NTSTATUS status;
+
+    if (fast_cv_supported())
+    {
+        int val = *(int *)&variable->Ptr;
+
+        if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+            RtlReleaseSRWLockShared( lock );
+        else
+            RtlReleaseSRWLockExclusive( lock );
+
+        status = fast_wait_cv( variable, val, timeout );
+
+        if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+            RtlAcquireSRWLockShared( lock );
+        else
+            RtlAcquireSRWLockExclusive( lock );
+        return status;
+    }
+
     interlocked_xchg_add( (int *)&variable->Ptr, 1 );
 
     if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
@@ -1893,3 +2862,170 @@ NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable,
         RtlAcquireSRWLockExclusive( lock );
     return status;
 }
+
+
+/* Address waits
+ *
+ * Waiters are hashed by address into a small table of wait queues, so waking
+ * an address may also wake threads waiting on unrelated addresses that share
+ * the same queue. That is allowed, callers have to check the value again
+ * anyway after returning.
+ */
+
+#define ADDR_WAIT_QUEUES 256
+
+static int addr_wait_queues[ADDR_WAIT_QUEUES];
+
+static RTL_CRITICAL_SECTION addr_section;
+static RTL_CRITICAL_SECTION_DEBUG addr_section_debug =
+{
+    0, 0, &addr_section,
+    { &addr_section_debug.ProcessLocksList, &addr_section_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": addr_section") }
+};
+static RTL_CRITICAL_SECTION addr_section = { &addr_section_debug, -1, 0, 0, 0, 0 };
+
+static inline int *get_addr_wait_queue( const void *addr )
+{
+    ULONG_PTR val = (ULONG_PTR)addr;
+    return &addr_wait_queues[(val ^ (val >> 8) ^ (val >> 16)) / sizeof(int) % ADDR_WAIT_QUEUES];
+}
+
+static inline BOOL compare_addr( const void *addr, const void *cmp, SIZE_T size )
+{
+    switch (size)
+    {
+    case 1: return *(const volatile BYTE *)addr == *(const BYTE *)cmp;
+    case 2: return *(const volatile WORD *)addr == *(const WORD *)cmp;
+    case 4: return *(const volatile DWORD *)addr == *(const DWORD *)cmp;
+    case 8: return *(const volatile DWORD64 *)addr == *(const DWORD64 *)cmp;
+    }
+    return FALSE;
+}
+
+#ifdef __linux__
+
+/* with futexes each queue is a wakeup sequence number */
+static NTSTATUS fast_wait_addr( const void *addr, const void *cmp, SIZE_T size,
+                                const LARGE_INTEGER *timeout )
+{
+    int *futex = get_addr_wait_queue( addr );
+    int val, spin;
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    /* the sequence number must be sampled before checking the value, so that
+     * a wakeup coming in between makes the futex wait return immediately */
+    val = interlocked_cmpxchg( futex, 0, 0 );
+    for (spin = spinning_allowed() ? SYNC_SPIN_COUNT : 0; spin > 0; spin--)
+    {
+        if (!compare_addr( addr, cmp, size )) return STATUS_SUCCESS;
+        small_pause();
+    }
+    if (!compare_addr( addr, cmp, size )) return STATUS_SUCCESS;
+    return futex_wait_timeout( futex, val, timeout );
+}
+
+static NTSTATUS fast_wake_addr( const void *addr )
+{
+    int *futex = get_addr_wait_queue( addr );
+
+    if (!use_futexes()) return STATUS_NOT_IMPLEMENTED;
+
+    interlocked_xchg_add( futex, 1 );
+    futex_wake( futex, INT_MAX );
+    return STATUS_SUCCESS;
+}
+
+#else
+
+static NTSTATUS fast_wait_addr( const void *addr, const void *cmp, SIZE_T size,
+                                const LARGE_INTEGER *timeout )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+static NTSTATUS fast_wake_addr( const void *addr )
+{
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+#endif  /* __linux__ */
+
+/***********************************************************************
+ *           RtlWaitOnAddress   (NTDLL.@)
+ *
+ * Waits until the value at addr differs from the one at cmp, or until
+ * RtlWakeAddressSingle/All is called for addr.
+ */
+NTSTATUS WINAPI RtlWaitOnAddress( const void *addr, const void *cmp, SIZE_T size,
+                                  const LARGE_INTEGER *timeout )
+{
+    int *queue;
+    NTSTATUS status;
+
+    if (size != 1 && size != 2 && size != 4 && size != 8)
+        return STATUS_INVALID_PARAMETER;
+
+    if ((status = fast_wait_addr( addr, cmp, size, timeout )) != STATUS_NOT_IMPLEMENTED)
+        return status;
+
+    /* with keyed events each queue counts its waiters */
+    queue = get_addr_wait_queue( addr );
+    RtlEnterCriticalSection( &addr_section );
+    if (!compare_addr( addr, cmp, size ))
+    {
+        RtlLeaveCriticalSection( &addr_section );
+        return STATUS_SUCCESS;
+    }
+    (*queue)++;
+    RtlLeaveCriticalSection( &addr_section );
+
+    status = NtWaitForKeyedEvent( keyed_event, queue, FALSE, timeout );
+    if (status != STATUS_SUCCESS)
+    {
+        RtlEnterCriticalSection( &addr_section );
+        if (*queue)
+        {
+            (*queue)--;
+            RtlLeaveCriticalSection( &addr_section );
+        }
+        else  /* a waker already committed to releasing us */
+        {
+            RtlLeaveCriticalSection( &addr_section );
+            status = NtWaitForKeyedEvent( keyed_event, queue, FALSE, NULL );
+        }
+    }
+    return status;
+}
+
+/***********************************************************************
+ *           RtlWakeAddressAll   (NTDLL.@)
+ */
+void WINAPI RtlWakeAddressAll( const void *addr )
+{
+    int *queue;
+    int count;
+
+    if (fast_wake_addr( addr ) != STATUS_NOT_IMPLEMENTED) return;
+
+    queue = get_addr_wait_queue( addr );
+    RtlEnterCriticalSection( &addr_section );
+    count = *queue;
+    *queue = 0;
+    RtlLeaveCriticalSection( &addr_section );
+
+    while (count-- > 0) NtReleaseKeyedEvent( keyed_event, queue, FALSE, NULL );
+}
+
+/***********************************************************************
+ *           RtlWakeAddressSingle   (NTDLL.@)
+ *
+ * NOTES
+ *  Since the wait queues are shared between addresses, this wakes all the
+ *  threads of the queue to make sure that a waiter of addr gets woken.
+ */
+void WINAPI RtlWakeAddressSingle( const void *addr )
+{
+    RtlWakeAddressAll( addr );
+}
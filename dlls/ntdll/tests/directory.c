@@ -371,6 +371,82 @@ done:
     pRtlFreeUnicodeString(&ntdirname);
 }
 
+#define LOOKUP_DIR_FILES 50000
+#define LOOKUP_COUNT     10000
+
+static void test_case_insensitive_lookup(void)
+{
+    char testdir[MAX_PATH], buf[MAX_PATH];
+    unsigned int i, created, found = 0;
+    DWORD start, create_time, lookup_time;
+    HANDLE h;
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+
+    ok(GetTempPathA(MAX_PATH, testdir), "couldn't get temp dir\n");
+    strcat(testdir, "lookup.tmp");
+    if (!CreateDirectoryA(testdir, NULL))
+    {
+        skip("couldn't create dir '%s', error %d\n", testdir, GetLastError());
+        return;
+    }
+
+    start = GetTickCount();
+    for (created = 0; created < LOOKUP_DIR_FILES; created++)
+    {
+        sprintf(buf, "%s\\File%05u.Dat", testdir, created);
+        h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+        if (h == INVALID_HANDLE_VALUE) break;
+        CloseHandle(h);
+    }
+    create_time = GetTickCount() - start;
+    ok(created == LOOKUP_DIR_FILES, "created only %u files, error %d\n", created, GetLastError());
+
+    start = GetTickCount();
+    for (i = 0; i < LOOKUP_COUNT; i++)
+    {
+        unsigned int index = (i * 7919) % created;
+        sprintf(buf, (i & 1) ? "%s\\FILE%05u.DAT" : "%s\\file%05u.dat", testdir, index);
+        h = CreateFileA(buf, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0);
+        if (h == INVALID_HANDLE_VALUE) continue;
+        found++;
+        CloseHandle(h);
+    }
+    lookup_time = GetTickCount() - start;
+    ok(found == LOOKUP_COUNT, "found only %u files\n", found);
+
+    sprintf(buf, "%s\\NOT_THERE.DAT", testdir);
+    SetLastError(0xdeadbeef);
+    h = CreateFileA(buf, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0);
+    ok(h == INVALID_HANDLE_VALUE, "opened nonexistent file\n");
+    ok(GetLastError() == ERROR_FILE_NOT_FOUND, "wrong error %d\n", GetLastError());
+
+    /* files created after the lookups must be found too */
+    sprintf(buf, "%s\\Late.Dat", testdir);
+    h = CreateFileA(buf, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, 0);
+    ok(h != INVALID_HANDLE_VALUE, "failed to create '%s'\n", buf);
+    CloseHandle(h);
+    sprintf(buf, "%s\\LATE.DAT", testdir);
+    h = CreateFileA(buf, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, 0);
+    ok(h != INVALID_HANDLE_VALUE, "failed to open '%s', error %d\n", buf, GetLastError());
+    CloseHandle(h);
+    ok(DeleteFileA(buf), "failed to delete '%s', error %d\n", buf, GetLastError());
+
+    trace("created %u files in %u ms, %u mixed-case opens in %u ms\n",
+          created, create_time, LOOKUP_COUNT, lookup_time);
+
+    for (i = 0; i < created; i++)
+    {
+        sprintf(buf, "%s\\File%05u.Dat", testdir, i);
+        DeleteFileA(buf);
+    }
+    RemoveDirectoryA(testdir);
+}
+
 static void test_redirection(void)
 {
     ULONG old, cur;
@@ -441,5 +517,6 @@ START_TEST(directory)
 
     test_NtQueryDirectoryFile();
     test_NtQueryDirectoryFile_case();
+    test_case_insensitive_lookup();
     test_redirection();
 }
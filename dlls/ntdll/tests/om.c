@@ -55,6 +55,9 @@ static NTSTATUS (WINAPI *pNtOpenKeyedEvent)( HANDLE *, ACCESS_MASK, const OBJECT
 static NTSTATUS (WINAPI *pNtWaitForKeyedEvent)( HANDLE, const void *, BOOLEAN, const LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtReleaseKeyedEvent)( HANDLE, const void *, BOOLEAN, const LARGE_INTEGER * );
 static NTSTATUS (WINAPI *pNtCreateIoCompletion)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES, ULONG);
+static NTSTATUS (WINAPI *pNtReleaseMutant)( HANDLE, PLONG );
+static NTSTATUS (WINAPI *pNtWaitForSingleObject)( HANDLE, BOOLEAN, const LARGE_INTEGER * );
+static NTSTATUS (WINAPI *pNtWaitForMultipleObjects)( ULONG, const HANDLE *, BOOLEAN, BOOLEAN, const LARGE_INTEGER * );
 
 #define KEYEDEVENT_WAIT       0x0001
 #define KEYEDEVENT_WAKE       0x0002
@@ -1099,6 +1102,190 @@ static void test_keyed_events(void)
     NtClose( event );
 }
 
+static DWORD WINAPI abandon_mutex_thread( void *arg )
+{
+    DWORD ret = WaitForSingleObject( arg, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    return 0;
+}
+
+static DWORD WINAPI close_owned_mutex_thread( void *arg )
+{
+    HANDLE mutex, mutex2;
+    DWORD ret;
+
+    mutex = CreateMutexA( NULL, FALSE, NULL );
+    mutex2 = CreateMutexA( NULL, FALSE, NULL );
+    ret = WaitForSingleObject( mutex, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( mutex2, 0 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( mutex );
+    ret = ReleaseMutex( mutex2 );
+    ok( ret, "ReleaseMutex failed %u\n", GetLastError() );
+    CloseHandle( mutex2 );
+    return 0;
+}
+
+static DWORD WINAPI ping_pong_thread( void *arg )
+{
+    HANDLE *events = arg;
+    DWORD ret;
+
+    for (;;)
+    {
+        ret = WaitForSingleObject( events[0], INFINITE );
+        ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+        if (!events[2]) break;
+        SetEvent( events[1] );
+    }
+    return 0;
+}
+
+static void test_wait_objects(void)
+{
+    HANDLE event, event2, sem, mutex, thread, events[2];
+    LARGE_INTEGER timeout;
+    ULONG prev;
+    LONG count;
+    NTSTATUS status;
+    DWORD ret, i;
+
+    timeout.QuadPart = 0;
+
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, TRUE );
+    ok( !status, "NtCreateEvent failed %08x\n", status );
+    status = pNtCreateEvent( &event2, EVENT_ALL_ACCESS, NULL, NotificationEvent, TRUE );
+    ok( !status, "NtCreateEvent failed %08x\n", status );
+
+    events[0] = event2;
+    events[1] = event;
+    status = pNtWaitForMultipleObjects( 2, events, WaitAny, FALSE, &timeout );
+    ok( status == STATUS_WAIT_0, "NtWaitForMultipleObjects returned %08x\n", status );
+    status = pNtWaitForSingleObject( event2, FALSE, &timeout );
+    ok( status == STATUS_WAIT_0, "NtWaitForSingleObject returned %08x\n", status );
+    status = pNtWaitForSingleObject( event, FALSE, &timeout );
+    ok( status == STATUS_WAIT_0, "NtWaitForSingleObject returned %08x\n", status );
+    status = pNtWaitForSingleObject( event, FALSE, &timeout );
+    ok( status == STATUS_TIMEOUT, "NtWaitForSingleObject returned %08x\n", status );
+    status = pNtPulseEvent( event2, NULL );
+    ok( !status, "NtPulseEvent failed %08x\n", status );
+    status = pNtWaitForSingleObject( event2, FALSE, &timeout );
+    ok( status == STATUS_TIMEOUT, "NtWaitForSingleObject returned %08x\n", status );
+
+    status = pNtCreateSemaphore( &sem, SEMAPHORE_ALL_ACCESS, NULL, 2, 2 );
+    ok( !status, "NtCreateSemaphore failed %08x\n", status );
+    status = pNtReleaseSemaphore( sem, 1, &prev );
+    ok( status == STATUS_SEMAPHORE_LIMIT_EXCEEDED, "NtReleaseSemaphore returned %08x\n", status );
+    for (i = 0; i < 2; i++)
+    {
+        status = pNtWaitForSingleObject( sem, FALSE, &timeout );
+        ok( status == STATUS_WAIT_0, "%u: NtWaitForSingleObject returned %08x\n", i, status );
+    }
+    status = pNtWaitForSingleObject( sem, FALSE, &timeout );
+    ok( status == STATUS_TIMEOUT, "NtWaitForSingleObject returned %08x\n", status );
+    prev = 0xdeadbeef;
+    status = pNtReleaseSemaphore( sem, 1, &prev );
+    ok( !status, "NtReleaseSemaphore failed %08x\n", status );
+    ok( prev == 0, "got previous count %u\n", prev );
+
+    status = pNtCreateMutant( &mutex, MUTANT_ALL_ACCESS, NULL, FALSE );
+    ok( !status, "NtCreateMutant failed %08x\n", status );
+    for (i = 0; i < 3; i++)
+    {
+        status = pNtWaitForSingleObject( mutex, FALSE, &timeout );
+        ok( status == STATUS_WAIT_0, "%u: NtWaitForSingleObject returned %08x\n", i, status );
+    }
+    for (i = 0; i < 3; i++)
+    {
+        count = 0xdeadbeef;
+        status = pNtReleaseMutant( mutex, &count );
+        ok( !status, "%u: NtReleaseMutant failed %08x\n", i, status );
+        ok( count == 3 - i, "%u: got previous count %d\n", i, count );
+    }
+    status = pNtReleaseMutant( mutex, NULL );
+    ok( status == STATUS_MUTANT_NOT_OWNED, "NtReleaseMutant returned %08x\n", status );
+
+    /* the mutex is abandoned when the owner thread exits */
+    thread = CreateThread( NULL, 0, abandon_mutex_thread, mutex, 0, NULL );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( thread );
+    status = pNtWaitForSingleObject( mutex, FALSE, &timeout );
+    ok( status == STATUS_ABANDONED_WAIT_0, "NtWaitForSingleObject returned %08x\n", status );
+    status = pNtReleaseMutant( mutex, NULL );
+    ok( !status, "NtReleaseMutant failed %08x\n", status );
+
+    /* the owner closes its last handle while owning it */
+    thread = CreateThread( NULL, 0, close_owned_mutex_thread, NULL, 0, NULL );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( thread );
+    for (i = 0; i < 2; i++)
+    {
+        status = pNtWaitForSingleObject( mutex, FALSE, &timeout );
+        ok( status == STATUS_WAIT_0, "%u: NtWaitForSingleObject returned %08x\n", i, status );
+    }
+    for (i = 0; i < 2; i++)
+    {
+        status = pNtReleaseMutant( mutex, NULL );
+        ok( !status, "%u: NtReleaseMutant failed %08x\n", i, status );
+    }
+
+    pNtClose( mutex );
+    pNtClose( sem );
+    pNtClose( event2 );
+    pNtClose( event );
+}
+
+static void test_wait_performance(void)
+{
+    HANDLE event, thread, events[3];
+    DWORD ret, i, start, elapsed;
+
+    if (!winetest_interactive)
+    {
+        skip( "performance tests, set WINETEST_INTERACTIVE=1 to run them\n" );
+        return;
+    }
+
+    /* signal back and forth with another thread, reporting the wait rate */
+    events[0] = CreateEventA( NULL, FALSE, FALSE, NULL );
+    events[1] = CreateEventA( NULL, FALSE, FALSE, NULL );
+    events[2] = (HANDLE)1;
+    thread = CreateThread( NULL, 0, ping_pong_thread, events, 0, NULL );
+    start = GetTickCount();
+    for (i = 0; i < 10000; i++)
+    {
+        SetEvent( events[0] );
+        ret = WaitForSingleObject( events[1], 5000 );
+        ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+        if (ret) break;
+    }
+    elapsed = GetTickCount() - start;
+    trace( "%u waits in %u ms (%u waits/s)\n", 2 * i, elapsed, elapsed ? 2000 * i / elapsed : 0 );
+    events[2] = NULL;
+    SetEvent( events[0] );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( thread );
+
+    /* uncontended waits only */
+    event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    start = GetTickCount();
+    for (i = 0; i < 100000; i++)
+    {
+        SetEvent( event );
+        WaitForSingleObject( event, 0 );
+    }
+    elapsed = GetTickCount() - start;
+    trace( "%u uncontended waits in %u ms\n", i, elapsed );
+
+    CloseHandle( event );
+    CloseHandle( events[0] );
+    CloseHandle( events[1] );
+}
+
 static void test_null_device(void)
 {
     OBJECT_ATTRIBUTES attr;
@@ -1230,6 +1417,9 @@ START_TEST(om)
     pNtWaitForKeyedEvent    =  (void *)GetProcAddress(hntdll, "NtWaitForKeyedEvent");
     pNtReleaseKeyedEvent    =  (void *)GetProcAddress(hntdll, "NtReleaseKeyedEvent");
     pNtCreateIoCompletion   =  (void *)GetProcAddress(hntdll, "NtCreateIoCompletion");
+    pNtReleaseMutant        =  (void *)GetProcAddress(hntdll, "NtReleaseMutant");
+    pNtWaitForSingleObject  =  (void *)GetProcAddress(hntdll, "NtWaitForSingleObject");
+    pNtWaitForMultipleObjects = (void *)GetProcAddress(hntdll, "NtWaitForMultipleObjects");
 
     test_case_sensitive();
     test_namespace_pipe();
@@ -1240,5 +1430,7 @@ START_TEST(om)
     test_type_mismatch();
     test_event();
     test_keyed_events();
+    test_wait_objects();
+    test_wait_performance();
     test_null_device();
 }
@@ -19,6 +19,7 @@
  */
 
 #include "ntdll_test.h"
+#include "tlhelp32.h"
 
 static HMODULE hntdll = 0;
 static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
@@ -143,6 +144,158 @@ static void test_RtlQueueWorkItem(void)
     CloseHandle(semaphore);
 }
 
+struct rtl_wait_info
+{
+    HANDLE semaphore;
+    LONG   signaled;
+    LONG   timeouts;
+};
+
+static void CALLBACK rtl_wait_cb(void *userdata, BOOLEAN timeout)
+{
+    struct rtl_wait_info *info = userdata;
+    trace("Running rtl_wait callback\n");
+    if (timeout)
+        InterlockedIncrement(&info->timeouts);
+    else
+        InterlockedIncrement(&info->signaled);
+    ReleaseSemaphore(info->semaphore, 1, NULL);
+}
+
+static void CALLBACK rtl_wait_apc_cb(ULONG_PTR userdata)
+{
+    HANDLE semaphore = (HANDLE)userdata;
+    trace("Running rtl_wait APC\n");
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+static void CALLBACK rtl_wait_io_cb(void *userdata, BOOLEAN timeout)
+{
+    struct rtl_wait_info *info = userdata;
+    trace("Running rtl_wait I/O callback\n");
+    if (timeout)
+        InterlockedIncrement(&info->timeouts);
+    else
+        InterlockedIncrement(&info->signaled);
+    /* I/O threads wait alertably, so the APC runs after we return */
+    QueueUserAPC(rtl_wait_apc_cb, GetCurrentThread(), (ULONG_PTR)info->semaphore);
+}
+
+static void test_RtlRegisterWait(void)
+{
+    struct rtl_wait_info info;
+    HANDLE semaphore, event;
+    NTSTATUS status;
+    HANDLE wait;
+    DWORD result;
+
+    semaphore = CreateSemaphoreA(NULL, 0, 3, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+    event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    ok(event != NULL, "CreateEventA failed %u\n", GetLastError());
+    info.semaphore = CreateSemaphoreA(NULL, 0, 10, NULL);
+    ok(info.semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+
+    /* wait objects without WT_EXECUTEONLYONCE keep waiting */
+    info.signaled = info.timeouts = 0;
+    wait = NULL;
+    status = RtlRegisterWait(&wait, semaphore, rtl_wait_cb, &info, INFINITE, WT_EXECUTEDEFAULT);
+    ok(!status, "RtlRegisterWait failed with status %x\n", status);
+    ok(wait != NULL, "expected wait != NULL\n");
+    ReleaseSemaphore(semaphore, 1, NULL);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ReleaseSemaphore(semaphore, 2, NULL);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    status = RtlDeregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    ok(!status, "RtlDeregisterWaitEx failed with status %x\n", status);
+    ok(info.signaled == 3, "expected info.signaled = 3, got %u\n", info.signaled);
+    ok(info.timeouts == 0, "expected info.timeouts = 0, got %u\n", info.timeouts);
+
+    /* timeouts are rearmed as well */
+    info.signaled = info.timeouts = 0;
+    wait = NULL;
+    status = RtlRegisterWait(&wait, semaphore, rtl_wait_cb, &info, 50, WT_EXECUTEDEFAULT);
+    ok(!status, "RtlRegisterWait failed with status %x\n", status);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    status = RtlDeregisterWaitEx(wait, event);
+    ok(!status || status == STATUS_PENDING, "RtlDeregisterWaitEx failed with status %x\n", status);
+    result = WaitForSingleObject(event, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    ok(info.signaled == 0, "expected info.signaled = 0, got %u\n", info.signaled);
+    ok(info.timeouts >= 2, "expected info.timeouts >= 2, got %u\n", info.timeouts);
+
+    /* WT_EXECUTEONLYONCE wait objects are only signaled once */
+    while (WaitForSingleObject(info.semaphore, 0) == WAIT_OBJECT_0);
+    info.signaled = info.timeouts = 0;
+    wait = NULL;
+    status = RtlRegisterWait(&wait, semaphore, rtl_wait_cb, &info, INFINITE, WT_EXECUTEONLYONCE);
+    ok(!status, "RtlRegisterWait failed with status %x\n", status);
+    ReleaseSemaphore(semaphore, 2, NULL);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    result = WaitForSingleObject(info.semaphore, 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result);
+    status = RtlDeregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    ok(!status, "RtlDeregisterWaitEx failed with status %x\n", status);
+    ok(info.signaled == 1, "expected info.signaled = 1, got %u\n", info.signaled);
+    result = WaitForSingleObject(semaphore, 0);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+
+    /* a persistent wait with a zero timeout keeps calling back */
+    while (WaitForSingleObject(info.semaphore, 0) == WAIT_OBJECT_0);
+    info.signaled = info.timeouts = 0;
+    wait = NULL;
+    status = RtlRegisterWait(&wait, semaphore, rtl_wait_cb, &info, 0, WT_EXECUTEDEFAULT);
+    ok(!status, "RtlRegisterWait failed with status %x\n", status);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    status = RtlDeregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    ok(!status, "RtlDeregisterWaitEx failed with status %x\n", status);
+    ok(info.timeouts >= 2, "expected info.timeouts >= 2, got %u\n", info.timeouts);
+    ok(info.signaled == 0, "expected info.signaled = 0, got %u\n", info.signaled);
+
+    /* a zero timeout still reports a signaled object */
+    while (WaitForSingleObject(info.semaphore, 0) == WAIT_OBJECT_0);
+    info.signaled = info.timeouts = 0;
+    wait = NULL;
+    ReleaseSemaphore(semaphore, 1, NULL);
+    status = RtlRegisterWait(&wait, semaphore, rtl_wait_cb, &info, 0, WT_EXECUTEONLYONCE);
+    ok(!status, "RtlRegisterWait failed with status %x\n", status);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    status = RtlDeregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    ok(!status, "RtlDeregisterWaitEx failed with status %x\n", status);
+    ok(info.signaled == 1, "expected info.signaled = 1, got %u\n", info.signaled);
+    ok(info.timeouts == 0, "expected info.timeouts = 0, got %u\n", info.timeouts);
+
+    /* WT_EXECUTEINIOTHREAD callbacks run in an alertable thread */
+    while (WaitForSingleObject(info.semaphore, 0) == WAIT_OBJECT_0);
+    info.signaled = info.timeouts = 0;
+    wait = NULL;
+    status = RtlRegisterWait(&wait, semaphore, rtl_wait_io_cb, &info, INFINITE,
+                             WT_EXECUTEINIOTHREAD | WT_EXECUTEONLYONCE);
+    ok(!status, "RtlRegisterWait failed with status %x\n", status);
+    ReleaseSemaphore(semaphore, 1, NULL);
+    result = WaitForSingleObject(info.semaphore, 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+    status = RtlDeregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    ok(!status, "RtlDeregisterWaitEx failed with status %x\n", status);
+    ok(info.signaled == 1, "expected info.signaled = 1, got %u\n", info.signaled);
+
+    CloseHandle(info.semaphore);
+    CloseHandle(event);
+    CloseHandle(semaphore);
+}
+
 static void CALLBACK simple_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
 {
     HANDLE semaphore = userdata;
@@ -376,6 +529,241 @@ static void test_tp_work_scheduler(void)
     pTpReleasePool(pool);
 }
 
+static TP_WORK *nested_work;
+
+static void CALLBACK nested_work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void CALLBACK nested_fanout_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    LONG count = *(LONG *)userdata;
+    int i;
+
+    for (i = 0; i < count; i++)
+        pTpPostWork(nested_work);
+}
+
+static void CALLBACK nested_wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    int i;
+
+    for (i = 0; i < 10; i++)
+        pTpPostWork(nested_work);
+    pTpWaitForWork(nested_work, FALSE);
+    InterlockedIncrement((LONG *)userdata);
+}
+
+static void test_tp_work_nested(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    LONG userdata, userdata2, count;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    int i;
+
+    /* allocate new threadpool */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    nested_work = NULL;
+    status = pTpAllocWork(&nested_work, nested_work_cb, &userdata, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(nested_work != NULL, "expected nested_work != NULL\n");
+
+    /* work items posted from callbacks */
+    work = NULL;
+    status = pTpAllocWork(&work, nested_fanout_cb, &count, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    userdata = 0;
+    count = 100;
+    for (i = 0; i < 10; i++)
+        pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    pTpWaitForWork(nested_work, FALSE);
+    ok(userdata == 1000, "expected userdata = 1000, got %u\n", userdata);
+    pTpReleaseWork(work);
+
+    /* waiting for work items posted from a callback */
+    work = NULL;
+    status = pTpAllocWork(&work, nested_wait_cb, &userdata2, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    ok(work != NULL, "expected work != NULL\n");
+
+    userdata = userdata2 = 0;
+    pTpPostWork(work);
+    pTpWaitForWork(work, FALSE);
+    ok(userdata2 == 1, "expected userdata2 = 1, got %u\n", userdata2);
+    ok(userdata == 10, "expected userdata = 10, got %u\n", userdata);
+    pTpReleaseWork(work);
+
+    /* cleanup */
+    pTpReleaseWork(nested_work);
+    pTpReleasePool(pool);
+}
+
+struct idle_timeout_info
+{
+    HANDLE started;
+    HANDLE signal;
+    DWORD  result;
+};
+
+static void CALLBACK idle_timeout_wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    struct idle_timeout_info *info = userdata;
+    SetEvent(info->started);
+    info->result = WaitForSingleObject(info->signal, 1000);
+}
+
+static void CALLBACK idle_timeout_signal_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    struct idle_timeout_info *info = userdata;
+    SetEvent(info->signal);
+}
+
+static void test_tp_work_idle_timeout(void)
+{
+    /* around the idle timeout of the worker threads in Wine */
+    static const int delays[] = { 4990, 5000, 5010 };
+    TP_WORK *warmup_work, *wait_work, *signal_work;
+    TP_CALLBACK_ENVIRON environment;
+    struct idle_timeout_info info;
+    NTSTATUS status;
+    TP_POOL *pool;
+    LONG userdata;
+    int i;
+
+    /* allocate new threadpool with two workers */
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %x\n", status);
+    ok(pool != NULL, "expected pool != NULL\n");
+    pTpSetPoolMaxThreads(pool, 2);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    warmup_work = wait_work = signal_work = NULL;
+    status = pTpAllocWork(&warmup_work, work_cb, &userdata, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    status = pTpAllocWork(&wait_work, idle_timeout_wait_cb, &info, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+    status = pTpAllocWork(&signal_work, idle_timeout_signal_cb, &info, &environment);
+    ok(!status, "TpAllocWork failed with status %x\n", status);
+
+    info.started = CreateEventA(NULL, FALSE, FALSE, NULL);
+    info.signal = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+    for (i = 0; i < sizeof(delays) / sizeof(delays[0]); i++)
+    {
+        /* let both workers become idle at the same time */
+        userdata = 0;
+        pTpPostWork(warmup_work);
+        pTpPostWork(warmup_work);
+        pTpWaitForWork(warmup_work, FALSE);
+        ok(userdata == 2, "expected userdata = 2, got %u\n", userdata);
+        Sleep(delays[i] - 10);
+
+        /* one worker blocks on work submitted while the other one times out */
+        info.result = WAIT_FAILED;
+        pTpPostWork(wait_work);
+        WaitForSingleObject(info.started, 1000);
+        pTpPostWork(signal_work);
+        pTpWaitForWork(wait_work, FALSE);
+        ok(info.result == WAIT_OBJECT_0, "%u: WaitForSingleObject returned %u\n", delays[i], info.result);
+        pTpWaitForWork(signal_work, FALSE);
+    }
+
+    /* cleanup */
+    pTpReleaseWork(warmup_work);
+    pTpReleaseWork(wait_work);
+    pTpReleaseWork(signal_work);
+    pTpReleasePool(pool);
+    CloseHandle(info.started);
+    CloseHandle(info.signal);
+}
+
+static void test_tp_work_performance(void)
+{
+    static const DWORD thread_counts[] = {1, 2, 4, 8, 16};
+    TP_CALLBACK_ENVIRON environment;
+    LARGE_INTEGER freq, start, end;
+    LONG userdata, count;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    double seconds;
+    int i, j;
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&freq);
+
+    for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+    {
+        pool = NULL;
+        status = pTpAllocPool(&pool, NULL);
+        ok(!status, "TpAllocPool failed with status %x\n", status);
+        pTpSetPoolMaxThreads(pool, thread_counts[i]);
+
+        memset(&environment, 0, sizeof(environment));
+        environment.Version = 1;
+        environment.Pool = pool;
+
+        /* 10M tiny work items posted from the main thread */
+        nested_work = NULL;
+        status = pTpAllocWork(&nested_work, nested_work_cb, &userdata, &environment);
+        ok(!status, "TpAllocWork failed with status %x\n", status);
+
+        userdata = 0;
+        QueryPerformanceCounter(&start);
+        for (j = 0; j < 10000000; j++)
+            pTpPostWork(nested_work);
+        pTpWaitForWork(nested_work, FALSE);
+        QueryPerformanceCounter(&end);
+        ok(userdata == 10000000, "expected userdata = 10000000, got %u\n", userdata);
+        seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+        trace("%u workers: %.0f external work items/s\n", thread_counts[i], userdata / seconds);
+
+        /* 10M tiny work items posted from callbacks */
+        work = NULL;
+        status = pTpAllocWork(&work, nested_fanout_cb, &count, &environment);
+        ok(!status, "TpAllocWork failed with status %x\n", status);
+
+        userdata = 0;
+        count = 10000;
+        QueryPerformanceCounter(&start);
+        for (j = 0; j < 1000; j++)
+            pTpPostWork(work);
+        pTpWaitForWork(work, FALSE);
+        pTpWaitForWork(nested_work, FALSE);
+        QueryPerformanceCounter(&end);
+        ok(userdata == 10000000, "expected userdata = 10000000, got %u\n", userdata);
+        seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+        trace("%u workers: %.0f nested work items/s\n", thread_counts[i], userdata / seconds);
+
+        pTpReleaseWork(work);
+        pTpReleaseWork(nested_work);
+        pTpReleasePool(pool);
+    }
+}
+
 static DWORD group_cancel_tid;
 
 static void CALLBACK group_cancel_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
@@ -1335,9 +1723,113 @@ static void test_tp_multi_wait(void)
     CloseHandle(semaphore);
 }
 
+static DWORD get_thread_count(void)
+{
+    THREADENTRY32 entry;
+    DWORD count = 0;
+    HANDLE snapshot;
+
+    snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE)
+        return 0;
+
+    entry.dwSize = sizeof(entry);
+    if (Thread32First(snapshot, &entry))
+    {
+        do
+        {
+            if (entry.th32OwnerProcessID == GetCurrentProcessId())
+                count++;
+        }
+        while (Thread32Next(snapshot, &entry));
+    }
+
+    CloseHandle(snapshot);
+    return count;
+}
+
+static LARGE_INTEGER rtl_wait_perf_end;
+
+static void CALLBACK rtl_wait_perf_cb(void *userdata, BOOLEAN timeout)
+{
+    QueryPerformanceCounter(&rtl_wait_perf_end);
+    ReleaseSemaphore(userdata, 1, NULL);
+}
+
+static void test_RtlRegisterWait_performance(void)
+{
+    static const DWORD num_waits = 20000;
+    LARGE_INTEGER freq, start, end;
+    HANDLE *events, *waits;
+    DWORD i, result, threads;
+    double seconds, latency;
+    HANDLE semaphore;
+    NTSTATUS status;
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+
+    semaphore = CreateSemaphoreA(NULL, 0, 1, NULL);
+    ok(semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError());
+    events = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, num_waits * sizeof(*events));
+    waits = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, num_waits * sizeof(*waits));
+    ok(events && waits, "HeapAlloc failed\n");
+
+    threads = get_thread_count();
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < num_waits; i++)
+    {
+        events[i] = CreateEventA(NULL, FALSE, FALSE, NULL);
+        ok(events[i] != NULL, "CreateEventA failed %u\n", GetLastError());
+        status = RtlRegisterWait(&waits[i], events[i], rtl_wait_perf_cb, semaphore,
+                                 INFINITE, WT_EXECUTEDEFAULT);
+        ok(!status, "RtlRegisterWait failed with status %x\n", status);
+        if (status) break;
+    }
+    QueryPerformanceCounter(&end);
+    seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+    trace("registered %u waits in %.3f s, %u threads before, %u threads after\n",
+          i, seconds, threads, get_thread_count());
+
+    /* signal-to-callback latency, spread over all wait threads */
+    latency = 0.0;
+    for (i = 0; i < 1000; i++)
+    {
+        QueryPerformanceCounter(&start);
+        SetEvent(events[(i * 7919) % num_waits]);
+        result = WaitForSingleObject(semaphore, 1000);
+        ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result);
+        latency += (double)(rtl_wait_perf_end.QuadPart - start.QuadPart) / freq.QuadPart;
+    }
+    trace("average signal-to-callback latency %.1f us\n", latency * 1000000.0 / 1000);
+
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < num_waits; i++)
+    {
+        if (waits[i])
+        {
+            status = RtlDeregisterWaitEx(waits[i], INVALID_HANDLE_VALUE);
+            ok(!status, "RtlDeregisterWaitEx failed with status %x\n", status);
+        }
+        CloseHandle(events[i]);
+    }
+    QueryPerformanceCounter(&end);
+    seconds = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+    trace("deregistered %u waits in %.3f s\n", num_waits, seconds);
+
+    HeapFree(GetProcessHeap(), 0, events);
+    HeapFree(GetProcessHeap(), 0, waits);
+    CloseHandle(semaphore);
+}
+
 START_TEST(threadpool)
 {
     test_RtlQueueWorkItem();
+    test_RtlRegisterWait();
 
     if (!init_threadpool())
         return;
@@ -1345,6 +1837,8 @@ START_TEST(threadpool)
     test_tp_simple();
     test_tp_work();
     test_tp_work_scheduler();
+    test_tp_work_nested();
+    test_tp_work_idle_timeout();
     test_tp_group_cancel();
     test_tp_instance();
     test_tp_disassociate();
@@ -1352,4 +1846,6 @@ START_TEST(threadpool)
     test_tp_window_length();
     test_tp_wait();
     test_tp_multi_wait();
+    test_tp_work_performance();
+    test_RtlRegisterWait_performance();
 }
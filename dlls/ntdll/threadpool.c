@@ -46,6 +46,7 @@ struct rtl_work_item
 {
     PRTL_WORK_ITEM_ROUTINE function;
     PVOID context;
+    HANDLE token;
 };
 
 #define EXPIRE_NEVER       (~(ULONGLONG)0)
@@ -57,11 +58,13 @@ static struct
 {
     HANDLE                  compl_port;
     RTL_CRITICAL_SECTION    threadpool_compl_cs;
+    HANDLE                  io_thread;
 }
 old_threadpool =
 {
     NULL,                                       /* compl_port */
     { &critsect_compl_debug, -1, 0, 0, 0, 0 },  /* threadpool_compl_cs */
+    NULL,                                       /* io_thread */
 };
 
 static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
@@ -71,19 +74,6 @@ static RTL_CRITICAL_SECTION_DEBUG critsect_compl_debug =
       0, 0, { (DWORD_PTR)(__FILE__ ": threadpool_compl_cs") }
 };
 
-struct wait_work_item
-{
-    HANDLE Object;
-    HANDLE CancelEvent;
-    WAITORTIMERCALLBACK Callback;
-    PVOID Context;
-    ULONG Milliseconds;
-    ULONG Flags;
-    HANDLE CompletionEvent;
-    LONG DeleteCount;
-    BOOLEAN CallbackInProgress;
-};
-
 struct timer_queue;
 struct queue_timer
 {
@@ -114,8 +104,16 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_SPIN_COUNT 4000
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* queue of objects with pending callbacks */
+struct threadpool_queue
+{
+    RTL_SRWLOCK             lock;
+    struct list             objects;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -123,14 +121,33 @@ struct threadpool
     LONG                    objcount;
     BOOL                    shutdown;
     CRITICAL_SECTION        cs;
-    /* pool of work items, locked via .cs */
-    struct list             pool;
+    /* objects submitted from outside of the pool */
+    struct threadpool_queue queue;
+    /* number of objects in all queues, interlocked */
+    LONG                    num_queued;
+    /* list of worker threads, locked via .workers_lock */
+    RTL_SRWLOCK             workers_lock;
+    struct list             workers;
     RTL_CONDITION_VARIABLE  update_event;
     /* information about worker threads, locked via .cs */
     int                     max_workers;
     int                     min_workers;
     int                     num_workers;
-    int                     num_busy_workers;
+    /* worker thread states, interlocked */
+    LONG                    num_busy_workers;
+    LONG                    num_blocked_workers;
+    LONG                    num_spinning_workers;
+    LONG                    num_sleeping_workers;
+};
+
+/* internal threadpool worker representation */
+struct threadpool_worker
+{
+    struct list             entry;
+    struct threadpool       *pool;
+    /* objects submitted by callbacks running on this worker. The owner
+     * takes objects from the head, other workers steal from the tail. */
+    struct threadpool_queue queue;
 };
 
 enum threadpool_objtype
@@ -155,13 +172,19 @@ struct threadpool_object
     PTP_SIMPLE_CALLBACK     finalization_callback;
     BOOL                    may_run_long;
     HMODULE                 race_dll;
+    /* event signaled when the object is destroyed */
+    HANDLE                  completed_event;
     /* information about the group, locked via .group->cs */
     struct list             group_entry;
     BOOL                    is_group_member;
-    /* information about the pool, locked via .pool->cs */
+    /* information about the pool, locked via the lock of the queue */
     struct list             pool_entry;
+    /* callback counters, interlocked. Waiting for them to drop to zero
+     * is synchronized via .pool->cs. */
+    LONG                    queued;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
+    LONG                    num_waiters;
     LONG                    num_pending_callbacks;
     LONG                    num_running_callbacks;
     LONG                    num_associated_callbacks;
@@ -192,6 +215,11 @@ struct threadpool_object
         {
             PTP_WAIT_CALLBACK callback;
             LONG            signaled;
+            /* information for RtlRegisterWait, read-only */
+            ULONG           flags;
+            RTL_WAITORTIMERCALLBACKFUNC rtl_callback;
+            LONGLONG        rtl_timeout;
+            HANDLE          rtl_token;
             /* information about the wait object, locked via waitqueue.cs */
             struct waitqueue_bucket *bucket;
             BOOL            wait_pending;
@@ -326,6 +354,8 @@ static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CAL
 }
 
 static void CALLBACK threadpool_worker_proc( void *param );
+static NTSTATUS tp_alloc_wait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                               TP_CALLBACK_ENVIRON *environment, ULONG flags );
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled );
 static void tp_object_shutdown( struct threadpool_object *object );
 static BOOL tp_object_release( struct threadpool_object *object );
@@ -341,16 +371,89 @@ static inline LONG interlocked_dec( PLONG dest )
     return interlocked_xchg_add( dest, -1 ) - 1;
 }
 
-static void CALLBACK process_rtl_work_item( TP_CALLBACK_INSTANCE *instance, void *userdata )
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+/* returns the impersonation token of the current thread for WT_TRANSFER_IMPERSONATION */
+static HANDLE rtl_get_impersonation_token( ULONG flags )
+{
+    HANDLE token;
+
+    if (!(flags & WT_TRANSFER_IMPERSONATION)) return NULL;
+    if (NtOpenThreadToken( GetCurrentThread(), TOKEN_IMPERSONATE, TRUE, &token )) return NULL;
+    return token;
+}
+
+static void rtl_set_impersonation_token( HANDLE token )
+{
+    NtSetInformationThread( GetCurrentThread(), ThreadImpersonationToken, &token, sizeof(token) );
+}
+
+/* The I/O thread waits alertably, so that the completion routines of I/O
+ * started by WT_EXECUTEINIOTHREAD callbacks can run. The callbacks
+ * themselves are delivered as user APCs as well. */
+static void WINAPI rtl_io_thread_proc( LPVOID param )
 {
-    struct rtl_work_item *item = userdata;
+    TRACE( "starting I/O thread\n" );
+
+    for (;;) NtDelayExecution( TRUE, NULL );
+}
 
+static NTSTATUS rtl_queue_io_apc( PNTAPCFUNC func, ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3 )
+{
+    if (!old_threadpool.io_thread)
+    {
+        NTSTATUS res = STATUS_SUCCESS;
+
+        RtlEnterCriticalSection(&old_threadpool.threadpool_compl_cs);
+        if (!old_threadpool.io_thread)
+        {
+            HANDLE thread;
+
+            res = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                       rtl_io_thread_proc, NULL, &thread, NULL );
+            if (!res)
+                old_threadpool.io_thread = thread;
+        }
+        RtlLeaveCriticalSection(&old_threadpool.threadpool_compl_cs);
+        if (res) return res;
+    }
+
+    return NtQueueApcThread( old_threadpool.io_thread, func, arg1, arg2, arg3 );
+}
+
+static void run_rtl_work_item( struct rtl_work_item *item )
+{
     TRACE("executing %p(%p)\n", item->function, item->context);
-    item->function( item->context );
+    if (item->token)
+    {
+        rtl_set_impersonation_token( item->token );
+        item->function( item->context );
+        rtl_set_impersonation_token( NULL );
+        NtClose( item->token );
+    }
+    else
+        item->function( item->context );
 
     RtlFreeHeap( GetProcessHeap(), 0, item );
 }
 
+static void CALLBACK process_rtl_work_item( TP_CALLBACK_INSTANCE *instance, void *userdata )
+{
+    run_rtl_work_item( userdata );
+}
+
+static void CALLBACK process_rtl_io_work_item( ULONG_PTR item, ULONG_PTR arg2, ULONG_PTR arg3 )
+{
+    run_rtl_work_item( (struct rtl_work_item *)item );
+}
+
 /***********************************************************************
  *              RtlQueueWorkItem   (NTDLL.@)
  *
@@ -392,9 +495,17 @@ NTSTATUS WINAPI RtlQueueWorkItem( PRTL_WORK_ITEM_ROUTINE function, PVOID context
 
     item->function = function;
     item->context  = context;
+    item->token    = rtl_get_impersonation_token( flags );
 
-    status = TpSimpleTryPost( process_rtl_work_item, item, &environment );
-    if (status) RtlFreeHeap( GetProcessHeap(), 0, item );
+    if (flags & WT_EXECUTEINIOTHREAD)
+        status = rtl_queue_io_apc( process_rtl_io_work_item, (ULONG_PTR)item, 0, 0 );
+    else
+        status = TpSimpleTryPost( process_rtl_work_item, item, &environment );
+    if (status)
+    {
+        if (item->token) NtClose( item->token );
+        RtlFreeHeap( GetProcessHeap(), 0, item );
+    }
     return status;
 }
 
@@ -491,63 +602,95 @@ static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout
     return pTime;
 }
 
-static void delete_wait_work_item(struct wait_work_item *wait_work_item)
+struct rtl_wait_apc
 {
-    NtClose( wait_work_item->CancelEvent );
-    RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
+    struct threadpool_object *object;
+    void                     *userdata;
+    BOOLEAN                   timeout;
+    HANDLE                    done;
+};
+
+static void run_rtl_wait_callback( struct threadpool_object *object, void *userdata, BOOLEAN timeout )
+{
+    TRACE( "executing wait callback %p(%p, %u)\n", object->u.wait.rtl_callback, userdata, timeout );
+    if (object->u.wait.rtl_token)
+    {
+        rtl_set_impersonation_token( object->u.wait.rtl_token );
+        object->u.wait.rtl_callback( userdata, timeout );
+        rtl_set_impersonation_token( NULL );
+    }
+    else
+        object->u.wait.rtl_callback( userdata, timeout );
+    TRACE( "callback %p returned\n", object->u.wait.rtl_callback );
 }
 
-static DWORD CALLBACK wait_thread_proc(LPVOID Arg)
+static void CALLBACK process_rtl_io_wait( ULONG_PTR arg1, ULONG_PTR arg2, ULONG_PTR arg3 )
 {
-    struct wait_work_item *wait_work_item = Arg;
-    NTSTATUS status;
-    BOOLEAN alertable = (wait_work_item->Flags & WT_EXECUTEINIOTHREAD) != 0;
-    HANDLE handles[2] = { wait_work_item->Object, wait_work_item->CancelEvent };
-    LARGE_INTEGER timeout;
-    HANDLE completion_event;
+    struct rtl_wait_apc *apc = (struct rtl_wait_apc *)arg1;
 
-    TRACE("\n");
+    run_rtl_wait_callback( apc->object, apc->userdata, apc->timeout );
+    NtSetEvent( apc->done, NULL );
+}
 
-    while (TRUE)
-    {
-        status = NtWaitForMultipleObjects( 2, handles, TRUE, alertable,
-                                           get_nt_timeout( &timeout, wait_work_item->Milliseconds ) );
-        if (status == STATUS_WAIT_0 || status == STATUS_TIMEOUT)
-        {
-            BOOLEAN TimerOrWaitFired;
+/* Persistent waits are moved to the reserved list when they are triggered
+ * and only wait again once the callback returned, see tp_waitqueue_rearm(). */
+static void rtl_wait_rearm( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket;
+    LARGE_INTEGER now;
 
-            if (status == STATUS_WAIT_0)
-            {
-                TRACE( "object %p signaled, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = FALSE;
-            }
-            else
-            {
-                TRACE( "wait for object %p timed out, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = TRUE;
-            }
-            wait_work_item->CallbackInProgress = TRUE;
-            wait_work_item->Callback( wait_work_item->Context, TimerOrWaitFired );
-            wait_work_item->CallbackInProgress = FALSE;
+    RtlEnterCriticalSection( &waitqueue.cs );
 
-            if (wait_work_item->Flags & WT_EXECUTEONLYONCE)
-                break;
+    /* RtlDeregisterWait clears the handle. */
+    if ((bucket = wait->u.wait.bucket) && wait->u.wait.handle && !wait->u.wait.wait_pending)
+    {
+        list_remove( &wait->u.wait.wait_entry );
+        list_add_tail( &bucket->waiting, &wait->u.wait.wait_entry );
+        wait->u.wait.wait_pending = TRUE;
+
+        if (wait->u.wait.rtl_timeout != TIMEOUT_INFINITE)
+        {
+            NtQuerySystemTime( &now );
+            wait->u.wait.timeout = now.QuadPart + wait->u.wait.rtl_timeout;
         }
         else
-            break;
+            wait->u.wait.timeout = TIMEOUT_INFINITE;
+
+        NtSetEvent( bucket->update_event, NULL );
     }
 
-    completion_event = wait_work_item->CompletionEvent;
-    if (completion_event) NtSetEvent( completion_event, NULL );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+}
 
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-        delete_wait_work_item( wait_work_item );
+static void CALLBACK rtl_wait_callback( TP_CALLBACK_INSTANCE *instance, void *userdata,
+                                        TP_WAIT *wait, TP_WAIT_RESULT result )
+{
+    struct threadpool_object *object = (struct threadpool_object *)wait;
+    struct rtl_wait_apc apc;
+    NTSTATUS status;
 
-    return 0;
+    if (object->u.wait.flags & WT_EXECUTEINIOTHREAD)
+    {
+        /* Keep the callback running until the I/O thread is done with it, so
+         * that RtlDeregisterWaitEx can still wait for it. */
+        apc.object   = object;
+        apc.userdata = userdata;
+        apc.timeout  = result != WAIT_OBJECT_0;
+        status = NtCreateEvent( &apc.done, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+        if (!status && !(status = rtl_queue_io_apc( process_rtl_io_wait, (ULONG_PTR)&apc, 0, 0 )))
+            NtWaitForSingleObject( apc.done, FALSE, NULL );
+        if (apc.done) NtClose( apc.done );
+        if (status)
+        {
+            ERR( "failed to queue callback to the I/O thread, status %x\n", status );
+            run_rtl_wait_callback( object, userdata, result != WAIT_OBJECT_0 );
+        }
+    }
+    else
+        run_rtl_wait_callback( object, userdata, result != WAIT_OBJECT_0 );
+
+    if (!(object->u.wait.flags & WT_EXECUTEONLYONCE))
+        rtl_wait_rearm( object );
 }
 
 /***********************************************************************
@@ -579,42 +722,40 @@ NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
                                 RTL_WAITORTIMERCALLBACKFUNC Callback,
                                 PVOID Context, ULONG Milliseconds, ULONG Flags)
 {
-    struct wait_work_item *wait_work_item;
+    struct threadpool_object *object;
+    TP_CALLBACK_ENVIRON environment;
+    LARGE_INTEGER timeout, *ptimeout;
     NTSTATUS status;
+    TP_WAIT *wait;
 
     TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
 
-    wait_work_item = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*wait_work_item) );
-    if (!wait_work_item)
-        return STATUS_NO_MEMORY;
-
-    wait_work_item->Object = Object;
-    wait_work_item->Callback = Callback;
-    wait_work_item->Context = Context;
-    wait_work_item->Milliseconds = Milliseconds;
-    wait_work_item->Flags = Flags;
-    wait_work_item->CallbackInProgress = FALSE;
-    wait_work_item->DeleteCount = 0;
-    wait_work_item->CompletionEvent = NULL;
+    /* The wait is multiplexed with other wait objects by the wait queue
+     * threads, callbacks are executed by the default threadpool. */
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.u.s.LongFunction = (Flags & WT_EXECUTELONGFUNCTION) != 0;
+    environment.u.s.Persistent   = (Flags & WT_EXECUTEINPERSISTENTTHREAD) != 0;
 
-    status = NtCreateEvent( &wait_work_item->CancelEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    status = tp_alloc_wait( &wait, rtl_wait_callback, Context, &environment, Flags );
     if (status != STATUS_SUCCESS)
-    {
-        RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
         return status;
-    }
 
-    Flags = Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD |
-                     WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION);
-    status = RtlQueueWorkItem( wait_thread_proc, wait_work_item, Flags );
-    if (status != STATUS_SUCCESS)
-    {
-        delete_wait_work_item( wait_work_item );
-        return status;
-    }
+    ptimeout = get_nt_timeout( &timeout, Milliseconds );
+    object = impl_from_TP_WAIT( wait );
+    object->u.wait.rtl_callback = Callback;
+    object->u.wait.rtl_timeout  = ptimeout ? -ptimeout->QuadPart : TIMEOUT_INFINITE;
+    object->u.wait.rtl_token    = rtl_get_impersonation_token( Flags );
 
-    *NewWaitObject = wait_work_item;
-    return status;
+    /* A zero timeout only tests the state of the object. Pass it through
+     * the wait queue instead of timing out right away; persistent waits
+     * test it again each time the callback returned. */
+    if (!Milliseconds) timeout.QuadPart = -1;
+
+    TpSetWait( wait, Object, ptimeout );
+
+    *NewWaitObject = object;
+    return STATUS_SUCCESS;
 }
 
 /***********************************************************************
@@ -632,43 +773,26 @@ NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
  */
 NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
 {
-    struct wait_work_item *wait_work_item = WaitHandle;
+    struct threadpool_object *object = WaitHandle;
     NTSTATUS status = STATUS_SUCCESS;
 
     TRACE( "(%p)\n", WaitHandle );
 
-    NtSetEvent( wait_work_item->CancelEvent, NULL );
-    if (wait_work_item->CallbackInProgress)
-    {
-        if (CompletionEvent != NULL)
-        {
-            if (CompletionEvent == INVALID_HANDLE_VALUE)
-            {
-                status = NtCreateEvent( &CompletionEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-                if (status != STATUS_SUCCESS)
-                    return status;
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    NtWaitForSingleObject( CompletionEvent, FALSE, NULL );
-                NtClose( CompletionEvent );
-            }
-            else
-            {
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    status = STATUS_PENDING;
-            }
-        }
-        else
-            status = STATUS_PENDING;
-    }
+    if (!object)
+        return STATUS_INVALID_HANDLE;
 
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-    {
-        status = STATUS_SUCCESS;
-        delete_wait_work_item( wait_work_item );
-    }
+    TpSetWait( (TP_WAIT *)object, NULL, NULL );
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+        TpWaitForWait( (TP_WAIT *)object, TRUE );
+    else
+        object->completed_event = CompletionEvent;
 
+    if (object->num_pending_callbacks || object->num_running_callbacks ||
+        object->num_associated_callbacks)
+        status = STATUS_PENDING;
+
+    TpReleaseWait( (TP_WAIT *)object );
     return status;
 }
 
@@ -1352,6 +1476,25 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
     RtlLeaveCriticalSection( &timerqueue.cs );
 }
 
+/***********************************************************************
+ *           tp_waitqueue_rearm    (internal)
+ *
+ * Called after a wait object was signaled or timed out. The wait object is
+ * moved to the reserved list. Wait objects registered with RtlRegisterWait
+ * without WT_EXECUTEONLYONCE are added back by rtl_wait_rearm() after the
+ * callback returned, so that a signaled object or a short timeout can't
+ * queue callbacks faster than they are executed.
+ * Must be called with waitqueue.cs held.
+ */
+static void tp_waitqueue_rearm( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket = wait->u.wait.bucket;
+
+    list_remove( &wait->u.wait.wait_entry );
+    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+    wait->u.wait.wait_pending = FALSE;
+}
+
 /***********************************************************************
  *           waitqueue_thread_proc    (internal)
  */
@@ -1361,12 +1504,15 @@ static void CALLBACK waitqueue_thread_proc( void *param )
     HANDLE handles[MAXIMUM_WAITQUEUE_OBJECTS + 1];
     struct waitqueue_bucket *bucket = param;
     struct threadpool_object *wait, *next;
-    LARGE_INTEGER now, timeout;
+    LARGE_INTEGER now, timeout, zero;
     DWORD num_handles;
     NTSTATUS status;
+    BOOL signaled;
 
     TRACE( "starting wait queue thread\n" );
 
+    zero.QuadPart = 0;
+
     RtlEnterCriticalSection( &waitqueue.cs );
 
     for (;;)
@@ -1381,12 +1527,15 @@ static void CALLBACK waitqueue_thread_proc( void *param )
             assert( wait->type == TP_OBJECT_TYPE_WAIT );
             if (wait->u.wait.timeout <= now.QuadPart)
             {
-                /* Wait object timed out. */
-                list_remove( &wait->u.wait.wait_entry );
-                list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
-                tp_object_submit( wait, FALSE );
+                /* Wait object timed out. The object may be signaled anyway
+                 * if RtlRegisterWait was called with a zero timeout. */
+                signaled = wait->u.wait.rtl_callback &&
+                           NtWaitForSingleObject( wait->u.wait.handle, FALSE, &zero ) == STATUS_WAIT_0;
+                tp_waitqueue_rearm( wait );
+                tp_object_submit( wait, signaled );
             }
-            else
+
+            if (wait->u.wait.wait_pending)
             {
                 if (wait->u.wait.timeout < timeout.QuadPart)
                     timeout.QuadPart = wait->u.wait.timeout;
@@ -1427,8 +1576,7 @@ static void CALLBACK waitqueue_thread_proc( void *param )
                 {
                     /* Wait object signaled. */
                     assert( wait->u.wait.bucket == bucket );
-                    list_remove( &wait->u.wait.wait_entry );
-                    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+                    tp_waitqueue_rearm( wait );
                     tp_object_submit( wait, TRUE );
                 }
                 else
@@ -1528,7 +1676,14 @@ static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait )
         {
             list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
             wait->u.wait.bucket = bucket;
-            bucket->objcount++;
+
+            /* Keep full buckets at the end of the list, this keeps the search
+             * short when a lot of wait objects are registered. */
+            if (++bucket->objcount == MAXIMUM_WAITQUEUE_OBJECTS)
+            {
+                list_remove( &bucket->bucket_entry );
+                list_add_tail( &waitqueue.buckets, &bucket->bucket_entry );
+            }
 
             status = STATUS_SUCCESS;
             goto out;
@@ -1594,13 +1749,149 @@ static void tp_waitqueue_unlock( struct threadpool_object *wait )
 
         list_remove( &wait->u.wait.wait_entry );
         wait->u.wait.bucket = NULL;
-        bucket->objcount--;
+
+        /* A previously full bucket can be reused again. */
+        if (bucket->objcount-- == MAXIMUM_WAITQUEUE_OBJECTS)
+        {
+            list_remove( &bucket->bucket_entry );
+            list_add_head( &waitqueue.buckets, &bucket->bucket_entry );
+        }
 
         NtSetEvent( bucket->update_event, NULL );
     }
     RtlLeaveCriticalSection( &waitqueue.cs );
 }
 
+/***********************************************************************
+ *           tp_new_worker_thread    (internal)
+ *
+ * Create and account a new worker thread for the desired pool.
+ * Must be called with pool->cs held.
+ */
+static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
+{
+    HANDLE thread;
+    NTSTATUS status;
+
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  threadpool_worker_proc, pool, &thread, NULL );
+    if (status == STATUS_SUCCESS)
+    {
+        interlocked_inc( &pool->refcount );
+        pool->num_workers++;
+        interlocked_inc( &pool->num_busy_workers );
+        NtClose( thread );
+    }
+    return status;
+}
+
+/***********************************************************************
+ *           tp_threadpool_wake    (internal)
+ *
+ * Makes sure that a worker thread picks up queued work. Nothing has to be
+ * done when a worker is still spinning, otherwise a sleeping worker is
+ * woken up, or a new thread is started when all workers are busy. Unless
+ * forced, new threads are only started as long as fewer workers than
+ * processors are running callbacks without being blocked in the pool.
+ */
+static void tp_threadpool_wake( struct threadpool *pool, BOOL force )
+{
+    if (*(volatile LONG *)&pool->num_spinning_workers)
+        return;
+
+    if (!*(volatile LONG *)&pool->num_sleeping_workers)
+    {
+        if (*(volatile LONG *)&pool->num_busy_workers < pool->num_workers ||
+            pool->num_workers >= pool->max_workers)
+            return;
+
+        if (!force && pool->num_busy_workers - pool->num_blocked_workers >=
+            NtCurrentTeb()->Peb->NumberOfProcessors)
+            return;
+    }
+
+    /* A sleeping worker may have timed out and be exiting with pool->cs held,
+     * so check again once we own it, and replace the worker if it is gone. */
+    RtlEnterCriticalSection( &pool->cs );
+    if (pool->num_sleeping_workers)
+        RtlWakeConditionVariable( &pool->update_event );
+    else if (pool->num_busy_workers >= pool->num_workers &&
+             pool->num_workers < pool->max_workers)
+        tp_new_worker_thread( pool );
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
+/***********************************************************************
+ *           tp_queue_push    (internal)
+ *
+ * Adds an object to a queue. New objects are added to the head of worker
+ * queues, so that work submitted by a callback runs next on the same
+ * thread, requeued objects are added to the tail.
+ */
+static void tp_queue_push( struct threadpool *pool, struct threadpool_queue *queue,
+                           struct threadpool_object *object, BOOL head )
+{
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if (head)
+        list_add_head( &queue->objects, &object->pool_entry );
+    else
+        list_add_tail( &queue->objects, &object->pool_entry );
+    RtlReleaseSRWLockExclusive( &queue->lock );
+
+    interlocked_inc( &pool->num_queued );
+}
+
+/***********************************************************************
+ *           tp_queue_claim    (internal)
+ *
+ * Claims a pending callback of the first or last object of a queue. The
+ * object is only removed from the queue after its last pending callback
+ * was claimed or all of them were cancelled, otherwise an object taken
+ * from the head is moved to the tail. Returns the number of pending
+ * callbacks before the claim.
+ */
+static struct threadpool_object *tp_queue_claim( struct threadpool *pool, struct threadpool_queue *queue,
+                                                 BOOL tail, LONG *pending )
+{
+    struct threadpool_object *object = NULL;
+    struct list *ptr;
+    LONG count = 0;
+
+    RtlAcquireSRWLockExclusive( &queue->lock );
+    if ((ptr = tail ? list_tail( &queue->objects ) : list_head( &queue->objects )))
+    {
+        object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+
+        /* Account the callback before claiming it, tp_object_wait checks
+         * the pending count first. */
+        interlocked_inc( &object->num_associated_callbacks );
+        interlocked_inc( &object->num_running_callbacks );
+
+        do
+        {
+            count = *(volatile LONG *)&object->num_pending_callbacks;
+            if (!count) break;
+        }
+        while (interlocked_cmpxchg( &object->num_pending_callbacks, count - 1, count ) != count);
+
+        if (count > 1)
+        {
+            if (!tail)
+            {
+                list_remove( &object->pool_entry );
+                list_add_tail( &queue->objects, &object->pool_entry );
+            }
+        }
+        else
+            list_remove( &object->pool_entry );
+    }
+    RtlReleaseSRWLockExclusive( &queue->lock );
+
+    if (object && count <= 1) interlocked_dec( &pool->num_queued );
+    *pending = count;
+    return object;
+}
+
 /***********************************************************************
  *           tp_threadpool_alloc    (internal)
  *
@@ -1621,13 +1912,21 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     RtlInitializeCriticalSection( &pool->cs );
     pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
 
-    list_init( &pool->pool );
+    RtlInitializeSRWLock( &pool->queue.lock );
+    list_init( &pool->queue.objects );
+    pool->num_queued            = 0;
+
+    RtlInitializeSRWLock( &pool->workers_lock );
+    list_init( &pool->workers );
     RtlInitializeConditionVariable( &pool->update_event );
 
     pool->max_workers           = 500;
     pool->min_workers           = 0;
     pool->num_workers           = 0;
     pool->num_busy_workers      = 0;
+    pool->num_blocked_workers   = 0;
+    pool->num_spinning_workers  = 0;
+    pool->num_sleeping_workers  = 0;
 
     TRACE( "allocated threadpool %p\n", pool );
 
@@ -1664,7 +1963,9 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
 
     assert( pool->shutdown );
     assert( !pool->objcount );
-    assert( list_empty( &pool->pool ) );
+    assert( !pool->num_queued );
+    assert( list_empty( &pool->queue.objects ) );
+    assert( list_empty( &pool->workers ) );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1710,18 +2011,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
 
     /* Make sure that the threadpool has at least one thread. */
     if (!pool->num_workers)
-    {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, pool, &thread, NULL );
-        if (status == STATUS_SUCCESS)
-        {
-            interlocked_inc( &pool->refcount );
-            pool->num_workers++;
-            pool->num_busy_workers++;
-            NtClose( thread );
-        }
-    }
+        status = tp_new_worker_thread( pool );
 
     /* Keep a reference, and increment objcount to ensure that the
      * last thread doesn't terminate. */
@@ -1832,13 +2122,16 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     object->finalization_callback   = NULL;
     object->may_run_long            = 0;
     object->race_dll                = NULL;
+    object->completed_event         = NULL;
 
     memset( &object->group_entry, 0, sizeof(object->group_entry) );
     object->is_group_member         = FALSE;
 
     memset( &object->pool_entry, 0, sizeof(object->pool_entry) );
+    object->queued                  = FALSE;
     RtlInitializeConditionVariable( &object->finished_event );
     RtlInitializeConditionVariable( &object->group_finished_event );
+    object->num_waiters             = 0;
     object->num_pending_callbacks   = 0;
     object->num_running_callbacks   = 0;
     object->num_associated_callbacks = 0;
@@ -1891,78 +2184,142 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
     }
 }
 
+/***********************************************************************
+ *           tp_object_wake_waiters    (internal)
+ *
+ * Wakes up threads waiting in tp_object_wait after one of the callback
+ * counters of an object was decremented.
+ */
+static void tp_object_wake_waiters( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+
+    if (!*(volatile LONG *)&object->num_waiters)
+        return;
+
+    RtlEnterCriticalSection( &pool->cs );
+    if (!object->num_pending_callbacks && !object->num_running_callbacks)
+        RtlWakeAllConditionVariable( &object->group_finished_event );
+    if (!object->num_pending_callbacks && !object->num_associated_callbacks)
+        RtlWakeAllConditionVariable( &object->finished_event );
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
 /***********************************************************************
  *           tp_object_submit    (internal)
  *
  * Submits a threadpool object to the associcated threadpool. This
  * function has to be VOID because TpPostWork can never fail on Windows.
+ *
+ * An object is only added to a queue once, further submissions just
+ * increment the number of pending callbacks.
  */
 static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
 {
+    struct threadpool_worker *worker = ntdll_get_thread_data()->threadpool_worker;
     struct threadpool *pool = object->pool;
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
 
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
-    RtlEnterCriticalSection( &pool->cs );
+    /* Increment refcount and count how often the object was signaled. */
+    interlocked_inc( &object->refcount );
+    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
+        interlocked_inc( &object->u.wait.signaled );
 
-    /* Start new worker threads if required. */
-    if (pool->num_busy_workers >= pool->num_workers &&
-        pool->num_workers < pool->max_workers)
+    interlocked_inc( &object->num_pending_callbacks );
+    if (interlocked_cmpxchg( &object->queued, TRUE, FALSE ))
+        return;
+
+    /* Queue work item, the queue holds an additional reference. Objects
+     * submitted from a worker of the same pool go to its local queue. */
+    interlocked_inc( &object->refcount );
+    if (worker && worker->pool == pool)
+        tp_queue_push( pool, &worker->queue, object, TRUE );
+    else
+        tp_queue_push( pool, &pool->queue, object, FALSE );
+
+    tp_threadpool_wake( pool, TRUE );
+}
+
+/***********************************************************************
+ *           tp_object_dequeue    (internal)
+ *
+ * Called by a worker after claiming a callback with tp_queue_claim.
+ * Returns TRUE if the callback has to be executed, FALSE if all pending
+ * callbacks were cancelled.
+ */
+static BOOL tp_object_dequeue( struct threadpool_object *object, struct threadpool_queue *queue,
+                               LONG pending, TP_WAIT_RESULT *wait_result )
+{
+    struct threadpool *pool = object->pool;
+    LONG signaled;
+    BOOL requeue;
+
+    if (pending > 1)
     {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, pool, &thread, NULL );
-        if (status == STATUS_SUCCESS)
+        /* The object is still queued, let another worker pick it up. */
+        tp_threadpool_wake( pool, FALSE );
+    }
+    else
+    {
+        /* The object was removed from the queue. Clear the queued flag, but
+         * requeue the object if further callbacks were submitted concurrently. */
+        interlocked_xchg( &object->queued, FALSE );
+        requeue = *(volatile LONG *)&object->num_pending_callbacks &&
+                  !interlocked_cmpxchg( &object->queued, TRUE, FALSE );
+        if (requeue)
         {
-            interlocked_inc( &pool->refcount );
-            pool->num_workers++;
-            pool->num_busy_workers++;
-            NtClose( thread );
+            tp_queue_push( pool, queue, object, FALSE );
+            tp_threadpool_wake( pool, TRUE );
         }
-    }
 
-    /* Queue work item and increment refcount. */
-    interlocked_inc( &object->refcount );
-    if (!object->num_pending_callbacks++)
-        list_add_tail( &pool->pool, &object->pool_entry );
+        if (!pending)
+        {
+            /* All callbacks were cancelled. */
+            interlocked_dec( &object->num_associated_callbacks );
+            interlocked_dec( &object->num_running_callbacks );
+            tp_object_wake_waiters( object );
+            if (!requeue) tp_object_release( object );
+            return FALSE;
+        }
 
-    /* Count how often the object was signaled. */
-    if (object->type == TP_OBJECT_TYPE_WAIT && signaled)
-        object->u.wait.signaled++;
+        /* Drop the queue reference, the claimed callback still holds one. */
+        if (!requeue) interlocked_dec( &object->refcount );
+    }
 
-    /* No new thread started - wake up one existing thread. */
-    if (status != STATUS_SUCCESS)
+    /* For wait objects check if they were signaled or have timed out. */
+    if (object->type == TP_OBJECT_TYPE_WAIT)
     {
-        assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        *wait_result = WAIT_TIMEOUT;
+        while ((signaled = *(volatile LONG *)&object->u.wait.signaled))
+        {
+            if (interlocked_cmpxchg( &object->u.wait.signaled, signaled - 1, signaled ) == signaled)
+            {
+                *wait_result = WAIT_OBJECT_0;
+                break;
+            }
+        }
     }
 
-    RtlLeaveCriticalSection( &pool->cs );
+    return TRUE;
 }
 
 /***********************************************************************
  *           tp_object_cancel    (internal)
  *
- * Cancels all currently pending callbacks for a specific object.
+ * Cancels all currently pending callbacks for a specific object. The
+ * object stays queued until a worker removes it.
  */
 static void tp_object_cancel( struct threadpool_object *object, BOOL group_cancel, PVOID userdata )
 {
-    struct threadpool *pool = object->pool;
-    LONG pending_callbacks = 0;
+    LONG pending_callbacks;
 
-    RtlEnterCriticalSection( &pool->cs );
-    if (object->num_pending_callbacks)
-    {
-        pending_callbacks = object->num_pending_callbacks;
-        object->num_pending_callbacks = 0;
-        list_remove( &object->pool_entry );
-
-        if (object->type == TP_OBJECT_TYPE_WAIT)
-            object->u.wait.signaled = 0;
-    }
-    RtlLeaveCriticalSection( &pool->cs );
+    pending_callbacks = interlocked_xchg( &object->num_pending_callbacks, 0 );
+    if (pending_callbacks && object->type == TP_OBJECT_TYPE_WAIT)
+        interlocked_xchg( &object->u.wait.signaled, 0 );
+    if (pending_callbacks)
+        tp_object_wake_waiters( object );
 
     /* Execute group cancellation callback if defined, and if this was actually a group cancel. */
     if (pending_callbacks && group_cancel && object->group_cancel_callback)
@@ -1980,11 +2337,25 @@ static void tp_object_cancel( struct threadpool_object *object, BOOL group_cance
  *           tp_object_wait    (internal)
  *
  * Waits until all pending and running callbacks of a specific object
- * have been processed.
+ * have been processed. A worker thread blocking here is not counted as
+ * available, so that queued work can still make progress.
  */
 static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
 {
+    struct threadpool_worker *worker = ntdll_get_thread_data()->threadpool_worker;
     struct threadpool *pool = object->pool;
+    BOOL blocked = FALSE;
+
+    interlocked_inc( &object->num_waiters );
+
+    if (worker && (object->num_pending_callbacks ||
+        (group_wait ? object->num_running_callbacks : object->num_associated_callbacks)))
+    {
+        interlocked_inc( &worker->pool->num_blocked_workers );
+        if (*(volatile LONG *)&worker->pool->num_queued)
+            tp_threadpool_wake( worker->pool, FALSE );
+        blocked = TRUE;
+    }
 
     RtlEnterCriticalSection( &pool->cs );
     if (group_wait)
@@ -1998,6 +2369,10 @@ static void tp_object_wait( struct threadpool_object *object, BOOL group_wait )
             RtlSleepConditionVariableCS( &object->finished_event, &pool->cs, NULL );
     }
     RtlLeaveCriticalSection( &pool->cs );
+
+    if (blocked)
+        interlocked_dec( &worker->pool->num_blocked_workers );
+    interlocked_dec( &object->num_waiters );
 }
 
 /***********************************************************************
@@ -2029,6 +2404,7 @@ static BOOL tp_object_release( struct threadpool_object *object )
     TRACE( "destroying object %p of type %u\n", object, object->type );
 
     assert( object->shutdown );
+    assert( !object->queued );
     assert( !object->num_pending_callbacks );
     assert( !object->num_running_callbacks );
     assert( !object->num_associated_callbacks );
@@ -2054,10 +2430,86 @@ static BOOL tp_object_release( struct threadpool_object *object )
     if (object->race_dll)
         LdrUnloadDll( object->race_dll );
 
+    if (object->completed_event && object->completed_event != INVALID_HANDLE_VALUE)
+        NtSetEvent( object->completed_event, NULL );
+
+    if (object->type == TP_OBJECT_TYPE_WAIT && object->u.wait.rtl_token)
+        NtClose( object->u.wait.rtl_token );
+
     RtlFreeHeap( GetProcessHeap(), 0, object );
     return TRUE;
 }
 
+/***********************************************************************
+ *           tp_worker_next_object    (internal)
+ *
+ * Claims the next callback from the local queue of a worker, from the
+ * global queue, or steals it from the tail of the queue of another worker.
+ * Returns the queue to use if the object has to be requeued.
+ */
+static struct threadpool_object *tp_worker_next_object( struct threadpool_worker *worker,
+                                                        struct threadpool_queue **queue, LONG *pending )
+{
+    struct threadpool *pool = worker->pool;
+    struct threadpool_worker *other;
+    struct threadpool_object *object;
+
+    if (!*(volatile LONG *)&pool->num_queued)
+        return NULL;
+
+    *queue = &worker->queue;
+    if ((object = tp_queue_claim( pool, &worker->queue, FALSE, pending )))
+        return object;
+
+    *queue = &pool->queue;
+    if ((object = tp_queue_claim( pool, &pool->queue, FALSE, pending )))
+        return object;
+
+    *queue = &worker->queue;
+    RtlAcquireSRWLockShared( &pool->workers_lock );
+    LIST_FOR_EACH_ENTRY( other, &pool->workers, struct threadpool_worker, entry )
+    {
+        if (other == worker) continue;
+        if ((object = tp_queue_claim( pool, &other->queue, TRUE, pending ))) break;
+    }
+    RtlReleaseSRWLockShared( &pool->workers_lock );
+    return object;
+}
+
+/***********************************************************************
+ *           tp_worker_spin    (internal)
+ *
+ * Spins for a short time waiting for new work before the worker goes to
+ * sleep. Returns TRUE when work was queued in the meantime. Workers only
+ * spin as long as running and spinning threads leave a processor for the
+ * threads submitting work. Workers blocked in tp_object_wait don't count.
+ */
+static BOOL tp_worker_spin( struct threadpool_worker *worker )
+{
+    struct threadpool *pool = worker->pool;
+    LONG num_active;
+    BOOL found = FALSE;
+    int i;
+
+    num_active = *(volatile LONG *)&pool->num_busy_workers - *(volatile LONG *)&pool->num_blocked_workers +
+                 *(volatile LONG *)&pool->num_spinning_workers;
+    if (num_active >= NtCurrentTeb()->Peb->NumberOfProcessors - 1)
+        return FALSE;
+
+    interlocked_inc( &pool->num_spinning_workers );
+    for (i = 0; i < THREADPOOL_SPIN_COUNT; i++)
+    {
+        if (*(volatile LONG *)&pool->num_queued)
+        {
+            found = TRUE;
+            break;
+        }
+        small_pause();
+    }
+    interlocked_dec( &pool->num_spinning_workers );
+    return found;
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
@@ -2065,42 +2517,40 @@ static void CALLBACK threadpool_worker_proc( void *param )
 {
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
+    struct threadpool_worker worker;
+    struct threadpool_object *object;
+    struct threadpool_queue *queue;
     struct threadpool *pool = param;
     TP_WAIT_RESULT wait_result = 0;
+    LONG pending;
     LARGE_INTEGER timeout;
-    struct list *ptr;
     NTSTATUS status;
 
     TRACE( "starting worker thread for pool %p\n", pool );
 
-    RtlEnterCriticalSection( &pool->cs );
-    pool->num_busy_workers--;
+    worker.pool = pool;
+    RtlInitializeSRWLock( &worker.queue.lock );
+    list_init( &worker.queue.objects );
+
+    RtlAcquireSRWLockExclusive( &pool->workers_lock );
+    list_add_tail( &pool->workers, &worker.entry );
+    RtlReleaseSRWLockExclusive( &pool->workers_lock );
+    ntdll_get_thread_data()->threadpool_worker = &worker;
+
+    interlocked_dec( &pool->num_busy_workers );
     for (;;)
     {
-        while ((ptr = list_head( &pool->pool )))
+        while ((object = tp_worker_next_object( &worker, &queue, &pending )))
         {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
-
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (--object->num_pending_callbacks)
-                list_add_tail( &pool->pool, &object->pool_entry );
-
-            /* For wait objects check if they were signaled or have timed out. */
-            if (object->type == TP_OBJECT_TYPE_WAIT)
+            /* Count the worker as busy before waking up others, so that
+             * a new thread is started when required. */
+            interlocked_inc( &pool->num_busy_workers );
+            if (!tp_object_dequeue( object, queue, pending, &wait_result ))
             {
-                wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
-                if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
+                interlocked_dec( &pool->num_busy_workers );
+                continue;
             }
 
-            /* Leave critical section and do the actual callback. */
-            object->num_associated_callbacks++;
-            object->num_running_callbacks++;
-            pool->num_busy_workers++;
-            RtlLeaveCriticalSection( &pool->cs );
-
             /* Initialize threadpool instance struct. */
             callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
             instance.object                     = object;
@@ -2192,43 +2642,60 @@ static void CALLBACK threadpool_worker_proc( void *param )
             }
 
         skip_cleanup:
-            RtlEnterCriticalSection( &pool->cs );
-            pool->num_busy_workers--;
-
-            object->num_running_callbacks--;
-            if (!object->num_pending_callbacks && !object->num_running_callbacks)
-                RtlWakeAllConditionVariable( &object->group_finished_event );
+            interlocked_dec( &pool->num_busy_workers );
 
+            interlocked_dec( &object->num_running_callbacks );
             if (instance.associated)
-            {
-                object->num_associated_callbacks--;
-                if (!object->num_pending_callbacks && !object->num_associated_callbacks)
-                    RtlWakeAllConditionVariable( &object->finished_event );
-            }
+                interlocked_dec( &object->num_associated_callbacks );
+            tp_object_wake_waiters( object );
 
             tp_object_release( object );
         }
 
-        /* Shutdown worker thread if requested. */
-        if (pool->shutdown)
-            break;
+        if (tp_worker_spin( &worker ))
+            continue;
 
-        /* Wait for new tasks or until the timeout expires. A thread only terminates
-         * when no new tasks are available, and the number of threads can be
-         * decreased without violating the min_workers limit. An exception is when
-         * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
-        timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !list_head( &pool->pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        RtlEnterCriticalSection( &pool->cs );
+        interlocked_inc( &pool->num_sleeping_workers );
+
+        /* Shutdown worker thread if requested, but only after all
+         * remaining work items have been processed. */
+        status = STATUS_SUCCESS;
+        if (!pool->num_queued)
+        {
+            if (pool->shutdown)
+                break;
+
+            /* Wait for new tasks or until the timeout expires. A thread only terminates
+             * when no new tasks are available, and the number of threads can be
+             * decreased without violating the min_workers limit. An exception is when
+             * min_workers == 0, then objcount is used to detect if the last thread
+             * can be terminated. */
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+            status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+        }
+
+        if (status == STATUS_TIMEOUT && !pool->num_queued &&
+            (pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
             break;
         }
+
+        interlocked_dec( &pool->num_sleeping_workers );
+        RtlLeaveCriticalSection( &pool->cs );
     }
+    interlocked_dec( &pool->num_sleeping_workers );
     pool->num_workers--;
     RtlLeaveCriticalSection( &pool->cs );
 
+    /* Only this thread adds objects to its local queue. */
+    assert( list_empty( &worker.queue.objects ) );
+    ntdll_get_thread_data()->threadpool_worker = NULL;
+    RtlAcquireSRWLockExclusive( &pool->workers_lock );
+    list_remove( &worker.entry );
+    RtlReleaseSRWLockExclusive( &pool->workers_lock );
+
     TRACE( "terminating worker thread for pool %p\n", pool );
     tp_threadpool_release( pool );
     RtlExitUserThread( 0 );
@@ -2298,17 +2765,15 @@ NTSTATUS WINAPI TpAllocTimer( TP_TIMER **out, PTP_TIMER_CALLBACK callback, PVOID
 }
 
 /***********************************************************************
- *           TpAllocWait     (NTDLL.@)
+ *           tp_alloc_wait    (internal)
  */
-NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
-                             TP_CALLBACK_ENVIRON *environment )
+static NTSTATUS tp_alloc_wait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                               TP_CALLBACK_ENVIRON *environment, ULONG flags )
 {
     struct threadpool_object *object;
     struct threadpool *pool;
     NTSTATUS status;
 
-    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
-
     object = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*object) );
     if (!object)
         return STATUS_NO_MEMORY;
@@ -2321,7 +2786,11 @@ NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID us
     }
 
     object->type = TP_OBJECT_TYPE_WAIT;
-    object->u.wait.callback = callback;
+    object->u.wait.callback     = callback;
+    object->u.wait.flags        = flags;
+    object->u.wait.rtl_callback = NULL;
+    object->u.wait.rtl_timeout  = TIMEOUT_INFINITE;
+    object->u.wait.rtl_token    = NULL;
 
     status = tp_waitqueue_lock( object );
     if (status)
@@ -2337,6 +2806,17 @@ NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID us
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           TpAllocWait     (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    return tp_alloc_wait( out, callback, userdata, environment, WT_EXECUTEONLYONCE );
+}
+
 /***********************************************************************
  *           TpAllocWork    (NTDLL.@)
  */
@@ -2409,18 +2889,7 @@ NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
     if (pool->num_busy_workers >= pool->num_workers)
     {
         if (pool->num_workers < pool->max_workers)
-        {
-            HANDLE thread;
-            status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                          threadpool_worker_proc, pool, &thread, NULL );
-            if (status == STATUS_SUCCESS)
-            {
-                interlocked_inc( &pool->refcount );
-                pool->num_workers++;
-                pool->num_busy_workers++;
-                NtClose( thread );
-            }
-        }
+            status = tp_new_worker_thread( pool );
         else
         {
             status = STATUS_TOO_MANY_THREADS;
@@ -2494,7 +2963,6 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
 {
     struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
     struct threadpool_object *object = this->object;
-    struct threadpool *pool;
 
     TRACE( "%p\n", instance );
 
@@ -2507,14 +2975,8 @@ VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
     if (!this->associated)
         return;
 
-    pool = object->pool;
-    RtlEnterCriticalSection( &pool->cs );
-
-    object->num_associated_callbacks--;
-    if (!object->num_pending_callbacks && !object->num_associated_callbacks)
-        RtlWakeAllConditionVariable( &object->finished_event );
-
-    RtlLeaveCriticalSection( &pool->cs );
+    interlocked_dec( &object->num_associated_callbacks );
+    tp_object_wake_waiters( object );
     this->associated = FALSE;
 }
 
@@ -2697,16 +3159,9 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 
     while (this->num_workers < minimum)
     {
-        HANDLE thread;
-        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
-                                      threadpool_worker_proc, this, &thread, NULL );
+        status = tp_new_worker_thread( this );
         if (status != STATUS_SUCCESS)
             break;
-
-        interlocked_inc( &this->refcount );
-        this->num_workers++;
-        this->num_busy_workers++;
-        NtClose( thread );
     }
 
     if (status == STATUS_SUCCESS)
@@ -51,6 +51,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -65,6 +66,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -96,6 +98,7 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 };
 
 static struct list views_list = LIST_INIT(views_list);
+static struct wine_rb_tree views_tree;  /* views indexed by base address */
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -241,6 +244,89 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+static int compare_view( const void *addr, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, tree_entry );
+
+    if (addr < view->base) return -1;
+    if (addr > view->base) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions views_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    compare_view
+};
+
+
+/***********************************************************************
+ *           find_view_end_after
+ *
+ * Find the first view that ends after a given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_end_after( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *view, *ret = NULL;
+
+    while (ptr)
+    {
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+        if ((const char *)view->base + view->size > (const char *)addr)
+        {
+            ret = view;
+            ptr = ptr->left;
+        }
+        else ptr = ptr->right;
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           find_last_view
+ *
+ * Find the last view that starts at or before a given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_last_view( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *view, *ret = NULL;
+
+    while (ptr)
+    {
+        view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+        if (view->base <= addr)
+        {
+            ret = view;
+            ptr = ptr->right;
+        }
+        else ptr = ptr->left;
+    }
+    return ret;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -255,17 +341,12 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_end_after( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
-    }
-    return NULL;
+    if (!view || view->base > addr) return NULL;  /* no matching view */
+    if ((const char *)view->base + view->size < (const char *)addr + size) return NULL;  /* size too large */
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+    return view;
 }
 
 
@@ -288,13 +369,9 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_end_after( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
-    }
+    if (view && (const char *)view->base < (const char *)addr + size) return view;
     return NULL;
 }
 
@@ -307,7 +384,7 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
-    struct list *ptr;
+    struct file_view *view;
     void *start;
 
     if (top_down)
@@ -315,12 +392,10 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        /* move below the last view overlapping the candidate area until there is none */
+        while ((view = find_last_view( (char *)start + size - 1 )))
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
-
             if ((char *)view->base + view->size <= (char *)start) break;
-            if ((char *)view->base >= (char *)start + size) continue;
             start = ROUND_ADDR( (char *)view->base - size, mask );
             /* stop if remaining space is not large enough */
             if (!start || start >= end || start < base) return NULL;
@@ -331,12 +406,9 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        /* move above the first view overlapping the candidate area until there is none */
+        while ((view = find_view_range( start, size )))
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
-
-            if ((char *)view->base >= (char *)start + size) break;
-            if ((char *)view->base + view->size <= (char *)start) continue;
             start = ROUND_ADDR( (char *)view->base + view->size + mask, mask );
             /* stop if remaining space is not large enough */
             if (!start || start >= end || (char *)end - (char *)start < size) return NULL;
@@ -437,6 +509,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
     list_remove( &view->entry );
+    wine_rb_remove( &views_tree, view->base );
     if (view->mapping) close_handle( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
 }
@@ -449,7 +522,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
+    struct file_view *view, *prev;
     struct list *ptr;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
@@ -473,12 +546,8 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
 
     /* Insert it in the linked list */
 
-    LIST_FOR_EACH( ptr, &views_list )
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
+    if ((prev = find_last_view( base ))) list_add_after( &prev->entry, &view->entry );
+    else list_add_head( &views_list, &view->entry );
 
     /* Check for overlapping views. This can happen if the previous view
      * was a system view that got unmapped behind our back. In that case
@@ -509,6 +578,15 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
         }
     }
 
+    /* and in the tree, now that overlapping views are gone */
+
+    if (wine_rb_put( &views_tree, base, &view->tree_entry ) == -1)
+    {
+        list_remove( &view->entry );
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
+    }
+
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
 
@@ -1333,6 +1411,11 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    if (wine_rb_init( &views_tree, &views_tree_functions ) == -1)
+    {
+        MESSAGE( "wine: failed to initialize the virtual memory views tree\n" );
+        exit(1);
+    }
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible (except the low 64K) to hide bugs in broken apps like Excel 2003 */
@@ -2297,30 +2380,22 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    if ((view = find_view_end_after( base )) && (char *)view->base <= base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        /* free area between the previous view and the next one */
+        ptr = view ? list_prev( &views_list, &view->entry ) : list_tail( &views_list );
+        if (ptr)
         {
-            alloc_base = view->base;
-            size = view->size;
-            break;
+            struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
+            alloc_base = (char *)prev->base + prev->size;
         }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        size = (view ? (char *)view->base : (char *)working_set_limit) - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
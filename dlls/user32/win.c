@@ -1515,7 +1515,13 @@ HWND WIN_CreateWindowEx( CREATESTRUCTW *cs, LPCWSTR className, HINSTANCE module,
         req->instance  = wine_server_client_ptr( wndPtr->hInstance );
         req->is_unicode = (wndPtr->flags & WIN_ISUNICODE) != 0;
         req->extra_offset = -1;
-        wine_server_call( req );
+        if ((wndPtr->dwStyle & (WS_CHILD | WS_POPUP)) == WS_CHILD)
+        {
+            /* set the child id in the same request */
+            req->flags |= SET_WIN_ID;
+            req->id     = (ULONG_PTR)cs->hMenu;
+        }
+        if (!wine_server_call( req ) && (req->flags & SET_WIN_ID)) wndPtr->wIDmenu = (ULONG_PTR)cs->hMenu;
     }
     SERVER_END_REQ;
 
@@ -1542,7 +1548,6 @@ HWND WIN_CreateWindowEx( CREATESTRUCTW *cs, LPCWSTR className, HINSTANCE module,
             }
         }
     }
-    else SetWindowLongPtrW( hwnd, GWLP_ID, (ULONG_PTR)cs->hMenu );
 
     /* call the WH_CBT hook */
 
@@ -58,6 +58,9 @@ static RTL_CRITICAL_SECTION vcomp_section = { &critsect_debug, -1, 0, 0, 0, 0 };
 #define VCOMP_DYNAMIC_FLAGS_GUIDED      0x03
 #define VCOMP_DYNAMIC_FLAGS_INCREMENT   0x40
 
+/* number of polling iterations before a waiting thread goes to sleep */
+#define VCOMP_SPIN_COUNT                4000
+
 struct vcomp_thread_data
 {
     struct vcomp_team_data  *team;
@@ -75,12 +78,18 @@ struct vcomp_thread_data
 
     /* section */
     unsigned int            section;
+    int                     num_sections;
 
     /* dynamic */
     unsigned int            dynamic;
     unsigned int            dynamic_type;
     unsigned int            dynamic_begin;
     unsigned int            dynamic_end;
+    unsigned int            dynamic_first;
+    unsigned int            dynamic_last;
+    unsigned int            dynamic_iterations;
+    int                     dynamic_step;
+    unsigned int            dynamic_chunksize;
 };
 
 struct vcomp_team_data
@@ -94,28 +103,31 @@ struct vcomp_team_data
     void                    *wrapper;
     __ms_va_list            valist;
 
-    /* barrier */
+    /* barrier, threads only go to sleep on lock/wait_cond after spinning */
     unsigned int            barrier;
-    int                     barrier_count;
+    LONG                    barrier_count;
+    SRWLOCK                 lock;
+    CONDITION_VARIABLE      wait_cond;
+    LONG                    waiters;
 };
 
+/* Work sharing state is updated without locks. The section and dynamic
+ * states pack the construct generation into the high and the progress into
+ * the low 32 bits, so that a thread still working on an earlier construct
+ * can never claim work of a later one. All threads pass the same construct
+ * parameters, so every thread keeps its own copy of them; with nowait a
+ * thread may already start the next construct while others still use the
+ * parameters of the previous one. */
 struct vcomp_task_data
 {
     /* single */
     unsigned int            single;
 
     /* section */
-    unsigned int            section;
-    int                     num_sections;
-    int                     section_index;
+    LONG64                  section_state;      /* generation, next section index */
 
     /* dynamic */
-    unsigned int            dynamic;
-    unsigned int            dynamic_first;
-    unsigned int            dynamic_last;
-    unsigned int            dynamic_iterations;
-    int                     dynamic_step;
-    unsigned int            dynamic_chunksize;
+    LONG64                  dynamic_state;      /* generation, remaining iterations */
 };
 
 #if defined(__i386__)
@@ -237,6 +249,77 @@ static void CDECL _vcomp_fork_call_wrapper(void *wrapper, int nargs, __ms_va_lis
 
 #endif
 
+static inline void small_pause(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+    __asm__ __volatile__( "" : : : "memory" );
+#endif
+}
+
+static inline LONG64 vcomp_read64(LONG64 *ptr)
+{
+#ifdef _WIN64
+    return *(volatile LONG64 *)ptr;
+#else
+    return interlocked_cmpxchg64(ptr, 0, 0);
+#endif
+}
+
+static inline unsigned int state_generation(LONG64 state)
+{
+    return (ULONG64)state >> 32;
+}
+
+static inline unsigned int state_value(LONG64 state)
+{
+    return (unsigned int)state;
+}
+
+static inline LONG64 make_state(unsigned int generation, unsigned int value)
+{
+    return ((ULONG64)generation << 32) | value;
+}
+
+/* spinning only helps when every thread of the team has a processor */
+static inline BOOL vcomp_should_spin(int num_threads)
+{
+    return num_threads <= vcomp_max_threads;
+}
+
+/* wait until *ptr no longer equals value */
+static void vcomp_team_wait(struct vcomp_team_data *team, volatile unsigned int *ptr, unsigned int value)
+{
+    int i;
+
+    if (vcomp_should_spin(team->num_threads))
+    {
+        for (i = 0; i < VCOMP_SPIN_COUNT; i++)
+        {
+            if (*ptr != value) return;
+            small_pause();
+        }
+    }
+
+    AcquireSRWLockExclusive(&team->lock);
+    interlocked_xchg_add(&team->waiters, 1);
+    while (*ptr == value)
+        SleepConditionVariableSRW(&team->wait_cond, &team->lock, INFINITE, 0);
+    interlocked_xchg_add(&team->waiters, -1);
+    ReleaseSRWLockExclusive(&team->lock);
+}
+
+/* wake threads sleeping in vcomp_team_wait, the caller has to update the
+ * watched value with an interlocked operation first */
+static void vcomp_team_wake(struct vcomp_team_data *team)
+{
+    if (!*(volatile LONG *)&team->waiters) return;
+    AcquireSRWLockExclusive(&team->lock);
+    ReleaseSRWLockExclusive(&team->lock);
+    WakeAllConditionVariable(&team->wait_cond);
+}
+
 static inline struct vcomp_thread_data *vcomp_get_thread_data(void)
 {
     return (struct vcomp_thread_data *)TlsGetValue(vcomp_context_tls);
@@ -264,8 +347,8 @@ static struct vcomp_thread_data *vcomp_init_thread_data(void)
     }
 
     data->task.single           = 0;
-    data->task.section          = 0;
-    data->task.dynamic          = 0;
+    data->task.section_state    = 0;
+    data->task.dynamic_state    = 0;
 
     thread_data = &data->thread;
     thread_data->team           = NULL;
@@ -512,26 +595,24 @@ void CDECL _vcomp_flush(void)
 void CDECL _vcomp_barrier(void)
 {
     struct vcomp_team_data *team_data = vcomp_init_thread_data()->team;
+    unsigned int barrier;
 
     TRACE("()\n");
 
     if (!team_data)
         return;
 
-    EnterCriticalSection(&vcomp_section);
-    if (++team_data->barrier_count >= team_data->num_threads)
+    /* The barrier counter is flipped by the last thread to arrive, it is read
+     * before arriving so it can't have advanced yet. */
+    barrier = *(volatile unsigned int *)&team_data->barrier;
+    if (interlocked_xchg_add(&team_data->barrier_count, 1) + 1 >= team_data->num_threads)
     {
-        team_data->barrier++;
         team_data->barrier_count = 0;
-        WakeAllConditionVariable(&team_data->cond);
+        interlocked_xchg_add((LONG *)&team_data->barrier, 1);
+        vcomp_team_wake(team_data);
     }
     else
-    {
-        unsigned int barrier = team_data->barrier;
-        while (team_data->barrier == barrier)
-            SleepConditionVariableCS(&team_data->cond, &vcomp_section, INFINITE);
-    }
-    LeaveCriticalSection(&vcomp_section);
+        vcomp_team_wait(team_data, &team_data->barrier, barrier);
 }
 
 void CDECL _vcomp_set_num_threads(int num_threads)
@@ -557,20 +638,20 @@ int CDECL _vcomp_single_begin(int flags)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int ret = FALSE;
+    unsigned int single, prev;
 
     TRACE("(%x): semi-stub\n", flags);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->single++;
-    if ((int)(thread_data->single - task_data->single) > 0)
+    single = *(volatile unsigned int *)&task_data->single;
+    while ((int)(thread_data->single - single) > 0)
     {
-        task_data->single = thread_data->single;
-        ret = TRUE;
+        prev = interlocked_cmpxchg((int *)&task_data->single, thread_data->single, single);
+        if (prev == single) return TRUE;
+        single = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
 
-    return ret;
+    return FALSE;
 }
 
 void CDECL _vcomp_single_end(void)
@@ -583,36 +664,42 @@ void CDECL _vcomp_sections_init(int n)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
+    LONG64 state, prev;
 
     TRACE("(%d)\n", n);
 
-    EnterCriticalSection(&vcomp_section);
     thread_data->section++;
-    if ((int)(thread_data->section - task_data->section) > 0)
+    thread_data->num_sections = n;
+    state = vcomp_read64(&task_data->section_state);
+    while ((int)(thread_data->section - state_generation(state)) > 0)
     {
-        task_data->section       = thread_data->section;
-        task_data->num_sections  = n;
-        task_data->section_index = 0;
+        prev = interlocked_cmpxchg64(&task_data->section_state, make_state(thread_data->section, 0), state);
+        if (prev == state) break;
+        state = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
 }
 
 int CDECL _vcomp_sections_next(void)
 {
     struct vcomp_thread_data *thread_data = vcomp_init_thread_data();
     struct vcomp_task_data *task_data = thread_data->task;
-    int i = -1;
+    LONG64 state, prev;
+    int i;
 
     TRACE("()\n");
 
-    EnterCriticalSection(&vcomp_section);
-    if (thread_data->section == task_data->section &&
-        task_data->section_index != task_data->num_sections)
+    state = vcomp_read64(&task_data->section_state);
+    for (;;)
     {
-        i = task_data->section_index++;
+        if (state_generation(state) != thread_data->section)
+            return -1;
+        i = state_value(state);
+        if (i >= thread_data->num_sections)
+            return -1;
+        prev = interlocked_cmpxchg64(&task_data->section_state, state + 1, state);
+        if (prev == state) return i;
+        state = prev;
     }
-    LeaveCriticalSection(&vcomp_section);
-    return i;
 }
 
 void CDECL _vcomp_for_static_simple_init(unsigned int first, unsigned int last, int step,
@@ -745,6 +832,7 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
     int num_threads = team_data ? team_data->num_threads : 1;
     int thread_num = thread_data->thread_num;
     unsigned int type = flags & ~VCOMP_DYNAMIC_FLAGS_INCREMENT;
+    LONG64 state, prev;
 
     TRACE("(%u, %u, %u, %d, %u)\n", flags, first, last, step, chunksize);
 
@@ -790,19 +878,21 @@ void CDECL _vcomp_for_dynamic_init(unsigned int flags, unsigned int first, unsig
             type = VCOMP_DYNAMIC_FLAGS_GUIDED;
         }
 
-        EnterCriticalSection(&vcomp_section);
         thread_data->dynamic++;
-        thread_data->dynamic_type = type;
-        if ((int)(thread_data->dynamic - task_data->dynamic) > 0)
+        thread_data->dynamic_type       = type;
+        thread_data->dynamic_first      = first;
+        thread_data->dynamic_last       = last;
+        thread_data->dynamic_iterations = iterations;
+        thread_data->dynamic_step       = step;
+        thread_data->dynamic_chunksize  = chunksize;
+        state = vcomp_read64(&task_data->dynamic_state);
+        while ((int)(thread_data->dynamic - state_generation(state)) > 0)
         {
-            task_data->dynamic              = thread_data->dynamic;
-            task_data->dynamic_first        = first;
-            task_data->dynamic_last         = last;
-            task_data->dynamic_iterations   = iterations;
-            task_data->dynamic_step         = step;
-            task_data->dynamic_chunksize    = chunksize;
+            prev = interlocked_cmpxchg64(&task_data->dynamic_state,
+                                         make_state(thread_data->dynamic, iterations), state);
+            if (prev == state) break;
+            state = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
     }
 }
 
@@ -825,26 +915,43 @@ int CDECL _vcomp_for_dynamic_next(unsigned int *begin, unsigned int *end)
     else if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_CHUNKED ||
              thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED)
     {
-        unsigned int iterations = 0;
-        EnterCriticalSection(&vcomp_section);
-        if (thread_data->dynamic == task_data->dynamic &&
-            task_data->dynamic_iterations != 0)
+        unsigned int iterations, remaining, first, last, total, chunksize;
+        LONG64 state, prev;
+        int step;
+
+        first       = thread_data->dynamic_first;
+        last        = thread_data->dynamic_last;
+        total       = thread_data->dynamic_iterations;
+        step        = thread_data->dynamic_step;
+        chunksize   = thread_data->dynamic_chunksize;
+
+        state = vcomp_read64(&task_data->dynamic_state);
+        for (;;)
         {
-            iterations = min(task_data->dynamic_iterations, task_data->dynamic_chunksize);
+            if (state_generation(state) != thread_data->dynamic)
+                return 0;
+            if (!(remaining = state_value(state)))
+                return 0;
+
+            iterations = min(remaining, chunksize);
             if (thread_data->dynamic_type == VCOMP_DYNAMIC_FLAGS_GUIDED &&
-                task_data->dynamic_iterations > num_threads * task_data->dynamic_chunksize)
+                remaining > num_threads * chunksize)
             {
-                iterations = (task_data->dynamic_iterations + num_threads - 1) / num_threads;
+                iterations = (remaining + num_threads - 1) / num_threads;
             }
-            *begin = task_data->dynamic_first;
-            *end   = task_data->dynamic_first + (iterations - 1) * task_data->dynamic_step;
-            task_data->dynamic_iterations -= iterations;
-            task_data->dynamic_first      += iterations * task_data->dynamic_step;
-            if (!task_data->dynamic_iterations)
-                *end = task_data->dynamic_last;
+            if (!iterations)
+                return 0;
+
+            prev = interlocked_cmpxchg64(&task_data->dynamic_state, state - iterations, state);
+            if (prev == state) break;
+            state = prev;
         }
-        LeaveCriticalSection(&vcomp_section);
-        return iterations != 0;
+
+        *begin = first + (total - remaining) * step;
+        *end   = *begin + (iterations - 1) * step;
+        if (iterations == remaining)
+            *end = last;
+        return 1;
     }
 
     return 0;
@@ -869,6 +976,8 @@ static DWORD WINAPI _vcomp_fork_worker(void *param)
         struct vcomp_team_data *team = thread_data->team;
         if (team != NULL)
         {
+            BOOL spin = vcomp_should_spin(team->num_threads);
+
             LeaveCriticalSection(&vcomp_section);
             _vcomp_fork_call_wrapper(team->wrapper, team->nargs, team->valist);
             EnterCriticalSection(&vcomp_section);
@@ -876,8 +985,20 @@ static DWORD WINAPI _vcomp_fork_worker(void *param)
             thread_data->team = NULL;
             list_remove(&thread_data->entry);
             list_add_tail(&vcomp_idle_threads, &thread_data->entry);
-            if (++team->finished_threads >= team->num_threads)
+            if (interlocked_xchg_add(&team->finished_threads, 1) + 1 >= team->num_threads)
                 WakeAllConditionVariable(&team->cond);
+
+            /* parallel regions often follow each other closely, so poll for
+             * the next one for a while before going to sleep */
+            if (spin)
+            {
+                int i;
+                LeaveCriticalSection(&vcomp_section);
+                for (i = 0; i < VCOMP_SPIN_COUNT && !*(struct vcomp_team_data * volatile *)&thread_data->team; i++)
+                    small_pause();
+                EnterCriticalSection(&vcomp_section);
+                continue;
+            }
         }
 
         if (!SleepConditionVariableCS(&thread_data->cond, &vcomp_section, 5000) &&
@@ -925,10 +1046,13 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
     __ms_va_start(team_data.valist, wrapper);
     team_data.barrier           = 0;
     team_data.barrier_count     = 0;
+    InitializeSRWLock(&team_data.lock);
+    InitializeConditionVariable(&team_data.wait_cond);
+    team_data.waiters           = 0;
 
     task_data.single            = 0;
-    task_data.section           = 0;
-    task_data.dynamic           = 0;
+    task_data.section_state     = 0;
+    task_data.dynamic_state     = 0;
 
     thread_data.team            = &team_data;
     thread_data.task            = &task_data;
@@ -1010,6 +1134,15 @@ void WINAPIV _vcomp_fork(BOOL ifval, int nargs, void *wrapper, ...)
 
     if (team_data.num_threads > 1)
     {
+        if (vcomp_should_spin(team_data.num_threads))
+        {
+            int i;
+            for (i = 0; i < VCOMP_SPIN_COUNT &&
+                 *(volatile int *)&team_data.finished_threads < team_data.num_threads - 1; i++)
+                small_pause();
+        }
+
+        /* always take the lock, the last worker may still be using team_data */
         EnterCriticalSection(&vcomp_section);
 
         team_data.finished_threads++;
@@ -1166,6 +1166,68 @@ static void test_vcomp_for_dynamic_init(void)
     pomp_set_num_threads(max_threads);
 }
 
+static void CDECL nowait_cb(LONG *a, LONG *b, LONG *c, LONG *d)
+{
+    unsigned int begin, end, j;
+    int i, k;
+
+    /* no barriers between the constructs, threads finishing early start the
+     * next one while others are still working on the previous one */
+    for (k = 0; k < 100; k++)
+    {
+        p_vcomp_sections_init(3);
+        while ((i = p_vcomp_sections_next()) != -1)
+        {
+            ok(i >= 0 && i < 3, "got section %d\n", i);
+            InterlockedIncrement(a);
+        }
+
+        p_vcomp_sections_init(50);
+        while ((i = p_vcomp_sections_next()) != -1)
+        {
+            ok(i >= 0 && i < 50, "got section %d\n", i);
+            InterlockedIncrement(b);
+        }
+
+        p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_CHUNKED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, 9, 1, 1);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+        {
+            ok(begin <= end && end <= 9, "got begin %u, end %u\n", begin, end);
+            for (j = begin; j <= end && j <= 9; j++)
+                InterlockedExchangeAdd(c, j);
+        }
+
+        p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_CHUNKED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 1000, 1999, 1, 7);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+        {
+            ok(begin >= 1000 && begin <= end && end <= 1999, "got begin %u, end %u\n", begin, end);
+            for (j = begin; j <= end && j <= 1999; j++)
+                InterlockedExchangeAdd(d, j);
+        }
+    }
+}
+
+static void test_vcomp_nowait(void)
+{
+    int max_threads = pomp_get_max_threads();
+    LONG a, b, c, d;
+    int i;
+
+    for (i = 1; i <= 4; i++)
+    {
+        pomp_set_num_threads(i);
+
+        a = b = c = d = 0;
+        p_vcomp_fork(TRUE, 4, nowait_cb, &a, &b, &c, &d);
+        ok(a == 300, "expected a == 300, got %d\n", a);
+        ok(b == 5000, "expected b == 5000, got %d\n", b);
+        ok(c == 4500, "expected c == 4500, got %d\n", c);
+        ok(d == 149950000, "expected d == 149950000, got %d\n", d);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 static void CDECL master_cb(HANDLE semaphore)
 {
     int num_threads = pomp_get_num_threads();
@@ -1486,6 +1548,129 @@ static void test_atomic_double(void)
     }
 }
 
+static void CDECL barrier_cb(LONG *counters)
+{
+    int num_threads = pomp_get_num_threads();
+    int i;
+
+    for (i = 0; i < 100; i++)
+    {
+        InterlockedIncrement(&counters[i]);
+        p_vcomp_barrier();
+        ok(counters[i] == num_threads, "expected counters[%d] == %d, got %d\n", i, num_threads, counters[i]);
+    }
+}
+
+static void CDECL for_dynamic_sum_cb(LONG *sum)
+{
+    unsigned int begin, end, i;
+    int j;
+
+    /* back to back loops without barriers in between */
+    for (j = 0; j < 100; j++)
+    {
+        p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_CHUNKED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, 99, 1, 1);
+        while (p_vcomp_for_dynamic_next(&begin, &end))
+        {
+            for (i = begin; i <= end; i++)
+                InterlockedExchangeAdd(sum, i);
+        }
+    }
+}
+
+static void test_vcomp_barrier(void)
+{
+    int max_threads = pomp_get_max_threads();
+    LONG counters[100], sum;
+    int i;
+
+    for (i = 1; i <= 4; i++)
+    {
+        pomp_set_num_threads(i);
+
+        memset(counters, 0, sizeof(counters));
+        p_vcomp_fork(TRUE, 1, barrier_cb, counters);
+
+        sum = 0;
+        p_vcomp_fork(TRUE, 1, for_dynamic_sum_cb, &sum);
+        ok(sum == 100 * 4950, "expected sum == %d, got %d\n", 100 * 4950, sum);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
+static void CDECL perf_barrier_cb(LONG *count)
+{
+    int i;
+    for (i = 0; i < *count; i++)
+        p_vcomp_barrier();
+}
+
+static void CDECL perf_empty_cb(void)
+{
+}
+
+static void CDECL perf_for_dynamic_cb(LONG *count, LONG *sum)
+{
+    unsigned int begin, end, i;
+    LONG local = 0;
+
+    p_vcomp_for_dynamic_init(VCOMP_DYNAMIC_FLAGS_CHUNKED | VCOMP_DYNAMIC_FLAGS_INCREMENT, 0, *count - 1, 1, 1);
+    while (p_vcomp_for_dynamic_next(&begin, &end))
+    {
+        for (i = begin; i <= end; i++)
+            local += i & 1;
+    }
+    InterlockedExchangeAdd(sum, local);
+}
+
+static double elapsed_us(LARGE_INTEGER *start, LARGE_INTEGER *freq)
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (now.QuadPart - start->QuadPart) * 1000000.0 / freq->QuadPart;
+}
+
+static void test_performance(void)
+{
+    int max_threads = pomp_get_max_threads();
+    LARGE_INTEGER freq, start;
+    LONG count, sum;
+    int i, threads;
+
+    if (!winetest_interactive)
+    {
+        skip("performance tests, set WINETEST_INTERACTIVE=1 to run them\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&freq);
+
+    for (threads = 1; threads <= max(max_threads, 4); threads++)
+    {
+        pomp_set_num_threads(threads);
+
+        count = 100000;
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 1, perf_barrier_cb, &count);
+        trace("%d threads: barrier %.3f us\n", threads, elapsed_us(&start, &freq) / count);
+
+        QueryPerformanceCounter(&start);
+        for (i = 0; i < 10000; i++)
+            p_vcomp_fork(TRUE, 0, perf_empty_cb);
+        trace("%d threads: empty parallel region %.3f us\n", threads, elapsed_us(&start, &freq) / 10000);
+
+        count = 1000000;
+        sum = 0;
+        QueryPerformanceCounter(&start);
+        p_vcomp_fork(TRUE, 2, perf_for_dynamic_cb, &count, &sum);
+        trace("%d threads: dynamic for %.3f us per iteration\n", threads, elapsed_us(&start, &freq) / count);
+        ok(sum == count / 2, "expected sum == %d, got %d\n", count / 2, sum);
+    }
+
+    pomp_set_num_threads(max_threads);
+}
+
 START_TEST(vcomp)
 {
     if (!init_vcomp())
@@ -1498,6 +1683,8 @@ START_TEST(vcomp)
     test_vcomp_for_static_simple_init();
     test_vcomp_for_static_init();
     test_vcomp_for_dynamic_init();
+    test_vcomp_nowait();
+    test_vcomp_barrier();
     test_vcomp_master_begin();
     test_vcomp_single_begin();
     test_vcomp_enter_critsect();
@@ -1507,6 +1694,7 @@ START_TEST(vcomp)
     test_atomic_integer32();
     test_atomic_float();
     test_atomic_double();
+    test_performance();
 
     release_vcomp();
 }
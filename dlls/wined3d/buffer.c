@@ -36,6 +36,7 @@ WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 #define WINED3D_BUFFER_DISCARD      0x10    /* A DISCARD lock has occurred since the last preload. */
 #define WINED3D_BUFFER_SYNC         0x20    /* There has been at least one synchronized map since the last preload. */
 #define WINED3D_BUFFER_APPLESYNC    0x40    /* Using sync as in GL_APPLE_flush_buffer_range. */
+#define WINED3D_BUFFER_NOWAIT       0x80    /* Mapped without waiting for the command stream. */
 
 #define VB_MAXDECLCHANGES     100     /* After that number of decl changes we stop converting */
 #define VB_RESETDECLCHANGE    1000    /* Reset the decl changecount after that number of draws */
@@ -552,6 +553,7 @@ ULONG CDECL wined3d_buffer_decref(struct wined3d_buffer *buffer)
 
     if (!refcount)
     {
+        wined3d_cs_finish(buffer->resource.device->cs);
         if (buffer->buffer_object)
         {
             context = context_acquire(buffer->resource.device, NULL);
@@ -937,14 +939,36 @@ struct wined3d_resource * CDECL wined3d_buffer_get_resource(struct wined3d_buffe
     return &buffer->resource;
 }
 
+/* NOOVERWRITE maps that go directly to the buffer object don't touch anything
+ * the queued commands may still use, so they don't need to wait for the
+ * command stream. */
+static BOOL buffer_map_nowait(const struct wined3d_buffer *buffer, DWORD flags)
+{
+    const struct wined3d_gl_info *gl_info = &buffer->resource.device->adapter->gl_info;
+
+    return (flags & WINED3D_MAP_NOOVERWRITE) && buffer->buffer_object && !buffer->conversion_map
+            && !(buffer->flags & WINED3D_BUFFER_DOUBLEBUFFER) && gl_info->supported[ARB_MAP_BUFFER_RANGE];
+}
+
 HRESULT CDECL wined3d_buffer_map(struct wined3d_buffer *buffer, UINT offset, UINT size, BYTE **data, DWORD flags)
 {
+    BOOL nowait;
     LONG count;
     BYTE *base;
 
     TRACE("buffer %p, offset %u, size %u, data %p, flags %#x\n", buffer, offset, size, data, flags);
 
     flags = wined3d_resource_sanitize_map_flags(&buffer->resource, flags);
+    if (!(nowait = buffer_map_nowait(buffer, flags)))
+    {
+        wined3d_cs_finish(buffer->resource.device->cs);
+        buffer->flags &= ~WINED3D_BUFFER_NOWAIT;
+    }
+    else if (!buffer->resource.map_count)
+    {
+        buffer->flags |= WINED3D_BUFFER_NOWAIT;
+    }
+
     /* Filter redundant WINED3D_MAP_DISCARD maps. The 3DMark2001 multitexture
      * fill rate test seems to depend on this. When we map a buffer with
      * GL_MAP_INVALIDATE_BUFFER_BIT, the driver is free to discard the
@@ -974,7 +998,7 @@ HRESULT CDECL wined3d_buffer_map(struct wined3d_buffer *buffer, UINT offset, UIN
                 struct wined3d_context *context;
                 const struct wined3d_gl_info *gl_info;
 
-                context = context_acquire(device, NULL);
+                context = nowait ? context_acquire_nowait(device, NULL) : context_acquire(device, NULL);
                 gl_info = context->gl_info;
 
                 if (buffer->buffer_type_hint == GL_ELEMENT_ARRAY_BUFFER_ARB)
@@ -1070,10 +1094,11 @@ void CDECL wined3d_buffer_unmap(struct wined3d_buffer *buffer)
     if (!(buffer->flags & WINED3D_BUFFER_DOUBLEBUFFER) && buffer->buffer_object)
     {
         struct wined3d_device *device = buffer->resource.device;
+        BOOL nowait = buffer->flags & WINED3D_BUFFER_NOWAIT;
         const struct wined3d_gl_info *gl_info;
         struct wined3d_context *context;
 
-        context = context_acquire(device, NULL);
+        context = nowait ? context_acquire_nowait(device, NULL) : context_acquire(device, NULL);
         gl_info = context->gl_info;
 
         if (buffer->buffer_type_hint == GL_ELEMENT_ARRAY_BUFFER_ARB)
@@ -1100,8 +1125,11 @@ void CDECL wined3d_buffer_unmap(struct wined3d_buffer *buffer)
         }
 
         GL_EXTCALL(glUnmapBuffer(buffer->buffer_type_hint));
-        if (wined3d_settings.strict_draw_ordering)
-            gl_info->gl_ops.gl.p_glFlush(); /* Flush to ensure ordering across contexts. */
+        /* Flush to ensure ordering across contexts. Commands queued after a
+         * NOOVERWRITE map are executed by the command stream thread. */
+        if (wined3d_settings.strict_draw_ordering || nowait)
+            gl_info->gl_ops.gl.p_glFlush();
+        buffer->flags &= ~WINED3D_BUFFER_NOWAIT;
         context_release(context);
 
         buffer_clear_dirty_areas(buffer);
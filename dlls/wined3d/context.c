@@ -1170,6 +1170,8 @@ BOOL context_set_current(struct wined3d_context *ctx)
 
 void context_release(struct wined3d_context *context)
 {
+    const struct wined3d_cs *cs = context->swapchain->device->cs;
+
     TRACE("Releasing context %p, level %u.\n", context, context->level);
 
     if (WARN_ON(d3d))
@@ -1182,6 +1184,10 @@ void context_release(struct wined3d_context *context)
 
     if (!--context->level)
     {
+        /* Make changes done by application threads visible to the command
+         * stream thread. */
+        if (cs && cs->thread && cs->thread_id != GetCurrentThreadId())
+            context->gl_info->gl_ops.gl.p_glFlush();
         if (context_restore_pixel_format(context))
             context->needs_set = 1;
         if (context->restore_ctx)
@@ -2371,7 +2377,7 @@ BOOL context_apply_clear_state(struct wined3d_context *context, const struct win
     DWORD rt_mask = 0, *cur_mask;
     UINT i;
 
-    if (isStateDirty(context, STATE_FRAMEBUFFER) || fb != &device->fb
+    if (isStateDirty(context, STATE_FRAMEBUFFER) || fb != &device->cs->fb
             || rt_count != context->gl_info->limits.buffers)
     {
         if (!context_validate_rt_config(rt_count, rts, dsv))
@@ -2465,7 +2471,7 @@ BOOL context_apply_clear_state(struct wined3d_context *context, const struct win
 
 static DWORD find_draw_buffers_mask(const struct wined3d_context *context, const struct wined3d_device *device)
 {
-    const struct wined3d_state *state = &device->state;
+    const struct wined3d_state *state = &device->cs->state;
     struct wined3d_rendertarget_view **rts = state->fb->render_targets;
     struct wined3d_shader *ps = state->shader[WINED3D_SHADER_TYPE_PIXEL];
     DWORD rt_mask, rt_mask_bits;
@@ -3150,7 +3156,7 @@ static void context_bind_shader_resources(struct wined3d_context *context, const
 /* Context activation is done by the caller. */
 BOOL context_apply_draw_state(struct wined3d_context *context, struct wined3d_device *device)
 {
-    const struct wined3d_state *state = &device->state;
+    const struct wined3d_state *state = &device->cs->state;
     const struct StateEntry *state_table = context->state_table;
     const struct wined3d_fb_state *fb = state->fb;
     unsigned int i;
@@ -3289,7 +3295,9 @@ static void context_setup_target(struct wined3d_context *context, struct wined3d
     context_set_render_offscreen(context, render_offscreen);
 }
 
-struct wined3d_context *context_acquire(const struct wined3d_device *device, struct wined3d_surface *target)
+/* Like context_acquire(), but doesn't wait for the command stream. Only use
+ * this for accesses that can't conflict with the queued commands. */
+struct wined3d_context *context_acquire_nowait(const struct wined3d_device *device, struct wined3d_surface *target)
 {
     struct wined3d_context *current_context = context_get_current();
     struct wined3d_context *context;
@@ -3356,3 +3364,27 @@ struct wined3d_context *context_acquire(const struct wined3d_device *device, str
 
     return context;
 }
+
+struct wined3d_context *context_acquire(const struct wined3d_device *device, struct wined3d_surface *target)
+{
+    struct wined3d_cs *cs = device->cs;
+    const struct wined3d_gl_info *gl_info;
+    struct wined3d_context *context;
+
+    /* Commands in the command stream may still use the objects the caller
+     * is about to access. */
+    wined3d_cs_finish(cs);
+
+    context = context_acquire_nowait(device, target);
+
+    /* The command stream thread only flushed its context, make sure our
+     * commands are executed after its commands. */
+    if (context->valid && cs && cs->finish_sync && cs->thread_id != GetCurrentThreadId())
+    {
+        gl_info = context->gl_info;
+        GL_EXTCALL(glWaitSync(cs->finish_sync, 0, GL_TIMEOUT_IGNORED));
+        checkGLcall("glWaitSync");
+    }
+
+    return context;
+}
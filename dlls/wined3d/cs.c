@@ -23,6 +23,8 @@
 WINE_DEFAULT_DEBUG_CHANNEL(d3d);
 
 #define WINED3D_INITIAL_CS_SIZE 4096
+#define WINED3D_CS_SPIN_COUNT 10000u
+#define WINED3D_CS_MAX_FRAMES_AHEAD 1
 
 enum wined3d_cs_op
 {
@@ -51,7 +53,21 @@ enum wined3d_cs_op
     WINED3D_CS_OP_SET_CLIP_PLANE,
     WINED3D_CS_OP_SET_COLOR_KEY,
     WINED3D_CS_OP_SET_MATERIAL,
+    WINED3D_CS_OP_SET_CONSTANTS,
+    WINED3D_CS_OP_SET_LIGHT,
+    WINED3D_CS_OP_SET_LIGHT_ENABLE,
     WINED3D_CS_OP_RESET_STATE,
+    WINED3D_CS_OP_QUERY_ISSUE,
+    WINED3D_CS_OP_QUERY_GET_DATA,
+    WINED3D_CS_OP_FINISH,
+    WINED3D_CS_OP_STOP,
+    WINED3D_CS_OP_INDIRECT,
+};
+
+struct wined3d_cs_packet
+{
+    size_t size;
+    BYTE data[1];
 };
 
 struct wined3d_cs_present
@@ -59,26 +75,29 @@ struct wined3d_cs_present
     enum wined3d_cs_op opcode;
     HWND dst_window_override;
     struct wined3d_swapchain *swapchain;
-    const RECT *src_rect;
-    const RECT *dst_rect;
-    const RGNDATA *dirty_region;
+    RECT src_rect;
+    RECT dst_rect;
+    BOOL set_src_rect;
+    BOOL set_dst_rect;
     DWORD flags;
 };
 
 struct wined3d_cs_clear
 {
     enum wined3d_cs_op opcode;
-    DWORD rect_count;
-    const RECT *rects;
     DWORD flags;
-    const struct wined3d_color *color;
+    struct wined3d_color color;
     float depth;
     DWORD stencil;
+    DWORD rect_count;
+    RECT rects[1];
 };
 
 struct wined3d_cs_draw
 {
     enum wined3d_cs_op opcode;
+    GLenum primitive_type;
+    INT base_vertex_idx;
     UINT start_idx;
     UINT index_count;
     UINT start_instance;
@@ -96,13 +115,13 @@ struct wined3d_cs_set_predication
 struct wined3d_cs_set_viewport
 {
     enum wined3d_cs_op opcode;
-    const struct wined3d_viewport *viewport;
+    struct wined3d_viewport viewport;
 };
 
 struct wined3d_cs_set_scissor_rect
 {
     enum wined3d_cs_op opcode;
-    const RECT *rect;
+    RECT rect;
 };
 
 struct wined3d_cs_set_rendertarget_view
@@ -230,20 +249,42 @@ struct wined3d_cs_set_transform
 {
     enum wined3d_cs_op opcode;
     enum wined3d_transform_state state;
-    const struct wined3d_matrix *matrix;
+    struct wined3d_matrix matrix;
 };
 
 struct wined3d_cs_set_clip_plane
 {
     enum wined3d_cs_op opcode;
     UINT plane_idx;
-    const struct wined3d_vec4 *plane;
+    struct wined3d_vec4 plane;
 };
 
 struct wined3d_cs_set_material
 {
     enum wined3d_cs_op opcode;
-    const struct wined3d_material *material;
+    struct wined3d_material material;
+};
+
+struct wined3d_cs_set_constants
+{
+    enum wined3d_cs_op opcode;
+    DWORD type;
+    UINT start_idx;
+    UINT count;
+    DWORD data[1];
+};
+
+struct wined3d_cs_set_light
+{
+    enum wined3d_cs_op opcode;
+    struct wined3d_light_info light;
+};
+
+struct wined3d_cs_set_light_enable
+{
+    enum wined3d_cs_op opcode;
+    UINT light_idx;
+    BOOL enable;
 };
 
 struct wined3d_cs_reset_state
@@ -251,6 +292,39 @@ struct wined3d_cs_reset_state
     enum wined3d_cs_op opcode;
 };
 
+struct wined3d_cs_query_issue
+{
+    enum wined3d_cs_op opcode;
+    struct wined3d_query *query;
+    DWORD flags;
+};
+
+struct wined3d_cs_query_get_data
+{
+    enum wined3d_cs_op opcode;
+    struct wined3d_query *query;
+    void *data;
+    UINT data_size;
+    DWORD flags;
+    HRESULT *hr;
+};
+
+struct wined3d_cs_finish
+{
+    enum wined3d_cs_op opcode;
+};
+
+struct wined3d_cs_stop
+{
+    enum wined3d_cs_op opcode;
+};
+
+struct wined3d_cs_indirect
+{
+    enum wined3d_cs_op opcode;
+    void *data;
+};
+
 static void wined3d_cs_exec_present(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_present *op = data;
@@ -259,8 +333,12 @@ static void wined3d_cs_exec_present(struct wined3d_cs *cs, const void *data)
     swapchain = op->swapchain;
     wined3d_swapchain_set_window(swapchain, op->dst_window_override);
 
-    swapchain->swapchain_ops->swapchain_present(swapchain,
-            op->src_rect, op->dst_rect, op->dirty_region, op->flags);
+    swapchain->swapchain_ops->swapchain_present(swapchain, op->set_src_rect ? &op->src_rect : NULL,
+            op->set_dst_rect ? &op->dst_rect : NULL, NULL, op->flags);
+
+    InterlockedDecrement(&cs->pending_presents);
+    if (cs->present_event)
+        SetEvent(cs->present_event);
 }
 
 void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *swapchain,
@@ -269,13 +347,23 @@ void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *sw
 {
     struct wined3d_cs_present *op;
 
+    /* Don't let the application get more than WINED3D_CS_MAX_FRAMES_AHEAD
+     * frames ahead of the command stream thread. */
+    if (cs->thread)
+    {
+        while (*(volatile LONG *)&cs->pending_presents >= WINED3D_CS_MAX_FRAMES_AHEAD)
+            WaitForSingleObject(cs->present_event, INFINITE);
+    }
+    InterlockedIncrement(&cs->pending_presents);
+
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_PRESENT;
     op->dst_window_override = dst_window_override;
     op->swapchain = swapchain;
-    op->src_rect = src_rect;
-    op->dst_rect = dst_rect;
-    op->dirty_region = dirty_region;
+    if ((op->set_src_rect = !!src_rect))
+        op->src_rect = *src_rect;
+    if ((op->set_dst_rect = !!dst_rect))
+        op->dst_rect = *dst_rect;
     op->flags = flags;
 
     cs->ops->submit(cs);
@@ -288,10 +376,10 @@ static void wined3d_cs_exec_clear(struct wined3d_cs *cs, const void *data)
     RECT draw_rect;
 
     device = cs->device;
-    wined3d_get_draw_rect(&device->state, &draw_rect);
+    wined3d_get_draw_rect(&cs->state, &draw_rect);
     device_clear_render_targets(device, device->adapter->gl_info.limits.buffers,
-            &device->fb, op->rect_count, op->rects, &draw_rect, op->flags,
-            op->color, op->depth, op->stencil);
+            &cs->fb, op->rect_count, op->rect_count ? op->rects : NULL, &draw_rect, op->flags,
+            &op->color, op->depth, op->stencil);
 }
 
 void wined3d_cs_emit_clear(struct wined3d_cs *cs, DWORD rect_count, const RECT *rects,
@@ -299,14 +387,19 @@ void wined3d_cs_emit_clear(struct wined3d_cs *cs, DWORD rect_count, const RECT *
 {
     struct wined3d_cs_clear *op;
 
-    op = cs->ops->require_space(cs, sizeof(*op));
+    if (!rects)
+        rect_count = 0;
+
+    if (!(op = cs->ops->require_space(cs, FIELD_OFFSET(struct wined3d_cs_clear, rects[rect_count]))))
+        return;
     op->opcode = WINED3D_CS_OP_CLEAR;
-    op->rect_count = rect_count;
-    op->rects = rects;
     op->flags = flags;
-    op->color = color;
+    if (color)
+        op->color = *color;
     op->depth = depth;
     op->stencil = stencil;
+    op->rect_count = rect_count;
+    memcpy(op->rects, rects, rect_count * sizeof(*rects));
 
     cs->ops->submit(cs);
 }
@@ -314,18 +407,43 @@ void wined3d_cs_emit_clear(struct wined3d_cs *cs, DWORD rect_count, const RECT *
 static void wined3d_cs_exec_draw(struct wined3d_cs *cs, const void *data)
 {
     const struct wined3d_cs_draw *op = data;
+    const struct wined3d_gl_info *gl_info = &cs->device->adapter->gl_info;
+    struct wined3d_state *state = &cs->state;
+    INT load_base_vertex_idx;
+
+    if (op->primitive_type != state->gl_primitive_type)
+    {
+        if (op->primitive_type == GL_POINTS || state->gl_primitive_type == GL_POINTS)
+            device_invalidate_state(cs->device, STATE_POINT_ENABLE);
+        state->gl_primitive_type = op->primitive_type;
+    }
+    state->base_vertex_index = op->base_vertex_idx;
+
+    /* Non-indexed drawing needs 0 here, indexed drawing without
+     * ARB_draw_elements_base_vertex needs the base vertex index. */
+    if (op->indexed && !gl_info->supported[ARB_DRAW_ELEMENTS_BASE_VERTEX])
+        load_base_vertex_idx = op->base_vertex_idx;
+    else
+        load_base_vertex_idx = 0;
+    if (state->load_base_vertex_index != load_base_vertex_idx)
+    {
+        state->load_base_vertex_index = load_base_vertex_idx;
+        device_invalidate_state(cs->device, STATE_BASEVERTEXINDEX);
+    }
 
     draw_primitive(cs->device, op->start_idx, op->index_count,
             op->start_instance, op->instance_count, op->indexed);
 }
 
-void wined3d_cs_emit_draw(struct wined3d_cs *cs, UINT start_idx, UINT index_count,
-        UINT start_instance, UINT instance_count, BOOL indexed)
+void wined3d_cs_emit_draw(struct wined3d_cs *cs, GLenum primitive_type, INT base_vertex_idx,
+        UINT start_idx, UINT index_count, UINT start_instance, UINT instance_count, BOOL indexed)
 {
     struct wined3d_cs_draw *op;
 
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_DRAW;
+    op->primitive_type = primitive_type;
+    op->base_vertex_idx = base_vertex_idx;
     op->start_idx = start_idx;
     op->index_count = index_count;
     op->start_instance = start_instance;
@@ -359,7 +477,7 @@ static void wined3d_cs_exec_set_viewport(struct wined3d_cs *cs, const void *data
 {
     const struct wined3d_cs_set_viewport *op = data;
 
-    cs->state.viewport = *op->viewport;
+    cs->state.viewport = op->viewport;
     device_invalidate_state(cs->device, STATE_VIEWPORT);
 }
 
@@ -369,7 +487,7 @@ void wined3d_cs_emit_set_viewport(struct wined3d_cs *cs, const struct wined3d_vi
 
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_SET_VIEWPORT;
-    op->viewport = viewport;
+    op->viewport = *viewport;
 
     cs->ops->submit(cs);
 }
@@ -378,7 +496,7 @@ static void wined3d_cs_exec_set_scissor_rect(struct wined3d_cs *cs, const void *
 {
     const struct wined3d_cs_set_scissor_rect *op = data;
 
-    cs->state.scissor_rect = *op->rect;
+    cs->state.scissor_rect = op->rect;
     device_invalidate_state(cs->device, STATE_SCISSORRECT);
 }
 
@@ -388,7 +506,7 @@ void wined3d_cs_emit_set_scissor_rect(struct wined3d_cs *cs, const RECT *rect)
 
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_SET_SCISSOR_RECT;
-    op->rect = rect;
+    op->rect = *rect;
 
     cs->ops->submit(cs);
 }
@@ -858,7 +976,7 @@ static void wined3d_cs_exec_set_transform(struct wined3d_cs *cs, const void *dat
 {
     const struct wined3d_cs_set_transform *op = data;
 
-    cs->state.transforms[op->state] = *op->matrix;
+    cs->state.transforms[op->state] = op->matrix;
     if (op->state < WINED3D_TS_WORLD_MATRIX(cs->device->adapter->d3d_info.limits.ffp_vertex_blend_matrices))
         device_invalidate_state(cs->device, STATE_TRANSFORM(op->state));
 }
@@ -871,7 +989,7 @@ void wined3d_cs_emit_set_transform(struct wined3d_cs *cs, enum wined3d_transform
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_SET_TRANSFORM;
     op->state = state;
-    op->matrix = matrix;
+    op->matrix = *matrix;
 
     cs->ops->submit(cs);
 }
@@ -880,7 +998,7 @@ static void wined3d_cs_exec_set_clip_plane(struct wined3d_cs *cs, const void *da
 {
     const struct wined3d_cs_set_clip_plane *op = data;
 
-    cs->state.clip_planes[op->plane_idx] = *op->plane;
+    cs->state.clip_planes[op->plane_idx] = op->plane;
     device_invalidate_state(cs->device, STATE_CLIPPLANE(op->plane_idx));
 }
 
@@ -891,7 +1009,7 @@ void wined3d_cs_emit_set_clip_plane(struct wined3d_cs *cs, UINT plane_idx, const
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_SET_CLIP_PLANE;
     op->plane_idx = plane_idx;
-    op->plane = plane;
+    op->plane = *plane;
 
     cs->ops->submit(cs);
 }
@@ -983,7 +1101,7 @@ static void wined3d_cs_exec_set_material(struct wined3d_cs *cs, const void *data
 {
     const struct wined3d_cs_set_material *op = data;
 
-    cs->state.material = *op->material;
+    cs->state.material = op->material;
     device_invalidate_state(cs->device, STATE_MATERIAL);
 }
 
@@ -993,7 +1111,165 @@ void wined3d_cs_emit_set_material(struct wined3d_cs *cs, const struct wined3d_ma
 
     op = cs->ops->require_space(cs, sizeof(*op));
     op->opcode = WINED3D_CS_OP_SET_MATERIAL;
-    op->material = material;
+    op->material = *material;
+
+    cs->ops->submit(cs);
+}
+
+static void wined3d_cs_exec_set_constants(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_set_constants *op = data;
+    struct wined3d_device *device = cs->device;
+
+    switch (op->type)
+    {
+        case WINED3D_SHADER_CONST_VS_F:
+            memcpy(&cs->state.vs_consts_f[op->start_idx * 4], op->data, op->count * sizeof(float) * 4);
+            device->shader_backend->shader_update_float_vertex_constants(device, op->start_idx, op->count);
+            break;
+
+        case WINED3D_SHADER_CONST_PS_F:
+            memcpy(&cs->state.ps_consts_f[op->start_idx * 4], op->data, op->count * sizeof(float) * 4);
+            device->shader_backend->shader_update_float_pixel_constants(device, op->start_idx, op->count);
+            break;
+
+        case WINED3D_SHADER_CONST_VS_I:
+            memcpy(&cs->state.vs_consts_i[op->start_idx * 4], op->data, op->count * sizeof(int) * 4);
+            device_invalidate_shader_constants(device, op->type);
+            break;
+
+        case WINED3D_SHADER_CONST_PS_I:
+            memcpy(&cs->state.ps_consts_i[op->start_idx * 4], op->data, op->count * sizeof(int) * 4);
+            device_invalidate_shader_constants(device, op->type);
+            break;
+
+        case WINED3D_SHADER_CONST_VS_B:
+            memcpy(&cs->state.vs_consts_b[op->start_idx], op->data, op->count * sizeof(BOOL));
+            device_invalidate_shader_constants(device, op->type);
+            break;
+
+        case WINED3D_SHADER_CONST_PS_B:
+            memcpy(&cs->state.ps_consts_b[op->start_idx], op->data, op->count * sizeof(BOOL));
+            device_invalidate_shader_constants(device, op->type);
+            break;
+
+        default:
+            ERR("Unhandled constant type %#x.\n", op->type);
+            break;
+    }
+}
+
+/* "type" is one of the WINED3D_SHADER_CONST_* flags. "count" is in registers,
+ * i.e. vec4s for float and integer constants. */
+void wined3d_cs_emit_set_constants(struct wined3d_cs *cs, DWORD type,
+        UINT start_idx, UINT count, const void *constants)
+{
+    struct wined3d_cs_set_constants *op;
+    size_t size;
+
+    switch (type)
+    {
+        case WINED3D_SHADER_CONST_VS_F:
+        case WINED3D_SHADER_CONST_PS_F:
+            size = count * sizeof(float) * 4;
+            break;
+
+        case WINED3D_SHADER_CONST_VS_I:
+        case WINED3D_SHADER_CONST_PS_I:
+            size = count * sizeof(int) * 4;
+            break;
+
+        default:
+            size = count * sizeof(BOOL);
+            break;
+    }
+
+    if (!(op = cs->ops->require_space(cs, FIELD_OFFSET(struct wined3d_cs_set_constants, data) + size)))
+        return;
+    op->opcode = WINED3D_CS_OP_SET_CONSTANTS;
+    op->type = type;
+    op->start_idx = start_idx;
+    op->count = count;
+    memcpy(op->data, constants, size);
+
+    cs->ops->submit(cs);
+}
+
+static void wined3d_cs_exec_set_light(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_set_light *op = data;
+    struct wined3d_light_info *light_info;
+    UINT light_idx = op->light.OriginalIndex;
+
+    if (!(light_info = wined3d_state_get_light(&cs->state, light_idx)))
+    {
+        TRACE("Adding new light.\n");
+        if (!(light_info = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*light_info))))
+        {
+            ERR("Failed to allocate light info.\n");
+            return;
+        }
+
+        list_add_head(&cs->state.light_map[LIGHTMAP_HASHFUNC(light_idx)], &light_info->entry);
+        light_info->glIndex = -1;
+        light_info->OriginalIndex = light_idx;
+    }
+
+    if (light_info->glIndex != -1)
+    {
+        if (light_info->OriginalParms.type != op->light.OriginalParms.type)
+            device_invalidate_state(cs->device, STATE_LIGHT_TYPE);
+        device_invalidate_state(cs->device, STATE_ACTIVELIGHT(light_info->glIndex));
+    }
+
+    light_info->OriginalParms = op->light.OriginalParms;
+    light_info->position = op->light.position;
+    light_info->direction = op->light.direction;
+    light_info->exponent = op->light.exponent;
+    light_info->cutoff = op->light.cutoff;
+}
+
+void wined3d_cs_emit_set_light(struct wined3d_cs *cs, const struct wined3d_light_info *light)
+{
+    struct wined3d_cs_set_light *op;
+
+    op = cs->ops->require_space(cs, sizeof(*op));
+    op->opcode = WINED3D_CS_OP_SET_LIGHT;
+    op->light = *light;
+
+    cs->ops->submit(cs);
+}
+
+static void wined3d_cs_exec_set_light_enable(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_set_light_enable *op = data;
+    struct wined3d_device *device = cs->device;
+    struct wined3d_light_info *light_info;
+    LONG prev_idx;
+
+    if (!(light_info = wined3d_state_get_light(&cs->state, op->light_idx)))
+    {
+        ERR("Light doesn't exist.\n");
+        return;
+    }
+
+    prev_idx = light_info->glIndex;
+    wined3d_state_enable_light(&cs->state, &device->adapter->gl_info, light_info, op->enable);
+    if (light_info->glIndex != prev_idx)
+    {
+        device_invalidate_state(device, STATE_LIGHT_TYPE);
+        device_invalidate_state(device, STATE_ACTIVELIGHT(op->enable ? light_info->glIndex : prev_idx));
+    }
+}
+
+void wined3d_cs_emit_set_light_enable(struct wined3d_cs *cs, UINT idx, BOOL enable)
+{
+    struct wined3d_cs_set_light_enable *op;
+
+    op = cs->ops->require_space(cs, sizeof(*op));
+    op->opcode = WINED3D_CS_OP_SET_LIGHT_ENABLE;
+    op->light_idx = idx;
+    op->enable = enable;
 
     cs->ops->submit(cs);
 }
@@ -1020,6 +1296,96 @@ void wined3d_cs_emit_reset_state(struct wined3d_cs *cs)
     cs->ops->submit(cs);
 }
 
+static void wined3d_cs_exec_query_issue(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_query_issue *op = data;
+
+    op->query->query_ops->query_issue(op->query, op->flags);
+    InterlockedDecrement(&op->query->pending_issues);
+}
+
+void wined3d_cs_emit_query_issue(struct wined3d_cs *cs, struct wined3d_query *query, DWORD flags)
+{
+    struct wined3d_cs_query_issue *op;
+
+    InterlockedIncrement(&query->pending_issues);
+    op = cs->ops->require_space(cs, sizeof(*op));
+    op->opcode = WINED3D_CS_OP_QUERY_ISSUE;
+    op->query = query;
+    op->flags = flags;
+
+    cs->ops->submit(cs);
+}
+
+static void wined3d_cs_exec_query_get_data(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_cs_query_get_data *op = data;
+
+    *op->hr = op->query->query_ops->query_get_data(op->query, op->data, op->data_size, op->flags);
+}
+
+/* Occlusion and timestamp queries are bound to the GL context they were
+ * issued in, so retrieving their results has to happen on the thread that
+ * executes the command stream. This is synchronous. */
+HRESULT wined3d_cs_emit_query_get_data(struct wined3d_cs *cs, struct wined3d_query *query,
+        void *data, UINT data_size, DWORD flags)
+{
+    struct wined3d_cs_query_get_data *op;
+    HRESULT hr;
+
+    op = cs->ops->require_space(cs, sizeof(*op));
+    op->opcode = WINED3D_CS_OP_QUERY_GET_DATA;
+    op->query = query;
+    op->data = data;
+    op->data_size = data_size;
+    op->flags = flags;
+    op->hr = &hr;
+
+    cs->ops->submit(cs);
+    wined3d_cs_finish(cs);
+
+    return hr;
+}
+
+static void wined3d_cs_exec_finish(struct wined3d_cs *cs, const void *data)
+{
+    const struct wined3d_gl_info *gl_info;
+    struct wined3d_context *context;
+
+    /* Make the results of previous commands visible to the GL contexts of
+     * other threads. A flush alone only guarantees that the commands get
+     * executed eventually; context_acquire() makes the other context wait
+     * for the fence, or we wait for completion here if there are no fences. */
+    if ((context = context_get_current()))
+    {
+        gl_info = context->gl_info;
+        if (gl_info->supported[ARB_SYNC])
+        {
+            if (cs->finish_sync)
+                GL_EXTCALL(glDeleteSync(cs->finish_sync));
+            cs->finish_sync = GL_EXTCALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+            checkGLcall("glFenceSync");
+            gl_info->gl_ops.gl.p_glFlush();
+        }
+        else
+        {
+            gl_info->gl_ops.gl.p_glFinish();
+        }
+    }
+
+    SetEvent(cs->finish_event);
+}
+
+static void wined3d_cs_exec_stop(struct wined3d_cs *cs, const void *data)
+{
+    /* Handled by wined3d_cs_run(). */
+}
+
+static void wined3d_cs_exec_indirect(struct wined3d_cs *cs, const void *data)
+{
+    /* Handled by wined3d_cs_run(). */
+}
+
 static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void *data) =
 {
     /* WINED3D_CS_OP_PRESENT                    */ wined3d_cs_exec_present,
@@ -1047,7 +1413,15 @@ static void (* const wined3d_cs_op_handlers[])(struct wined3d_cs *cs, const void
     /* WINED3D_CS_OP_SET_CLIP_PLANE             */ wined3d_cs_exec_set_clip_plane,
     /* WINED3D_CS_OP_SET_COLOR_KEY              */ wined3d_cs_exec_set_color_key,
     /* WINED3D_CS_OP_SET_MATERIAL               */ wined3d_cs_exec_set_material,
+    /* WINED3D_CS_OP_SET_CONSTANTS              */ wined3d_cs_exec_set_constants,
+    /* WINED3D_CS_OP_SET_LIGHT                  */ wined3d_cs_exec_set_light,
+    /* WINED3D_CS_OP_SET_LIGHT_ENABLE           */ wined3d_cs_exec_set_light_enable,
     /* WINED3D_CS_OP_RESET_STATE                */ wined3d_cs_exec_reset_state,
+    /* WINED3D_CS_OP_QUERY_ISSUE                */ wined3d_cs_exec_query_issue,
+    /* WINED3D_CS_OP_QUERY_GET_DATA             */ wined3d_cs_exec_query_get_data,
+    /* WINED3D_CS_OP_FINISH                     */ wined3d_cs_exec_finish,
+    /* WINED3D_CS_OP_STOP                       */ wined3d_cs_exec_stop,
+    /* WINED3D_CS_OP_INDIRECT                   */ wined3d_cs_exec_indirect,
 };
 
 static void *wined3d_cs_st_require_space(struct wined3d_cs *cs, size_t size)
@@ -1080,6 +1454,278 @@ static const struct wined3d_cs_ops wined3d_cs_st_ops =
     wined3d_cs_st_submit,
 };
 
+static BOOL wined3d_cs_queue_is_empty(const struct wined3d_cs_queue *queue)
+{
+    return *(volatile const LONG *)&queue->head == queue->tail;
+}
+
+static DWORD WINAPI wined3d_cs_run(void *ctx)
+{
+    struct wined3d_cs *cs = ctx;
+    struct wined3d_cs_queue *queue = cs->queue;
+    struct wined3d_context *context;
+    struct wined3d_cs_packet *packet;
+    enum wined3d_cs_op opcode;
+    unsigned int spin_count = 0;
+    LONG tail;
+
+    TRACE("Started.\n");
+
+    for (;;)
+    {
+        if (wined3d_cs_queue_is_empty(queue))
+        {
+            if (++spin_count < WINED3D_CS_SPIN_COUNT)
+                continue;
+
+            /* Going to sleep. The producer checks "waiting" after publishing
+             * a packet, so recheck the queue after setting it. */
+            spin_count = 0;
+            InterlockedExchange(&cs->waiting, TRUE);
+            if (wined3d_cs_queue_is_empty(queue))
+                WaitForSingleObject(cs->event, INFINITE);
+            InterlockedExchange(&cs->waiting, FALSE);
+            continue;
+        }
+
+        spin_count = 0;
+        tail = queue->tail;
+        packet = (struct wined3d_cs_packet *)&queue->data[tail];
+        if (!packet->size)
+        {
+            /* Wrap marker. */
+            InterlockedExchange(&queue->tail, 0);
+            continue;
+        }
+
+        opcode = *(const enum wined3d_cs_op *)packet->data;
+        if (opcode == WINED3D_CS_OP_INDIRECT)
+        {
+            const struct wined3d_cs_indirect *op = (const struct wined3d_cs_indirect *)packet->data;
+
+            wined3d_cs_op_handlers[*(const enum wined3d_cs_op *)op->data](cs, op->data);
+            HeapFree(GetProcessHeap(), 0, op->data);
+        }
+        else if (opcode != WINED3D_CS_OP_STOP)
+        {
+            wined3d_cs_op_handlers[opcode](cs, packet->data);
+        }
+
+        tail += packet->size;
+        if (tail == WINED3D_CS_QUEUE_SIZE)
+            tail = 0;
+        InterlockedExchange(&queue->tail, tail);
+
+        if (opcode == WINED3D_CS_OP_STOP)
+            break;
+    }
+
+    if (cs->finish_sync)
+    {
+        if ((context = context_get_current()))
+        {
+            const struct wined3d_gl_info *gl_info = context->gl_info;
+
+            GL_EXTCALL(glDeleteSync(cs->finish_sync));
+        }
+        cs->finish_sync = NULL;
+    }
+
+    /* Release the GL context, so that it can be destroyed from other threads. */
+    context_set_current(NULL);
+
+    TRACE("Stopped.\n");
+
+    return 0;
+}
+
+static BOOL wined3d_cs_start(struct wined3d_cs *cs)
+{
+    if (!(cs->thread = CreateThread(NULL, 0, wined3d_cs_run, cs, 0, &cs->thread_id)))
+    {
+        ERR("Failed to create command stream thread, error %#x.\n", GetLastError());
+        return FALSE;
+    }
+
+    TRACE("Created command stream thread %p, id %#x.\n", cs->thread, cs->thread_id);
+
+    return TRUE;
+}
+
+static void *wined3d_cs_mt_require_space(struct wined3d_cs *cs, size_t size)
+{
+    struct wined3d_cs_queue *queue = cs->queue;
+    struct wined3d_cs_packet *packet;
+    size_t packet_size, remaining;
+    LONG head, tail;
+
+    /* Commands emitted while executing the command stream are executed
+     * immediately. */
+    if (cs->thread_id == GetCurrentThreadId())
+        return wined3d_cs_st_require_space(cs, size);
+
+    if (!cs->thread && !wined3d_cs_start(cs))
+    {
+        /* Fall back to executing commands on the application thread. */
+        cs->ops = &wined3d_cs_st_ops;
+        return wined3d_cs_st_require_space(cs, size);
+    }
+
+    packet_size = FIELD_OFFSET(struct wined3d_cs_packet, data[size]);
+    packet_size = (packet_size + 7) & ~7;
+    if (packet_size >= WINED3D_CS_QUEUE_SIZE / 2)
+    {
+        struct wined3d_cs_indirect *op;
+        void *data;
+
+        /* Too large for the queue, pass it by reference instead. The
+         * command stream thread frees it after executing it. */
+        if (!(data = HeapAlloc(GetProcessHeap(), 0, size)))
+        {
+            ERR("Failed to allocate %lu bytes for a command.\n", (unsigned long)size);
+            return NULL;
+        }
+        op = wined3d_cs_mt_require_space(cs, sizeof(*op));
+        op->opcode = WINED3D_CS_OP_INDIRECT;
+        op->data = data;
+        return data;
+    }
+
+    for (;;)
+    {
+        head = queue->head;
+        tail = *(volatile LONG *)&queue->tail;
+
+        /* Never let head catch up with tail; head == tail means empty. */
+        if (tail > head)
+        {
+            if (tail - head > packet_size)
+                break;
+        }
+        else
+        {
+            remaining = WINED3D_CS_QUEUE_SIZE - head;
+            if (remaining > packet_size || (remaining == packet_size && tail))
+                break;
+
+            if (tail)
+            {
+                /* Not enough space left at the end of the queue, wrap. */
+                packet = (struct wined3d_cs_packet *)&queue->data[head];
+                packet->size = 0;
+                InterlockedExchange(&queue->head, 0);
+                continue;
+            }
+        }
+
+        /* The queue is full, wait for the command stream thread. */
+        SwitchToThread();
+    }
+
+    packet = (struct wined3d_cs_packet *)&queue->data[head];
+    packet->size = packet_size;
+    return packet->data;
+}
+
+static void wined3d_cs_mt_submit(struct wined3d_cs *cs)
+{
+    struct wined3d_cs_queue *queue = cs->queue;
+    struct wined3d_cs_packet *packet;
+    LONG head;
+
+    if (cs->thread_id == GetCurrentThreadId())
+    {
+        wined3d_cs_st_submit(cs);
+        return;
+    }
+
+    head = queue->head;
+    packet = (struct wined3d_cs_packet *)&queue->data[head];
+    head += packet->size;
+    if (head == WINED3D_CS_QUEUE_SIZE)
+        head = 0;
+    InterlockedExchange(&queue->head, head);
+    cs->pending_finish = TRUE;
+
+    if (InterlockedCompareExchange(&cs->waiting, FALSE, TRUE))
+        SetEvent(cs->event);
+}
+
+static const struct wined3d_cs_ops wined3d_cs_mt_ops =
+{
+    wined3d_cs_mt_require_space,
+    wined3d_cs_mt_submit,
+};
+
+/* Wait for the command stream thread to execute all pending commands. This
+ * needs to be called before the application thread accesses GL objects or
+ * state that commands in the queue may still reference. */
+void wined3d_cs_finish(struct wined3d_cs *cs)
+{
+    struct wined3d_cs_finish *op;
+
+    if (!cs || !cs->thread || !cs->pending_finish || cs->thread_id == GetCurrentThreadId())
+        return;
+
+    op = cs->ops->require_space(cs, sizeof(*op));
+    op->opcode = WINED3D_CS_OP_FINISH;
+    cs->ops->submit(cs);
+
+    WaitForSingleObject(cs->finish_event, INFINITE);
+    cs->pending_finish = FALSE;
+}
+
+/* Stop the command stream thread, releasing its GL context. The thread is
+ * restarted on the next submitted command. */
+void wined3d_cs_stop(struct wined3d_cs *cs)
+{
+    struct wined3d_cs_stop *op;
+
+    if (!cs->thread || cs->thread_id == GetCurrentThreadId())
+        return;
+
+    op = cs->ops->require_space(cs, sizeof(*op));
+    op->opcode = WINED3D_CS_OP_STOP;
+    cs->ops->submit(cs);
+
+    WaitForSingleObject(cs->thread, INFINITE);
+    CloseHandle(cs->thread);
+    cs->thread = NULL;
+    cs->thread_id = 0;
+    cs->pending_finish = FALSE;
+}
+
+static void wined3d_cs_cleanup_mt(struct wined3d_cs *cs)
+{
+    if (cs->present_event)
+        CloseHandle(cs->present_event);
+    if (cs->finish_event)
+        CloseHandle(cs->finish_event);
+    if (cs->event)
+        CloseHandle(cs->event);
+    HeapFree(GetProcessHeap(), 0, cs->queue);
+}
+
+static BOOL wined3d_cs_init_mt(struct wined3d_cs *cs)
+{
+    if (!(cs->queue = HeapAlloc(GetProcessHeap(), 0, sizeof(*cs->queue))))
+        return FALSE;
+    cs->queue->head = cs->queue->tail = 0;
+
+    if (!(cs->event = CreateEventW(NULL, FALSE, FALSE, NULL))
+            || !(cs->finish_event = CreateEventW(NULL, FALSE, FALSE, NULL))
+            || !(cs->present_event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+    {
+        ERR("Failed to create events, error %#x.\n", GetLastError());
+        wined3d_cs_cleanup_mt(cs);
+        return FALSE;
+    }
+
+    cs->ops = &wined3d_cs_mt_ops;
+
+    return TRUE;
+}
+
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
 {
     const struct wined3d_gl_info *gl_info = &device->adapter->gl_info;
@@ -1109,15 +1755,31 @@ struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device)
     cs->data_size = WINED3D_INITIAL_CS_SIZE;
     if (!(cs->data = HeapAlloc(GetProcessHeap(), 0, cs->data_size)))
     {
+        state_cleanup(&cs->state);
+        HeapFree(GetProcessHeap(), 0, cs->fb.render_targets);
         HeapFree(GetProcessHeap(), 0, cs);
         return NULL;
     }
 
+    if (wined3d_settings.cs_multithreaded)
+    {
+        if (wined3d_cs_init_mt(cs))
+            TRACE("Using the multi-threaded command stream.\n");
+        else
+            WARN("Failed to initialize the multi-threaded command stream.\n");
+    }
+
     return cs;
 }
 
 void wined3d_cs_destroy(struct wined3d_cs *cs)
 {
+    if (cs->queue)
+    {
+        wined3d_cs_stop(cs);
+        wined3d_cs_cleanup_mt(cs);
+    }
+
     state_cleanup(&cs->state);
     HeapFree(GetProcessHeap(), 0, cs->fb.render_targets);
     HeapFree(GetProcessHeap(), 0, cs->data);
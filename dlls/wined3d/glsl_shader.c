@@ -107,6 +107,7 @@ struct shader_glsl_priv {
     struct wine_rb_tree ffp_fragment_shaders;
     BOOL ffp_proj_control;
     BOOL legacy_lighting;
+    struct wined3d_shader_cache *program_cache;
 };
 
 struct glsl_vs_program
@@ -470,6 +471,77 @@ void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint pro
     print_glsl_info_log(gl_info, program, TRUE);
 }
 
+/* Context activation is done by the caller. */
+static void shader_glsl_hash_shader_source(const struct wined3d_gl_info *gl_info,
+        struct wined3d_shader_cache_key *key, GLuint shader_id)
+{
+    GLint source_size;
+    char *source;
+
+    GL_EXTCALL(glGetShaderiv(shader_id, GL_SHADER_SOURCE_LENGTH, &source_size));
+    if (source_size <= 0 || !(source = HeapAlloc(GetProcessHeap(), 0, source_size)))
+    {
+        wined3d_shader_cache_key_update(key, &shader_id, sizeof(shader_id));
+        return;
+    }
+    GL_EXTCALL(glGetShaderSource(shader_id, source_size, &source_size, source));
+    checkGLcall("glGetShaderSource");
+
+    /* Include the terminator so that the boundaries between shaders are part
+     * of the key. */
+    wined3d_shader_cache_key_update(key, source, source_size + 1);
+    HeapFree(GetProcessHeap(), 0, source);
+}
+
+/* Links "program_id", or loads it from the program binary cache if a binary
+ * for the same sources and link parameters was stored by an earlier run.
+ * Context activation is done by the caller. */
+static void shader_glsl_link_program(const struct wined3d_gl_info *gl_info,
+        struct wined3d_shader_cache *cache, const struct wined3d_shader_cache_key *key, GLuint program_id)
+{
+    GLint status;
+    GLenum format;
+    GLsizei size;
+    void *binary;
+
+    if (cache && (binary = wined3d_shader_cache_load(cache, key, &format, &size)))
+    {
+        GL_EXTCALL(glProgramBinary(program_id, format, binary, size));
+        HeapFree(GetProcessHeap(), 0, binary);
+        GL_EXTCALL(glGetProgramiv(program_id, GL_LINK_STATUS, &status));
+        checkGLcall("glProgramBinary");
+        if (status)
+        {
+            TRACE("Loaded GLSL shader program %u from the program binary cache.\n", program_id);
+            return;
+        }
+
+        WARN("Driver rejected the cached binary for program %u, relinking.\n", program_id);
+        wined3d_shader_cache_remove(cache, key);
+    }
+
+    if (cache)
+        GL_EXTCALL(glProgramParameteri(program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+
+    TRACE("Linking GLSL shader program %u.\n", program_id);
+    GL_EXTCALL(glLinkProgram(program_id));
+    shader_glsl_validate_link(gl_info, program_id);
+
+    if (!cache)
+        return;
+
+    GL_EXTCALL(glGetProgramiv(program_id, GL_LINK_STATUS, &status));
+    if (!status)
+        return;
+    GL_EXTCALL(glGetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &size));
+    if (size <= 0 || !(binary = HeapAlloc(GetProcessHeap(), 0, size)))
+        return;
+    GL_EXTCALL(glGetProgramBinary(program_id, size, &size, &format, binary));
+    if (gl_info->gl_ops.gl.p_glGetError() == GL_NO_ERROR)
+        wined3d_shader_cache_store(cache, key, format, binary, size);
+    HeapFree(GetProcessHeap(), 0, binary);
+}
+
 /* Context activation is done by the caller. */
 static void shader_glsl_load_samplers(const struct wined3d_gl_info *gl_info,
         struct shader_glsl_priv *priv, const DWORD *tex_unit_map, GLuint program_id)
@@ -1547,11 +1619,11 @@ static void shader_generate_glsl_declarations(const struct wined3d_context *cont
         const struct wined3d_shader_reg_maps *reg_maps, const struct shader_glsl_ctx_priv *ctx_priv)
 {
     const struct wined3d_shader_version *version = &reg_maps->shader_version;
-    const struct wined3d_state *state = &shader->device->state;
+    const struct wined3d_state *state = &shader->device->cs->state;
     const struct vs_compile_args *vs_args = ctx_priv->cur_vs_args;
     const struct ps_compile_args *ps_args = ctx_priv->cur_ps_args;
     const struct wined3d_gl_info *gl_info = context->gl_info;
-    const struct wined3d_fb_state *fb = &shader->device->fb;
+    const struct wined3d_fb_state *fb = &shader->device->cs->fb;
     unsigned int i, extra_constants_needed = 0;
     const struct wined3d_shader_lconst *lconst;
     const char *prefix;
@@ -6617,6 +6689,8 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
 {
     const struct wined3d_gl_info *gl_info = context->gl_info;
     const struct ps_np2fixup_info *np2fixup_info = NULL;
+    struct wined3d_shader_cache *cache = priv->program_cache;
+    struct wined3d_shader_cache_key cache_key;
     struct glsl_shader_prog_link *entry = NULL;
     struct wined3d_shader *vshader = NULL;
     struct wined3d_shader *gshader = NULL;
@@ -6723,12 +6797,20 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     /* Set the current program */
     ctx_data->glsl_program = entry;
 
+    if (cache)
+        wined3d_shader_cache_key_init(cache, &cache_key);
+
     /* Attach GLSL vshader */
     if (vs_id)
     {
         TRACE("Attaching GLSL shader object %u to program %u.\n", vs_id, program_id);
         GL_EXTCALL(glAttachShader(program_id, vs_id));
         checkGLcall("glAttachShader");
+        if (cache)
+        {
+            wined3d_shader_cache_key_update(&cache_key, "vs", 2);
+            shader_glsl_hash_shader_source(gl_info, &cache_key, vs_id);
+        }
 
         list_add_head(vs_list, &entry->vs.shader_entry);
     }
@@ -6741,6 +6823,11 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         TRACE("Attaching GLSL shader object %u to program %u.\n", reorder_shader_id, program_id);
         GL_EXTCALL(glAttachShader(program_id, reorder_shader_id));
         checkGLcall("glAttachShader");
+        if (cache)
+        {
+            wined3d_shader_cache_key_update(&cache_key, "reorder", 7);
+            shader_glsl_hash_shader_source(gl_info, &cache_key, reorder_shader_id);
+        }
         /* Flag the reorder function for deletion, then it will be freed automatically when the program
          * is destroyed
          */
@@ -6750,6 +6837,8 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
     {
         attribs_map = (1u << WINED3D_FFP_ATTRIBS_COUNT) - 1;
     }
+    if (cache)
+        wined3d_shader_cache_key_update(&cache_key, &attribs_map, sizeof(attribs_map));
 
     /* Bind vertex attributes to a corresponding index number to match
      * the same index numbers as ARB_vertex_programs (makes loading
@@ -6789,6 +6878,17 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         GL_EXTCALL(glProgramParameteriARB(program_id, GL_GEOMETRY_VERTICES_OUT_ARB,
                 gshader->u.gs.vertices_out));
         checkGLcall("glProgramParameteriARB");
+        if (cache)
+        {
+            GLint gs_params[3];
+
+            gs_params[0] = gl_primitive_type_from_d3d(gshader->u.gs.input_type);
+            gs_params[1] = gl_primitive_type_from_d3d(gshader->u.gs.output_type);
+            gs_params[2] = gshader->u.gs.vertices_out;
+            wined3d_shader_cache_key_update(&cache_key, "gs", 2);
+            wined3d_shader_cache_key_update(&cache_key, gs_params, sizeof(gs_params));
+            shader_glsl_hash_shader_source(gl_info, &cache_key, gs_id);
+        }
 
         list_add_head(&gshader->linked_programs, &entry->gs.shader_entry);
     }
@@ -6799,14 +6899,17 @@ static void set_glsl_shader_program(const struct wined3d_context *context, const
         TRACE("Attaching GLSL shader object %u to program %u.\n", ps_id, program_id);
         GL_EXTCALL(glAttachShader(program_id, ps_id));
         checkGLcall("glAttachShader");
+        if (cache)
+        {
+            wined3d_shader_cache_key_update(&cache_key, "ps", 2);
+            shader_glsl_hash_shader_source(gl_info, &cache_key, ps_id);
+        }
 
         list_add_head(ps_list, &entry->ps.shader_entry);
     }
 
     /* Link the program */
-    TRACE("Linking GLSL shader program %u.\n", program_id);
-    GL_EXTCALL(glLinkProgram(program_id));
-    shader_glsl_validate_link(gl_info, program_id);
+    shader_glsl_link_program(gl_info, cache, &cache_key, program_id);
 
     shader_glsl_init_vs_uniform_locations(gl_info, priv, program_id, &entry->vs,
             vshader ? min(vshader->limits->constant_float, gl_info->limits.glsl_vs_float_constants) : 0);
@@ -7422,6 +7525,7 @@ static HRESULT shader_glsl_alloc(struct wined3d_device *device, const struct win
     fragment_pipe->get_caps(gl_info, &fragment_caps);
     priv->ffp_proj_control = fragment_caps.wined3d_caps & WINED3D_FRAGMENT_CAP_PROJ_CONTROL;
     priv->legacy_lighting = device->wined3d->flags & WINED3D_LEGACY_FFP_LIGHTING;
+    priv->program_cache = device->adapter->shader_cache;
 
     device->vertex_priv = vertex_priv;
     device->fragment_priv = fragment_priv;
@@ -241,6 +241,7 @@ ULONG CDECL wined3d_query_decref(struct wined3d_query *query)
 
     if (!refcount)
     {
+        wined3d_cs_finish(query->device->cs);
         /* Queries are specific to the GL context that created them. Not
          * deleting the query will obviously leak it, but that's still better
          * than potentially deleting a different query with the same id in this
@@ -278,7 +279,12 @@ HRESULT CDECL wined3d_query_get_data(struct wined3d_query *query,
     TRACE("query %p, data %p, data_size %u, flags %#x.\n",
             query, data, data_size, flags);
 
-    return query->query_ops->query_get_data(query, data, data_size, flags);
+    /* The result can't be available before the command stream thread has
+     * issued the query, so don't wait for it. */
+    if (*(volatile LONG *)&query->pending_issues)
+        return S_FALSE;
+
+    return wined3d_cs_emit_query_get_data(query->device->cs, query, data, data_size, flags);
 }
 
 UINT CDECL wined3d_query_get_data_size(const struct wined3d_query *query)
@@ -292,7 +298,9 @@ HRESULT CDECL wined3d_query_issue(struct wined3d_query *query, DWORD flags)
 {
     TRACE("query %p, flags %#x.\n", query, flags);
 
-    return query->query_ops->query_issue(query, flags);
+    wined3d_cs_emit_query_issue(query->device->cs, query, flags);
+
+    return WINED3D_OK;
 }
 
 static void fill_query_data(void *out, unsigned int out_size, const void *result, unsigned int result_size)
@@ -43,6 +43,7 @@ ULONG CDECL wined3d_sampler_decref(struct wined3d_sampler *sampler)
 
     if (!refcount)
     {
+        wined3d_cs_finish(sampler->device->cs);
         context = context_acquire(sampler->device, NULL);
         gl_info = context->gl_info;
         GL_EXTCALL(glDeleteSamplers(1, &sampler->name));
@@ -0,0 +1,507 @@
+/*
+ * Persistent cache for linked GLSL program binaries
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Programs linked through ARB_get_program_binary are stored as one file per
+ * program in $XDG_CACHE_HOME/wine/wined3d (~/.cache/wine/wined3d by default).
+ * The file name is a 128-bit hash of the GLSL sources and link parameters of
+ * the program, seeded with the GL vendor, renderer and version strings, so a
+ * driver update or a different GPU simply results in cache misses. The total
+ * size of the directory is bounded by the "ShaderCacheSize" setting; when it
+ * is exceeded the least recently used files are removed. Concurrent writers
+ * are handled by writing to a temporary file and renaming it into place.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_DIRENT_H
+# include <dirent.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_UTIME_H
+# include <utime.h>
+#endif
+
+#include "wined3d_private.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(d3d_shader);
+WINE_DECLARE_DEBUG_CHANNEL(d3d_perf);
+
+#define WINED3D_SHADER_CACHE_MAGIC      0x43533357 /* "W3SC" */
+#define WINED3D_SHADER_CACHE_VERSION    1
+#define WINED3D_SHADER_CACHE_NAME_LEN   32
+#define WINED3D_SHADER_CACHE_SIZE_UNKNOWN (~(UINT64)0)
+
+struct wined3d_shader_cache
+{
+    CRITICAL_SECTION cs;
+    char *path;
+    size_t path_len;
+    struct wined3d_shader_cache_key seed;
+    UINT64 size;
+    UINT64 max_size;
+
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int rejects;
+    unsigned int stores;
+    unsigned int evictions;
+};
+
+struct wined3d_shader_cache_header
+{
+    DWORD magic;
+    DWORD version;
+    UINT64 hash[2];
+    UINT64 key_size;
+    DWORD format;
+    DWORD size;
+};
+
+struct wined3d_shader_cache_file
+{
+    char name[WINED3D_SHADER_CACHE_NAME_LEN + 1];
+    UINT64 size;
+    time_t mtime;
+};
+
+void wined3d_shader_cache_key_update(struct wined3d_shader_cache_key *key, const void *data, size_t size)
+{
+    const unsigned char *ptr = data;
+    UINT64 h0 = key->hash[0], h1 = key->hash[1];
+    size_t i;
+
+    /* Two unrelated 64-bit hashes over the same input: FNV-1a and a
+     * multiply/xorshift mix. */
+    for (i = 0; i < size; ++i)
+    {
+        h0 = (h0 ^ ptr[i]) * 0x00000100000001b3ull;
+        h1 = (h1 + ptr[i] + 1) * 0x9e3779b97f4a7c15ull;
+        h1 ^= h1 >> 29;
+    }
+
+    key->hash[0] = h0;
+    key->hash[1] = h1;
+    key->size += size;
+}
+
+void wined3d_shader_cache_key_init(const struct wined3d_shader_cache *cache, struct wined3d_shader_cache_key *key)
+{
+    *key = cache->seed;
+}
+
+static void shader_cache_get_file_name(const struct wined3d_shader_cache *cache,
+        const struct wined3d_shader_cache_key *key, char *name)
+{
+    memcpy(name, cache->path, cache->path_len);
+    sprintf(name + cache->path_len, "%08x%08x%08x%08x",
+            (unsigned int)(key->hash[0] >> 32), (unsigned int)key->hash[0],
+            (unsigned int)(key->hash[1] >> 32), (unsigned int)key->hash[1]);
+}
+
+static BOOL shader_cache_is_entry_name(const char *name)
+{
+    return strlen(name) == WINED3D_SHADER_CACHE_NAME_LEN
+            && strspn(name, "0123456789abcdef") == WINED3D_SHADER_CACHE_NAME_LEN;
+}
+
+static int shader_cache_file_compare(const void *a, const void *b)
+{
+    const struct wined3d_shader_cache_file *f1 = a, *f2 = b;
+
+    if (f1->mtime < f2->mtime) return -1;
+    if (f1->mtime > f2->mtime) return 1;
+    return strcmp(f1->name, f2->name);
+}
+
+/* Recomputes the size of the cache directory and, if it exceeds "limit",
+ * removes the least recently used entries until the cache is at 3/4 of the
+ * limit. Called with the cache lock held. */
+static void shader_cache_trim(struct wined3d_shader_cache *cache, UINT64 limit)
+{
+    struct wined3d_shader_cache_file *files = NULL, *new_files;
+    unsigned int count = 0, capacity = 0, evicted = 0, i;
+    struct dirent *entry;
+    struct stat st;
+    UINT64 total = 0;
+    char *name;
+    DIR *dir;
+
+    if (!(dir = opendir(cache->path)))
+    {
+        WARN("Failed to open %s, errno %d.\n", debugstr_a(cache->path), errno);
+        cache->size = 0;
+        return;
+    }
+
+    if (!(name = HeapAlloc(GetProcessHeap(), 0, cache->path_len + WINED3D_SHADER_CACHE_NAME_LEN + 1)))
+    {
+        closedir(dir);
+        return;
+    }
+    memcpy(name, cache->path, cache->path_len);
+
+    while ((entry = readdir(dir)))
+    {
+        if (!shader_cache_is_entry_name(entry->d_name))
+            continue;
+
+        strcpy(name + cache->path_len, entry->d_name);
+        if (stat(name, &st) || !S_ISREG(st.st_mode))
+            continue;
+
+        if (count == capacity)
+        {
+            capacity = max(capacity * 2, 64);
+            if (files)
+                new_files = HeapReAlloc(GetProcessHeap(), 0, files, capacity * sizeof(*files));
+            else
+                new_files = HeapAlloc(GetProcessHeap(), 0, capacity * sizeof(*files));
+            if (!new_files)
+                break;
+            files = new_files;
+        }
+
+        strcpy(files[count].name, entry->d_name);
+        files[count].size = st.st_size;
+        files[count].mtime = st.st_mtime;
+        total += st.st_size;
+        ++count;
+    }
+    closedir(dir);
+
+    if (total > limit)
+    {
+        qsort(files, count, sizeof(*files), shader_cache_file_compare);
+        for (i = 0; i < count && total > limit / 4 * 3; ++i)
+        {
+            strcpy(name + cache->path_len, files[i].name);
+            if (unlink(name) && errno != ENOENT)
+                continue;
+            total -= files[i].size;
+            ++evicted;
+        }
+        cache->evictions += evicted;
+        TRACE_(d3d_perf)("Evicted %u program binaries, cache size now 0x%s bytes.\n",
+                evicted, wine_dbgstr_longlong(total));
+    }
+
+    cache->size = total;
+    HeapFree(GetProcessHeap(), 0, files);
+    HeapFree(GetProcessHeap(), 0, name);
+}
+
+static char *shader_cache_get_path(void)
+{
+    const char *base, *suffix;
+    size_t len;
+    char *path;
+
+    if ((base = getenv("XDG_CACHE_HOME")) && *base)
+    {
+        suffix = "/wine/wined3d/";
+    }
+    else if ((base = getenv("HOME")))
+    {
+        suffix = "/.cache/wine/wined3d/";
+    }
+    else
+    {
+        return NULL;
+    }
+
+    len = strlen(base);
+    while (len > 1 && base[len - 1] == '/')
+        --len;
+
+    if (!(path = HeapAlloc(GetProcessHeap(), 0, len + strlen(suffix) + WINED3D_SHADER_CACHE_NAME_LEN + 16)))
+        return NULL;
+    memcpy(path, base, len);
+    strcpy(path + len, suffix);
+
+    /* Create each missing component of the suffix. */
+    for (++len; path[len]; ++len)
+    {
+        if (path[len] != '/')
+            continue;
+
+        path[len] = 0;
+        if (mkdir(path, 0777) && errno != EEXIST)
+        {
+            WARN("Failed to create %s, errno %d.\n", debugstr_a(path), errno);
+            HeapFree(GetProcessHeap(), 0, path);
+            return NULL;
+        }
+        path[len] = '/';
+    }
+
+    return path;
+}
+
+/* Context activation is done by the caller. */
+struct wined3d_shader_cache *wined3d_shader_cache_create(const struct wined3d_gl_info *gl_info)
+{
+    static const GLenum strings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION_ARB};
+    struct wined3d_shader_cache *cache;
+    GLint format_count = 0;
+    const char *str;
+    unsigned int i;
+
+    if (!wined3d_settings.shader_cache_size)
+    {
+        TRACE("Program binary cache disabled.\n");
+        return NULL;
+    }
+
+    gl_info->gl_ops.gl.p_glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+    if (!format_count)
+    {
+        TRACE("Driver doesn't support any program binary formats.\n");
+        return NULL;
+    }
+
+    if (!(cache = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*cache))))
+        return NULL;
+
+    if (!(cache->path = shader_cache_get_path()))
+    {
+        HeapFree(GetProcessHeap(), 0, cache);
+        return NULL;
+    }
+    cache->path_len = strlen(cache->path);
+    cache->size = WINED3D_SHADER_CACHE_SIZE_UNKNOWN;
+    cache->max_size = (UINT64)wined3d_settings.shader_cache_size * 1024 * 1024;
+
+    cache->seed.hash[0] = 0xcbf29ce484222325ull;
+    cache->seed.hash[1] = 0x84222325cbf29ce4ull;
+    for (i = 0; i < ARRAY_SIZE(strings); ++i)
+    {
+        if (!(str = (const char *)gl_info->gl_ops.gl.p_glGetString(strings[i])))
+            str = "";
+        wined3d_shader_cache_key_update(&cache->seed, str, strlen(str) + 1);
+    }
+    cache->seed.size = 0;
+
+    InitializeCriticalSection(&cache->cs);
+    cache->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": wined3d_shader_cache.cs");
+
+    TRACE("Using program binary cache %s, limit 0x%s bytes.\n",
+            debugstr_a(cache->path), wine_dbgstr_longlong(cache->max_size));
+
+    return cache;
+}
+
+void wined3d_shader_cache_destroy(struct wined3d_shader_cache *cache)
+{
+    if (!cache)
+        return;
+
+    TRACE("Program binary cache: %u hits, %u misses, %u rejected, %u stored, %u evicted.\n",
+            cache->hits, cache->misses, cache->rejects, cache->stores, cache->evictions);
+
+    cache->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection(&cache->cs);
+    HeapFree(GetProcessHeap(), 0, cache->path);
+    HeapFree(GetProcessHeap(), 0, cache);
+}
+
+static BOOL shader_cache_read(int fd, void *data, size_t size)
+{
+    char *ptr = data;
+    ssize_t ret;
+
+    while (size)
+    {
+        if ((ret = read(fd, ptr, size)) <= 0)
+        {
+            if (ret < 0 && errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    return TRUE;
+}
+
+static BOOL shader_cache_write(int fd, const void *data, size_t size)
+{
+    const char *ptr = data;
+    ssize_t ret;
+
+    while (size)
+    {
+        if ((ret = write(fd, ptr, size)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        ptr += ret;
+        size -= ret;
+    }
+    return TRUE;
+}
+
+/* Returns a HeapAlloc()ed copy of the binary stored for "key", or NULL. */
+void *wined3d_shader_cache_load(struct wined3d_shader_cache *cache,
+        const struct wined3d_shader_cache_key *key, GLenum *format, GLsizei *size)
+{
+    struct wined3d_shader_cache_header header;
+    void *data = NULL;
+    struct stat st;
+    char *name;
+    int fd;
+
+    if (!(name = HeapAlloc(GetProcessHeap(), 0, cache->path_len + WINED3D_SHADER_CACHE_NAME_LEN + 1)))
+        return NULL;
+    shader_cache_get_file_name(cache, key, name);
+
+    if ((fd = open(name, O_RDONLY)) == -1)
+        goto done;
+
+    if (fstat(fd, &st) || !shader_cache_read(fd, &header, sizeof(header))
+            || header.magic != WINED3D_SHADER_CACHE_MAGIC
+            || header.version != WINED3D_SHADER_CACHE_VERSION
+            || header.hash[0] != key->hash[0] || header.hash[1] != key->hash[1]
+            || header.key_size != key->size
+            || !header.size || st.st_size != sizeof(header) + header.size)
+    {
+        WARN("Ignoring invalid cache file %s.\n", debugstr_a(name));
+        close(fd);
+        goto done;
+    }
+
+    if ((data = HeapAlloc(GetProcessHeap(), 0, header.size)) && !shader_cache_read(fd, data, header.size))
+    {
+        HeapFree(GetProcessHeap(), 0, data);
+        data = NULL;
+    }
+    close(fd);
+
+    if (data)
+    {
+        *format = header.format;
+        *size = header.size;
+#ifdef HAVE_UTIME_H
+        /* Eviction is based on the modification time. */
+        utime(name, NULL);
+#endif
+    }
+
+done:
+    EnterCriticalSection(&cache->cs);
+    if (data)
+        ++cache->hits;
+    else
+        ++cache->misses;
+    LeaveCriticalSection(&cache->cs);
+
+    TRACE("%s %s.\n", data ? "Found" : "Missed", debugstr_a(name + cache->path_len));
+    HeapFree(GetProcessHeap(), 0, name);
+    return data;
+}
+
+/* Called when the driver rejects a binary returned by wined3d_shader_cache_load(). */
+void wined3d_shader_cache_remove(struct wined3d_shader_cache *cache, const struct wined3d_shader_cache_key *key)
+{
+    char *name;
+
+    if (!(name = HeapAlloc(GetProcessHeap(), 0, cache->path_len + WINED3D_SHADER_CACHE_NAME_LEN + 1)))
+        return;
+    shader_cache_get_file_name(cache, key, name);
+    unlink(name);
+    HeapFree(GetProcessHeap(), 0, name);
+
+    EnterCriticalSection(&cache->cs);
+    --cache->hits;
+    ++cache->misses;
+    ++cache->rejects;
+    LeaveCriticalSection(&cache->cs);
+}
+
+void wined3d_shader_cache_store(struct wined3d_shader_cache *cache, const struct wined3d_shader_cache_key *key,
+        GLenum format, const void *data, GLsizei size)
+{
+    struct wined3d_shader_cache_header header;
+    char *name, *tmp_name;
+    size_t name_size;
+    BOOL ret;
+    int fd;
+
+    if (size <= 0 || sizeof(header) + size > cache->max_size)
+        return;
+
+    name_size = cache->path_len + WINED3D_SHADER_CACHE_NAME_LEN + 1;
+    if (!(name = HeapAlloc(GetProcessHeap(), 0, 2 * name_size + 16)))
+        return;
+    tmp_name = name + name_size;
+    shader_cache_get_file_name(cache, key, name);
+    sprintf(tmp_name, "%s.%x", name, GetCurrentThreadId());
+
+    if ((fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+    {
+        WARN("Failed to create %s, errno %d.\n", debugstr_a(tmp_name), errno);
+        HeapFree(GetProcessHeap(), 0, name);
+        return;
+    }
+
+    header.magic = WINED3D_SHADER_CACHE_MAGIC;
+    header.version = WINED3D_SHADER_CACHE_VERSION;
+    header.hash[0] = key->hash[0];
+    header.hash[1] = key->hash[1];
+    header.key_size = key->size;
+    header.format = format;
+    header.size = size;
+
+    ret = shader_cache_write(fd, &header, sizeof(header)) && shader_cache_write(fd, data, size);
+    if (close(fd))
+        ret = FALSE;
+    if (!ret || rename(tmp_name, name))
+    {
+        WARN("Failed to write %s, errno %d.\n", debugstr_a(name), errno);
+        unlink(tmp_name);
+        HeapFree(GetProcessHeap(), 0, name);
+        return;
+    }
+
+    TRACE("Stored %s, format %#x, size %d.\n", debugstr_a(name + cache->path_len), format, size);
+    HeapFree(GetProcessHeap(), 0, name);
+
+    EnterCriticalSection(&cache->cs);
+    ++cache->stores;
+    if (cache->size == WINED3D_SHADER_CACHE_SIZE_UNKNOWN)
+        shader_cache_trim(cache, cache->max_size);
+    else
+        cache->size += sizeof(header) + size;
+    if (cache->size > cache->max_size)
+        shader_cache_trim(cache, cache->max_size);
+    LeaveCriticalSection(&cache->cs);
+}
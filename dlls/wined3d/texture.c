@@ -412,6 +412,7 @@ ULONG CDECL wined3d_texture_decref(struct wined3d_texture *texture)
 
     if (!refcount)
     {
+        wined3d_cs_finish(texture->resource.device->cs);
         wined3d_texture_cleanup(texture);
         texture->resource.parent_ops->wined3d_object_destroyed(texture->resource.parent);
         HeapFree(GetProcessHeap(), 0, texture);
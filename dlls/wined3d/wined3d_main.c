@@ -86,6 +86,8 @@ struct wined3d_settings wined3d_settings =
     ~0U,            /* No GS shader model limit by default. */
     ~0U,            /* No PS shader model limit by default. */
     FALSE,          /* 3D support enabled by default. */
+    64,             /* 64 MB program binary cache. */
+    FALSE,          /* Single-threaded command stream by default. */
 };
 
 struct wined3d * CDECL wined3d_create(DWORD flags)
@@ -314,6 +316,14 @@ static BOOL wined3d_dll_init(HINSTANCE hInstDLL)
             TRACE("Disabling 3D support.\n");
             wined3d_settings.no_3d = TRUE;
         }
+        if (!get_config_key_dword(hkey, appkey, "ShaderCacheSize", &wined3d_settings.shader_cache_size))
+            TRACE("Limiting program binary cache to %u MB.\n", wined3d_settings.shader_cache_size);
+        if (!get_config_key(hkey, appkey, "CSMT", buffer, size)
+                && !strcmp(buffer, "enabled"))
+        {
+            TRACE("Enabling the multi-threaded command stream.\n");
+            wined3d_settings.cs_multithreaded = TRUE;
+        }
     }
 
     if (appkey) RegCloseKey( appkey );
@@ -277,6 +277,8 @@ struct wined3d_settings
     unsigned int max_sm_gs;
     unsigned int max_sm_ps;
     BOOL no_3d;
+    unsigned int shader_cache_size;
+    BOOL cs_multithreaded;
 };
 
 extern struct wined3d_settings wined3d_settings DECLSPEC_HIDDEN;
@@ -1389,6 +1391,8 @@ const struct blit_shader *wined3d_select_blitter(const struct wined3d_gl_info *g
 
 struct wined3d_context *context_acquire(const struct wined3d_device *device,
         struct wined3d_surface *target) DECLSPEC_HIDDEN;
+struct wined3d_context *context_acquire_nowait(const struct wined3d_device *device,
+        struct wined3d_surface *target) DECLSPEC_HIDDEN;
 void context_alloc_event_query(struct wined3d_context *context,
         struct wined3d_event_query *query) DECLSPEC_HIDDEN;
 void context_alloc_occlusion_query(struct wined3d_context *context,
@@ -1798,6 +1802,7 @@ struct wined3d_adapter
     const struct fragment_pipeline *fragment_pipe;
     const struct wined3d_shader_backend_ops *shader_backend;
     const struct blit_shader *blitter;
+    struct wined3d_shader_cache *shader_cache;
 };
 
 struct wined3d_caps_gl_ctx
@@ -2122,6 +2127,7 @@ void device_resource_add(struct wined3d_device *device, struct wined3d_resource
 void device_resource_released(struct wined3d_device *device, struct wined3d_resource *resource) DECLSPEC_HIDDEN;
 void device_switch_onscreen_ds(struct wined3d_device *device, struct wined3d_context *context,
         struct wined3d_surface *depth_stencil) DECLSPEC_HIDDEN;
+void device_invalidate_shader_constants(const struct wined3d_device *device, DWORD mask) DECLSPEC_HIDDEN;
 void device_invalidate_state(const struct wined3d_device *device, DWORD state) DECLSPEC_HIDDEN;
 
 static inline BOOL isStateDirty(const struct wined3d_context *context, DWORD state)
@@ -2574,6 +2580,10 @@ HRESULT state_init(struct wined3d_state *state, struct wined3d_fb_state *fb,
         const struct wined3d_gl_info *gl_info, const struct wined3d_d3d_info *d3d_info,
         DWORD flags) DECLSPEC_HIDDEN;
 void state_unbind_resources(struct wined3d_state *state) DECLSPEC_HIDDEN;
+void wined3d_state_enable_light(struct wined3d_state *state, const struct wined3d_gl_info *gl_info,
+        struct wined3d_light_info *light_info, BOOL enable) DECLSPEC_HIDDEN;
+struct wined3d_light_info *wined3d_state_get_light(const struct wined3d_state *state,
+        unsigned int idx) DECLSPEC_HIDDEN;
 
 struct wined3d_cs_ops
 {
@@ -2581,6 +2591,16 @@ struct wined3d_cs_ops
     void (*submit)(struct wined3d_cs *cs);
 };
 
+#define WINED3D_CS_QUEUE_SIZE 0x100000
+
+/* Single producer, single consumer ring buffer. "head" is only written by
+ * the application thread, "tail" only by the command stream thread. */
+struct wined3d_cs_queue
+{
+    LONG head, tail;
+    BYTE data[WINED3D_CS_QUEUE_SIZE];
+};
+
 struct wined3d_cs
 {
     const struct wined3d_cs_ops *ops;
@@ -2590,29 +2610,50 @@ struct wined3d_cs
 
     size_t data_size;
     void *data;
+
+    /* Multi-threaded command stream. */
+    struct wined3d_cs_queue *queue;
+    HANDLE thread;
+    DWORD thread_id;
+    LONG waiting;
+    HANDLE event;
+    HANDLE finish_event;
+    BOOL pending_finish;
+    GLsync finish_sync;
+    LONG pending_presents;
+    HANDLE present_event;
 };
 
 struct wined3d_cs *wined3d_cs_create(struct wined3d_device *device) DECLSPEC_HIDDEN;
 void wined3d_cs_destroy(struct wined3d_cs *cs) DECLSPEC_HIDDEN;
+void wined3d_cs_finish(struct wined3d_cs *cs) DECLSPEC_HIDDEN;
+void wined3d_cs_stop(struct wined3d_cs *cs) DECLSPEC_HIDDEN;
 
 void wined3d_cs_emit_clear(struct wined3d_cs *cs, DWORD rect_count, const RECT *rects,
         DWORD flags, const struct wined3d_color *color, float depth, DWORD stencil) DECLSPEC_HIDDEN;
-void wined3d_cs_emit_draw(struct wined3d_cs *cs, UINT start_idx, UINT index_count,
-        UINT start_instance, UINT instance_count, BOOL indexed) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_draw(struct wined3d_cs *cs, GLenum primitive_type, INT base_vertex_idx,
+        UINT start_idx, UINT index_count, UINT start_instance, UINT instance_count, BOOL indexed) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_present(struct wined3d_cs *cs, struct wined3d_swapchain *swapchain,
         const RECT *src_rect, const RECT *dst_rect, HWND dst_window_override,
         const RGNDATA *dirty_region, DWORD flags) DECLSPEC_HIDDEN;
+HRESULT wined3d_cs_emit_query_get_data(struct wined3d_cs *cs, struct wined3d_query *query,
+        void *data, UINT data_size, DWORD flags) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_query_issue(struct wined3d_cs *cs, struct wined3d_query *query, DWORD flags) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_reset_state(struct wined3d_cs *cs) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_clip_plane(struct wined3d_cs *cs, UINT plane_idx,
         const struct wined3d_vec4 *plane) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_color_key(struct wined3d_cs *cs, struct wined3d_texture *texture,
         WORD flags, const struct wined3d_color_key *color_key) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_set_constants(struct wined3d_cs *cs, DWORD type,
+        UINT start_idx, UINT count, const void *constants) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_constant_buffer(struct wined3d_cs *cs, enum wined3d_shader_type type,
         UINT cb_idx, struct wined3d_buffer *buffer) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_depth_stencil_view(struct wined3d_cs *cs,
         struct wined3d_rendertarget_view *view) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_index_buffer(struct wined3d_cs *cs, struct wined3d_buffer *buffer,
         enum wined3d_format_id format_id) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_set_light(struct wined3d_cs *cs, const struct wined3d_light_info *light) DECLSPEC_HIDDEN;
+void wined3d_cs_emit_set_light_enable(struct wined3d_cs *cs, UINT idx, BOOL enable) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_material(struct wined3d_cs *cs, const struct wined3d_material *material) DECLSPEC_HIDDEN;
 void wined3d_cs_emit_set_predication(struct wined3d_cs *cs,
         struct wined3d_query *predicate, BOOL value) DECLSPEC_HIDDEN;
@@ -2671,6 +2712,7 @@ struct wined3d_query
     enum wined3d_query_type type;
     DWORD data_size;
     void                     *extendedData;
+    LONG pending_issues;
 };
 
 /* TODO: Add tests and support for FLOAT16_4 POSITIONT, D3DCOLOR position, other
@@ -3125,6 +3167,27 @@ struct ps_np2fixup_info {
 void print_glsl_info_log(const struct wined3d_gl_info *gl_info, GLuint id, BOOL program) DECLSPEC_HIDDEN;
 void shader_glsl_validate_link(const struct wined3d_gl_info *gl_info, GLuint program) DECLSPEC_HIDDEN;
 
+struct wined3d_shader_cache;
+
+struct wined3d_shader_cache_key
+{
+    UINT64 hash[2];
+    UINT64 size;
+};
+
+struct wined3d_shader_cache *wined3d_shader_cache_create(const struct wined3d_gl_info *gl_info) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_destroy(struct wined3d_shader_cache *cache) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_key_init(const struct wined3d_shader_cache *cache,
+        struct wined3d_shader_cache_key *key) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_key_update(struct wined3d_shader_cache_key *key,
+        const void *data, size_t size) DECLSPEC_HIDDEN;
+void *wined3d_shader_cache_load(struct wined3d_shader_cache *cache,
+        const struct wined3d_shader_cache_key *key, GLenum *format, GLsizei *size) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_remove(struct wined3d_shader_cache *cache,
+        const struct wined3d_shader_cache_key *key) DECLSPEC_HIDDEN;
+void wined3d_shader_cache_store(struct wined3d_shader_cache *cache, const struct wined3d_shader_cache_key *key,
+        GLenum format, const void *data, GLsizei size) DECLSPEC_HIDDEN;
+
 struct wined3d_palette
 {
     LONG ref;
@@ -131,6 +131,12 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -158,6 +164,7 @@
 #include "wine/debug.h"
 #include "wine/exception.h"
 #include "wine/unicode.h"
+#include "wine/list.h"
 
 #if defined(linux) && !defined(IP_UNICAST_IF)
 #define IP_UNICAST_IF 50
@@ -514,6 +521,19 @@ struct ws2_accept_async
     struct ws2_async    *read;
 };
 
+struct ws2_transmit_async
+{
+    struct ws2_async_io      io;
+    HANDLE                   hSocket;
+    DWORD                    flags;      /* TP_ flags */
+    DWORD                    send_size;  /* maximum size of a single send, 0 for no limit */
+    unsigned int             count;
+    unsigned int             current;    /* element being sent */
+    ULONGLONG                offset;     /* data of the current element already sent */
+    ULONGLONG                remaining;  /* data of the current element left, ~0 if not started */
+    TRANSMIT_PACKETS_ELEMENT elements[1];
+};
+
 static struct ws2_async_io *async_io_freelist;
 
 static void release_async_io( struct ws2_async_io *io )
@@ -572,8 +592,12 @@ struct per_thread_data
     int se_len;
     int pe_len;
     char ntoa_buffer[16]; /* 4*3 digits + 3 '.' + 1 '\0' */
+    struct poll_cache *poll_cache;
 };
 
+static void poll_cache_destroy( struct poll_cache *cache );
+static void poll_cache_remove( SOCKET s );
+
 /* internal: routing description information */
 struct route {
     struct in_addr addr;
@@ -595,6 +619,7 @@ int WSAIOCTL_GetInterfaceCount(void);
 int WSAIOCTL_GetInterfaceName(int intNumber, char *intName);
 
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus, ULONG Information );
+static void reactor_detach(void);
 
 #define MAP_OPTION(opt) { WS_##opt, opt }
 
@@ -1144,6 +1169,7 @@ static void free_per_thread_data(void)
     ptb->he_buffer = NULL;
     ptb->se_buffer = NULL;
     ptb->pe_buffer = NULL;
+    if (ptb->poll_cache) poll_cache_destroy( ptb->poll_cache );
 
     HeapFree( GetProcessHeap(), 0, ptb );
     NtCurrentTeb()->WinSockData = NULL;
@@ -1161,6 +1187,7 @@ BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID fImpLoad)
     case DLL_PROCESS_DETACH:
         if (fImpLoad) break;
         free_per_thread_data();
+        reactor_detach();
         DeleteCriticalSection(&csWSgetXXXbyYYY);
         break;
     case DLL_THREAD_DETACH:
@@ -2303,6 +2330,9 @@ static NTSTATUS WS2_async_accept( void *user, IO_STATUS_BLOCK *iosb,
         if (status == STATUS_CANT_WAIT)
             return STATUS_PENDING;
 
+        /* the accepting socket now has a new unix fd */
+        if (!status) poll_cache_remove( HANDLE2SOCKET(wsa->accept_socket) );
+
         if (status == STATUS_INVALID_HANDLE)
         {
             FIXME("AcceptEx accepting socket closed but request was not cancelled\n");
@@ -2486,53 +2516,1119 @@ static NTSTATUS WS2_async_send( void *user, IO_STATUS_BLOCK *iosb,
         else
             release_async_io( &wsa->io );
     }
-    return status;
+    return status;
+}
+
+/***********************************************************************
+ *              WS2_async_shutdown      (INTERNAL)
+ *
+ * Handler for shutdown() operations on overlapped sockets.
+ */
+static NTSTATUS WS2_async_shutdown( void *user, IO_STATUS_BLOCK *iosb,
+                                    NTSTATUS status, void **apc, void **arg )
+{
+    struct ws2_async_shutdown *wsa = user;
+    int fd, err = 1;
+
+    switch (status)
+    {
+    case STATUS_ALERTED:
+        if ((status = wine_server_handle_to_fd( wsa->hSocket, 0, &fd, NULL ) ))
+            break;
+
+        switch ( wsa->type )
+        {
+        case ASYNC_TYPE_READ:   err = shutdown( fd, 0 );  break;
+        case ASYNC_TYPE_WRITE:  err = shutdown( fd, 1 );  break;
+        }
+        status = err ? wsaErrStatus() : STATUS_SUCCESS;
+        wine_server_release_fd( wsa->hSocket, fd );
+        break;
+    }
+    iosb->u.Status = status;
+    release_async_io( &wsa->io );
+    return status;
+}
+
+/***********************************************************************
+ *              WS2_send_file           (INTERNAL)
+ *
+ * Send up to len bytes of a file at the given offset, without going through
+ * user space when the system allows it. A zero size in *sent means that the
+ * end of the file has been reached.
+ */
+static NTSTATUS WS2_send_file( int fd, HANDLE file, ULONGLONG offset, size_t len, size_t *sent )
+{
+    char buffer[16384];
+    NTSTATUS status;
+    ssize_t ret;
+    int file_fd;
+
+    if ((status = wine_server_handle_to_fd( file, FILE_READ_DATA, &file_fd, NULL ))) return status;
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H) && defined(__linux__)
+    /* the BSD sendfile() has a different signature, use the copy loop there */
+    {
+        off_t off = offset;
+
+        while ((ret = sendfile( fd, file_fd, &off, len )) == -1 && errno == EINTR);
+        /* fall back to a copy for files that can't be mapped */
+        if (ret >= 0 || (errno != EINVAL && errno != ENOSYS)) goto done;
+    }
+#endif
+    if (len > sizeof(buffer)) len = sizeof(buffer);
+    if ((ret = pread( file_fd, buffer, len, offset )) > 0)
+        while ((ret = send( fd, buffer, ret, 0 )) == -1 && errno == EINTR);
+
+done:
+    wine_server_release_fd( file, file_fd );
+    if (ret >= 0)
+    {
+        *sent = ret;
+        return STATUS_SUCCESS;
+    }
+    if (errno == EAGAIN) return STATUS_PENDING;
+    return wsaErrStatus();
+}
+
+/* private flag of the elements that are sent from the current file position */
+#define WS2_TP_ELEMENT_FILE_POINTER 0x80000000
+
+/* compute the number of bytes to send for a TransmitPackets element */
+static NTSTATUS WS2_transmit_element_size( TRANSMIT_PACKETS_ELEMENT *elem, ULONGLONG *size )
+{
+    LARGE_INTEGER pos, file_size;
+
+    if (!(elem->dwElFlags & TP_ELEMENT_FILE))
+    {
+        *size = elem->cLength;
+        return STATUS_SUCCESS;
+    }
+    if (elem->u.s.nFileOffset.QuadPart == -1)
+    {
+        /* start at the current file position, and move it past the data once sent */
+        pos.QuadPart = 0;
+        if (!SetFilePointerEx( elem->u.s.hFile, pos, &elem->u.s.nFileOffset, FILE_CURRENT ))
+            return STATUS_INVALID_HANDLE;
+        elem->dwElFlags |= WS2_TP_ELEMENT_FILE_POINTER;
+    }
+    if (elem->cLength)
+    {
+        *size = elem->cLength;
+        return STATUS_SUCCESS;
+    }
+    if (!GetFileSizeEx( elem->u.s.hFile, &file_size )) return STATUS_INVALID_HANDLE;
+    *size = file_size.QuadPart > elem->u.s.nFileOffset.QuadPart ?
+            file_size.QuadPart - elem->u.s.nFileOffset.QuadPart : 0;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              WS2_transmit            (INTERNAL)
+ *
+ * Workhorse for TransmitFile() and TransmitPackets(). Sends the remaining
+ * elements until the socket would block; the amount of data sent is added
+ * to the iosb.
+ */
+static NTSTATUS WS2_transmit( int fd, struct ws2_transmit_async *wsa, IO_STATUS_BLOCK *iosb )
+{
+    NTSTATUS status;
+
+    while (wsa->current < wsa->count)
+    {
+        TRANSMIT_PACKETS_ELEMENT *elem = &wsa->elements[wsa->current];
+        size_t len, sent;
+        ssize_t ret;
+        int flags = 0;
+
+        if (wsa->remaining == ~(ULONGLONG)0)
+        {
+            if ((status = WS2_transmit_element_size( elem, &wsa->remaining ))) return status;
+            wsa->offset = 0;
+        }
+        if (!wsa->remaining)
+        {
+            if (elem->dwElFlags & WS2_TP_ELEMENT_FILE_POINTER)
+            {
+                LARGE_INTEGER pos;
+
+                pos.QuadPart = elem->u.s.nFileOffset.QuadPart + wsa->offset;
+                SetFilePointerEx( elem->u.s.hFile, pos, NULL, FILE_BEGIN );
+            }
+            wsa->current++;
+            wsa->remaining = ~(ULONGLONG)0;
+            continue;
+        }
+
+        len = min( wsa->remaining, wsa->send_size ? wsa->send_size : 0x7ffff000 );
+        if (elem->dwElFlags & TP_ELEMENT_FILE)
+        {
+            if ((status = WS2_send_file( fd, elem->u.s.hFile, elem->u.s.nFileOffset.QuadPart + wsa->offset,
+                                         len, &sent )))
+                return status;
+            if (!sent) wsa->remaining = 0;  /* the file is shorter than expected */
+        }
+        else
+        {
+#ifdef MSG_MORE
+            /* let the kernel merge headers with the file data that follows */
+            if (!(elem->dwElFlags & TP_ELEMENT_EOP) && wsa->current + 1 < wsa->count &&
+                (wsa->elements[wsa->current + 1].dwElFlags & TP_ELEMENT_FILE))
+                flags |= MSG_MORE;
+#endif
+            while ((ret = send( fd, (char *)elem->u.pBuffer + wsa->offset, len, flags )) == -1 &&
+                   errno == EINTR);
+            if (ret == -1) return errno == EAGAIN ? STATUS_PENDING : wsaErrStatus();
+            sent = ret;
+        }
+        wsa->offset += sent;
+        wsa->remaining -= sent;
+        iosb->Information += sent;
+    }
+    return STATUS_SUCCESS;
+}
+
+/* finish a TransmitPackets() operation once all the data has been sent */
+static NTSTATUS WS2_transmit_done( int fd, struct ws2_transmit_async *wsa )
+{
+    if (!(wsa->flags & TP_DISCONNECT)) return STATUS_SUCCESS;
+    if (shutdown( fd, SHUT_WR )) return wsaErrStatus();
+    _enable_event( wsa->hSocket, 0, 0, FD_WRITE );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              WS2_async_transmit      (INTERNAL)
+ *
+ * Handler for overlapped TransmitFile() and TransmitPackets() operations.
+ */
+static NTSTATUS WS2_async_transmit( void *user, IO_STATUS_BLOCK *iosb,
+                                    NTSTATUS status, void **apc, void **arg )
+{
+    struct ws2_transmit_async *wsa = user;
+    int fd;
+
+    if (status == STATUS_ALERTED)
+    {
+        if (!(status = wine_server_handle_to_fd( wsa->hSocket, FILE_WRITE_DATA, &fd, NULL )))
+        {
+            if (!(status = WS2_transmit( fd, wsa, iosb ))) status = WS2_transmit_done( fd, wsa );
+            wine_server_release_fd( wsa->hSocket, fd );
+        }
+    }
+    if (status != STATUS_PENDING)
+    {
+        iosb->u.Status = status;
+        release_async_io( &wsa->io );
+    }
+    return status;
+}
+
+/***********************************************************************
+ * Socket reactor
+ *
+ * When WINESOCKETREACTOR is set, overlapped operations that can't complete
+ * right away are not queued as server asyncs. They are handed to a thread
+ * that waits for the sockets of the process with epoll and does the I/O
+ * itself. The server is then only involved to post the completion and
+ * re-enable the socket events, and the requests for several completed
+ * operations are sent in a single batch. Completion routines are queued as
+ * user APCs to the thread that started the operation.
+ *
+ * The reactor keeps the operations of each direction in order: while some
+ * are pending, new recv, send, TransmitPackets and shutdown requests of the
+ * same direction are queued behind them instead of being attempted right
+ * away or given to the server. Reads and writes done through ntdll on the
+ * socket handle are not ordered with them.
+ *
+ * The reactor works on its own copy of the unix fd. ntdll calls back into
+ * it when the I/O of a handle is cancelled and before the handle is closed,
+ * so that the pending operations are aborted and the copy is closed with it.
+ */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+
+static BOOL CDECL socket_cancel_io( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread,
+                                    NTSTATUS status );
+
+enum reactor_op_type
+{
+    REACTOR_RECV,
+    REACTOR_SEND,
+    REACTOR_TRANSMIT,
+    REACTOR_SHUTDOWN_RECV,
+    REACTOR_SHUTDOWN_SEND
+};
+
+struct reactor_op
+{
+    struct list          entry;
+    enum reactor_op_type type;
+    void                *user;      /* async data of the operation, NULL for a shutdown */
+    HANDLE               handle;    /* socket handle */
+    IO_STATUS_BLOCK     *iosb;      /* NULL if the operation has no completion */
+    HANDLE               event;
+    ULONG_PTR            cvalue;
+    HANDLE               thread;    /* thread to queue the completion routine to */
+    DWORD                tid;       /* thread that started the operation, for CancelIo */
+    NTSTATUS             status;    /* final status, the iosb may be gone by the time */
+    ULONG_PTR            information;
+};
+
+struct reactor_socket
+{
+    struct list         entry;     /* entry in the hash table */
+    SOCKET              s;
+    int                 fd;        /* private copy of the unix fd */
+    unsigned int        events;    /* events registered with epoll */
+    struct list         reads;     /* pending recv operations */
+    struct list         writes;    /* pending send operations */
+};
+
+#define REACTOR_HASH_SIZE  256
+#define REACTOR_BATCH_OPS  16      /* completions sent to the server at once */
+
+static struct list reactor_sockets[REACTOR_HASH_SIZE];
+static LONG reactor_nb_sockets;
+static int reactor_epoll_fd = -1;
+static int reactor_enabled = -1;   /* -1 until initialized */
+
+static CRITICAL_SECTION reactor_cs;
+static CRITICAL_SECTION_DEBUG reactor_cs_debug =
+{
+    0, 0, &reactor_cs,
+    { &reactor_cs_debug.ProcessLocksList, &reactor_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": reactor_cs") }
+};
+static CRITICAL_SECTION reactor_cs = { &reactor_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline struct list *reactor_bucket( SOCKET s )
+{
+    return &reactor_sockets[(s >> 2) % REACTOR_HASH_SIZE];
+}
+
+static inline BOOL reactor_op_is_read( enum reactor_op_type type )
+{
+    return type == REACTOR_RECV || type == REACTOR_SHUTDOWN_RECV;
+}
+
+/* find the reactor entry of a socket; reactor_cs must be held */
+static struct reactor_socket *reactor_find_socket( SOCKET s )
+{
+    struct reactor_socket *sock;
+
+    LIST_FOR_EACH_ENTRY( sock, reactor_bucket( s ), struct reactor_socket, entry )
+        if (sock->s == s) return sock;
+    return NULL;
+}
+
+/* update the epoll registration of a socket, freeing it once it has no pending operation */
+static BOOL reactor_update_socket( struct reactor_socket *sock )
+{
+    struct epoll_event ev;
+    unsigned int events = 0;
+
+    if (!list_empty( &sock->reads )) events |= EPOLLIN;
+    if (!list_empty( &sock->writes )) events |= EPOLLOUT;
+    if (events == sock->events && events) return TRUE;
+
+    if (!events)
+    {
+        if (sock->events) epoll_ctl( reactor_epoll_fd, EPOLL_CTL_DEL, sock->fd, NULL );
+        close( sock->fd );
+        list_remove( &sock->entry );
+        HeapFree( GetProcessHeap(), 0, sock );
+        InterlockedDecrement( &reactor_nb_sockets );
+        return TRUE;
+    }
+    ev.events = events;
+    ev.data.u64 = sock->s;
+    if (epoll_ctl( reactor_epoll_fd, sock->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, sock->fd, &ev ) == -1)
+        return FALSE;
+    sock->events = events;
+    return TRUE;
+}
+
+/* finish an operation; the caller still has to notify the completion */
+static void reactor_set_result( struct reactor_op *op, NTSTATUS status, struct list *done )
+{
+    list_remove( &op->entry );
+    op->status = status;
+    if (op->iosb)
+    {
+        op->iosb->Information = op->information;
+        /* the status must be visible last, applications poll it */
+        InterlockedExchange( (LONG *)&op->iosb->u.Status, status );
+    }
+    list_add_tail( done, &op->entry );
+}
+
+/* try to perform an operation; returns FALSE if it has to wait for the socket */
+static BOOL reactor_run_op( struct reactor_socket *sock, struct reactor_op *op, struct list *done )
+{
+    struct ws2_async *wsa = op->user;
+    NTSTATUS status;
+    int n;
+
+    switch (op->type)
+    {
+    case REACTOR_RECV:
+        n = WS2_recv( sock->fd, wsa, convert_flags(wsa->flags) );
+        if (n == -1 && errno == EAGAIN) return FALSE;
+        if (n == -1)
+        {
+            reactor_set_result( op, wsaErrStatus(), done );
+            break;
+        }
+        op->information = n;
+        reactor_set_result( op, STATUS_SUCCESS, done );
+        break;
+
+    case REACTOR_SEND:
+        n = WS2_send( sock->fd, wsa, convert_flags(wsa->flags) );
+        if (n == -1 && errno == EAGAIN) return FALSE;
+        if (n == -1)
+        {
+            reactor_set_result( op, wsaErrStatus(), done );
+            break;
+        }
+        op->information += n;
+        /* partial send, wait until there is room for the rest */
+        if (wsa->first_iovec < wsa->n_iovecs) return FALSE;
+        reactor_set_result( op, STATUS_SUCCESS, done );
+        break;
+
+    case REACTOR_TRANSMIT:
+        status = WS2_transmit( sock->fd, op->user, op->iosb );
+        op->information = op->iosb->Information;
+        if (status == STATUS_PENDING) return FALSE;
+        if (!status) status = WS2_transmit_done( sock->fd, op->user );
+        reactor_set_result( op, status, done );
+        break;
+
+    case REACTOR_SHUTDOWN_RECV:
+    case REACTOR_SHUTDOWN_SEND:
+        n = shutdown( sock->fd, op->type == REACTOR_SHUTDOWN_RECV ? SHUT_RD : SHUT_WR );
+        reactor_set_result( op, n ? wsaErrStatus() : STATUS_SUCCESS, done );
+        break;
+    }
+    return TRUE;
+}
+
+/* try to perform the pending operations of a socket; reactor_cs must be held */
+static void reactor_process_socket( struct reactor_socket *sock, unsigned int events, struct list *done )
+{
+    struct reactor_op *op, *next;
+
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( op, next, &sock->reads, struct reactor_op, entry )
+            if (!reactor_run_op( sock, op, done )) break;
+    }
+    if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+    {
+        LIST_FOR_EACH_ENTRY_SAFE( op, next, &sock->writes, struct reactor_op, entry )
+            if (!reactor_run_op( sock, op, done )) break;
+    }
+}
+
+/* notify the completion of finished operations */
+static void reactor_complete( struct list *done )
+{
+    struct __server_request_info info[2 * REACTOR_BATCH_OPS];
+    void *reqs[2 * REACTOR_BATCH_OPS];
+    struct reactor_op *ops[REACTOR_BATCH_OPS];
+    struct list *ptr;
+    unsigned int i, count, nb_ops;
+
+    while (!list_empty( done ))
+    {
+        count = nb_ops = 0;
+        while (nb_ops < REACTOR_BATCH_OPS && (ptr = list_head( done )))
+        {
+            struct reactor_op *op = LIST_ENTRY( ptr, struct reactor_op, entry );
+
+            list_remove( &op->entry );
+            ops[nb_ops++] = op;
+            if (op->type == REACTOR_RECV && !op->status)
+            {
+                struct enable_socket_event_request *req = SERVER_INIT_REQ( &info[count], enable_socket_event );
+                req->handle = wine_server_obj_handle( op->handle );
+                req->mask   = FD_READ;
+                reqs[count] = &info[count];
+                count++;
+            }
+            if (op->cvalue)
+            {
+                struct add_fd_completion_request *req = SERVER_INIT_REQ( &info[count], add_fd_completion );
+                req->handle      = wine_server_obj_handle( op->handle );
+                req->cvalue      = op->cvalue;
+                req->status      = op->status;
+                req->information = op->information;
+                reqs[count] = &info[count];
+                count++;
+            }
+        }
+        if (count) wine_server_call_batch( reqs, count );
+
+        for (i = 0; i < nb_ops; i++)
+        {
+            if (ops[i]->event) NtSetEvent( ops[i]->event, NULL );
+            if (ops[i]->iosb) RtlWakeAddressAll( &ops[i]->iosb->u.Status );
+            if (ops[i]->thread)
+            {
+                NtQueueApcThread( ops[i]->thread, (PNTAPCFUNC)ws2_async_apc,
+                                  (ULONG_PTR)ops[i]->user, (ULONG_PTR)ops[i]->iosb, 0 );
+                NtClose( ops[i]->thread );
+            }
+            else if (ops[i]->user) release_async_io( ops[i]->user );
+            HeapFree( GetProcessHeap(), 0, ops[i] );
+        }
+    }
+}
+
+static DWORD WINAPI reactor_thread( void *arg )
+{
+    struct epoll_event events[64];
+    struct reactor_socket *sock;
+    struct list done;
+    int i, n;
+
+    for (;;)
+    {
+        if ((n = epoll_wait( reactor_epoll_fd, events, sizeof(events) / sizeof(events[0]), -1 )) == -1)
+        {
+            if (errno == EINTR) continue;
+            ERR( "epoll_wait failed: %s\n", strerror(errno) );
+            break;
+        }
+
+        list_init( &done );
+        EnterCriticalSection( &reactor_cs );
+        for (i = 0; i < n; i++)
+        {
+            /* the socket may have been closed since epoll_wait returned */
+            if (!(sock = reactor_find_socket( events[i].data.u64 ))) continue;
+            reactor_process_socket( sock, events[i].events, &done );
+            reactor_update_socket( sock );
+        }
+        LeaveCriticalSection( &reactor_cs );
+        reactor_complete( &done );
+    }
+    return 0;
+}
+
+/***********************************************************************
+ *              reactor_cancel_io       (INTERNAL)
+ *
+ * Abort the reactor operations of a handle whose I/O is cancelled or which
+ * is about to be closed.
+ */
+static BOOL CDECL reactor_cancel_io( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread,
+                                     NTSTATUS status )
+{
+    struct reactor_socket *sock;
+    struct reactor_op *op, *next;
+    struct list done, *lists[2];
+    DWORD tid = GetCurrentThreadId();
+    unsigned int i;
+    BOOL ret;
+
+    if (!reactor_nb_sockets) return FALSE;
+
+    list_init( &done );
+    EnterCriticalSection( &reactor_cs );
+    if ((sock = reactor_find_socket( HANDLE2SOCKET(handle) )))
+    {
+        lists[0] = &sock->reads;
+        lists[1] = &sock->writes;
+        for (i = 0; i < 2; i++)
+        {
+            LIST_FOR_EACH_ENTRY_SAFE( op, next, lists[i], struct reactor_op, entry )
+            {
+                if (iosb && op->iosb != iosb) continue;
+                if (only_thread && op->tid != tid) continue;
+                reactor_set_result( op, status, &done );
+            }
+        }
+        /* the operations queued behind the cancelled ones may be able to run now */
+        reactor_process_socket( sock, EPOLLIN | EPOLLOUT, &done );
+        reactor_update_socket( sock );
+    }
+    LeaveCriticalSection( &reactor_cs );
+
+    ret = !list_empty( &done );
+    reactor_complete( &done );
+    return ret;
+}
+
+static BOOL reactor_init(void)
+{
+    if (reactor_enabled != -1) return reactor_enabled;
+
+    EnterCriticalSection( &reactor_cs );
+    if (reactor_enabled == -1)
+    {
+        const char *env = getenv( "WINESOCKETREACTOR" );
+        HANDLE thread;
+        int i;
+
+        reactor_enabled = 0;
+        if (env && atoi( env ) && (reactor_epoll_fd = epoll_create( 128 )) != -1)
+        {
+            fcntl( reactor_epoll_fd, F_SETFD, FD_CLOEXEC );
+            for (i = 0; i < REACTOR_HASH_SIZE; i++) list_init( &reactor_sockets[i] );
+            if ((thread = CreateThread( NULL, 0, reactor_thread, NULL, 0, NULL )))
+            {
+                CloseHandle( thread );
+                __wine_set_io_cancel_handler( socket_cancel_io );
+                reactor_enabled = 1;
+            }
+            else
+            {
+                close( reactor_epoll_fd );
+                reactor_epoll_fd = -1;
+            }
+        }
+        TRACE( "socket reactor %s\n", reactor_enabled ? "enabled" : "disabled" );
+    }
+    LeaveCriticalSection( &reactor_cs );
+    return reactor_enabled;
+}
+
+static void reactor_detach(void)
+{
+    /* the handler is also installed for the poll caches */
+    __wine_set_io_cancel_handler( NULL );
+}
+
+/* check whether operations of the given direction are pending in the reactor */
+static BOOL reactor_busy( SOCKET s, BOOL read )
+{
+    struct reactor_socket *sock;
+    BOOL ret = FALSE;
+
+    if (!reactor_nb_sockets) return FALSE;
+
+    EnterCriticalSection( &reactor_cs );
+    if ((sock = reactor_find_socket( s )))
+        ret = !list_empty( read ? &sock->reads : &sock->writes );
+    LeaveCriticalSection( &reactor_cs );
+    return ret;
+}
+
+/***********************************************************************
+ *              reactor_queue           (INTERNAL)
+ *
+ * Hand a pending overlapped operation to the reactor. The iosb must already
+ * be set to STATUS_PENDING. A shutdown is only queued if it has to wait for
+ * other operations. Returns FALSE if the server must handle it.
+ */
+static BOOL reactor_queue( SOCKET s, enum reactor_op_type type, void *user, IO_STATUS_BLOCK *iosb,
+                           HANDLE event, ULONG_PTR cvalue )
+{
+    struct reactor_socket *sock;
+    struct reactor_op *op;
+    struct list *queue;
+    int fd;
+    BOOL ret = FALSE;
+
+    if (!reactor_init()) return FALSE;
+    if ((type == REACTOR_SHUTDOWN_RECV || type == REACTOR_SHUTDOWN_SEND) &&
+        !reactor_busy( s, reactor_op_is_read( type ) ))
+        return FALSE;
+
+    if (!(op = HeapAlloc( GetProcessHeap(), 0, sizeof(*op) ))) return FALSE;
+    op->type        = type;
+    op->user        = user;
+    op->handle      = SOCKET2HANDLE(s);
+    op->iosb        = iosb;
+    op->event       = event;
+    op->cvalue      = cvalue;
+    op->thread      = 0;
+    op->tid         = GetCurrentThreadId();
+    op->status      = STATUS_PENDING;
+    op->information = iosb ? iosb->Information : 0;
+
+    /* the completion routine has to be called in the thread that started the operation */
+    if ((type == REACTOR_RECV || type == REACTOR_SEND) && ((struct ws2_async *)user)->completion_func &&
+        NtDuplicateObject( NtCurrentProcess(), GetCurrentThread(), NtCurrentProcess(),
+                           &op->thread, 0, 0, DUPLICATE_SAME_ACCESS ))
+    {
+        HeapFree( GetProcessHeap(), 0, op );
+        return FALSE;
+    }
+
+    /* like the server does for asyncs, the event is reset when the I/O starts */
+    if (event) NtResetEvent( event, NULL );
+
+    EnterCriticalSection( &reactor_cs );
+    if (!(sock = reactor_find_socket( s )))
+    {
+        if ((fd = get_sock_fd( s, 0, NULL )) == -1) goto done;
+        if (!(sock = HeapAlloc( GetProcessHeap(), 0, sizeof(*sock) )))
+        {
+            release_sock_fd( s, fd );
+            goto done;
+        }
+        sock->s      = s;
+        sock->fd     = dup( fd );
+        sock->events = 0;
+        list_init( &sock->reads );
+        list_init( &sock->writes );
+        release_sock_fd( s, fd );
+        if (sock->fd == -1)
+        {
+            HeapFree( GetProcessHeap(), 0, sock );
+            goto done;
+        }
+        fcntl( sock->fd, F_SETFD, FD_CLOEXEC );
+        list_add_tail( reactor_bucket( s ), &sock->entry );
+        InterlockedIncrement( &reactor_nb_sockets );
+    }
+    queue = reactor_op_is_read( type ) ? &sock->reads : &sock->writes;
+    if ((type == REACTOR_SHUTDOWN_RECV || type == REACTOR_SHUTDOWN_SEND) && list_empty( queue ))
+    {
+        /* the operations it waited for are done already */
+        reactor_update_socket( sock );
+        goto done;
+    }
+    list_add_tail( queue, &op->entry );
+    if (!(ret = reactor_update_socket( sock )))
+    {
+        list_remove( &op->entry );
+        reactor_update_socket( sock );
+    }
+done:
+    LeaveCriticalSection( &reactor_cs );
+    if (!ret)
+    {
+        if (op->thread) NtClose( op->thread );
+        HeapFree( GetProcessHeap(), 0, op );
+    }
+    return ret;
+}
+
+/* wait for a reactor operation that has no event; returns FALSE if it isn't one */
+static BOOL reactor_wait( SOCKET s, IO_STATUS_BLOCK *iosb )
+{
+    static const NTSTATUS pending = STATUS_PENDING;
+    struct reactor_socket *sock;
+    struct reactor_op *op;
+    BOOL found = FALSE;
+
+    if (reactor_enabled != 1) return FALSE;
+
+    /* the status is updated with reactor_cs held, so a finished operation is never missed */
+    EnterCriticalSection( &reactor_cs );
+    if (iosb->u.Status != STATUS_PENDING) found = TRUE;
+    else if ((sock = reactor_find_socket( s )))
+    {
+        LIST_FOR_EACH_ENTRY( op, &sock->reads, struct reactor_op, entry )
+            if (op->iosb == iosb) found = TRUE;
+        LIST_FOR_EACH_ENTRY( op, &sock->writes, struct reactor_op, entry )
+            if (op->iosb == iosb) found = TRUE;
+    }
+    LeaveCriticalSection( &reactor_cs );
+
+    if (found)
+        while (iosb->u.Status == STATUS_PENDING)
+            RtlWaitOnAddress( &iosb->u.Status, &pending, sizeof(pending), NULL );
+    return found;
+}
+
+#else  /* HAVE_SYS_EPOLL_H */
+
+enum reactor_op_type
+{
+    REACTOR_RECV,
+    REACTOR_SEND,
+    REACTOR_TRANSMIT,
+    REACTOR_SHUTDOWN_RECV,
+    REACTOR_SHUTDOWN_SEND
+};
+
+static void reactor_detach(void)
+{
+}
+
+static BOOL reactor_busy( SOCKET s, BOOL read )
+{
+    return FALSE;
+}
+
+static BOOL reactor_queue( SOCKET s, enum reactor_op_type type, void *user, IO_STATUS_BLOCK *iosb,
+                           HANDLE event, ULONG_PTR cvalue )
+{
+    return FALSE;
+}
+
+static BOOL reactor_wait( SOCKET s, IO_STATUS_BLOCK *iosb )
+{
+    return FALSE;
+}
+
+#endif  /* HAVE_SYS_EPOLL_H */
+
+/* the unix events to poll on a socket for a POLLIN, POLLOUT or POLLPRI (exceptions)
+ * request, following the select() rules: only bound sockets are reported, except
+ * that datagram sockets can always be written to */
+static short map_poll_request( short request, int type, BOOL bound, BOOL oob_inline )
+{
+    short events = 0;
+
+    if (!bound) return type == SOCK_DGRAM ? request & POLLOUT : 0;
+    if (request & POLLIN) events |= POLLIN;
+    if (request & POLLOUT) events |= POLLOUT;
+    if (request & POLLPRI) events |= oob_inline ? POLLHUP : POLLHUP | POLLPRI;
+    return events;
+}
+
+/***********************************************************************
+ * Poll cache
+ *
+ * select() and WSAPoll() calls on large socket sets keep the unix fds of the
+ * sockets registered in a per-thread epoll set, along with the socket state
+ * that decides which events are polled. Polling the same sockets again then
+ * costs a hash lookup per socket instead of several system calls, and the
+ * kernel only reports the ready ones. Entries are dropped when their socket
+ * is closed, or when they are reported ready while no longer being polled.
+ * Sockets can also be closed through ntdll, which notifies us before the
+ * handle is closed, so that a reused handle value doesn't find the old fd.
+ */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+
+#define POLL_CACHE_MIN      64      /* smaller sets are passed to poll() directly */
+#define POLL_CACHE_BUCKETS  4096
+#define POLL_CACHE_EVENTS   4096    /* maximum number of events returned at once */
+
+struct poll_cache_entry
+{
+    struct list   entry;        /* entry in the hash table */
+    SOCKET        s;
+    int           fd;           /* private copy of the unix fd */
+    int           type;
+    BOOL          bound;        /* a socket can't become unbound again */
+    BOOL          oob_inline;
+    unsigned int  events;       /* events registered with epoll */
+    unsigned int  wanted;       /* events polled by the current call */
+    unsigned int  revents;      /* events reported to the current call */
+    unsigned int  gen;          /* last call that polled the socket */
+};
+
+struct poll_cache
+{
+    struct list       entry;    /* entry in the poll_caches list */
+    CRITICAL_SECTION  cs;       /* protects the entries against closesocket() from other threads */
+    int               epoll_fd;
+    unsigned int      gen;
+    unsigned int      count;
+    struct list       buckets[POLL_CACHE_BUCKETS];
+};
+
+static struct list poll_caches = LIST_INIT( poll_caches );
+
+static CRITICAL_SECTION poll_cache_cs;
+static CRITICAL_SECTION_DEBUG poll_cache_cs_debug =
+{
+    0, 0, &poll_cache_cs,
+    { &poll_cache_cs_debug.ProcessLocksList, &poll_cache_cs_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": poll_cache_cs") }
+};
+static CRITICAL_SECTION poll_cache_cs = { &poll_cache_cs_debug, -1, 0, 0, 0, 0 };
+
+static inline struct list *poll_cache_bucket( struct poll_cache *cache, SOCKET s )
+{
+    return &cache->buckets[(s >> 2) % POLL_CACHE_BUCKETS];
+}
+
+/* cache->cs must be held */
+static struct poll_cache_entry *poll_cache_find( struct poll_cache *cache, SOCKET s )
+{
+    struct poll_cache_entry *entry;
+
+    LIST_FOR_EACH_ENTRY( entry, poll_cache_bucket( cache, s ), struct poll_cache_entry, entry )
+        if (entry->s == s) return entry;
+    return NULL;
+}
+
+/* cache->cs must be held */
+static void poll_cache_free_entry( struct poll_cache *cache, struct poll_cache_entry *entry )
+{
+    if (entry->events) epoll_ctl( cache->epoll_fd, EPOLL_CTL_DEL, entry->fd, NULL );
+    close( entry->fd );
+    list_remove( &entry->entry );
+    HeapFree( GetProcessHeap(), 0, entry );
+    cache->count--;
+}
+
+/* find or create the entry of a socket; cache->cs must be held */
+static struct poll_cache_entry *poll_cache_get( struct poll_cache *cache, SOCKET s )
+{
+    struct poll_cache_entry *entry;
+    socklen_t len = sizeof(int);
+    int fd;
+
+    if ((entry = poll_cache_find( cache, s ))) return entry;
+
+    if ((fd = get_sock_fd( s, 0, NULL )) == -1) return NULL;
+    if (!(entry = HeapAlloc( GetProcessHeap(), 0, sizeof(*entry) )))
+    {
+        release_sock_fd( s, fd );
+        return NULL;
+    }
+    /* the fd returned by get_sock_fd is our own copy, keep it */
+    fcntl( fd, F_SETFD, FD_CLOEXEC );
+    entry->s       = s;
+    entry->fd      = fd;
+    entry->type    = _get_fd_type( fd );
+    entry->bound   = is_fd_bound( fd, NULL, NULL ) == 1;
+    entry->oob_inline = 0;
+    getsockopt( fd, SOL_SOCKET, SO_OOBINLINE, (char *)&entry->oob_inline, &len );
+    entry->events  = 0;
+    entry->wanted  = 0;
+    entry->revents = 0;
+    entry->gen     = 0;
+    list_add_tail( poll_cache_bucket( cache, s ), &entry->entry );
+    cache->count++;
+    return entry;
+}
+
+static struct poll_cache *get_poll_cache( unsigned int count )
+{
+    struct per_thread_data *ptb;
+    struct poll_cache *cache;
+    unsigned int i;
+
+    if (count < POLL_CACHE_MIN) return NULL;
+    ptb = get_per_thread_data();
+    if (ptb->poll_cache) return ptb->poll_cache;
+
+    if (!(cache = HeapAlloc( GetProcessHeap(), 0, sizeof(*cache) ))) return NULL;
+    if ((cache->epoll_fd = epoll_create( 128 )) == -1)
+    {
+        HeapFree( GetProcessHeap(), 0, cache );
+        return NULL;
+    }
+    fcntl( cache->epoll_fd, F_SETFD, FD_CLOEXEC );
+    InitializeCriticalSection( &cache->cs );
+    cache->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": poll_cache.cs");
+    cache->gen = 0;
+    cache->count = 0;
+    for (i = 0; i < POLL_CACHE_BUCKETS; i++) list_init( &cache->buckets[i] );
+
+    EnterCriticalSection( &poll_cache_cs );
+    list_add_tail( &poll_caches, &cache->entry );
+    LeaveCriticalSection( &poll_cache_cs );
+    __wine_set_io_cancel_handler( socket_cancel_io );
+    ptb->poll_cache = cache;
+    return cache;
+}
+
+static void poll_cache_destroy( struct poll_cache *cache )
+{
+    struct poll_cache_entry *entry, *next;
+    unsigned int i;
+
+    EnterCriticalSection( &poll_cache_cs );
+    list_remove( &cache->entry );
+    LeaveCriticalSection( &poll_cache_cs );
+
+    for (i = 0; i < POLL_CACHE_BUCKETS; i++)
+        LIST_FOR_EACH_ENTRY_SAFE( entry, next, &cache->buckets[i], struct poll_cache_entry, entry )
+            poll_cache_free_entry( cache, entry );
+    close( cache->epoll_fd );
+    cache->cs.DebugInfo->Spare[0] = 0;
+    DeleteCriticalSection( &cache->cs );
+    HeapFree( GetProcessHeap(), 0, cache );
+}
+
+/* forget a socket that is being closed, or whose handle is being reused */
+static void poll_cache_remove( SOCKET s )
+{
+    struct poll_cache_entry *entry;
+    struct poll_cache *cache;
+
+    if (list_empty( &poll_caches )) return;
+
+    EnterCriticalSection( &poll_cache_cs );
+    LIST_FOR_EACH_ENTRY( cache, &poll_caches, struct poll_cache, entry )
+    {
+        EnterCriticalSection( &cache->cs );
+        if ((entry = poll_cache_find( cache, s ))) poll_cache_free_entry( cache, entry );
+        LeaveCriticalSection( &cache->cs );
+    }
+    LeaveCriticalSection( &poll_cache_cs );
+}
+
+/***********************************************************************
+ *              socket_cancel_io        (INTERNAL)
+ *
+ * Called by ntdll when the I/O of a handle is cancelled or the handle is
+ * about to be closed.
+ */
+static BOOL CDECL socket_cancel_io( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread,
+                                    NTSTATUS status )
+{
+    if (status == STATUS_HANDLES_CLOSED) poll_cache_remove( HANDLE2SOCKET(handle) );
+    return reactor_enabled == 1 && reactor_cancel_io( handle, iosb, only_thread, status );
+}
+
+/***********************************************************************
+ *              poll_cache_wait         (INTERNAL)
+ *
+ * Equivalent of poll() on sockets. fds[i].events holds the POLLIN, POLLOUT
+ * or POLLPRI request for sockets[i], items without request are ignored.
+ * Sockets that can't be polled get POLLNVAL. Returns the number of items
+ * with events, or -1 on failure with errno set.
+ */
+static int poll_cache_wait( struct poll_cache *cache, const SOCKET *sockets, struct pollfd *fds,
+                            unsigned int count, int timeout )
+{
+    struct poll_cache_entry *entry, *next;
+    struct epoll_event ev, *events;
+    unsigned int i, gen, distinct = 0, invalid = 0;
+    DWORD end = 0;
+    int n, ret = 0;
+
+    EnterCriticalSection( &cache->cs );
+    gen = ++cache->gen;
+    for (i = 0; i < count; i++)
+    {
+        fds[i].revents = 0;
+        if (!fds[i].events) continue;
+        if (!(entry = poll_cache_get( cache, sockets[i] )))
+        {
+            fds[i].events = 0;
+            fds[i].revents = POLLNVAL;
+            invalid++;
+            continue;
+        }
+        if (entry->gen != gen)
+        {
+            entry->gen = gen;
+            entry->wanted = 0;
+            entry->revents = 0;
+            if (!entry->bound) entry->bound = is_fd_bound( entry->fd, NULL, NULL ) == 1;
+            distinct++;
+        }
+        fds[i].events = map_poll_request( fds[i].events, entry->type, entry->bound, entry->oob_inline );
+        entry->wanted |= fds[i].events;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (!fds[i].events || !(entry = poll_cache_find( cache, sockets[i] ))) continue;
+        if (entry->events == entry->wanted) continue;
+        /* the poll and epoll flags have the same values */
+        ev.events = entry->wanted;
+        ev.data.u64 = entry->s;
+        if (!entry->wanted) epoll_ctl( cache->epoll_fd, EPOLL_CTL_DEL, entry->fd, NULL );
+        else epoll_ctl( cache->epoll_fd, entry->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, entry->fd, &ev );
+        entry->events = entry->wanted;
+    }
+    LeaveCriticalSection( &cache->cs );
+
+    distinct = min( max( distinct, 1 ), POLL_CACHE_EVENTS );
+    if (!(events = HeapAlloc( GetProcessHeap(), 0, distinct * sizeof(*events) )))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (invalid) timeout = 0;
+    if (timeout > 0) end = GetTickCount() + timeout;
+
+    for (;;)
+    {
+        if ((n = epoll_wait( cache->epoll_fd, events, distinct, timeout )) == -1)
+        {
+            if (errno != EINTR) break;
+            n = 0;
+        }
+
+        EnterCriticalSection( &cache->cs );
+        for (i = 0; i < n; i++)
+        {
+            if (!(entry = poll_cache_find( cache, events[i].data.u64 ))) continue;
+            if (entry->gen != gen)
+            {
+                /* no longer polled by anybody, stop watching it */
+                poll_cache_free_entry( cache, entry );
+                continue;
+            }
+            entry->revents = events[i].events;
+            ret++;
+        }
+        LeaveCriticalSection( &cache->cs );
+
+        if (ret || !timeout) break;
+        if (timeout > 0 && (timeout = end - GetTickCount()) <= 0) break;
+    }
+    HeapFree( GetProcessHeap(), 0, events );
+    if (n == -1) return -1;
+
+    ret = invalid;
+    EnterCriticalSection( &cache->cs );
+    for (i = 0; i < count; i++)
+    {
+        if (!fds[i].events) continue;
+        /* the socket may have been closed meanwhile */
+        if (!(entry = poll_cache_find( cache, sockets[i] )) || entry->gen != gen) continue;
+        fds[i].revents = entry->revents & (fds[i].events | POLLERR | POLLHUP);
+        if (fds[i].revents) ret++;
+    }
+    /* drop the entries of sockets that aren't polled any more */
+    if (cache->count > 2 * count + POLL_CACHE_MIN)
+    {
+        for (i = 0; i < POLL_CACHE_BUCKETS; i++)
+            LIST_FOR_EACH_ENTRY_SAFE( entry, next, &cache->buckets[i], struct poll_cache_entry, entry )
+                if (entry->gen != gen) poll_cache_free_entry( cache, entry );
+    }
+    LeaveCriticalSection( &cache->cs );
+    return ret;
 }
 
-/***********************************************************************
- *              WS2_async_shutdown      (INTERNAL)
- *
- * Handler for shutdown() operations on overlapped sockets.
- */
-static NTSTATUS WS2_async_shutdown( void *user, IO_STATUS_BLOCK *iosb,
-                                    NTSTATUS status, void **apc, void **arg )
+#else  /* HAVE_SYS_EPOLL_H */
+
+static struct poll_cache *get_poll_cache( unsigned int count )
 {
-    struct ws2_async_shutdown *wsa = user;
-    int fd, err = 1;
+    return NULL;
+}
 
-    switch (status)
-    {
-    case STATUS_ALERTED:
-        if ((status = wine_server_handle_to_fd( wsa->hSocket, 0, &fd, NULL ) ))
-            break;
+static void poll_cache_destroy( struct poll_cache *cache )
+{
+}
 
-        switch ( wsa->type )
-        {
-        case ASYNC_TYPE_READ:   err = shutdown( fd, 0 );  break;
-        case ASYNC_TYPE_WRITE:  err = shutdown( fd, 1 );  break;
-        }
-        status = err ? wsaErrStatus() : STATUS_SUCCESS;
-        wine_server_release_fd( wsa->hSocket, fd );
-        break;
-    }
-    iosb->u.Status = status;
-    iosb->Information = 0;
-    release_async_io( &wsa->io );
-    return status;
+static void poll_cache_remove( SOCKET s )
+{
+}
+
+static int poll_cache_wait( struct poll_cache *cache, const SOCKET *sockets, struct pollfd *fds,
+                            unsigned int count, int timeout )
+{
+    errno = ENOSYS;
+    return -1;
 }
 
+#endif  /* HAVE_SYS_EPOLL_H */
+
 /***********************************************************************
  *  WS2_register_async_shutdown         (INTERNAL)
  *
- * Helper function for WS_shutdown() on overlapped sockets.
+ * Helper function for WS_shutdown() on overlapped sockets. When an iosb is
+ * given, the shutdown completes it like any other overlapped operation.
  */
-static int WS2_register_async_shutdown( SOCKET s, int type )
+static int WS2_register_async_shutdown( SOCKET s, int type, IO_STATUS_BLOCK *iosb,
+                                        HANDLE event, ULONG_PTR cvalue )
 {
     struct ws2_async_shutdown *wsa;
     NTSTATUS status;
 
     TRACE("socket %04lx type %d\n", s, type);
 
+    /* keep it behind the operations pending in the reactor */
+    if (reactor_queue( s, type == ASYNC_TYPE_READ ? REACTOR_SHUTDOWN_RECV : REACTOR_SHUTDOWN_SEND,
+                       NULL, iosb, (HANDLE)((ULONG_PTR)event & ~1), cvalue ))
+        return 0;
+
     wsa = (struct ws2_async_shutdown *)alloc_async_io( sizeof(*wsa) );
     if ( !wsa )
         return WSAEFAULT;
@@ -2545,9 +3641,10 @@ static int WS2_register_async_shutdown( SOCKET s, int type )
         req->type   = type;
         req->async.handle   = wine_server_obj_handle( wsa->hSocket );
         req->async.callback = wine_server_client_ptr( WS2_async_shutdown );
-        req->async.iosb     = wine_server_client_ptr( &wsa->iosb );
+        req->async.iosb     = wine_server_client_ptr( iosb ? iosb : &wsa->iosb );
         req->async.arg      = wine_server_client_ptr( wsa );
-        req->async.cvalue   = 0;
+        req->async.event    = wine_server_obj_handle( event );
+        req->async.cvalue   = cvalue;
         status = wine_server_call( req );
     }
     SERVER_END_REQ;
@@ -2596,6 +3693,7 @@ SOCKET WINAPI WS_accept(SOCKET s, struct WS_sockaddr *addr, int *addrlen32)
                 return SOCKET_ERROR;
             }
             TRACE("\taccepted %04lx\n", as);
+            poll_cache_remove(as);
             return as;
         }
         if (is_blocking && status == STATUS_CANT_WAIT)
@@ -2969,6 +4067,7 @@ int WINAPI WS_closesocket(SOCKET s)
         if (fd >= 0)
         {
             release_sock_fd(s, fd);
+            poll_cache_remove(s);
             if (CloseHandle(SOCKET2HANDLE(s)))
                 res = 0;
         }
@@ -3201,6 +4300,231 @@ connection_success:
     return TRUE;
 }
 
+/***********************************************************************
+ *     TransmitPackets
+ */
+static BOOL WINAPI WS2_TransmitPackets( SOCKET s, LPTRANSMIT_PACKETS_ELEMENT array, DWORD count,
+                                        DWORD send_size, LPOVERLAPPED overlapped, DWORD flags )
+{
+    struct ws2_transmit_async *wsa;
+    IO_STATUS_BLOCK local_iosb, *iosb;
+    struct pollfd pfd;
+    NTSTATUS status;
+    ULONG_PTR cvalue;
+    unsigned int i;
+    int fd;
+
+    TRACE( "socket %04lx, elements %p, count %u, send_size %u, ov %p, flags %#x\n",
+           s, array, count, send_size, overlapped, flags );
+
+    if (count && !array)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (!(array[i].dwElFlags & (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE)) ||
+            (array[i].dwElFlags & (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE)) == (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE))
+        {
+            SetLastError( WSAEINVAL );
+            return FALSE;
+        }
+    }
+    if (flags & TP_REUSE_SOCKET)
+    {
+        FIXME( "socket reuse is not supported\n" );
+        SetLastError( WSAEOPNOTSUPP );
+        return FALSE;
+    }
+
+    if ((fd = get_sock_fd( s, FILE_WRITE_DATA, NULL )) == -1) return FALSE;
+
+    if (!(wsa = (struct ws2_transmit_async *)alloc_async_io( offsetof(struct ws2_transmit_async,
+                                                                      elements[count]) )))
+    {
+        release_sock_fd( s, fd );
+        SetLastError( WSAEFAULT );
+        return FALSE;
+    }
+    wsa->hSocket   = SOCKET2HANDLE(s);
+    wsa->flags     = flags;
+    wsa->send_size = send_size;
+    wsa->count     = count;
+    wsa->current   = 0;
+    wsa->offset    = 0;
+    wsa->remaining = ~(ULONGLONG)0;
+    memcpy( wsa->elements, array, count * sizeof(*array) );
+
+    iosb = overlapped ? (IO_STATUS_BLOCK *)overlapped : &local_iosb;
+    iosb->u.Status = STATUS_PENDING;
+    iosb->Information = 0;
+
+    if (overlapped && reactor_busy( s, FALSE )) status = STATUS_PENDING;
+    else status = WS2_transmit( fd, wsa, iosb );
+    if (!overlapped)
+    {
+        /* the unix socket is non-blocking, wait until there is room for the rest */
+        while (status == STATUS_PENDING)
+        {
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            poll( &pfd, 1, -1 );
+            status = WS2_transmit( fd, wsa, iosb );
+        }
+    }
+    if (!status && !overlapped) status = WS2_transmit_done( fd, wsa );
+    release_sock_fd( s, fd );
+
+    if (!status && overlapped && (flags & TP_DISCONNECT))
+    {
+        int err;
+
+        /* all the data is sent, the operation completes once the connection is shut down */
+        HeapFree( GetProcessHeap(), 0, wsa );
+        cvalue = ((ULONG_PTR)overlapped->hEvent & 1) == 0 ? (ULONG_PTR)overlapped : 0;
+        if ((err = WS2_register_async_shutdown( s, ASYNC_TYPE_WRITE, iosb, overlapped->hEvent, cvalue )))
+        {
+            SetLastError( err );
+            return FALSE;
+        }
+        _enable_event( SOCKET2HANDLE(s), 0, 0, FD_WRITE );
+        SetLastError( WSA_IO_PENDING );
+        return FALSE;
+    }
+
+    if (status == STATUS_PENDING)
+    {
+        cvalue = ((ULONG_PTR)overlapped->hEvent & 1) == 0 ? (ULONG_PTR)overlapped : 0;
+
+        if (reactor_queue( s, REACTOR_TRANSMIT, wsa, iosb,
+                           (HANDLE)((ULONG_PTR)overlapped->hEvent & ~1), cvalue ))
+        {
+            _enable_event( SOCKET2HANDLE(s), FD_WRITE, 0, 0 );
+            SetLastError( WSA_IO_PENDING );
+            return FALSE;
+        }
+
+        SERVER_START_REQ( register_async )
+        {
+            req->type           = ASYNC_TYPE_WRITE;
+            req->async.handle   = wine_server_obj_handle( wsa->hSocket );
+            req->async.callback = wine_server_client_ptr( WS2_async_transmit );
+            req->async.iosb     = wine_server_client_ptr( iosb );
+            req->async.arg      = wine_server_client_ptr( wsa );
+            req->async.event    = wine_server_obj_handle( overlapped->hEvent );
+            req->async.cvalue   = cvalue;
+            status = wine_server_call( req );
+        }
+        SERVER_END_REQ;
+
+        _enable_event( SOCKET2HANDLE(s), FD_WRITE, 0, 0 );
+
+        if (status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
+        SetLastError( NtStatusToWSAError( status ) );
+        return FALSE;
+    }
+
+    HeapFree( GetProcessHeap(), 0, wsa );
+    iosb->u.Status = status;
+    if (status)
+    {
+        /* an immediate failure isn't reported through the completion port nor the event */
+        SetLastError( NtStatusToWSAError( status ) );
+        return FALSE;
+    }
+    if (overlapped)
+    {
+        cvalue = ((ULONG_PTR)overlapped->hEvent & 1) == 0 ? (ULONG_PTR)overlapped : 0;
+        if (cvalue) WS_AddCompletion( s, cvalue, status, iosb->Information );
+        if (overlapped->hEvent) SetEvent( overlapped->hEvent );
+    }
+    return TRUE;
+}
+
+/***********************************************************************
+ *     TransmitFile
+ */
+static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE file, DWORD total_len, DWORD chunk_len,
+                                     LPOVERLAPPED overlapped, LPTRANSMIT_FILE_BUFFERS buffers, DWORD flags )
+{
+    TRANSMIT_PACKETS_ELEMENT elements[3];
+    DWORD count = 0;
+
+    TRACE( "socket %04lx, file %p, total_len %u, chunk_len %u, ov %p, buffers %p, flags %#x\n",
+           s, file, total_len, chunk_len, overlapped, buffers, flags );
+
+    if (buffers && buffers->Head && buffers->HeadLength)
+    {
+        elements[count].dwElFlags = TP_ELEMENT_MEMORY;
+        elements[count].cLength   = buffers->HeadLength;
+        elements[count].u.pBuffer = buffers->Head;
+        count++;
+    }
+    if (file)
+    {
+        elements[count].dwElFlags = TP_ELEMENT_FILE;
+        elements[count].cLength   = total_len;
+        elements[count].u.s.hFile = file;
+        /* overlapped transfers start at the offset of the overlapped structure */
+        if (overlapped)
+        {
+            elements[count].u.s.nFileOffset.u.LowPart  = overlapped->u.s.Offset;
+            elements[count].u.s.nFileOffset.u.HighPart = overlapped->u.s.OffsetHigh;
+        }
+        else elements[count].u.s.nFileOffset.QuadPart = -1;
+        count++;
+    }
+    if (buffers && buffers->Tail && buffers->TailLength)
+    {
+        elements[count].dwElFlags = TP_ELEMENT_MEMORY;
+        elements[count].cLength   = buffers->TailLength;
+        elements[count].u.pBuffer = buffers->Tail;
+        count++;
+    }
+    return WS2_TransmitPackets( s, elements, count, chunk_len, overlapped,
+                                flags & (TF_DISCONNECT | TF_REUSE_SOCKET) );
+}
+
+/***********************************************************************
+ *     DisconnectEx
+ */
+static BOOL WINAPI WS2_DisconnectEx( SOCKET s, LPOVERLAPPED overlapped, DWORD flags, DWORD reserved )
+{
+    IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)overlapped;
+    ULONG_PTR cvalue;
+    int err;
+
+    TRACE( "socket %04lx, ov %p, flags %#x, reserved %#x\n", s, overlapped, flags, reserved );
+
+    if (reserved)
+    {
+        SetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & TF_REUSE_SOCKET)
+    {
+        FIXME( "socket reuse is not supported\n" );
+        SetLastError( WSAEOPNOTSUPP );
+        return FALSE;
+    }
+
+    if (!overlapped) return !WS_shutdown( s, SD_SEND );
+
+    /* the shutdown is queued after the pending sends and completes the overlapped operation */
+    iosb->u.Status = STATUS_PENDING;
+    iosb->Information = 0;
+    cvalue = ((ULONG_PTR)overlapped->hEvent & 1) == 0 ? (ULONG_PTR)overlapped : 0;
+    if ((err = WS2_register_async_shutdown( s, ASYNC_TYPE_WRITE, iosb, overlapped->hEvent, cvalue )))
+    {
+        SetLastError( err );
+        return FALSE;
+    }
+    _enable_event( SOCKET2HANDLE(s), 0, 0, FD_WRITE );
+    SetLastError( WSA_IO_PENDING );
+    return FALSE;
+}
+
 
 /***********************************************************************
  *		getpeername		(WS2_32.5)
@@ -4416,7 +5740,8 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         }
         else if ( IsEqualGUID(&disconnectex_guid, in_buff) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented DisconnectEx\n");
+            *(LPFN_DISCONNECTEX *)out_buff = WS2_DisconnectEx;
+            break;
         }
         else if ( IsEqualGUID(&acceptex_guid, in_buff) )
         {
@@ -4430,11 +5755,13 @@ INT WINAPI WSAIoctl(SOCKET s, DWORD code, LPVOID in_buff, DWORD in_size, LPVOID
         }
         else if ( IsEqualGUID(&transmitfile_guid, in_buff) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitFile\n");
+            *(LPFN_TRANSMITFILE *)out_buff = WS2_TransmitFile;
+            break;
         }
         else if ( IsEqualGUID(&transmitpackets_guid, in_buff) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitPackets\n");
+            *(LPFN_TRANSMITPACKETS *)out_buff = WS2_TransmitPackets;
+            break;
         }
         else if ( IsEqualGUID(&wsarecvmsg_guid, in_buff) )
         {
@@ -4688,16 +6015,25 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
         return n;
 }
 
+/* number of sockets in the fd sets */
+static unsigned int fd_sets_count( const WS_fd_set *readfds, const WS_fd_set *writefds,
+                                   const WS_fd_set *exceptfds )
+{
+    unsigned int count = 0;
+
+    if (readfds) count += readfds->fd_count;
+    if (writefds) count += writefds->fd_count;
+    if (exceptfds) count += exceptfds->fd_count;
+    return count;
+}
+
 /* allocate a poll array for the corresponding fd sets */
 static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
                                        const WS_fd_set *exceptfds, int *count_ptr )
 {
-    unsigned int i, j = 0, count = 0;
+    unsigned int i, j = 0, count = fd_sets_count( readfds, writefds, exceptfds );
     struct pollfd *fds;
 
-    if (readfds) count += readfds->fd_count;
-    if (writefds) count += writefds->fd_count;
-    if (exceptfds) count += exceptfds->fd_count;
     *count_ptr = count;
     if (!count)
     {
@@ -4892,6 +6228,54 @@ static int get_poll_results( WS_fd_set *readfds, WS_fd_set *writefds, WS_fd_set
     return total;
 }
 
+/* select() through the poll cache */
+static int select_cached( struct poll_cache *cache, WS_fd_set *readfds, WS_fd_set *writefds,
+                          WS_fd_set *exceptfds, int timeout )
+{
+    unsigned int i, j = 0, count = fd_sets_count( readfds, writefds, exceptfds );
+    struct pollfd *fds;
+    SOCKET *sockets;
+    int ret;
+
+    if (!(fds = HeapAlloc( GetProcessHeap(), 0, count * (sizeof(*fds) + sizeof(*sockets)) )))
+    {
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return SOCKET_ERROR;
+    }
+    sockets = (SOCKET *)(fds + count);
+    if (readfds)
+        for (i = 0; i < readfds->fd_count; i++, j++)
+        {
+            sockets[j] = readfds->fd_array[i];
+            fds[j].events = POLLIN;
+        }
+    if (writefds)
+        for (i = 0; i < writefds->fd_count; i++, j++)
+        {
+            sockets[j] = writefds->fd_array[i];
+            fds[j].events = POLLOUT;
+        }
+    if (exceptfds)
+        for (i = 0; i < exceptfds->fd_count; i++, j++)
+        {
+            sockets[j] = exceptfds->fd_array[i];
+            fds[j].events = POLLPRI;
+        }
+
+    if ((ret = poll_cache_wait( cache, sockets, fds, count, timeout )) == -1)
+        SetLastError( wsaErrno() );
+    else
+    {
+        /* the error has been set when looking up the invalid socket */
+        for (i = 0; i < count; i++)
+            if (fds[i].revents & POLLNVAL) break;
+        if (i < count) ret = SOCKET_ERROR;
+        else ret = get_poll_results( readfds, writefds, exceptfds, fds );
+    }
+    HeapFree( GetProcessHeap(), 0, fds );
+    return ret;
+}
+
 /***********************************************************************
  *		select			(WS2_32.18)
  */
@@ -4899,18 +6283,22 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
                      WS_fd_set *ws_writefds, WS_fd_set *ws_exceptfds,
                      const struct WS_timeval* ws_timeout)
 {
+    struct poll_cache *cache;
     struct pollfd *pollfds;
     int count, ret, timeout = -1;
 
     TRACE("read %p, write %p, excp %p timeout %p\n",
           ws_readfds, ws_writefds, ws_exceptfds, ws_timeout);
 
-    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
-        return SOCKET_ERROR;
-
     if (ws_timeout)
         timeout = (ws_timeout->tv_sec * 1000) + (ws_timeout->tv_usec + 999) / 1000;
 
+    if ((cache = get_poll_cache( fd_sets_count( ws_readfds, ws_writefds, ws_exceptfds ) )))
+        return select_cached( cache, ws_readfds, ws_writefds, ws_exceptfds, timeout );
+
+    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
+        return SOCKET_ERROR;
+
     ret = do_poll(pollfds, count, timeout);
     release_poll_fds( ws_readfds, ws_writefds, ws_exceptfds, pollfds );
 
@@ -4920,6 +6308,108 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
     return ret;
 }
 
+/* poll() on sockets, with the same conventions as poll_cache_wait */
+static int poll_sockets( const SOCKET *sockets, struct pollfd *fds, unsigned int count, int timeout )
+{
+    unsigned int i, invalid = 0;
+    socklen_t len;
+    int oob_inline, ret;
+
+    for (i = 0; i < count; i++)
+    {
+        fds[i].fd = -1;
+        if (!fds[i].events) continue;
+        if ((fds[i].fd = get_sock_fd( sockets[i], 0, NULL )) == -1)
+        {
+            fds[i].events = POLLNVAL;  /* reported after the poll */
+            invalid++;
+            continue;
+        }
+        oob_inline = 0;
+        len = sizeof(oob_inline);
+        if (fds[i].events & POLLPRI)
+            getsockopt( fds[i].fd, SOL_SOCKET, SO_OOBINLINE, (char *)&oob_inline, &len );
+        fds[i].events = map_poll_request( fds[i].events, _get_fd_type( fds[i].fd ),
+                                          is_fd_bound( fds[i].fd, NULL, NULL ) == 1, oob_inline );
+    }
+
+    ret = do_poll( fds, count, invalid ? 0 : timeout );
+
+    for (i = 0; i < count; i++)
+    {
+        if (fds[i].fd != -1) release_sock_fd( sockets[i], fds[i].fd );
+        else if (fds[i].events == POLLNVAL) fds[i].revents = POLLNVAL;
+    }
+    return ret == -1 ? -1 : ret + invalid;
+}
+
+/***********************************************************************
+ *		WSAPoll			(WS2_32.@)
+ */
+int WINAPI WSAPoll( WSAPOLLFD *wfds, ULONG count, int timeout )
+{
+    struct poll_cache *cache;
+    struct pollfd *fds;
+    SOCKET *sockets;
+    unsigned int i;
+    short revents;
+    int ret;
+
+    TRACE( "fds %p, count %u, timeout %d\n", wfds, count, timeout );
+
+    if (!wfds || !count)
+    {
+        SetLastError( WSAEINVAL );
+        return SOCKET_ERROR;
+    }
+    if (!(fds = HeapAlloc( GetProcessHeap(), 0, count * (sizeof(*fds) + sizeof(*sockets)) )))
+    {
+        SetLastError( WSAENOBUFS );
+        return SOCKET_ERROR;
+    }
+    sockets = (SOCKET *)(fds + count);
+    for (i = 0; i < count; i++)
+    {
+        sockets[i] = wfds[i].fd;
+        fds[i].events = 0;
+        fds[i].revents = 0;
+        /* negative sockets are ignored */
+        if ((INT_PTR)wfds[i].fd < 0) continue;
+        if (wfds[i].events & WS_POLLRDNORM) fds[i].events |= POLLIN;
+        if (wfds[i].events & WS_POLLRDBAND) fds[i].events |= POLLPRI;
+        if (wfds[i].events & WS_POLLWRNORM) fds[i].events |= POLLOUT;
+    }
+
+    if ((cache = get_poll_cache( count ))) ret = poll_cache_wait( cache, sockets, fds, count, timeout );
+    else ret = poll_sockets( sockets, fds, count, timeout );
+
+    if (ret == -1) SetLastError( wsaErrno() );
+    else
+    {
+        for (i = ret = 0; i < count; i++)
+        {
+            revents = 0;
+            if (fds[i].revents & POLLNVAL) revents = WS_POLLNVAL;
+            else
+            {
+                if ((fds[i].revents & POLLIN) && (wfds[i].events & WS_POLLRDNORM))
+                    revents |= WS_POLLRDNORM;
+                if ((fds[i].revents & POLLPRI) && (wfds[i].events & WS_POLLRDBAND))
+                    revents |= WS_POLLRDBAND;
+                if ((fds[i].revents & POLLOUT) && !(fds[i].revents & POLLHUP) &&
+                    (wfds[i].events & WS_POLLWRNORM))
+                    revents |= WS_POLLWRNORM;
+                if (fds[i].revents & POLLERR) revents |= WS_POLLERR;
+                if (fds[i].revents & POLLHUP) revents |= WS_POLLHUP;
+            }
+            wfds[i].revents = revents;
+            if (revents) ret++;
+        }
+    }
+    HeapFree( GetProcessHeap(), 0, fds );
+    return ret;
+}
+
 /* helper to send completion messages for client-only i/o operation case */
 static void WS_AddCompletion( SOCKET sock, ULONG_PTR CompletionValue, NTSTATUS CompletionStatus,
                               ULONG Information )
@@ -5031,7 +6521,13 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     }
 
     flags = convert_flags(dwFlags);
-    n = WS2_send( fd, wsa, flags );
+    if (overlapped && reactor_busy( s, FALSE ))
+    {
+        /* queue it behind the pending sends to keep the data in order */
+        n = -1;
+        errno = EAGAIN;
+    }
+    else n = WS2_send( fd, wsa, flags );
     if (n == -1 && errno != EAGAIN)
     {
         err = wsaErrno();
@@ -5052,6 +6548,15 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
             iosb->u.Status = STATUS_PENDING;
             iosb->Information = n == -1 ? 0 : n;
 
+            if (reactor_queue( s, REACTOR_SEND, wsa, iosb,
+                               lpCompletionRoutine ? 0 : (HANDLE)((ULONG_PTR)lpOverlapped->hEvent & ~1),
+                               cvalue ))
+            {
+                _enable_event(SOCKET2HANDLE(s), FD_WRITE, 0, 0);
+                SetLastError( WSA_IO_PENDING );
+                return SOCKET_ERROR;
+            }
+
             SERVER_START_REQ( register_async )
             {
                 req->type           = ASYNC_TYPE_WRITE;
@@ -5522,15 +7027,15 @@ int WINAPI WS_shutdown(SOCKET s, int how)
         switch ( how )
         {
         case SD_RECEIVE:
-            err = WS2_register_async_shutdown( s, ASYNC_TYPE_READ );
+            err = WS2_register_async_shutdown( s, ASYNC_TYPE_READ, NULL, 0, 0 );
             break;
         case SD_SEND:
-            err = WS2_register_async_shutdown( s, ASYNC_TYPE_WRITE );
+            err = WS2_register_async_shutdown( s, ASYNC_TYPE_WRITE, NULL, 0, 0 );
             break;
         case SD_BOTH:
         default:
-            err = WS2_register_async_shutdown( s, ASYNC_TYPE_READ );
-            if (!err) err = WS2_register_async_shutdown( s, ASYNC_TYPE_WRITE );
+            err = WS2_register_async_shutdown( s, ASYNC_TYPE_READ, NULL, 0, 0 );
+            if (!err) err = WS2_register_async_shutdown( s, ASYNC_TYPE_WRITE, NULL, 0, 0 );
             break;
         }
         if (err) goto error;
@@ -6494,7 +7999,9 @@ BOOL WINAPI WSAGetOverlappedResult( SOCKET s, LPWSAOVERLAPPED lpOverlapped,
             return FALSE;
         }
 
-        if (WaitForSingleObject( lpOverlapped->hEvent ? lpOverlapped->hEvent : SOCKET2HANDLE(s),
+        /* operations done by the reactor don't signal the socket handle */
+        if ((lpOverlapped->hEvent || !reactor_wait( s, (IO_STATUS_BLOCK *)lpOverlapped )) &&
+            WaitForSingleObject( lpOverlapped->hEvent ? lpOverlapped->hEvent : SOCKET2HANDLE(s),
                                  INFINITE ) == WAIT_FAILED)
             return FALSE;
         status = lpOverlapped->Internal;
@@ -6715,6 +8222,7 @@ SOCKET WINAPI WSASocketW(int af, int type, int protocol,
     if (ret)
     {
         TRACE("\tcreated %04lx\n", ret );
+        poll_cache_remove(ret);
         if (ipxptype > 0)
             set_ipx_packettype(ret, ipxptype);
        return ret;
@@ -7096,7 +8604,13 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     flags = convert_flags(wsa->flags);
     for (;;)
     {
-        n = WS2_recv( fd, wsa, flags );
+        if (overlapped && reactor_busy( s, TRUE ))
+        {
+            /* queue it behind the pending receives to keep the data in order */
+            n = -1;
+            errno = EAGAIN;
+        }
+        else n = WS2_recv( fd, wsa, flags );
         if (n == -1)
         {
             /* Unix-like systems return EINVAL when attempting to read OOB data from
@@ -7127,6 +8641,14 @@ static int WS2_recv_base( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                 iosb->u.Status = STATUS_PENDING;
                 iosb->Information = 0;
 
+                if (reactor_queue( s, REACTOR_RECV, wsa, iosb,
+                                   lpCompletionRoutine ? 0 : (HANDLE)((ULONG_PTR)lpOverlapped->hEvent & ~1),
+                                   cvalue ))
+                {
+                    SetLastError( WSA_IO_PENDING );
+                    return SOCKET_ERROR;
+                }
+
                 SERVER_START_REQ( register_async )
                 {
                     req->type           = ASYNC_TYPE_READ;
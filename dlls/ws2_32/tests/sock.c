@@ -71,6 +71,8 @@ static int   (WINAPI *pInetPton)(INT,LPSTR,LPVOID);
 static int   (WINAPI *pWSALookupServiceBeginW)(LPWSAQUERYSETW,DWORD,LPHANDLE);
 static int   (WINAPI *pWSALookupServiceEnd)(HANDLE);
 static int   (WINAPI *pWSALookupServiceNextW)(HANDLE,DWORD,LPDWORD,LPWSAQUERYSETW);
+static int   (WINAPI *pWSAPoll)(WSAPOLLFD *,ULONG,INT);
+static BOOL  (WINAPI *pCancelIoEx)(HANDLE,LPOVERLAPPED);
 
 /**************** Structs and typedefs ***************/
 
@@ -1163,6 +1165,8 @@ static void Init (void)
     pWSALookupServiceBeginW = (void *)GetProcAddress(hws2_32, "WSALookupServiceBeginW");
     pWSALookupServiceEnd = (void *)GetProcAddress(hws2_32, "WSALookupServiceEnd");
     pWSALookupServiceNextW = (void *)GetProcAddress(hws2_32, "WSALookupServiceNextW");
+    pWSAPoll = (void *)GetProcAddress(hws2_32, "WSAPoll");
+    pCancelIoEx = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "CancelIoEx");
 
     ok ( WSAStartup ( ver, &data ) == 0, "WSAStartup failed\n" );
     tls = TlsAlloc();
@@ -3510,6 +3514,190 @@ static void test_listen(void)
 
 #define FD_ZERO_ALL() { FD_ZERO(&readfds); FD_ZERO(&writefds); FD_ZERO(&exceptfds); }
 #define FD_SET_ALL(s) { FD_SET(s, &readfds); FD_SET(s, &writefds); FD_SET(s, &exceptfds); }
+static void test_WSAPoll(void)
+{
+    WSAPOLLFD fds[3];
+    SOCKET src, dest;
+    char buf[4];
+    int ret;
+
+    if (!pWSAPoll)
+    {
+        win_skip("WSAPoll is not available\n");
+        return;
+    }
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+
+    fds[0].fd = dest;
+    fds[0].events = POLLRDNORM;
+    fds[0].revents = 0xdead;
+    fds[1].fd = src;
+    fds[1].events = POLLWRNORM;
+    fds[1].revents = 0xdead;
+    ret = pWSAPoll(fds, 2, 0);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(!fds[0].revents, "got events %x\n", fds[0].revents);
+    ok(fds[1].revents == POLLWRNORM, "got events %x\n", fds[1].revents);
+
+    send(src, "test", 4, 0);
+    ret = pWSAPoll(fds, 1, 1000);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == POLLRDNORM, "got events %x\n", fds[0].revents);
+    ret = recv(dest, buf, sizeof(buf), 0);
+    ok(ret == 4, "recv returned %d\n", ret);
+
+    /* negative sockets are ignored, invalid ones are reported */
+    fds[0].events = POLLRDNORM;
+    fds[1].fd = INVALID_SOCKET;
+    fds[1].revents = 0xdead;
+    fds[2].fd = 0xdeadbeef;
+    fds[2].events = POLLRDNORM;
+    fds[2].revents = 0xdead;
+    ret = pWSAPoll(fds, 3, 1000);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(!fds[0].revents, "got events %x\n", fds[0].revents);
+    ok(!fds[1].revents, "got events %x\n", fds[1].revents);
+    ok(fds[2].revents == POLLNVAL, "got events %x\n", fds[2].revents);
+
+    SetLastError(0xdeadbeef);
+    ret = pWSAPoll(NULL, 0, 0);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == WSAEINVAL, "WSAPoll returned %d error %d\n",
+       ret, WSAGetLastError());
+
+    closesocket(src);
+    ret = pWSAPoll(fds, 1, 1000);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents & (POLLRDNORM | POLLHUP), "got events %x\n", fds[0].revents);
+    closesocket(dest);
+}
+
+/* select() and WSAPoll() on many idle connections and a few active ones */
+static void test_poll_many(void)
+{
+    unsigned int i, j, iter, count, nb_conns = winetest_interactive ? 10000 : 512;
+    unsigned int nb_iters = winetest_interactive ? 1000 : 100;
+    SOCKET *clients, *servers, new_client, new_server;
+    struct timeval timeout = { 1, 0 }, wait_timeout = { 1, 0 };
+    WSAPOLLFD *fds;
+    fd_set *set;
+    DWORD start, elapsed_select, elapsed_poll = 0;
+    char buf[4];
+    int ret;
+
+    clients = HeapAlloc(GetProcessHeap(), 0, nb_conns * sizeof(*clients));
+    servers = HeapAlloc(GetProcessHeap(), 0, nb_conns * sizeof(*servers));
+    set = HeapAlloc(GetProcessHeap(), 0, FIELD_OFFSET(fd_set, fd_array[nb_conns]));
+    fds = HeapAlloc(GetProcessHeap(), 0, nb_conns * sizeof(*fds));
+
+    for (count = 0; count < nb_conns; count++)
+        if (tcp_socketpair(&clients[count], &servers[count])) break;
+    if (count < nb_conns) trace("created %u connections out of %u\n", count, nb_conns);
+    if (count < 8)
+    {
+        skip("failed to create sockets\n");
+        goto done;
+    }
+
+    start = GetTickCount();
+    for (iter = 0; iter < nb_iters; iter++)
+    {
+        /* make four connections spread over the set active */
+        for (i = 0; i < 4; i++)
+            send(clients[(iter * 37 + i * count / 4) % count], "x", 1, 0);
+        /* loopback data may not all be there at once */
+        for (j = 0; j < 4; j += set->fd_count)
+        {
+            set->fd_count = count;
+            memcpy(set->fd_array, servers, count * sizeof(*servers));
+            ret = select(0, set, NULL, NULL, &timeout);
+            ok(ret > 0 && j + ret <= 4, "select returned %d\n", ret);
+            if (ret <= 0) goto done;
+            for (i = 0; i < set->fd_count; i++)
+            {
+                ret = recv(set->fd_array[i], buf, sizeof(buf), 0);
+                ok(ret == 1, "recv returned %d\n", ret);
+            }
+        }
+    }
+    elapsed_select = GetTickCount() - start;
+
+    if (pWSAPoll)
+    {
+        for (i = 0; i < count; i++)
+        {
+            fds[i].fd = servers[i];
+            fds[i].events = POLLRDNORM;
+        }
+        start = GetTickCount();
+        for (iter = 0; iter < nb_iters; iter++)
+        {
+            for (i = 0; i < 4; i++)
+                send(clients[(iter * 37 + i * count / 4) % count], "x", 1, 0);
+            for (j = 0; j < 4;)
+            {
+                ret = pWSAPoll(fds, count, 1000);
+                ok(ret > 0 && j + ret <= 4, "WSAPoll returned %d\n", ret);
+                if (ret <= 0) goto done;
+                for (i = 0; i < count; i++)
+                {
+                    if (!fds[i].revents) continue;
+                    ok(fds[i].revents == POLLRDNORM, "got events %x\n", fds[i].revents);
+                    ret = recv(fds[i].fd, buf, sizeof(buf), 0);
+                    ok(ret == 1, "recv returned %d\n", ret);
+                    j++;
+                }
+            }
+        }
+        elapsed_poll = GetTickCount() - start;
+    }
+    trace("%u iterations on %u sockets: select %u ms, WSAPoll %u ms\n",
+          nb_iters, count, elapsed_select, elapsed_poll);
+
+    /* a closed socket isn't reported any more */
+    closesocket(servers[0]);
+    servers[0] = INVALID_SOCKET;
+    set->fd_count = count - 1;
+    memcpy(set->fd_array, servers + 1, (count - 1) * sizeof(*servers));
+    timeout.tv_sec = 0;
+    ret = select(0, set, NULL, NULL, &timeout);
+    ok(!ret, "select returned %d\n", ret);
+
+    /* nor is a readable socket closed with CloseHandle, when its handle value is reused */
+    send(clients[1], "x", 1, 0);
+    set->fd_count = 1;
+    set->fd_array[0] = servers[1];
+    ret = select(0, set, NULL, NULL, &wait_timeout);
+    ok(ret == 1, "select returned %d\n", ret);
+    CloseHandle((HANDLE)servers[1]);
+    servers[1] = INVALID_SOCKET;
+    if (!tcp_socketpair(&new_client, &new_server))
+    {
+        set->fd_count = count - 2;
+        memcpy(set->fd_array, servers + 2, (count - 2) * sizeof(*servers));
+        set->fd_array[set->fd_count++] = new_client;
+        set->fd_array[set->fd_count++] = new_server;
+        ret = select(0, set, NULL, NULL, &timeout);
+        ok(!ret, "select returned %d\n", ret);
+        closesocket(new_client);
+        closesocket(new_server);
+    }
+
+done:
+    for (i = 0; i < count; i++)
+    {
+        closesocket(clients[i]);
+        if (servers[i] != INVALID_SOCKET) closesocket(servers[i]);
+    }
+    HeapFree(GetProcessHeap(), 0, fds);
+    HeapFree(GetProcessHeap(), 0, set);
+    HeapFree(GetProcessHeap(), 0, servers);
+    HeapFree(GetProcessHeap(), 0, clients);
+}
+
 static void test_select(void)
 {
     static char tmp_buf[1024];
@@ -8439,6 +8627,525 @@ static void test_completion_port(void)
     CloseHandle(previous_port);
 }
 
+struct transmit_recv
+{
+    SOCKET sock;
+    DWORD  expected;
+    DWORD  received;
+    BOOL   match;
+    const char *data;   /* expected contents, or NULL */
+};
+
+static DWORD WINAPI transmit_recv_thread(void *arg)
+{
+    struct transmit_recv *info = arg;
+    char buf[65536];
+    int ret;
+
+    info->received = 0;
+    info->match = TRUE;
+    while (info->received < info->expected)
+    {
+        ret = recv(info->sock, buf, sizeof(buf), 0);
+        if (ret <= 0) break;
+        if (info->data && (info->received + ret > info->expected ||
+                           memcmp(buf, info->data + info->received, ret)))
+            info->match = FALSE;
+        info->received += ret;
+    }
+    return 0;
+}
+
+static HANDLE create_transmit_file(char *path, DWORD size, char **data)
+{
+    char temp_path[MAX_PATH];
+    HANDLE file;
+    DWORD i, written;
+
+    *data = HeapAlloc(GetProcessHeap(), 0, size);
+    for (i = 0; i < size; i++) (*data)[i] = i * 7 + i / 4096;
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "wst", 0, path);
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed %u\n", GetLastError());
+    WriteFile(file, *data, size, &written, NULL);
+    ok(written == size, "wrote %u bytes\n", written);
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    return file;
+}
+
+static void test_TransmitFile(void)
+{
+    GUID transmitfile_guid = WSAID_TRANSMITFILE;
+    GUID transmitpackets_guid = WSAID_TRANSMITPACKETS;
+    GUID disconnectex_guid = WSAID_DISCONNECTEX;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    LPFN_TRANSMITPACKETS pTransmitPackets = NULL;
+    LPFN_DISCONNECTEX pDisconnectEx = NULL;
+    DWORD file_size = winetest_interactive ? 256 * 1024 * 1024 : 4 * 1024 * 1024;
+    static char header[] = "header", footer[] = "footer";
+    TRANSMIT_FILE_BUFFERS buffers;
+    TRANSMIT_PACKETS_ELEMENT elements[3];
+    struct transmit_recv info;
+    char path[MAX_PATH], *data, *expect, *buf;
+    SOCKET src, dest;
+    OVERLAPPED ov;
+    HANDLE file, thread;
+    DWORD size, start, bytes, elapsed_transmit, elapsed_copy;
+    BOOL bret;
+    int ret;
+
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+    ret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitfile_guid, sizeof(transmitfile_guid),
+                   &pTransmitFile, sizeof(pTransmitFile), &size, NULL, NULL);
+    ok(!ret, "failed to get TransmitFile %d\n", WSAGetLastError());
+    ret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitpackets_guid, sizeof(transmitpackets_guid),
+                   &pTransmitPackets, sizeof(pTransmitPackets), &size, NULL, NULL);
+    ok(!ret, "failed to get TransmitPackets %d\n", WSAGetLastError());
+    ret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &disconnectex_guid, sizeof(disconnectex_guid),
+                   &pDisconnectEx, sizeof(pDisconnectEx), &size, NULL, NULL);
+    ok(!ret, "failed to get DisconnectEx %d\n", WSAGetLastError());
+    if (!pTransmitFile || !pTransmitPackets || !pDisconnectEx)
+    {
+        closesocket(src);
+        closesocket(dest);
+        return;
+    }
+
+    file = create_transmit_file(path, file_size, &data);
+    expect = HeapAlloc(GetProcessHeap(), 0, file_size + 2 * sizeof(header));
+    memcpy(expect, header, sizeof(header));
+    memcpy(expect + sizeof(header), data, file_size);
+    memcpy(expect + sizeof(header) + file_size, footer, sizeof(footer));
+
+    /* synchronous, with head and tail buffers */
+    buffers.Head = header;
+    buffers.HeadLength = sizeof(header);
+    buffers.Tail = footer;
+    buffers.TailLength = sizeof(footer);
+    info.sock = dest;
+    info.expected = file_size + sizeof(header) + sizeof(footer);
+    info.data = expect;
+    thread = CreateThread(NULL, 0, transmit_recv_thread, &info, 0, NULL);
+    start = GetTickCount();
+    bret = pTransmitFile(src, file, 0, 0, NULL, &buffers, 0);
+    ok(bret, "TransmitFile failed %d\n", WSAGetLastError());
+    WaitForSingleObject(thread, INFINITE);
+    elapsed_transmit = GetTickCount() - start;
+    CloseHandle(thread);
+    ok(info.received == info.expected, "received %u bytes, expected %u\n", info.received, info.expected);
+    ok(info.match, "received data doesn't match\n");
+    size = SetFilePointer(file, 0, NULL, FILE_CURRENT);
+    ok(size == file_size, "file pointer is at %u\n", size);
+
+    /* overlapped, starting at the offset of the overlapped structure */
+    memset(&ov, 0, sizeof(ov));
+    ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    ov.Offset = 1000;
+    info.expected = 5000;
+    info.data = data + 1000;
+    thread = CreateThread(NULL, 0, transmit_recv_thread, &info, 0, NULL);
+    bret = pTransmitFile(src, file, 5000, 0, &ov, NULL, 0);
+    ok(bret || WSAGetLastError() == ERROR_IO_PENDING, "TransmitFile failed %d\n", WSAGetLastError());
+    ok(WaitForSingleObject(ov.hEvent, 5000) == WAIT_OBJECT_0, "event isn't signaled\n");
+    bret = WSAGetOverlappedResult(src, &ov, &bytes, FALSE, &size);
+    ok(bret, "WSAGetOverlappedResult failed %d\n", WSAGetLastError());
+    ok(bytes == 5000, "sent %u bytes\n", bytes);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    ok(info.received == 5000, "received %u bytes\n", info.received);
+    ok(info.match, "received data doesn't match\n");
+
+    /* memory and file elements */
+    elements[0].dwElFlags = TP_ELEMENT_MEMORY;
+    elements[0].cLength = sizeof(header);
+    elements[0].pBuffer = header;
+    elements[1].dwElFlags = TP_ELEMENT_FILE;
+    elements[1].cLength = 100;
+    elements[1].nFileOffset.QuadPart = 0;
+    elements[1].hFile = file;
+    elements[2].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_EOP;
+    elements[2].cLength = sizeof(footer);
+    elements[2].pBuffer = footer;
+    memcpy(expect + sizeof(header) + 100, footer, sizeof(footer));
+    info.expected = sizeof(header) + 100 + sizeof(footer);
+    info.data = expect;
+    thread = CreateThread(NULL, 0, transmit_recv_thread, &info, 0, NULL);
+    bret = pTransmitPackets(src, elements, 3, 0, NULL, 0);
+    ok(bret, "TransmitPackets failed %d\n", WSAGetLastError());
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+    ok(info.received == info.expected, "received %u bytes, expected %u\n", info.received, info.expected);
+    ok(info.match, "received data doesn't match\n");
+
+    elements[0].dwElFlags = 0;
+    SetLastError(0xdeadbeef);
+    bret = pTransmitPackets(src, elements, 1, 0, NULL, 0);
+    ok(!bret && WSAGetLastError() == WSAEINVAL, "TransmitPackets returned %d error %d\n",
+       bret, WSAGetLastError());
+
+    /* the same transfer through a read/send loop, for comparison */
+    buf = HeapAlloc(GetProcessHeap(), 0, 65536);
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    info.expected = file_size;
+    info.data = NULL;
+    thread = CreateThread(NULL, 0, transmit_recv_thread, &info, 0, NULL);
+    start = GetTickCount();
+    while (ReadFile(file, buf, 65536, &bytes, NULL) && bytes)
+    {
+        ret = send(src, buf, bytes, 0);
+        if (ret != bytes) break;
+    }
+    WaitForSingleObject(thread, INFINITE);
+    elapsed_copy = GetTickCount() - start;
+    CloseHandle(thread);
+    ok(info.received == file_size, "received %u bytes\n", info.received);
+    trace("%u bytes: TransmitFile %u ms, ReadFile/send %u ms\n", file_size, elapsed_transmit, elapsed_copy);
+    HeapFree(GetProcessHeap(), 0, buf);
+
+    /* the peer sees the end of the connection after DisconnectEx */
+    ResetEvent(ov.hEvent);
+    bret = pDisconnectEx(src, &ov, 0, 0);
+    ok(bret || WSAGetLastError() == ERROR_IO_PENDING, "DisconnectEx failed %d\n", WSAGetLastError());
+    ok(WaitForSingleObject(ov.hEvent, 5000) == WAIT_OBJECT_0, "event isn't signaled\n");
+    bret = WSAGetOverlappedResult(src, &ov, &bytes, FALSE, &size);
+    ok(bret, "WSAGetOverlappedResult failed %d\n", WSAGetLastError());
+    ret = recv(dest, path, sizeof(path), 0);
+    ok(!ret, "recv returned %d\n", ret);
+
+    /* socket reuse isn't supported */
+    SetLastError(0xdeadbeef);
+    bret = pTransmitFile(src, NULL, 0, 0, NULL, NULL, TF_DISCONNECT | TF_REUSE_SOCKET);
+    ok((!bret && WSAGetLastError() == WSAEOPNOTSUPP) || broken(bret) /* Windows */,
+       "TransmitFile returned %d error %d\n", bret, WSAGetLastError());
+    SetLastError(0xdeadbeef);
+    bret = pDisconnectEx(src, NULL, TF_REUSE_SOCKET, 0);
+    ok((!bret && WSAGetLastError() == WSAEOPNOTSUPP) || broken(bret) /* Windows */,
+       "DisconnectEx returned %d error %d\n", bret, WSAGetLastError());
+
+    CloseHandle(ov.hEvent);
+    CloseHandle(file);
+    HeapFree(GetProcessHeap(), 0, expect);
+    HeapFree(GetProcessHeap(), 0, data);
+    closesocket(src);
+    closesocket(dest);
+}
+
+struct echo_conn
+{
+    SOCKET client;
+    SOCKET server;
+    WSAOVERLAPPED recv_ov;
+    WSAOVERLAPPED send_ov;
+    WSABUF wsabuf;
+    char buf[16];
+};
+
+static BOOL echo_post_recv(struct echo_conn *conn)
+{
+    DWORD flags = 0;
+    int ret;
+
+    memset(&conn->recv_ov, 0, sizeof(conn->recv_ov));
+    conn->wsabuf.buf = conn->buf;
+    conn->wsabuf.len = sizeof(conn->buf);
+    ret = WSARecv(conn->server, &conn->wsabuf, 1, NULL, &flags, &conn->recv_ov, NULL);
+    return !ret || WSAGetLastError() == ERROR_IO_PENDING;
+}
+
+static void test_iocp_echo(void)
+{
+    unsigned int i, count, nb_conns = winetest_interactive ? 10000 : 64;
+    unsigned int round, nb_rounds = winetest_interactive ? 20 : 5;
+    struct echo_conn *conns;
+    WSAOVERLAPPED ov, *povl;
+    SOCKET src, dest;
+    HANDLE port;
+    DWORD bytes, flags, start;
+    ULONG_PTR key;
+    char buf[16];
+    WSABUF wsabuf;
+    BOOL bret;
+    int ret;
+
+    /* a pending overlapped receive without event nor port */
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+    memset(&ov, 0, sizeof(ov));
+    wsabuf.buf = buf;
+    wsabuf.len = sizeof(buf);
+    flags = 0;
+    ret = WSARecv(dest, &wsabuf, 1, NULL, &flags, &ov, NULL);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+       "WSARecv returned %d error %d\n", ret, WSAGetLastError());
+    bret = WSAGetOverlappedResult(dest, &ov, &bytes, FALSE, &flags);
+    ok(!bret && WSAGetLastError() == WSA_IO_INCOMPLETE,
+       "WSAGetOverlappedResult returned %d error %d\n", bret, WSAGetLastError());
+    ret = send(src, "echo", 4, 0);
+    ok(ret == 4, "send returned %d\n", ret);
+    bytes = 0xdeadbeef;
+    bret = WSAGetOverlappedResult(dest, &ov, &bytes, TRUE, &flags);
+    ok(bret, "WSAGetOverlappedResult failed %d\n", WSAGetLastError());
+    ok(bytes == 4, "got %u bytes\n", bytes);
+    ok(!memcmp(buf, "echo", 4), "got %s\n", buf);
+
+    /* a pending receive is completed with an error when its socket is closed */
+    ov.hEvent = CreateEventA(NULL, TRUE, TRUE, NULL);
+    ret = WSARecv(dest, &wsabuf, 1, NULL, &flags, &ov, NULL);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+       "WSARecv returned %d error %d\n", ret, WSAGetLastError());
+    ok(WaitForSingleObject(ov.hEvent, 0) == WAIT_TIMEOUT, "event is signaled\n");
+    closesocket(dest);
+    ok(WaitForSingleObject(ov.hEvent, 1000) == WAIT_OBJECT_0, "event isn't signaled\n");
+    ok(ov.Internal != STATUS_PENDING, "receive is still pending\n");
+    CloseHandle(ov.hEvent);
+    closesocket(src);
+
+    /* echo server on a completion port */
+    conns = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, nb_conns * sizeof(*conns));
+    port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed %u\n", GetLastError());
+
+    for (count = 0; count < nb_conns; count++)
+    {
+        if (tcp_socketpair(&conns[count].client, &conns[count].server)) break;
+        CreateIoCompletionPort((HANDLE)conns[count].server, port, count, 0);
+        if (!echo_post_recv(&conns[count]))
+        {
+            ok(0, "WSARecv failed %d\n", WSAGetLastError());
+            closesocket(conns[count].client);
+            closesocket(conns[count].server);
+            break;
+        }
+    }
+    if (count < nb_conns) trace("created %u connections out of %u\n", count, nb_conns);
+    if (!count)
+    {
+        skip("failed to create sockets\n");
+        goto done;
+    }
+
+    start = GetTickCount();
+    for (round = 0; round < nb_rounds; round++)
+    {
+        unsigned int pending = 2 * count;
+
+        for (i = 0; i < count; i++)
+        {
+            sprintf(buf, "%u-%u", round, i);
+            ret = send(conns[i].client, buf, strlen(buf) + 1, 0);
+            ok(ret == strlen(buf) + 1, "send returned %d\n", ret);
+        }
+
+        while (pending)
+        {
+            bret = GetQueuedCompletionStatus(port, &bytes, &key, &povl, 5000);
+            ok(bret, "GetQueuedCompletionStatus failed %u, %u completions left\n", GetLastError(), pending);
+            if (!bret) goto done;
+            ok(key < count, "got key %lu\n", key);
+            pending--;
+
+            if (povl == &conns[key].recv_ov)
+            {
+                /* send the message back */
+                memset(&conns[key].send_ov, 0, sizeof(conns[key].send_ov));
+                conns[key].wsabuf.len = bytes;
+                ret = WSASend(conns[key].server, &conns[key].wsabuf, 1, NULL, 0, &conns[key].send_ov, NULL);
+                ok(!ret || WSAGetLastError() == ERROR_IO_PENDING, "WSASend failed %d\n", WSAGetLastError());
+            }
+            else
+            {
+                ok(povl == &conns[key].send_ov, "got overlapped %p\n", povl);
+                ok(echo_post_recv(&conns[key]), "WSARecv failed %d\n", WSAGetLastError());
+            }
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            char expect[16];
+
+            sprintf(expect, "%u-%u", round, i);
+            ret = recv(conns[i].client, buf, sizeof(buf), 0);
+            ok(ret == strlen(expect) + 1 && !strcmp(buf, expect),
+               "connection %u: got %d bytes %s\n", i, ret, buf);
+        }
+    }
+    trace("%u round trips on %u connections in %u ms\n", nb_rounds * count, count, GetTickCount() - start);
+
+done:
+    for (i = 0; i < count; i++)
+    {
+        closesocket(conns[i].client);
+        closesocket(conns[i].server);
+    }
+    /* drain the cancelled receives */
+    while (GetQueuedCompletionStatus(port, &bytes, &key, &povl, 0));
+    CloseHandle(port);
+    HeapFree(GetProcessHeap(), 0, conns);
+}
+
+static DWORD reactor_apc_error, reactor_apc_bytes, reactor_apc_count;
+
+static void WINAPI reactor_completion_routine(DWORD error, DWORD bytes, LPWSAOVERLAPPED ov, DWORD flags)
+{
+    reactor_apc_error = error;
+    reactor_apc_bytes = bytes;
+    reactor_apc_count++;
+}
+
+static void test_overlapped_order_and_cancel(void)
+{
+    WSAOVERLAPPED ov[3];
+    WSABUF wsabuf[3];
+    SOCKET src, dest;
+    DWORD bytes, flags;
+    char buf[3][4];
+    int ret, timeout = 1000;
+    unsigned int i;
+    BOOL bret;
+
+    if (tcp_socketpair(&src, &dest))
+    {
+        skip("failed to create sockets\n");
+        return;
+    }
+
+    /* receives complete in the order they were issued, completion routines included */
+    memset(ov, 0, sizeof(ov));
+    for (i = 0; i < 3; i++)
+    {
+        wsabuf[i].buf = buf[i];
+        wsabuf[i].len = sizeof(buf[i]);
+        if (i < 2) ov[i].hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        flags = 0;
+        ret = WSARecv(dest, &wsabuf[i], 1, NULL, &flags, &ov[i], i < 2 ? NULL : reactor_completion_routine);
+        ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+           "WSARecv %u returned %d error %d\n", i, ret, WSAGetLastError());
+    }
+    reactor_apc_count = 0;
+    ret = send(src, "abcdefghijkl", 12, 0);
+    ok(ret == 12, "send returned %d\n", ret);
+    for (i = 0; i < 2; i++)
+    {
+        bret = WSAGetOverlappedResult(dest, &ov[i], &bytes, TRUE, &flags);
+        ok(bret, "WSAGetOverlappedResult %u failed %d\n", i, WSAGetLastError());
+        ok(bytes == 4, "receive %u got %u bytes\n", i, bytes);
+    }
+    ok(!memcmp(buf[0], "abcd", 4), "got %.4s\n", buf[0]);
+    ok(!memcmp(buf[1], "efgh", 4), "got %.4s\n", buf[1]);
+    for (i = 0; i < 10 && !reactor_apc_count; i++) SleepEx(100, TRUE);
+    ok(reactor_apc_count == 1, "completion routine called %u times\n", reactor_apc_count);
+    ok(!reactor_apc_error, "completion routine got error %u\n", reactor_apc_error);
+    ok(reactor_apc_bytes == 4, "completion routine got %u bytes\n", reactor_apc_bytes);
+    ok(!memcmp(buf[2], "ijkl", 4), "got %.4s\n", buf[2]);
+
+    /* CancelIoEx only cancels the given operation */
+    if (pCancelIoEx)
+    {
+        for (i = 0; i < 2; i++)
+        {
+            ResetEvent(ov[i].hEvent);
+            flags = 0;
+            ret = WSARecv(dest, &wsabuf[i], 1, NULL, &flags, &ov[i], NULL);
+            ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+               "WSARecv %u returned %d error %d\n", i, ret, WSAGetLastError());
+        }
+        bret = pCancelIoEx((HANDLE)dest, &ov[0]);
+        ok(bret, "CancelIoEx failed %u\n", GetLastError());
+        ok(WaitForSingleObject(ov[0].hEvent, 1000) == WAIT_OBJECT_0, "event isn't signaled\n");
+        bret = WSAGetOverlappedResult(dest, &ov[0], &bytes, FALSE, &flags);
+        ok(!bret && WSAGetLastError() == ERROR_OPERATION_ABORTED,
+           "WSAGetOverlappedResult returned %d error %d\n", bret, WSAGetLastError());
+        ok(WaitForSingleObject(ov[1].hEvent, 0) == WAIT_TIMEOUT, "event is signaled\n");
+
+        /* the next receive gets the data */
+        ret = send(src, "mnop", 4, 0);
+        ok(ret == 4, "send returned %d\n", ret);
+        bret = WSAGetOverlappedResult(dest, &ov[1], &bytes, TRUE, &flags);
+        ok(bret, "WSAGetOverlappedResult failed %d\n", WSAGetLastError());
+        ok(bytes == 4 && !memcmp(buf[1], "mnop", 4), "got %u bytes %.4s\n", bytes, buf[1]);
+
+        bret = pCancelIoEx((HANDLE)dest, &ov[0]);
+        ok(!bret && GetLastError() == ERROR_NOT_FOUND, "CancelIoEx returned %d error %u\n", bret, GetLastError());
+    }
+    else win_skip("CancelIoEx is not available\n");
+
+    /* CancelIo cancels the operations of the calling thread */
+    ResetEvent(ov[0].hEvent);
+    flags = 0;
+    ret = WSARecv(dest, &wsabuf[0], 1, NULL, &flags, &ov[0], NULL);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+       "WSARecv returned %d error %d\n", ret, WSAGetLastError());
+    bret = CancelIo((HANDLE)dest);
+    ok(bret, "CancelIo failed %u\n", GetLastError());
+    ok(WaitForSingleObject(ov[0].hEvent, 1000) == WAIT_OBJECT_0, "event isn't signaled\n");
+    bret = WSAGetOverlappedResult(dest, &ov[0], &bytes, FALSE, &flags);
+    ok(!bret && WSAGetLastError() == ERROR_OPERATION_ABORTED,
+       "WSAGetOverlappedResult returned %d error %d\n", bret, WSAGetLastError());
+
+    /* closing the socket with a receive pending completes it and closes the connection */
+    ResetEvent(ov[0].hEvent);
+    flags = 0;
+    ret = WSARecv(dest, &wsabuf[0], 1, NULL, &flags, &ov[0], NULL);
+    ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+       "WSARecv returned %d error %d\n", ret, WSAGetLastError());
+    closesocket(dest);
+    ok(WaitForSingleObject(ov[0].hEvent, 1000) == WAIT_OBJECT_0, "event isn't signaled\n");
+    ok(ov[0].Internal != STATUS_PENDING, "receive is still pending\n");
+    setsockopt(src, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout));
+    ret = recv(src, buf[0], sizeof(buf[0]), 0);
+    ok(ret == 0 || broken(ret == SOCKET_ERROR && WSAGetLastError() == WSAECONNRESET),
+       "recv returned %d error %d\n", ret, WSAGetLastError());
+
+    /* a new socket that gets the same handle value starts from scratch */
+    closesocket(src);
+    if (!tcp_socketpair(&src, &dest))
+    {
+        ResetEvent(ov[0].hEvent);
+        flags = 0;
+        ret = WSARecv(dest, &wsabuf[0], 1, NULL, &flags, &ov[0], NULL);
+        ok(ret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+           "WSARecv returned %d error %d\n", ret, WSAGetLastError());
+        ret = send(src, "qrst", 4, 0);
+        ok(ret == 4, "send returned %d\n", ret);
+        bret = WSAGetOverlappedResult(dest, &ov[0], &bytes, TRUE, &flags);
+        ok(bret, "WSAGetOverlappedResult failed %d\n", WSAGetLastError());
+        ok(bytes == 4 && !memcmp(buf[0], "qrst", 4), "got %u bytes %.4s\n", bytes, buf[0]);
+        closesocket(dest);
+        closesocket(src);
+    }
+    for (i = 0; i < 2; i++) CloseHandle(ov[i].hEvent);
+}
+
+/* run the overlapped tests again with the socket reactor enabled */
+static void test_reactor(void)
+{
+    char cmdline[MAX_PATH + 16], **argv;
+    STARTUPINFOA si = { sizeof(si) };
+    PROCESS_INFORMATION pi;
+    BOOL ret;
+
+    winetest_get_mainargs(&argv);
+    sprintf(cmdline, "\"%s\" sock reactor", argv[0]);
+    SetEnvironmentVariableA("WINESOCKETREACTOR", "1");
+    ret = CreateProcessA(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi);
+    SetEnvironmentVariableA("WINESOCKETREACTOR", NULL);
+    ok(ret, "CreateProcess failed %u\n", GetLastError());
+    if (!ret) return;
+    winetest_wait_child_process(pi.hProcess);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+}
+
 static void test_address_list_query(void)
 {
     SOCKET_ADDRESS_LIST *address_list;
@@ -8712,8 +9419,18 @@ todo_wine
 
 START_TEST( sock )
 {
+    char **argv;
     int i;
 
+    if (winetest_get_mainargs(&argv) >= 3 && !strcmp(argv[2], "reactor"))
+    {
+        Init();
+        test_overlapped_order_and_cancel();
+        test_iocp_echo();
+        Exit();
+        return;
+    }
+
 /* Leave these tests at the beginning. They depend on WSAStartup not having been
  * called, which is done by Init() below. */
     test_WithoutWSAStartup();
@@ -8751,6 +9468,8 @@ START_TEST( sock )
     test_errors();
     test_listen();
     test_select();
+    test_WSAPoll();
+    test_poll_many();
     test_accept();
     test_getpeername();
     test_getsockname();
@@ -8783,6 +9502,10 @@ START_TEST( sock )
     test_WSAAsyncGetServByName();
 
     test_completion_port();
+    test_iocp_echo();
+    test_overlapped_order_and_cancel();
+    test_reactor();
+    test_TransmitFile();
     test_address_list_query();
 
     /* this is an io heavy test, do it at the end so the kernel doesn't start dropping packets */
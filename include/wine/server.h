@@ -50,11 +50,17 @@ struct __server_request_info
 };
 
 extern unsigned int wine_server_call( void *req_ptr );
+extern unsigned int CDECL wine_server_call_batch( void **reqs, unsigned int count );
 extern void CDECL wine_server_send_fd( int fd );
 extern int CDECL wine_server_fd_to_handle( int fd, unsigned int access, unsigned int attributes, HANDLE *handle );
 extern int CDECL wine_server_handle_to_fd( HANDLE handle, unsigned int access, int *unix_fd, unsigned int *options );
 extern void CDECL wine_server_release_fd( HANDLE handle, int unix_fd );
 
+/* handler for the I/O that a dll performs on a handle without going through server asyncs */
+typedef BOOL (CDECL *wine_io_cancel_handler)( HANDLE handle, IO_STATUS_BLOCK *iosb, BOOL only_thread,
+                                              NTSTATUS status );
+extern void CDECL __wine_set_io_cancel_handler( wine_io_cancel_handler handler );
+
 /* do a server call and set the last error code */
 static inline unsigned int wine_server_call_err( void *req_ptr )
 {
@@ -138,5 +144,12 @@ static inline void *wine_server_get_ptr( client_ptr_t ptr )
         while(0); \
     } while(0)
 
+/* initialize a request structure for use with wine_server_call_batch */
+#define SERVER_INIT_REQ(info,type) \
+    ((info)->data_count = 0, \
+     memset( &(info)->u.req, 0, sizeof((info)->u.req) ), \
+     (info)->u.req.request_header.req = REQ_##type, \
+     &(info)->u.req.type##_request)
+
 
 #endif  /* __WINE_WINE_SERVER_H */
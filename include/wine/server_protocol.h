@@ -259,6 +259,16 @@ typedef struct
 } async_data_t;
 
 
+typedef struct
+{
+    apc_param_t     ckey;
+    apc_param_t     cvalue;
+    apc_param_t     information;
+    unsigned int    status;
+    unsigned int    __pad;
+} completion_msg_t;
+
+
 
 struct hardware_msg_data
 {
@@ -685,6 +695,35 @@ struct rawinput_device
 };
 
 
+struct inproc_sync
+{
+    union
+    {
+        __int64          data;
+        struct
+        {
+            int          value;
+            unsigned int waiters;
+        } s;
+    } u;
+    unsigned int         count;
+    unsigned int         max;
+    unsigned int         owned_prev;
+    unsigned int         owned_next;
+};
+#define INPROC_SYNC_ABANDONED (-1)
+#define INPROC_SYNC_NO_LIST   (~0u)
+#define INPROC_SYNC_SERIAL    0
+
+enum inproc_sync_type
+{
+    INPROC_SYNC_NONE,
+    INPROC_SYNC_EVENT,
+    INPROC_SYNC_SEMAPHORE,
+    INPROC_SYNC_MUTEX
+};
+
+
 
 
 
@@ -1357,6 +1396,50 @@ struct open_semaphore_reply
 
 
 
+struct get_inproc_sync_fd_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_inproc_sync_fd_reply
+{
+    struct reply_header __header;
+    unsigned int count;
+    char __pad_12[4];
+};
+
+
+
+struct get_inproc_sync_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct get_inproc_sync_reply
+{
+    struct reply_header __header;
+    int          type;
+    unsigned int index;
+    unsigned int access;
+    char __pad_20[4];
+};
+
+
+
+struct get_inproc_owned_list_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_inproc_owned_list_reply
+{
+    struct reply_header __header;
+    unsigned int index;
+    char __pad_12[4];
+};
+
+
+
 struct create_file_request
 {
     struct request_header __header;
@@ -5035,6 +5118,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(msgs,completion_msgs); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5367,6 +5463,9 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_inproc_sync_fd,
+    REQ_get_inproc_sync,
+    REQ_get_inproc_owned_list,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5578,6 +5677,7 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
@@ -5643,6 +5743,9 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_inproc_sync_fd_request get_inproc_sync_fd_request;
+    struct get_inproc_sync_request get_inproc_sync_request;
+    struct get_inproc_owned_list_request get_inproc_owned_list_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -5854,6 +5957,7 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
@@ -5917,6 +6021,9 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_inproc_sync_fd_reply get_inproc_sync_fd_reply;
+    struct get_inproc_sync_reply get_inproc_sync_reply;
+    struct get_inproc_owned_list_reply get_inproc_owned_list_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6128,6 +6235,7 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
@@ -6149,6 +6257,6 @@ union generic_reply
     struct terminate_job_reply terminate_job_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 487
+#define SERVER_PROTOCOL_VERSION 490
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
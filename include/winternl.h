@@ -1114,6 +1114,30 @@ typedef struct _RTL_HEAP_DEFINITION {
     ULONG Unknown[11];
 } RTL_HEAP_DEFINITION, *PRTL_HEAP_DEFINITION;
 
+/* Wine specific heap information class, returns a HEAP_WINE_STATISTICS */
+#define HeapWineStatistics ((HEAP_INFORMATION_CLASS)0x1000)
+
+#define HEAP_STATISTICS_SIZE_CLASSES 16
+
+typedef struct _HEAP_WINE_STATISTICS {
+    ULONG     Flags;              /* heap flags */
+    ULONG     SubheapCount;       /* number of sub-heaps */
+    SIZE_T    ReservedBytes;      /* address space reserved by the heap */
+    SIZE_T    CommittedBytes;     /* memory committed by the heap */
+    SIZE_T    BusyBytes;          /* bytes currently allocated by the application */
+    SIZE_T    BusyBlocks;         /* blocks currently allocated by the application */
+    SIZE_T    FreeBytes;          /* bytes in the free lists */
+    SIZE_T    FreeBlocks;         /* blocks in the free lists */
+    SIZE_T    LargestFreeBlock;   /* size of the largest block in the free lists */
+    ULONG     LargeBlockCount;    /* number of blocks allocated directly from virtual memory */
+    SIZE_T    LargeBlockBytes;    /* address space used by these blocks */
+    ULONG     LfhGroupCount;      /* number of low fragmentation heap groups */
+    SIZE_T    LfhFreeBytes;       /* free bytes cached in these groups */
+    ULONG     ContentionCount;    /* number of times a thread had to wait for a heap lock */
+    ULONGLONG AllocationCount;    /* number of allocations since the heap was created */
+    ULONGLONG SizeClassCount[HEAP_STATISTICS_SIZE_CLASSES]; /* allocations of up to 16 << n bytes, the last class is for larger ones */
+} HEAP_WINE_STATISTICS, *PHEAP_WINE_STATISTICS;
+
 typedef struct _RTL_RWLOCK {
     RTL_CRITICAL_SECTION rtlCS;
 
@@ -1919,6 +1943,12 @@ typedef struct _FILE_COMPLETION_INFORMATION {
     ULONG_PTR CompletionKey;
 } FILE_COMPLETION_INFORMATION, *PFILE_COMPLETION_INFORMATION;
 
+typedef struct _FILE_IO_COMPLETION_INFORMATION {
+    ULONG_PTR CompletionKey;
+    ULONG_PTR CompletionValue;
+    IO_STATUS_BLOCK IoStatusBlock;
+} FILE_IO_COMPLETION_INFORMATION, *PFILE_IO_COMPLETION_INFORMATION;
+
 #define IO_COMPLETION_QUERY_STATE  0x0001
 #define IO_COMPLETION_MODIFY_STATE 0x0002
 #define IO_COMPLETION_ALL_ACCESS   (STANDARD_RIGHTS_REQUIRED|SYNCHRONIZE|0x3)
@@ -2220,6 +2250,7 @@ NTSYSAPI NTSTATUS  WINAPI NtReleaseKeyedEvent(HANDLE,const void*,BOOLEAN,const L
 NTSYSAPI NTSTATUS  WINAPI NtReleaseMutant(HANDLE,PLONG);
 NTSYSAPI NTSTATUS  WINAPI NtReleaseSemaphore(HANDLE,ULONG,PULONG);
 NTSYSAPI NTSTATUS  WINAPI NtRemoveIoCompletion(HANDLE,PULONG_PTR,PULONG_PTR,PIO_STATUS_BLOCK,PLARGE_INTEGER);
+NTSYSAPI NTSTATUS  WINAPI NtRemoveIoCompletionEx(HANDLE,PFILE_IO_COMPLETION_INFORMATION,ULONG,PULONG,PLARGE_INTEGER,BOOLEAN);
 NTSYSAPI NTSTATUS  WINAPI NtReplaceKey(POBJECT_ATTRIBUTES,HANDLE,POBJECT_ATTRIBUTES);
 NTSYSAPI NTSTATUS  WINAPI NtReplyPort(HANDLE,PLPC_MESSAGE);
 NTSYSAPI NTSTATUS  WINAPI NtReplyWaitReceivePort(HANDLE,PULONG,PLPC_MESSAGE,PLPC_MESSAGE);
@@ -2588,6 +2619,9 @@ NTSYSAPI BOOLEAN   WINAPI RtlValidAcl(PACL);
 NTSYSAPI BOOLEAN   WINAPI RtlValidSid(PSID);
 NTSYSAPI BOOLEAN   WINAPI RtlValidateHeap(HANDLE,ULONG,LPCVOID);
 NTSYSAPI NTSTATUS  WINAPI RtlVerifyVersionInfo(const RTL_OSVERSIONINFOEXW*,DWORD,DWORDLONG);
+NTSYSAPI NTSTATUS  WINAPI RtlWaitOnAddress(const void *,const void *,SIZE_T,const LARGE_INTEGER *);
+NTSYSAPI void      WINAPI RtlWakeAddressAll(const void *);
+NTSYSAPI void      WINAPI RtlWakeAddressSingle(const void *);
 NTSYSAPI void      WINAPI RtlWakeAllConditionVariable(RTL_CONDITION_VARIABLE *);
 NTSYSAPI void      WINAPI RtlWakeConditionVariable(RTL_CONDITION_VARIABLE *);
 NTSYSAPI NTSTATUS  WINAPI RtlWalkHeap(HANDLE,PVOID);
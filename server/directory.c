@@ -124,10 +124,17 @@ static struct object_type *object_type_get_type( struct object *obj )
 
 static void directory_dump( struct object *obj, int verbose )
 {
+    struct directory *dir = (struct directory *)obj;
+
     assert( obj->ops == &directory_ops );
 
     fputs( "Directory ", stderr );
     dump_object_name( obj );
+    if (verbose && dir->entries)
+    {
+        fputc( ' ', stderr );
+        dump_namespace( dir->entries );
+    }
     fputc( '\n', stderr );
 }
 
@@ -185,7 +192,7 @@ static void directory_destroy( struct object *obj )
 {
     struct directory *dir = (struct directory *)obj;
     assert( obj->ops == &directory_ops );
-    free( dir->entries );
+    free_namespace( dir->entries );
 }
 
 static struct directory *create_directory( struct directory *root, const struct unicode_str *name,
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -38,25 +39,30 @@
 
 struct event
 {
-    struct object  obj;             /* object header */
-    int            manual_reset;    /* is it a manual reset event? */
-    int            signaled;        /* event has been signaled */
+    struct object       obj;             /* object header */
+    int                 manual_reset;    /* is it a manual reset event? */
+    struct inproc_sync *sync;            /* event state, possibly shared with the clients */
+    struct inproc_sync  local_sync;      /* storage for the state when not shared */
+    unsigned int        sync_index;      /* index of the state in the shared area */
 };
 
 static void event_dump( struct object *obj, int verbose );
 static struct object_type *event_get_type( struct object *obj );
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -67,7 +73,7 @@ static const struct object_ops event_ops =
     no_lookup_name,            /* lookup_name */
     no_open_file,              /* open_file */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -114,7 +120,13 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
         {
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
-            event->signaled     = initial_state;
+            if (!(event->sync = alloc_inproc_sync( &event->obj, &event->sync_index )))
+            {
+                memset( &event->local_sync, 0, sizeof(event->local_sync) );
+                event->sync = &event->local_sync;
+            }
+            event->sync->u.s.value = initial_state;
+            event->sync->max       = manual_reset;
             if (sd) default_set_sd( &event->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
                                                      DACL_SECURITY_INFORMATION|
@@ -131,22 +143,31 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
 
 void pulse_event( struct event *event )
 {
-    event->signaled = 1;
+    inproc_sync_set_value( event->sync, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+    inproc_sync_set_value( event->sync, 0 );
 }
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    inproc_sync_set_value( event->sync, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    inproc_sync_set_value( event->sync, 0 );
+}
+
+int get_event_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct event *event = (struct event *)obj;
+
+    if (obj->ops != &event_ops || event->sync == &event->local_sync) return 0;
+    *index = event->sync_index;
+    return 1;
 }
 
 static void event_dump( struct object *obj, int verbose )
@@ -154,7 +175,7 @@ static void event_dump( struct object *obj, int verbose )
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     fprintf( stderr, "Event manual=%d signaled=%d ",
-             event->manual_reset, event->signaled );
+             event->manual_reset, event->sync->u.s.value );
     dump_object_name( &event->obj );
     fputc( '\n', stderr );
 }
@@ -166,11 +187,25 @@ static struct object_type *event_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    return inproc_sync_add_queue( obj, entry, event->sync );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    inproc_sync_remove_queue( obj, entry, event->sync );
+}
+
 static int event_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    return event->sync->u.s.value;
 }
 
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -178,7 +213,7 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) inproc_sync_set_value( event->sync, 0 );
 }
 
 static unsigned int event_map_access( struct object *obj, unsigned int access )
@@ -204,6 +239,14 @@ static int event_signal( struct object *obj, unsigned int access )
     return 1;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+
+    if (event->sync != &event->local_sync) free_inproc_sync( event->sync_index );
+}
+
 struct keyed_event *create_keyed_event( struct directory *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -365,7 +408,7 @@ DECL_HANDLER(query_event)
     if (!(event = get_event_obj( current->process, req->handle, EVENT_QUERY_STATE ))) return;
 
     reply->manual_reset = event->manual_reset;
-    reply->state = event->signaled;
+    reply->state = event->sync->u.s.value;
 
     release_object( event );
 }
@@ -138,6 +138,7 @@ extern obj_handle_t open_mapping_file( struct process *process, struct mapping *
                                        unsigned int access, unsigned int sharing );
 extern struct mapping *grab_mapping_unless_removable( struct mapping *mapping );
 extern int get_page_size(void);
+extern int create_temp_file( file_pos_t size );
 
 /* device functions */
 
@@ -631,6 +631,8 @@ DECL_HANDLER(dup_handle)
         if ((req->options & DUP_HANDLE_CLOSE_SOURCE) && (src != dst || req->src_handle != reply->handle))
             reply->closed = !close_handle( src, req->src_handle );
         reply->self = (src == current->process);
+        /* the source process can't know that its handle is gone */
+        if (reply->closed && !reply->self) inproc_sync_handle_closed();
         release_object( src );
     }
 }
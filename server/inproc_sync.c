@@ -0,0 +1,287 @@
+/*
+ * Server-side support for in-process synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The state of events, semaphores and mutexes is stored in a memory area
+ * shared with all the clients. A client is allowed to update the state of
+ * an object directly as long as no thread is waiting on it in the server;
+ * this is checked atomically together with the state change since both
+ * values are part of the same 64-bit word. As soon as a thread is queued
+ * in the server, only the server modifies the object state, so the usual
+ * signaled/satisfied sequence stays consistent.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "handle.h"
+#include "thread.h"
+#include "request.h"
+
+#define INPROC_SYNC_COUNT 65536  /* number of objects in the shared area */
+
+static int shared_fd = -1;                   /* fd of the shared area */
+static struct inproc_sync *shared_area;      /* objects state shared with the clients */
+static struct object **slot_objects;         /* object owning each slot */
+static unsigned int *free_slots;             /* stack of freed indices */
+static unsigned int free_count;              /* number of entries in the free stack */
+static unsigned int next_unused = INPROC_SYNC_SERIAL + 1;  /* first never used index */
+
+/* create the shared area if in-process synchronization is enabled */
+void init_inproc_sync(void)
+{
+    const char *env = getenv( "WINEINPROCSYNC" );
+    size_t size = INPROC_SYNC_COUNT * sizeof(*shared_area);
+    void *ptr;
+
+    if (!env || !atoi( env )) return;
+
+    if ((shared_fd = create_temp_file( size )) == -1) goto failed;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shared_fd, 0 );
+    if (ptr == MAP_FAILED) goto failed;
+    if (!(free_slots = malloc( INPROC_SYNC_COUNT * sizeof(*free_slots) )) ||
+        !(slot_objects = calloc( INPROC_SYNC_COUNT, sizeof(*slot_objects) )))
+    {
+        free( free_slots );
+        munmap( ptr, size );
+        goto failed;
+    }
+    shared_area = ptr;
+    if (debug_level) fprintf( stderr, "wineserver: in-process synchronization enabled\n" );
+    return;
+
+failed:
+    fprintf( stderr, "wineserver: failed to create the in-process synchronization area\n" );
+    if (shared_fd != -1) close( shared_fd );
+    shared_fd = -1;
+    clear_error();
+}
+
+/* allocate the shared state for a new object, or return NULL if not possible */
+struct inproc_sync *alloc_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct inproc_sync *sync;
+
+    if (!shared_area) return NULL;
+    if (free_count) *index = free_slots[--free_count];
+    else if (next_unused < INPROC_SYNC_COUNT) *index = next_unused++;
+    else return NULL;
+
+    sync = &shared_area[*index];
+    memset( sync, 0, sizeof(*sync) );
+    sync->owned_prev = sync->owned_next = *index;
+    slot_objects[*index] = obj;
+    return sync;
+}
+
+/* free the shared state of a destroyed object */
+void free_inproc_sync( unsigned int index )
+{
+    assert( index > INPROC_SYNC_SERIAL && index < next_unused );
+    memset( &shared_area[index], 0, sizeof(shared_area[index]) );
+    slot_objects[index] = NULL;
+    free_slots[free_count++] = index;
+}
+
+/* retrieve the object owning a slot, NULL if it has been destroyed */
+struct object *get_inproc_sync_object( unsigned int index )
+{
+    return slot_objects[index];
+}
+
+/* change the object owning a slot */
+void set_inproc_sync_object( unsigned int index, struct object *obj )
+{
+    slot_objects[index] = obj;
+}
+
+/* retrieve the list of in-process mutexes owned by a thread, allocating it if needed */
+int get_thread_inproc_list( struct thread *thread, unsigned int *list )
+{
+    if (thread->inproc_list == INPROC_SYNC_NO_LIST)
+    {
+        unsigned int index;
+        if (!alloc_inproc_sync( NULL, &index )) return 0;
+        thread->inproc_list = index;
+    }
+    *list = thread->inproc_list;
+    return 1;
+}
+
+/* check a link read from the shared area, the clients can store anything there */
+static int is_valid_owned_link( unsigned int index )
+{
+    struct object *obj;
+    unsigned int mutex_index;
+
+    if (index <= INPROC_SYNC_SERIAL || index >= next_unused) return 0;
+    /* owned list heads and destroyed mutexes don't have an object */
+    return !(obj = slot_objects[index]) || get_mutex_inproc_sync( obj, &mutex_index );
+}
+
+/* retrieve the first mutex of the thread owned list, or INPROC_SYNC_NO_LIST if it's empty */
+unsigned int get_first_inproc_owned( struct thread *thread )
+{
+    unsigned int list = thread->inproc_list, first;
+
+    if (list == INPROC_SYNC_NO_LIST) return INPROC_SYNC_NO_LIST;
+    first = shared_area[list].owned_next;
+    if (first != list && is_valid_owned_link( first ) && shared_area[first].owned_prev == list)
+        return first;
+    /* empty or corrupted, reset it */
+    shared_area[list].owned_prev = shared_area[list].owned_next = list;
+    return INPROC_SYNC_NO_LIST;
+}
+
+/* link an owned mutex into an owned list; the clients do the same for their own thread */
+void add_inproc_owned( unsigned int list, unsigned int index )
+{
+    struct inproc_sync *head = &shared_area[list], *sync = &shared_area[index];
+    unsigned int next = head->owned_next;
+
+    if (!is_valid_owned_link( next )) next = list;
+    sync->owned_prev = list;
+    sync->owned_next = next;
+    shared_area[next].owned_prev = index;
+    head->owned_next = index;
+}
+
+/* unlink a mutex from its owned list, if any */
+void remove_inproc_owned( unsigned int index )
+{
+    struct inproc_sync *sync = &shared_area[index];
+    unsigned int prev = sync->owned_prev, next = sync->owned_next;
+
+    if (is_valid_owned_link( prev )) shared_area[prev].owned_next = next;
+    if (is_valid_owned_link( next )) shared_area[next].owned_prev = prev;
+    sync->owned_prev = sync->owned_next = index;
+}
+
+/* a handle was closed on behalf of another process, make the clients flush their handle cache */
+void inproc_sync_handle_closed(void)
+{
+    if (shared_area) shared_area[INPROC_SYNC_SERIAL].u.s.value++;
+}
+
+/* atomically replace the object value if it matches the comparand, return the previous value */
+int inproc_sync_cmpxchg_value( struct inproc_sync *sync, int value, int compare )
+{
+    struct inproc_sync old, new;
+
+    for (;;)
+    {
+        old.u.data = sync->u.data;
+        if (old.u.s.value != compare) return old.u.s.value;
+        new.u = old.u;
+        new.u.s.value = value;
+        if (interlocked_cmpxchg64( &sync->u.data, new.u.data, old.u.data ) == old.u.data) return compare;
+    }
+}
+
+/* atomically replace the object value, return the previous value */
+int inproc_sync_set_value( struct inproc_sync *sync, int value )
+{
+    struct inproc_sync old, new;
+
+    for (;;)
+    {
+        old.u.data = sync->u.data;
+        new.u = old.u;
+        new.u.s.value = value;
+        if (interlocked_cmpxchg64( &sync->u.data, new.u.data, old.u.data ) == old.u.data)
+            return old.u.s.value;
+    }
+}
+
+/* atomically update the count of server waiters, preventing the clients from touching the object */
+static void update_waiters( struct inproc_sync *sync, int delta )
+{
+    struct inproc_sync old, new;
+
+    for (;;)
+    {
+        old.u.data = sync->u.data;
+        new.u = old.u;
+        new.u.s.waiters += delta;
+        if (interlocked_cmpxchg64( &sync->u.data, new.u.data, old.u.data ) == old.u.data) return;
+    }
+}
+
+/* add_queue implementation for objects with an in-process state */
+int inproc_sync_add_queue( struct object *obj, struct wait_queue_entry *entry, struct inproc_sync *sync )
+{
+    update_waiters( sync, 1 );
+    return add_queue( obj, entry );
+}
+
+/* remove_queue implementation for objects with an in-process state */
+void inproc_sync_remove_queue( struct object *obj, struct wait_queue_entry *entry, struct inproc_sync *sync )
+{
+    update_waiters( sync, -1 );
+    remove_queue( obj, entry );
+}
+
+/* retrieve the shared area */
+DECL_HANDLER(get_inproc_sync_fd)
+{
+    if (!shared_area)
+    {
+        set_error( STATUS_NOT_IMPLEMENTED );
+        return;
+    }
+    reply->count = INPROC_SYNC_COUNT;
+    send_client_fd( current->process, shared_fd, 0 );
+}
+
+/* retrieve the list of in-process mutexes owned by the current thread */
+DECL_HANDLER(get_inproc_owned_list)
+{
+    if (!shared_area) set_error( STATUS_NOT_IMPLEMENTED );
+    else if (!get_thread_inproc_list( current, &reply->index )) set_error( STATUS_NO_MEMORY );
+}
+
+/* retrieve the in-process state of an object */
+DECL_HANDLER(get_inproc_sync)
+{
+    struct object *obj;
+
+    if (!(obj = get_handle_obj( current->process, req->handle, 0, NULL ))) return;
+
+    if (get_event_inproc_sync( obj, &reply->index )) reply->type = INPROC_SYNC_EVENT;
+    else if (get_semaphore_inproc_sync( obj, &reply->index )) reply->type = INPROC_SYNC_SEMAPHORE;
+    else if (get_mutex_inproc_sync( obj, &reply->index )) reply->type = INPROC_SYNC_MUTEX;
+    else reply->type = INPROC_SYNC_NONE;
+    reply->access = get_handle_access( current->process, req->handle );
+    release_object( obj );
+}
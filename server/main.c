@@ -143,6 +143,7 @@ int main( int argc, char *argv[] )
 
     if (debug_level) fprintf( stderr, "wineserver: starting (pid=%ld)\n", (long) getpid() );
     init_signals();
+    init_inproc_sync();
     init_directories();
     init_registry();
     main_loop();
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -38,15 +39,17 @@
 
 struct mutex
 {
-    struct object  obj;             /* object header */
-    struct thread *owner;           /* mutex owner */
-    unsigned int   count;           /* recursion count */
-    int            abandoned;       /* has it been abandoned? */
-    struct list    entry;           /* entry in owner thread mutex list */
+    struct object       obj;         /* object header */
+    struct inproc_sync *sync;        /* owner id and recursion count, possibly shared with the clients */
+    struct inproc_sync  local_sync;  /* storage for the state when not shared */
+    unsigned int        sync_index;  /* index of the state in the shared area */
+    struct list         entry;       /* entry in owner thread mutex list, empty if not in it */
 };
 
 static void mutex_dump( struct object *obj, int verbose );
 static struct object_type *mutex_get_type( struct object *obj );
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int mutex_map_access( struct object *obj, unsigned int access );
@@ -58,8 +61,8 @@ static const struct object_ops mutex_ops =
     sizeof(struct mutex),      /* size */
     mutex_dump,                /* dump */
     mutex_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    mutex_add_queue,           /* add_queue */
+    mutex_remove_queue,        /* remove_queue */
     mutex_signaled,            /* signaled */
     mutex_satisfied,           /* satisfied */
     mutex_signal,              /* signal */
@@ -74,26 +77,52 @@ static const struct object_ops mutex_ops =
 };
 
 
+static inline int is_mutex_shared( struct mutex *mutex )
+{
+    return mutex->sync != &mutex->local_sync;
+}
+
+/* check if a mutex is owned by a given thread */
+static inline int is_mutex_owner( struct mutex *mutex, struct thread *thread )
+{
+    return mutex->sync->count && mutex->sync->u.s.value == thread->id;
+}
+
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
-    assert( !mutex->count || (mutex->owner == thread) );
+    assert( !mutex->sync->count || is_mutex_owner( mutex, thread ) );
 
-    if (!mutex->count++)  /* FIXME: avoid wrap-around */
+    if (!mutex->sync->count++)  /* FIXME: avoid wrap-around */
     {
-        assert( !mutex->owner );
-        mutex->owner = thread;
-        list_add_head( &thread->mutex_list, &mutex->entry );
+        unsigned int list;
+
+        inproc_sync_set_value( mutex->sync, thread->id );
+        /* shared mutexes are linked in the owned list of the thread in the shared
+         * area, so that the clients can release them without the server */
+        if (is_mutex_shared( mutex ) && get_thread_inproc_list( thread, &list ))
+            add_inproc_owned( list, mutex->sync_index );
+        else
+        {
+            list_add_head( &thread->mutex_list, &mutex->entry );
+            mutex->sync->owned_prev = mutex->sync->owned_next = INPROC_SYNC_NO_LIST;
+        }
     }
 }
 
 /* release a mutex once the recursion count is 0 */
-static void do_release( struct mutex *mutex )
+static void do_release( struct mutex *mutex, int abandoned )
 {
-    assert( !mutex->count );
+    assert( !mutex->sync->count );
     /* remove the mutex from the thread list of owned mutexes */
-    list_remove( &mutex->entry );
-    mutex->owner = NULL;
+    if (!list_empty( &mutex->entry ))
+    {
+        list_remove( &mutex->entry );
+        list_init( &mutex->entry );
+        mutex->sync->owned_prev = mutex->sync->owned_next = mutex->sync_index;
+    }
+    else if (is_mutex_shared( mutex )) remove_inproc_owned( mutex->sync_index );
+    inproc_sync_set_value( mutex->sync, abandoned ? INPROC_SYNC_ABANDONED : 0 );
     wake_up( &mutex->obj, 0 );
 }
 
@@ -107,9 +136,12 @@ static struct mutex *create_mutex( struct directory *root, const struct unicode_
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            mutex->count = 0;
-            mutex->owner = NULL;
-            mutex->abandoned = 0;
+            list_init( &mutex->entry );
+            if (!(mutex->sync = alloc_inproc_sync( &mutex->obj, &mutex->sync_index )))
+            {
+                memset( &mutex->local_sync, 0, sizeof(mutex->local_sync) );
+                mutex->sync = &mutex->local_sync;
+            }
             if (owned) do_grab( mutex, current );
             if (sd) default_set_sd( &mutex->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
@@ -122,23 +154,55 @@ static struct mutex *create_mutex( struct directory *root, const struct unicode_
 
 void abandon_mutexes( struct thread *thread )
 {
+    struct mutex *mutex;
+    struct object *obj;
     struct list *ptr;
+    unsigned int index;
 
     while ((ptr = list_head( &thread->mutex_list )) != NULL)
     {
-        struct mutex *mutex = LIST_ENTRY( ptr, struct mutex, entry );
-        assert( mutex->owner == thread );
-        mutex->count = 0;
-        mutex->abandoned = 1;
-        do_release( mutex );
+        mutex = LIST_ENTRY( ptr, struct mutex, entry );
+        assert( is_mutex_owner( mutex, thread ));
+        mutex->sync->count = 0;
+        do_release( mutex, 1 );
+    }
+
+    /* mutexes acquired or released in-process are only found in the owned list */
+    while ((index = get_first_inproc_owned( thread )) != INPROC_SYNC_NO_LIST)
+    {
+        if (!(obj = get_inproc_sync_object( index )))
+        {
+            /* destroyed while owned, see mutex_destroy */
+            remove_inproc_owned( index );
+            free_inproc_sync( index );
+            continue;
+        }
+        mutex = (struct mutex *)obj;
+        if (obj->ops != &mutex_ops || mutex->sync->u.s.value != thread->id)
+        {
+            /* the thread died while acquiring or releasing it */
+            remove_inproc_owned( index );
+            continue;
+        }
+        mutex->sync->count = 0;
+        do_release( mutex, 1 );
     }
 }
 
+int get_mutex_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+
+    if (obj->ops != &mutex_ops || !is_mutex_shared( mutex )) return 0;
+    *index = mutex->sync_index;
+    return 1;
+}
+
 static void mutex_dump( struct object *obj, int verbose )
 {
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
-    fprintf( stderr, "Mutex count=%u owner=%p ", mutex->count, mutex->owner );
+    fprintf( stderr, "Mutex count=%u owner=%04x ", mutex->sync->count, mutex->sync->u.s.value );
     dump_object_name( &mutex->obj );
     fputc( '\n', stderr );
 }
@@ -150,11 +214,28 @@ static struct object_type *mutex_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int mutex_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    return inproc_sync_add_queue( obj, entry, mutex->sync );
+}
+
+static void mutex_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct mutex *mutex = (struct mutex *)obj;
+    assert( obj->ops == &mutex_ops );
+    inproc_sync_remove_queue( obj, entry, mutex->sync );
+}
+
 static int mutex_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct mutex *mutex = (struct mutex *)obj;
+    int owner = mutex->sync->u.s.value;
+
     assert( obj->ops == &mutex_ops );
-    return (!mutex->count || (mutex->owner == get_wait_queue_thread( entry )));
+    /* don't rely on the count here, a client may be about to update it */
+    return (!owner || owner == INPROC_SYNC_ABANDONED || owner == get_wait_queue_thread( entry )->id);
 }
 
 static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry )
@@ -162,9 +243,8 @@ static void mutex_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
+    if (mutex->sync->u.s.value == INPROC_SYNC_ABANDONED) make_wait_abandoned( entry );
     do_grab( mutex, get_wait_queue_thread( entry ));
-    if (mutex->abandoned) make_wait_abandoned( entry );
-    mutex->abandoned = 0;
 }
 
 static unsigned int mutex_map_access( struct object *obj, unsigned int access )
@@ -186,12 +266,12 @@ static int mutex_signal( struct object *obj, unsigned int access )
         set_error( STATUS_ACCESS_DENIED );
         return 0;
     }
-    if (!mutex->count || (mutex->owner != current))
+    if (!is_mutex_owner( mutex, current ))
     {
         set_error( STATUS_MUTANT_NOT_OWNED );
         return 0;
     }
-    if (!--mutex->count) do_release( mutex );
+    if (!--mutex->sync->count) do_release( mutex, 0 );
     return 1;
 }
 
@@ -200,9 +280,19 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
-    if (!mutex->count) return;
-    mutex->count = 0;
-    do_release( mutex );
+    if (!list_empty( &mutex->entry ))
+    {
+        mutex->sync->count = 0;
+        do_release( mutex, 0 );
+    }
+    else if (is_mutex_shared( mutex ) && mutex->sync->owned_next != mutex->sync_index)
+    {
+        /* the owner thread may be updating its owned list concurrently, so leave
+         * the entry in the list and let abandon_mutexes free it later */
+        set_inproc_sync_object( mutex->sync_index, NULL );
+        return;
+    }
+    if (is_mutex_shared( mutex )) free_inproc_sync( mutex->sync_index );
 }
 
 /* create a mutex */
@@ -265,11 +355,11 @@ DECL_HANDLER(release_mutex)
     if ((mutex = (struct mutex *)get_handle_obj( current->process, req->handle,
                                                  0, &mutex_ops )))
     {
-        if (!mutex->count || (mutex->owner != current)) set_error( STATUS_MUTANT_NOT_OWNED );
+        if (!is_mutex_owner( mutex, current )) set_error( STATUS_MUTANT_NOT_OWNED );
         else
         {
-            reply->prev_count = mutex->count;
-            if (!--mutex->count) do_release( mutex );
+            reply->prev_count = mutex->sync->count;
+            if (!--mutex->sync->count) do_release( mutex, 0 );
         }
         release_object( mutex );
     }
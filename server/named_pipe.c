@@ -443,8 +443,16 @@ static void pipe_client_destroy( struct object *obj)
 
 static void named_pipe_device_dump( struct object *obj, int verbose )
 {
+    struct named_pipe_device *device = (struct named_pipe_device *)obj;
+
     assert( obj->ops == &named_pipe_device_ops );
-    fprintf( stderr, "Named pipe device\n" );
+    fprintf( stderr, "Named pipe device" );
+    if (verbose && device->pipes)
+    {
+        fputc( ' ', stderr );
+        dump_namespace( device->pipes );
+    }
+    fputc( '\n', stderr );
 }
 
 static struct object_type *named_pipe_device_get_type( struct object *obj )
@@ -486,7 +494,7 @@ static void named_pipe_device_destroy( struct object *obj )
     struct named_pipe_device *device = (struct named_pipe_device*)obj;
     assert( obj->ops == &named_pipe_device_ops );
     if (device->fd) release_object( device->fd );
-    free( device->pipes );
+    free_namespace( device->pipes );
 }
 
 static enum server_fd_type named_pipe_device_get_fd_type( struct fd *fd )
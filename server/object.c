@@ -45,16 +45,29 @@ struct object_name
     struct list         entry;           /* entry in the hash list */
     struct object      *obj;             /* object owning this name */
     struct object      *parent;          /* parent object */
+    struct namespace   *namespace;       /* namespace containing this name */
+    unsigned int        hash;            /* full case-insensitive hash of the name */
     data_size_t         len;             /* name length in bytes */
     WCHAR               name[1];
 };
 
 struct namespace
 {
+    struct list         entry;           /* entry in global namespace list */
     unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        min_size;        /* initial size, the table never shrinks below it */
+    unsigned int        count;           /* number of names in the namespace */
+    unsigned int        resizes;         /* number of times the table was rehashed */
+    struct list        *names;           /* array of hash entry lists */
 };
 
+/* average chain length above which the hash table is grown */
+#define NAMESPACE_MAX_LOAD  2
+/* average chain length below which the hash table is shrunk */
+#define NAMESPACE_MIN_LOAD_SHIFT  3
+
+static struct list namespace_list = LIST_INIT(namespace_list);
+
 
 #ifdef DEBUG_OBJECTS
 static struct list object_list = LIST_INIT(object_list);
@@ -120,12 +133,49 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
-static int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
+/* case-insensitive FNV-1a hash over the full 16 bits of each character */
+static unsigned int get_name_hash( const WCHAR *name, data_size_t len )
 {
-    WCHAR hash = 0;
+    unsigned int hash = 2166136261u;
+
     len /= sizeof(WCHAR);
-    while (len--) hash ^= tolowerW(*name++);
-    return hash % namespace->hash_size;
+    while (len--)
+    {
+        WCHAR ch = tolowerW( *name++ );
+        hash = (hash ^ (ch & 0xff)) * 16777619;
+        hash = (hash ^ (ch >> 8)) * 16777619;
+    }
+    /* final avalanche so that the low bits depend on the whole name */
+    hash ^= hash >> 15;
+    hash *= 0x2c1b3c6d;
+    hash ^= hash >> 12;
+    return hash;
+}
+
+/* move all the names to a hash table of a different size */
+static void resize_namespace( struct namespace *namespace, unsigned int new_size )
+{
+    struct list *names;
+    unsigned int i;
+
+    /* failing to resize is harmless, we simply keep using the old table */
+    if (!(names = malloc( new_size * sizeof(*names) ))) return;
+    for (i = 0; i < new_size; i++) list_init( &names[i] );
+
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        struct list *ptr;
+        while ((ptr = list_head( &namespace->names[i] )))
+        {
+            struct object_name *name = LIST_ENTRY( ptr, struct object_name, entry );
+            list_remove( &name->entry );
+            list_add_tail( &names[name->hash % new_size], &name->entry );
+        }
+    }
+    free( namespace->names );
+    namespace->names = names;
+    namespace->hash_size = new_size;
+    namespace->resizes++;
 }
 
 /* allocate a name for an object */
@@ -146,7 +196,12 @@ static struct object_name *alloc_name( const struct unicode_str *name )
 static void free_name( struct object *obj )
 {
     struct object_name *ptr = obj->name;
+    struct namespace *namespace = ptr->namespace;
+
     list_remove( &ptr->entry );
+    if (namespace && --namespace->count < namespace->hash_size >> NAMESPACE_MIN_LOAD_SHIFT &&
+        namespace->hash_size > namespace->min_size)
+        resize_namespace( namespace, max( namespace->hash_size / 2, namespace->min_size ));
     if (ptr->parent) release_object( ptr->parent );
     free( ptr );
 }
@@ -155,9 +210,11 @@ static void free_name( struct object *obj )
 static void set_object_name( struct namespace *namespace,
                              struct object *obj, struct object_name *ptr )
 {
-    int hash = get_name_hash( namespace, ptr->name, ptr->len );
-
-    list_add_head( &namespace->names[hash], &ptr->entry );
+    ptr->hash = get_name_hash( ptr->name, ptr->len );
+    ptr->namespace = namespace;
+    if (++namespace->count > namespace->hash_size * NAMESPACE_MAX_LOAD)
+        resize_namespace( namespace, namespace->hash_size * 2 + 1 );
+    list_add_head( &namespace->names[ptr->hash % namespace->hash_size], &ptr->entry );
     ptr->obj = obj;
     obj->name = ptr;
 }
@@ -327,14 +384,16 @@ struct object *find_object( const struct namespace *namespace, const struct unic
 {
     const struct list *list;
     struct list *p;
+    unsigned int hash;
 
     if (!name || !name->len) return NULL;
 
-    list = &namespace->names[ get_name_hash( namespace, name->str, name->len ) ];
+    hash = get_name_hash( name->str, name->len );
+    list = &namespace->names[hash % namespace->hash_size];
     LIST_FOR_EACH( p, list )
     {
         const struct object_name *ptr = LIST_ENTRY( p, struct object_name, entry );
-        if (ptr->len != name->len) continue;
+        if (ptr->hash != hash || ptr->len != name->len) continue;
         if (attributes & OBJ_CASE_INSENSITIVE)
         {
             if (!strncmpiW( ptr->name, name->str, name->len/sizeof(WCHAR) ))
@@ -373,15 +432,72 @@ struct namespace *create_namespace( unsigned int hash_size )
     struct namespace *namespace;
     unsigned int i;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
-    if (namespace)
+    if (!(namespace = mem_alloc( sizeof(*namespace) ))) return NULL;
+    if (!(namespace->names = mem_alloc( hash_size * sizeof(namespace->names[0]) )))
     {
-        namespace->hash_size      = hash_size;
-        for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+        free( namespace );
+        return NULL;
     }
+    namespace->hash_size = hash_size;
+    namespace->min_size  = hash_size;
+    namespace->count     = 0;
+    namespace->resizes   = 0;
+    for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+    list_add_tail( &namespace_list, &namespace->entry );
     return namespace;
 }
 
+/* free a namespace, detaching any names still linked into it */
+void free_namespace( struct namespace *namespace )
+{
+    unsigned int i;
+
+    if (!namespace) return;
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        struct list *ptr;
+        while ((ptr = list_head( &namespace->names[i] )))
+        {
+            struct object_name *name = LIST_ENTRY( ptr, struct object_name, entry );
+            list_remove( &name->entry );
+            list_init( &name->entry );
+            name->namespace = NULL;
+        }
+    }
+    list_remove( &namespace->entry );
+    free( namespace->names );
+    free( namespace );
+}
+
+/* dump the hash chain statistics of a namespace to stderr */
+void dump_namespace( const struct namespace *namespace )
+{
+    unsigned int i, len, used = 0, max_len = 0;
+
+    for (i = 0; i < namespace->hash_size; i++)
+    {
+        if (!(len = list_count( &namespace->names[i] ))) continue;
+        used++;
+        if (len > max_len) max_len = len;
+    }
+    fprintf( stderr, "names=%u buckets=%u used=%u max_chain=%u avg_chain=%.2f resizes=%u",
+             namespace->count, namespace->hash_size, used, max_len,
+             used ? (double)namespace->count / used : 0.0, namespace->resizes );
+}
+
+/* dump the hash chain statistics of all namespaces to stderr */
+void dump_namespaces(void)
+{
+    const struct namespace *namespace;
+
+    LIST_FOR_EACH_ENTRY( namespace, &namespace_list, const struct namespace, entry )
+    {
+        fprintf( stderr, "Namespace %p: ", namespace );
+        dump_namespace( namespace );
+        fputc( '\n', stderr );
+    }
+}
+
 /* functions for unimplemented/default object operations */
 
 struct object_type *no_get_type( struct object *obj )
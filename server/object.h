@@ -125,6 +125,9 @@ extern void *create_named_object( struct namespace *namespace, const struct obje
 extern void unlink_named_object( struct object *obj );
 extern void make_object_static( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
+extern void dump_namespace( const struct namespace *namespace );
+extern void dump_namespaces(void);
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
 extern struct object *grab_object( void *obj );
@@ -167,10 +170,33 @@ extern struct keyed_event *get_keyed_event_obj( struct process *process, obj_han
 extern void pulse_event( struct event *event );
 extern void set_event( struct event *event );
 extern void reset_event( struct event *event );
+extern int get_event_inproc_sync( struct object *obj, unsigned int *index );
 
 /* mutex functions */
 
 extern void abandon_mutexes( struct thread *thread );
+extern int get_mutex_inproc_sync( struct object *obj, unsigned int *index );
+
+/* semaphore functions */
+
+extern int get_semaphore_inproc_sync( struct object *obj, unsigned int *index );
+
+/* in-process synchronization functions */
+
+extern void init_inproc_sync(void);
+extern struct inproc_sync *alloc_inproc_sync( struct object *obj, unsigned int *index );
+extern void free_inproc_sync( unsigned int index );
+extern struct object *get_inproc_sync_object( unsigned int index );
+extern void set_inproc_sync_object( unsigned int index, struct object *obj );
+extern int get_thread_inproc_list( struct thread *thread, unsigned int *list );
+extern unsigned int get_first_inproc_owned( struct thread *thread );
+extern void add_inproc_owned( unsigned int list, unsigned int index );
+extern void remove_inproc_owned( unsigned int index );
+extern void inproc_sync_handle_closed(void);
+extern int inproc_sync_cmpxchg_value( struct inproc_sync *sync, int value, int compare );
+extern int inproc_sync_set_value( struct inproc_sync *sync, int value );
+extern int inproc_sync_add_queue( struct object *obj, struct wait_queue_entry *entry, struct inproc_sync *sync );
+extern void inproc_sync_remove_queue( struct object *obj, struct wait_queue_entry *entry, struct inproc_sync *sync );
 
 /* serial functions */
 
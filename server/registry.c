@@ -30,11 +30,24 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+#ifdef HAVE_SYS_POLL_H
+#include <sys/poll.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <sys/stat.h>
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -87,6 +100,7 @@ struct key
 #define KEY_SYMLINK  0x0008  /* key is a symbolic link */
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
+#define KEY_CHANGED  0x0040  /* key itself has been modified, as opposed to one of its subkeys */
 
 /* a key value */
 struct key_value
@@ -119,6 +133,7 @@ static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_va
 
 static void set_periodic_save_timer(void);
 static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static int save_branch( struct key *key, const char *path );
 
 /* information about where to save a registry branch */
 struct save_branch_info
@@ -131,6 +146,55 @@ struct save_branch_info
 static int save_branch_count;
 static struct save_branch_info save_branch_info[MAX_SAVE_BRANCH_INFO];
 
+/* periodic save running in a child process */
+struct save_job
+{
+    struct object  obj;       /* object header */
+    struct fd     *fd;        /* pipe the child reports its status on */
+    pid_t          pid;       /* pid of the child process */
+    unsigned int   branches;  /* mask of the branches being saved */
+};
+
+static void save_job_dump( struct object *obj, int verbose );
+static void save_job_destroy( struct object *obj );
+
+static const struct object_ops save_job_ops =
+{
+    sizeof(struct save_job),  /* size */
+    save_job_dump,            /* dump */
+    no_get_type,              /* get_type */
+    no_add_queue,             /* add_queue */
+    NULL,                     /* remove_queue */
+    NULL,                     /* signaled */
+    NULL,                     /* satisfied */
+    no_signal,                /* signal */
+    no_get_fd,                /* get_fd */
+    no_map_access,            /* map_access */
+    default_get_sd,           /* get_sd */
+    default_set_sd,           /* set_sd */
+    no_lookup_name,           /* lookup_name */
+    no_open_file,             /* open_file */
+    no_close_handle,          /* close_handle */
+    save_job_destroy          /* destroy */
+};
+
+static void save_job_poll_event( struct fd *fd, int event );
+
+static const struct fd_ops save_job_fd_ops =
+{
+    NULL,                     /* get_poll_events */
+    save_job_poll_event,      /* poll_event */
+    NULL,                     /* flush */
+    NULL,                     /* get_fd_type */
+    NULL,                     /* ioctl */
+    NULL,                     /* queue_async */
+    NULL,                     /* reselect_async */
+    NULL                      /* cancel_async */
+};
+
+static int background_save;             /* save in a child process instead of blocking the server */
+static struct save_job *save_job;       /* currently running periodic save */
+
 
 /* information about a file being loaded */
 struct file_load_info
@@ -503,6 +567,14 @@ static void make_dirty( struct key *key )
     }
 }
 
+/* mark a key as modified itself, and all its parents as dirty */
+static void make_changed( struct key *key )
+{
+    if (key->flags & KEY_VOLATILE) return;
+    key->flags |= KEY_CHANGED;
+    make_dirty( key );
+}
+
 /* mark a key and all its subkeys as clean (not modified) */
 static void make_clean( struct key *key )
 {
@@ -510,7 +582,7 @@ static void make_clean( struct key *key )
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    key->flags &= ~(KEY_DIRTY | KEY_CHANGED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -533,7 +605,7 @@ static void touch_key( struct key *key, unsigned int change )
     struct key *k;
 
     key->modif = current_time;
-    make_dirty( key );
+    make_changed( key );
 
     /* do notifications */
     check_notify( key, change, 1 );
@@ -800,12 +872,12 @@ static struct key *create_key( struct key *key, const struct unicode_str *name,
         return NULL;
     }
     *created = 1;
-    make_dirty( key );
+    make_changed( key );
     if (!(key = alloc_subkey( key, &token, index, current_time ))) return NULL;
 
     if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
     if (options & REG_OPTION_VOLATILE) key->flags |= KEY_VOLATILE;
-    else key->flags |= KEY_DIRTY;
+    else key->flags |= KEY_DIRTY | KEY_CHANGED;
 
     if (debug_level > 1) dump_operation( key, NULL, "Create" );
     if (class && class->len)
@@ -1700,28 +1772,944 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* load one of the initial registry files */
-static int load_init_registry_from_file( const char *filename, struct key *key )
+/*
+ * Binary registry snapshots
+ *
+ * When enabled, each registry branch is also stored as a binary snapshot
+ * (e.g. system.reg.snap) that is mapped and copied into the key tree at
+ * startup instead of parsing the text file, plus an append-only journal
+ * (e.g. system.reg.journal). The periodic save only appends the state of
+ * the keys that changed since the previous save to the journal; the
+ * snapshot is rewritten when the journal grows too large, and the text
+ * file is only exported when the server exits.
+ *
+ * The snapshot and journal record the size, mtime and inode of the text
+ * file as it was last written by the server. If the text file has been
+ * changed behind our back, it takes precedence and is imported as usual.
+ *
+ * All records are 8-byte aligned. A snapshot contains the non-volatile
+ * keys of the branch in depth-first order, each key record referencing
+ * the index of its parent record. A journal contains a sequence of key
+ * records identified by their path relative to the branch root, each
+ * holding the full state of the key including the names of its subkeys,
+ * so that deleted subkeys can be detected when replaying.
+ */
+
+#define REG_SNAPSHOT_MAGIC   "WINEREGS"
+#define REG_JOURNAL_MAGIC    "WINEREGJ"
+#define REG_SNAPSHOT_VERSION 2
+
+#define REG_ALIGN(size)  (((size) + 7) & ~7)
+
+/* identification of the text file matching a snapshot */
+struct reg_text_stamp
 {
-    FILE *f;
+    unsigned __int64   size;
+    __int64            mtime;         /* in nanoseconds */
+    unsigned __int64   ino;
+};
+
+struct reg_snapshot_header
+{
+    char                  magic[8];
+    unsigned int          version;
+    unsigned int          arch;           /* prefix type */
+    timeout_t             generation;     /* generation, the journal must match it */
+    struct reg_text_stamp text;           /* text file at the time of the snapshot */
+    unsigned int          text_current;   /* whether the text file contains the same data */
+    unsigned int          key_count;      /* number of key records */
+    data_size_t           data_size;      /* size of the key records */
+    unsigned int          checksum;       /* checksum of the key records */
+};
+
+struct reg_key_record
+{
+    data_size_t           size;           /* size of the record including names and values */
+    unsigned int          parent;         /* index of the parent record (snapshot only) */
+    timeout_t             modif;          /* modification time */
+    unsigned int          flags;          /* KEY_SYMLINK */
+    unsigned int          value_count;    /* number of value records */
+    unsigned short        namelen;        /* length of the name in bytes */
+    unsigned short        classlen;       /* length of the class in bytes */
+    /* followed by name, class and value records */
+};
+
+struct reg_value_record
+{
+    data_size_t           len;            /* length of the data in bytes */
+    unsigned short        namelen;        /* length of the name in bytes */
+    unsigned short        type;           /* value type */
+    /* followed by name and data */
+};
+
+struct reg_journal_header
+{
+    char                  magic[8];
+    unsigned int          version;
+    unsigned int          reserved;
+    timeout_t             generation;     /* generation of the matching snapshot */
+};
+
+enum reg_journal_type
+{
+    REG_JOURNAL_KEY,                      /* state of a key */
+    REG_JOURNAL_TEXT                      /* the text file has been exported */
+};
+
+struct reg_journal_record
+{
+    data_size_t           size;           /* size of the record including the header */
+    unsigned int          type;           /* enum reg_journal_type */
+    unsigned int          checksum;       /* checksum of the data following the header */
+    unsigned int          reserved;
+    /* REG_JOURNAL_KEY: path length, path, key record, subkey count, subkey names
+     * REG_JOURNAL_TEXT: struct reg_text_stamp */
+};
+
+/* buffer used to build the snapshot and journal data */
+struct reg_buffer
+{
+    char                 *data;
+    data_size_t           pos;
+    data_size_t           size;
+};
 
-    if ((f = fopen( filename, "r" )))
+/* state of the binary files of a branch */
+struct reg_snapshot_info
+{
+    int                   journal_fd;     /* journal opened for appending */
+    timeout_t             generation;     /* generation of the current snapshot */
+    data_size_t           snapshot_size;  /* size of the snapshot file */
+    data_size_t           journal_size;   /* size of the journal file */
+    int                   snapshot_stale; /* the snapshot needs to be rewritten */
+    int                   text_stale;     /* the text file needs to be exported */
+};
+
+static int use_snapshots;  /* keep binary snapshots of the registry branches */
+static struct reg_snapshot_info snapshot_info[MAX_SAVE_BRANCH_INFO];
+
+/* the journal is compacted into a new snapshot when it grows larger than this */
+#define REG_JOURNAL_MIN_COMPACT  (1024 * 1024)
+
+static unsigned int reg_checksum( const void *ptr, data_size_t size )
+{
+    const unsigned int *p = ptr;
+    unsigned int sum = 0;
+
+    for (size /= sizeof(*p); size; size--, p++) sum = ((sum << 5) | (sum >> 27)) ^ *p;
+    return sum;
+}
+
+/* reserve some zeroed space at the end of the buffer */
+static void *reg_buffer_alloc( struct reg_buffer *buf, data_size_t size )
+{
+    void *ret;
+
+    size = REG_ALIGN( size );
+    if (buf->pos + size > buf->size)
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        data_size_t new_size = max( buf->size + buf->size / 2, buf->pos + size );
+        char *new_data;
+
+        if (!(new_data = realloc( buf->data, new_size )))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        buf->data = new_data;
+        buf->size = new_size;
+    }
+    ret = buf->data + buf->pos;
+    memset( ret, 0, size );
+    buf->pos += size;
+    return ret;
+}
+
+static int reg_buffer_add( struct reg_buffer *buf, const void *data, data_size_t size )
+{
+    void *ptr;
+
+    if (!size) return 1;
+    if (!(ptr = reg_buffer_alloc( buf, size ))) return 0;
+    memcpy( ptr, data, size );
+    return 1;
+}
+
+/* append the record of a key to the buffer */
+static int put_key_record( struct reg_buffer *buf, const struct key *key, unsigned int parent )
+{
+    struct reg_key_record rec;
+    int i;
+
+    rec.size        = REG_ALIGN( sizeof(rec) ) + REG_ALIGN( key->namelen ) + REG_ALIGN( key->classlen );
+    rec.parent      = parent;
+    rec.modif       = key->modif;
+    rec.flags       = key->flags & KEY_SYMLINK;
+    rec.value_count = key->last_value + 1;
+    rec.namelen     = key->namelen;
+    rec.classlen    = key->classlen;
+    for (i = 0; i <= key->last_value; i++)
+        rec.size += REG_ALIGN( sizeof(struct reg_value_record) ) + REG_ALIGN( key->values[i].namelen ) +
+                    REG_ALIGN( key->values[i].len );
+
+    if (!reg_buffer_add( buf, &rec, sizeof(rec) )) return 0;
+    if (!reg_buffer_add( buf, key->name, key->namelen )) return 0;
+    if (!reg_buffer_add( buf, key->class, key->classlen )) return 0;
+    for (i = 0; i <= key->last_value; i++)
+    {
+        const struct key_value *value = &key->values[i];
+        struct reg_value_record val;
+
+        val.len     = value->len;
+        val.namelen = value->namelen;
+        val.type    = value->type;
+        if (!reg_buffer_add( buf, &val, sizeof(val) )) return 0;
+        if (!reg_buffer_add( buf, value->name, value->namelen )) return 0;
+        if (!reg_buffer_add( buf, value->data, value->len )) return 0;
+    }
+    return 1;
+}
+
+/* return the key record at the given offset if it fits in the data */
+static const struct reg_key_record *get_key_record( const char *data, data_size_t size, data_size_t pos )
+{
+    const struct reg_key_record *rec = (const struct reg_key_record *)(data + pos);
+
+    if (pos > size || size - pos < REG_ALIGN( sizeof(*rec) )) return NULL;
+    if (rec->size < REG_ALIGN( sizeof(*rec) ) || rec->size > size - pos || rec->size % 8) return NULL;
+    if (rec->namelen > MAX_NAME_LEN * sizeof(WCHAR) || rec->namelen % sizeof(WCHAR)) return NULL;
+    if (REG_ALIGN( rec->namelen ) + REG_ALIGN( rec->classlen ) > rec->size - REG_ALIGN( sizeof(*rec) ))
+        return NULL;
+    return rec;
+}
+
+static inline const WCHAR *get_key_record_name( const struct reg_key_record *rec )
+{
+    return (const WCHAR *)((const char *)rec + REG_ALIGN( sizeof(*rec) ));
+}
+
+/* free all the values of a key */
+static void free_key_values( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    key->last_value = -1;
+}
+
+/* set the class, flags, values and time of a key from its record */
+static int load_key_record( struct key *key, const struct reg_key_record *rec )
+{
+    const char *ptr = (const char *)get_key_record_name( rec ) + REG_ALIGN( rec->namelen );
+    const char *end = (const char *)rec + rec->size;
+    unsigned int i;
+
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    if (rec->classlen)
+    {
+        if (!(key->class = memdup( ptr, rec->classlen ))) return 0;
+        key->classlen = rec->classlen;
+    }
+    ptr += REG_ALIGN( rec->classlen );
+    key->flags = (key->flags & ~KEY_SYMLINK) | (rec->flags & KEY_SYMLINK);
+
+    /* values are stored in sorted order, so we can simply append them */
+    free_key_values( key );
+    for (i = 0; i < rec->value_count; i++)
+    {
+        const struct reg_value_record *val = (const struct reg_value_record *)ptr;
+        struct key_value *value;
+        struct unicode_str name;
+
+        if (end - ptr < REG_ALIGN( sizeof(*val) )) return 0;
+        ptr += REG_ALIGN( sizeof(*val) );
+        if (REG_ALIGN( val->namelen ) > end - ptr || val->namelen % sizeof(WCHAR)) return 0;
+        name.str = (const WCHAR *)ptr;
+        name.len = val->namelen;
+        ptr += REG_ALIGN( val->namelen );
+        if (REG_ALIGN( val->len ) > end - ptr) return 0;
+        if (!(value = insert_value( key, &name, key->last_value + 1 ))) return 0;
+        if (val->len && !(value->data = memdup( ptr, val->len ))) return 0;
+        value->len  = val->len;
+        value->type = val->type;
+        ptr += REG_ALIGN( val->len );
+    }
+    key->modif = rec->modif;
+    return 1;
+}
+
+/* remove all the subkeys and values of a branch after a failed load */
+static void clear_branch( struct key *key )
+{
+    while (key->last_subkey >= 0) delete_key( key->subkeys[key->last_subkey], 1 );
+    free_key_values( key );
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+}
+
+/* get the stamp of the text file of a branch */
+static int get_text_stamp( const char *path, struct reg_text_stamp *stamp )
+{
+    struct stat st;
+
+    if (stat( path, &st ) == -1) return 0;
+    stamp->size  = st.st_size;
+    stamp->mtime = (__int64)st.st_mtime * 1000000000;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    stamp->mtime += st.st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    stamp->mtime += st.st_mtimespec.tv_nsec;
+#endif
+    stamp->ino   = st.st_ino;
+    return 1;
+}
+
+static int write_all( int fd, const char *data, data_size_t size )
+{
+    while (size)
+    {
+        ssize_t ret = write( fd, data, size );
+        if (ret == -1)
+        {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        data += ret;
+        size -= ret;
+    }
+    return 1;
+}
+
+static char *get_snapshot_path( const char *path, const char *ext )
+{
+    char *ret;
+
+    if ((ret = malloc( strlen(path) + strlen(ext) + 1 )))
+    {
+        strcpy( ret, path );
+        strcat( ret, ext );
+    }
+    return ret;
+}
+
+/* atomically replace a file with the given contents */
+static int replace_file( const char *path, const char *data, data_size_t size )
+{
+    char *tmp;
+    int fd, ret = 0;
+
+    if (!(tmp = get_snapshot_path( path, ".tmp" ))) return 0;
+    if ((fd = open( tmp, O_CREAT | O_TRUNC | O_WRONLY, 0666 )) != -1)
+    {
+        ret = write_all( fd, data, size );
+        if (close( fd )) ret = 0;
+        if (ret) ret = !rename( tmp, path );
+        if (!ret) unlink( tmp );
+    }
+    free( tmp );
+    return ret;
+}
+
+/* add the non-volatile keys of a branch to a snapshot buffer */
+static int put_snapshot_keys( struct reg_buffer *buf, const struct key *key, unsigned int parent,
+                              unsigned int *count )
+{
+    unsigned int index = (*count)++;
+    int i;
+
+    if (!put_key_record( buf, key, parent )) return 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        if (key->subkeys[i]->flags & KEY_VOLATILE) continue;
+        if (!put_snapshot_keys( buf, key->subkeys[i], index, count )) return 0;
+    }
+    return 1;
+}
+
+/* write a full snapshot of a branch and start a new journal */
+static int write_snapshot( int branch )
+{
+    struct reg_snapshot_info *info = &snapshot_info[branch];
+    struct key *key = save_branch_info[branch].key;
+    const char *path = save_branch_info[branch].path;
+    struct reg_snapshot_header *header;
+    struct reg_journal_header journal;
+    struct reg_buffer buf = { NULL, 0, 0 };
+    char *snap_path = NULL, *journal_path = NULL;
+    unsigned int count = 0;
+    int fd, ret = 0;
+
+    if (!(snap_path = get_snapshot_path( path, ".snap" ))) goto done;
+    if (!(journal_path = get_snapshot_path( path, ".journal" ))) goto done;
+
+    if (!reg_buffer_alloc( &buf, sizeof(*header) )) goto done;
+    if (!put_snapshot_keys( &buf, key, ~0u, &count )) goto done;
+
+    header = (struct reg_snapshot_header *)buf.data;
+    memcpy( header->magic, REG_SNAPSHOT_MAGIC, sizeof(header->magic) );
+    header->version      = REG_SNAPSHOT_VERSION;
+    header->arch         = prefix_type;
+    header->generation   = max( current_time, info->generation + 1 );
+    header->text_current = !info->text_stale && !(key->flags & KEY_DIRTY);
+    header->key_count    = count;
+    header->data_size    = buf.pos - REG_ALIGN( sizeof(*header) );
+    header->checksum     = reg_checksum( buf.data + REG_ALIGN( sizeof(*header) ), header->data_size );
+    if (!get_text_stamp( path, &header->text )) memset( &header->text, 0, sizeof(header->text) );
+
+    /* once the new snapshot is in place, the old journal doesn't match its generation anymore */
+    if (!replace_file( snap_path, buf.data, buf.pos )) goto done;
+    if (info->journal_fd != -1) close( info->journal_fd );
+    info->journal_fd = -1;
+
+    memcpy( journal.magic, REG_JOURNAL_MAGIC, sizeof(journal.magic) );
+    journal.version    = REG_SNAPSHOT_VERSION;
+    journal.reserved   = 0;
+    journal.generation = header->generation;
+    if (!replace_file( journal_path, (const char *)&journal, sizeof(journal) )) goto done;
+    if ((fd = open( journal_path, O_WRONLY | O_APPEND )) == -1) goto done;
+
+    info->journal_fd     = fd;
+    info->generation     = header->generation;
+    info->snapshot_size  = buf.pos;
+    info->journal_size   = sizeof(journal);
+    info->snapshot_stale = 0;
+    info->text_stale     = !header->text_current;
+    make_clean( key );
+    ret = 1;
+    if (debug_level > 1) fprintf( stderr, "%s: wrote snapshot of %u keys\n", path, count );
+
+done:
+    free( buf.data );
+    free( snap_path );
+    free( journal_path );
+    return ret;
+}
+
+/* add a journal record header to the buffer; returns its offset */
+static data_size_t put_journal_record( struct reg_buffer *buf, enum reg_journal_type type )
+{
+    struct reg_journal_record *rec;
+    data_size_t pos = buf->pos;
+
+    if (!(rec = reg_buffer_alloc( buf, sizeof(*rec) ))) return ~0u;
+    rec->type = type;
+    return pos;
+}
+
+/* update the size and checksum of a journal record once its data has been added */
+static void finish_journal_record( struct reg_buffer *buf, data_size_t pos )
+{
+    struct reg_journal_record *rec = (struct reg_journal_record *)(buf->data + pos);
+
+    rec->size = buf->pos - pos;
+    rec->checksum = reg_checksum( rec + 1, rec->size - sizeof(*rec) );
+}
+
+/* add the path of a key relative to the branch root */
+static int put_key_path( struct reg_buffer *buf, const struct key *key, const struct key *base )
+{
+    static const WCHAR backslash = '\\';
+    const struct key *k;
+    data_size_t len = 0, *len_ptr;
+    WCHAR *p;
+
+    for (k = key; k != base; k = k->parent) len += k->namelen + sizeof(WCHAR);
+    if (len) len -= sizeof(WCHAR);
+
+    if (!(len_ptr = reg_buffer_alloc( buf, sizeof(*len_ptr) ))) return 0;
+    *len_ptr = len;
+    if (!len) return 1;
+    if (!(p = reg_buffer_alloc( buf, len ))) return 0;
+    p = (WCHAR *)((char *)p + len);
+    for (k = key; k != base; k = k->parent)
+    {
+        if (k != key) memcpy( --p, &backslash, sizeof(WCHAR) );
+        p -= k->namelen / sizeof(WCHAR);
+        memcpy( p, k->name, k->namelen );
+    }
+    return 1;
+}
+
+/* add journal records for all the modified keys below a key; the keys that
+ * are only dirty because of one of their subkeys don't need a record */
+static int put_journal_keys( struct reg_buffer *buf, const struct key *key, const struct key *base )
+{
+    unsigned int count = 0;
+    data_size_t pos, count_pos;
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return 1;
+    if (!(key->flags & KEY_DIRTY)) return 1;
+    if (!(key->flags & KEY_CHANGED)) goto subkeys;
+
+    if ((pos = put_journal_record( buf, REG_JOURNAL_KEY )) == ~0u) return 0;
+    if (!put_key_path( buf, key, base )) return 0;
+    if (!put_key_record( buf, key, ~0u )) return 0;
+    count_pos = buf->pos;
+    if (!reg_buffer_alloc( buf, sizeof(count) )) return 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        const struct key *subkey = key->subkeys[i];
+        data_size_t len = subkey->namelen;
+
+        if (subkey->flags & KEY_VOLATILE) continue;
+        if (!reg_buffer_add( buf, &len, sizeof(len) )) return 0;
+        if (!reg_buffer_add( buf, subkey->name, subkey->namelen )) return 0;
+        count++;
+    }
+    memcpy( buf->data + count_pos, &count, sizeof(count) );
+    finish_journal_record( buf, pos );
+
+subkeys:
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!put_journal_keys( buf, key->subkeys[i], base )) return 0;
+    return 1;
+}
+
+/* compare a key name with a subkey name, using the same ordering as find_subkey */
+static int compare_key_names( const struct unicode_str *name1, const struct unicode_str *name2 )
+{
+    data_size_t len = min( name1->len, name2->len );
+    int res = memicmpW( name1->str, name2->str, len / sizeof(WCHAR) );
+
+    if (!res) res = name1->len - name2->len;
+    return res;
+}
+
+/* apply a journal record describing the state of a key */
+static int replay_journal_key( struct key *base, const char *data, data_size_t size )
+{
+    const struct reg_key_record *rec;
+    struct unicode_str path, token, name, *names = NULL;
+    struct key *key = base, *subkey;
+    data_size_t len, pos;
+    unsigned int count;
+    int i, j, index, ret = 0;
+
+    /* find the key, creating it if necessary */
+    if (size < REG_ALIGN( sizeof(len) )) return 0;
+    len = *(const data_size_t *)data;
+    pos = REG_ALIGN( sizeof(len) );
+    if (len % sizeof(WCHAR) || REG_ALIGN( len ) > size - pos) return 0;
+    path.str = (const WCHAR *)(data + pos);
+    path.len = len;
+    pos += REG_ALIGN( len );
+
+    token.str = NULL;
+    if (!get_path_token( &path, &token )) return 0;
+    while (token.len)
+    {
+        if (!(subkey = find_subkey( key, &token, &index )) &&
+            !(subkey = alloc_subkey( key, &token, index, current_time ))) return 0;
+        key = subkey;
+        get_path_token( &path, &token );
+    }
+
+    if (!(rec = get_key_record( data, size, pos ))) return 0;
+    pos += rec->size;
+
+    /* get the list of subkeys */
+    if (size - pos < REG_ALIGN( sizeof(count) )) return 0;
+    count = *(const unsigned int *)(data + pos);
+    pos += REG_ALIGN( sizeof(count) );
+    if (count > (size - pos) / REG_ALIGN( sizeof(len) )) return 0;
+    if (count && !(names = mem_alloc( count * sizeof(*names) ))) return 0;
+    for (i = 0; i < count; i++)
+    {
+        if (size - pos < REG_ALIGN( sizeof(len) )) goto done;
+        len = *(const data_size_t *)(data + pos);
+        pos += REG_ALIGN( sizeof(len) );
+        if (!len || len > MAX_NAME_LEN * sizeof(WCHAR) || len % sizeof(WCHAR)) goto done;
+        if (REG_ALIGN( len ) > size - pos) goto done;
+        names[i].str = (const WCHAR *)(data + pos);
+        names[i].len = len;
+        pos += REG_ALIGN( len );
+    }
+
+    /* delete the subkeys that are no longer present, both lists being sorted */
+    for (i = key->last_subkey, j = count - 1; i >= 0; i--)
+    {
+        subkey = key->subkeys[i];
+        name.str = subkey->name;
+        name.len = subkey->namelen;
+        while (j >= 0 && compare_key_names( &names[j], &name ) > 0) j--;
+        if (j >= 0 && !compare_key_names( &names[j], &name )) continue;
+        if (delete_key( subkey, 1 ) == -1) goto done;
+    }
+
+    /* and create the new ones; they have their own record if they contain anything */
+    for (i = 0; i < count; i++)
+    {
+        if (find_subkey( key, &names[i], &index )) continue;
+        if (!alloc_subkey( key, &names[i], index, rec->modif )) goto done;
+    }
+
+    ret = load_key_record( key, rec );
+
+done:
+    free( names );
+    return ret;
+}
+
+static void *map_snapshot( int fd, data_size_t size )
+{
+#ifdef HAVE_SYS_MMAN_H
+    void *ptr = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if (ptr != MAP_FAILED) return ptr;
+#endif
+    return NULL;
+}
+
+static void unmap_snapshot( void *ptr, data_size_t size )
+{
+#ifdef HAVE_SYS_MMAN_H
+    munmap( ptr, size );
+#endif
+}
+
+/* read the whole contents of the journal of a branch */
+static char *read_journal( const char *path, timeout_t generation, data_size_t *size )
+{
+    struct reg_journal_header *header;
+    struct stat st;
+    char *data = NULL;
+    ssize_t ret;
+    int fd;
+
+    if ((fd = open( path, O_RDONLY )) == -1) return NULL;
+    if (fstat( fd, &st ) == -1 || st.st_size < REG_ALIGN( sizeof(*header) ) ||
+        st.st_size > INT_MAX || !(data = malloc( st.st_size )))
+        goto failed;
+    ret = pread( fd, data, st.st_size, 0 );
+    if (ret != st.st_size) goto failed;
+
+    /* a journal from an older generation has been merged into the snapshot already */
+    header = (struct reg_journal_header *)data;
+    if (memcmp( header->magic, REG_JOURNAL_MAGIC, sizeof(header->magic) ) ||
+        header->version != REG_SNAPSHOT_VERSION || header->generation != generation)
+        goto failed;
+
+    close( fd );
+    *size = st.st_size;
+    return data;
+
+failed:
+    free( data );
+    close( fd );
+    return NULL;
+}
+
+/* load a registry branch from its snapshot and journal; return 0 if the text file must be used */
+static int load_branch_snapshot( const char *path, struct key *key, struct reg_snapshot_info *info )
+{
+    const struct reg_snapshot_header *header;
+    const struct reg_journal_record *rec;
+    const struct reg_key_record *key_rec;
+    struct reg_text_stamp text, expected;
+    struct key **keys = NULL;
+    struct stat st;
+    char *snap_path = NULL, *journal_path = NULL, *journal = NULL;
+    const char *snapshot = NULL, *body;
+    data_size_t snapshot_size = 0, journal_size = 0, journal_end, pos;
+    unsigned int i;
+    int fd, text_stale, ret = 0;
+
+    info->journal_fd     = -1;
+    info->generation     = 0;
+    info->snapshot_size  = 0;
+    info->journal_size   = 0;
+    info->snapshot_stale = 1;
+    info->text_stale     = 0;
+
+    if (!(snap_path = get_snapshot_path( path, ".snap" ))) goto done;
+    if (!(journal_path = get_snapshot_path( path, ".journal" ))) goto done;
+
+    if ((fd = open( snap_path, O_RDONLY )) == -1) goto done;
+    if (fstat( fd, &st ) != -1 && st.st_size >= sizeof(*header) && st.st_size <= INT_MAX)
+    {
+        snapshot_size = st.st_size;
+        snapshot = map_snapshot( fd, snapshot_size );
+    }
+    close( fd );
+    if (!snapshot) goto done;
+
+    header = (const struct reg_snapshot_header *)snapshot;
+    body = snapshot + REG_ALIGN( sizeof(*header) );
+    if (memcmp( header->magic, REG_SNAPSHOT_MAGIC, sizeof(header->magic) )) goto done;
+    if (header->version != REG_SNAPSHOT_VERSION) goto done;
+    if (header->arch != PREFIX_32BIT && header->arch != PREFIX_64BIT) goto done;
+    if (prefix_type != PREFIX_UNKNOWN && header->arch != prefix_type) goto done;
+    if (header->data_size > snapshot_size - REG_ALIGN( sizeof(*header) )) goto done;
+    if (!header->key_count || header->key_count > header->data_size / REG_ALIGN( sizeof(*key_rec) ))
+        goto done;
+    if (reg_checksum( body, header->data_size ) != header->checksum) goto done;
+
+    /* find the valid part of the journal, and the last exported text file */
+    expected = header->text;
+    text_stale = !header->text_current;
+    journal_end = 0;
+    if ((journal = read_journal( journal_path, header->generation, &journal_size )))
+    {
+        for (journal_end = REG_ALIGN( sizeof(struct reg_journal_header) ); journal_end < journal_size;
+             journal_end += rec->size)
+        {
+            rec = (const struct reg_journal_record *)(journal + journal_end);
+            if (journal_size - journal_end < sizeof(*rec)) break;
+            if (rec->size < sizeof(*rec) || rec->size > journal_size - journal_end || rec->size % 8) break;
+            if (reg_checksum( rec + 1, rec->size - sizeof(*rec) ) != rec->checksum) break;
+            if (rec->type == REG_JOURNAL_KEY) text_stale = 1;
+            else if (rec->type == REG_JOURNAL_TEXT && rec->size - sizeof(*rec) >= sizeof(expected))
+            {
+                memcpy( &expected, rec + 1, sizeof(expected) );
+                text_stale = 0;
+            }
+            else break;
         }
     }
 
+    /* the text file has precedence if it has been modified behind our back */
+    if (!get_text_stamp( path, &text )) memset( &text, 0, sizeof(text) );
+    if (memcmp( &text, &expected, sizeof(text) ))
+    {
+        if (debug_level) fprintf( stderr, "%s: text file modified, ignoring snapshot\n", path );
+        goto done;
+    }
+
+    /* build the keys from the snapshot records */
+    if (!(keys = mem_alloc( header->key_count * sizeof(*keys) ))) goto done;
+    for (i = pos = 0; i < header->key_count; i++, pos += key_rec->size)
+    {
+        struct key *parent, *subkey = key;
+        struct unicode_str name;
+
+        if (!(key_rec = get_key_record( body, header->data_size, pos ))) goto failed;
+        if (i)
+        {
+            if (key_rec->parent >= i || !key_rec->namelen) goto failed;
+            parent = keys[key_rec->parent];
+            name.str = get_key_record_name( key_rec );
+            name.len = key_rec->namelen;
+            if (!(subkey = alloc_subkey( parent, &name, parent->last_subkey + 1, key_rec->modif )))
+                goto failed;
+        }
+        else if (key_rec->parent != ~0u) goto failed;
+        if (!load_key_record( subkey, key_rec )) goto failed;
+        keys[i] = subkey;
+    }
+
+    /* apply the changes saved since the snapshot was written */
+    if (journal)
+    {
+        for (pos = REG_ALIGN( sizeof(struct reg_journal_header) ); pos < journal_end; pos += rec->size)
+        {
+            rec = (const struct reg_journal_record *)(journal + pos);
+            if (rec->type != REG_JOURNAL_KEY) continue;
+            if (!replay_journal_key( key, (const char *)(rec + 1), rec->size - sizeof(*rec) )) goto failed;
+        }
+    }
+    make_clean( key );
+
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = header->arch;
+    info->generation    = header->generation;
+    info->snapshot_size = snapshot_size;
+    info->text_stale    = text_stale;
+    if (journal && (fd = open( journal_path, O_WRONLY | O_APPEND )) != -1)
+    {
+        /* drop a partially written record at the end */
+        if (journal_end == journal_size || !ftruncate( fd, journal_end ))
+        {
+            info->journal_fd     = fd;
+            info->journal_size   = journal_end;
+            info->snapshot_stale = 0;
+        }
+        else close( fd );
+    }
+    if (debug_level > 1)
+        fprintf( stderr, "%s: loaded snapshot of %u keys\n", path, header->key_count );
+    ret = 1;
+    goto done;
+
+failed:
+    fprintf( stderr, "%s: invalid registry snapshot, loading the text file\n", path );
+    clear_branch( key );
+    make_clean( key );
+done:
+    if (snapshot) unmap_snapshot( (void *)snapshot, snapshot_size );
+    free( keys );
+    free( journal );
+    free( snap_path );
+    free( journal_path );
+    return ret;
+}
+
+/* append the keys modified since the last save to the journal of a branch */
+static int append_journal( int branch )
+{
+    struct reg_snapshot_info *info = &snapshot_info[branch];
+    struct key *key = save_branch_info[branch].key;
+    struct reg_buffer buf = { NULL, 0, 0 };
+    int ret = 0;
+
+    if (!(key->flags & KEY_DIRTY)) return 1;
+    if (!put_journal_keys( &buf, key, key )) goto done;
+    if (!write_all( info->journal_fd, buf.data, buf.pos ))
+    {
+        ftruncate( info->journal_fd, info->journal_size );
+        goto done;
+    }
+    info->journal_size += buf.pos;
+    info->text_stale = 1;
+    make_clean( key );
+    ret = 1;
+    if (debug_level > 1)
+        fprintf( stderr, "%s: appended %u bytes to journal\n", save_branch_info[branch].path, buf.pos );
+done:
+    free( buf.data );
+    return ret;
+}
+
+/* compare the contents of two keys and of their non-volatile subkeys */
+static int compare_keys( const struct key *key1, const struct key *key2 )
+{
+    const struct key_value *val1, *val2;
+    int i, j;
+
+    if (key1->modif != key2->modif) return 0;
+    if ((key1->flags & KEY_SYMLINK) != (key2->flags & KEY_SYMLINK)) return 0;
+    if (key1->classlen != key2->classlen || memcmp( key1->class, key2->class, key1->classlen )) return 0;
+    if (key1->last_value != key2->last_value) return 0;
+    for (i = 0; i <= key1->last_value; i++)
+    {
+        val1 = &key1->values[i];
+        val2 = &key2->values[i];
+        if (val1->namelen != val2->namelen || memcmp( val1->name, val2->name, val1->namelen )) return 0;
+        if (val1->type != val2->type || val1->len != val2->len) return 0;
+        if (memcmp( val1->data, val2->data, val1->len )) return 0;
+    }
+    for (i = j = 0; i <= key1->last_subkey; i++)
+    {
+        const struct key *subkey1 = key1->subkeys[i], *subkey2;
+
+        if (subkey1->flags & KEY_VOLATILE) continue;
+        if (j > key2->last_subkey) return 0;
+        subkey2 = key2->subkeys[j++];
+        if (subkey1->namelen != subkey2->namelen) return 0;
+        if (memcmp( subkey1->name, subkey2->name, subkey1->namelen )) return 0;
+        if (!compare_keys( subkey1, subkey2 )) return 0;
+    }
+    return j == key2->last_subkey + 1;
+}
+
+/* check that loading the snapshot and journal of a branch gives back its current contents */
+static int verify_branch_snapshot( int branch )
+{
+    static const struct unicode_str empty_name = { NULL, 0 };
+    struct reg_snapshot_info info;
+    struct key *key;
+    int ret = 0;
+
+    if (!(key = alloc_key( &empty_name, current_time ))) return 0;
+    if (load_branch_snapshot( save_branch_info[branch].path, key, &info ))
+    {
+        if (info.journal_fd != -1) close( info.journal_fd );
+        ret = compare_keys( save_branch_info[branch].key, key );
+    }
+    clear_branch( key );
+    release_object( key );
+    if (!ret) fprintf( stderr, "%s: registry snapshot does not match the current contents\n",
+                       save_branch_info[branch].path );
+    return ret;
+}
+
+/* save the changes to a branch in snapshot mode */
+static int save_branch_snapshot( int branch )
+{
+    struct reg_snapshot_info *info = &snapshot_info[branch];
+
+    if (info->snapshot_stale || info->journal_fd == -1)
+    {
+        if (!write_snapshot( branch )) return 0;
+    }
+    else if (!append_journal( branch ))
+    {
+        info->snapshot_stale = 1;
+        if (!write_snapshot( branch )) return 0;
+    }
+    /* merge the journal into a new snapshot once it gets too large */
+    else if (info->journal_size > max( info->snapshot_size / 2, REG_JOURNAL_MIN_COMPACT ))
+        write_snapshot( branch );
+
+    if (use_snapshots > 1 && !verify_branch_snapshot( branch ))
+    {
+        info->snapshot_stale = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/* save a branch in snapshot mode on exit, exporting the text file if needed */
+static int flush_branch_snapshot( int branch )
+{
+    struct reg_snapshot_info *info = &snapshot_info[branch];
+    struct key *key = save_branch_info[branch].key;
+    const char *path = save_branch_info[branch].path;
+    struct reg_buffer buf = { NULL, 0, 0 };
+    struct reg_text_stamp *stamp;
+    data_size_t pos;
+
+    if (!save_branch_snapshot( branch )) return save_branch( key, path );
+    if (!info->text_stale) return 1;
+
+    make_dirty( key );
+    if (!save_branch( key, path )) return 0;
+    info->text_stale = 0;
+
+    /* record the exported file so that the snapshot is still used at the next startup */
+    if ((pos = put_journal_record( &buf, REG_JOURNAL_TEXT )) != ~0u &&
+        (stamp = reg_buffer_alloc( &buf, sizeof(*stamp) )) && get_text_stamp( path, stamp ))
+    {
+        finish_journal_record( &buf, pos );
+        if (write_all( info->journal_fd, buf.data, buf.pos )) info->journal_size += buf.pos;
+        else ftruncate( info->journal_fd, info->journal_size );
+    }
+    free( buf.data );
+    return 1;
+}
+
+/* load one of the initial registry files */
+static int load_init_registry_from_file( const char *filename, struct key *key )
+{
+    FILE *f = NULL;
+    int loaded;
+
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
+    if (!(loaded = use_snapshots && load_branch_snapshot( filename, key, &snapshot_info[save_branch_count] )))
+    {
+        if ((f = fopen( filename, "r" )))
+        {
+            load_keys( key, filename, f, 0 );
+            fclose( f );
+            if (get_error() == STATUS_NOT_REGISTRY_FILE)
+            {
+                fprintf( stderr, "%s is not a valid registry file\n", filename );
+                return 1;
+            }
+        }
+        loaded = (f != NULL);
+    }
+
     save_branch_info[save_branch_count].path = filename;
     save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
     make_object_static( &key->obj );
-    return (f != NULL);
+    return loaded;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1801,6 +2789,12 @@ void init_registry(void)
     assert( root_key );
     make_object_static( &root_key->obj );
 
+    /* keep binary snapshots of the registry files if requested */
+    {
+        const char *env = getenv( "WINEREGSNAPSHOT" );
+        if (env) use_snapshots = atoi( env );
+    }
+
     /* load system.reg into Registry\Machine */
 
     if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time )))
@@ -1844,6 +2838,12 @@ void init_registry(void)
     release_object( hkcu );
 
     /* start the periodic save timer */
+#ifdef USE_PTRACE  /* saving in the background relies on the SIGCHLD handler to reap the child */
+    {
+        const char *env = getenv( "WINEASYNCREGSAVE" );
+        if (env) background_save = atoi( env );
+    }
+#endif
     set_periodic_save_timer();
 
     /* go back to the server dir */
@@ -1970,6 +2970,119 @@ done:
     return ret;
 }
 
+static void save_job_dump( struct object *obj, int verbose )
+{
+    struct save_job *job = (struct save_job *)obj;
+    fprintf( stderr, "Registry save job pid=%d branches=%x\n", (int)job->pid, job->branches );
+}
+
+static void save_job_destroy( struct object *obj )
+{
+    struct save_job *job = (struct save_job *)obj;
+    if (job->fd) release_object( job->fd );
+}
+
+/* process the status reported by a save child process */
+static void finish_save_job( struct save_job *job, int status_len, unsigned char failed )
+{
+    int i;
+
+    /* if the child died without reporting, consider that nothing was saved */
+    if (status_len != 1) failed = job->branches;
+    for (i = 0; i < save_branch_count; i++)
+    {
+        if (!(failed & (1 << i))) continue;
+        fprintf( stderr, "wineserver: could not save registry branch to %s\n", save_branch_info[i].path );
+        make_dirty( save_branch_info[i].key );
+    }
+    if (debug_level > 1) fprintf( stderr, "wineserver: registry save process %d done\n", (int)job->pid );
+#ifdef HAVE_SYS_WAIT_H
+    waitpid( job->pid, NULL, WNOHANG );  /* may already have been reaped by the SIGCHLD handler */
+#endif
+    if (save_job == job) save_job = NULL;
+    release_object( job );
+}
+
+static void save_job_poll_event( struct fd *fd, int event )
+{
+    struct save_job *job = get_fd_user( fd );
+    unsigned char failed = 0;
+    int len = read( get_unix_fd( fd ), &failed, 1 );
+
+    if (len == -1 && errno == EAGAIN) return;
+    finish_save_job( job, len, failed );
+}
+
+/* wait for the running save job, if any, to finish */
+static void wait_save_job(void)
+{
+    unsigned char failed = 0;
+    int len;
+
+    if (!save_job) return;
+    do len = read( get_unix_fd( save_job->fd ), &failed, 1 );
+    while (len == -1 && errno == EINTR);
+    finish_save_job( save_job, len, failed );
+}
+
+/* save the dirty branches from a child process working on a snapshot of the registry */
+static int start_save_job(void)
+{
+    struct save_job *job;
+    unsigned int branches = 0;
+    unsigned char failed = 0;
+    int i, fd[2];
+    pid_t pid;
+
+    for (i = 0; i < save_branch_count; i++)
+        if (save_branch_info[i].key->flags & KEY_DIRTY) branches |= 1 << i;
+    if (!branches) return 1;
+
+    if (pipe( fd ) == -1) return 0;
+    switch ((pid = fork()))
+    {
+    case -1:
+        close( fd[0] );
+        close( fd[1] );
+        return 0;
+
+    case 0:  /* child */
+        signal( SIGHUP, SIG_DFL );
+        signal( SIGINT, SIG_DFL );
+        signal( SIGQUIT, SIG_DFL );
+        signal( SIGTERM, SIG_DFL );
+        close( fd[0] );
+        for (i = 0; i < save_branch_count; i++)
+            if ((branches & (1 << i)) && !save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+                failed |= 1 << i;
+        write( fd[1], &failed, 1 );
+        _exit( 0 );
+    }
+
+    /* parent */
+    close( fd[1] );
+    if (!(job = alloc_object( &save_job_ops )))
+    {
+        close( fd[0] );
+        return 1;  /* the child runs anyway, we just won't know the outcome */
+    }
+    job->pid      = pid;
+    job->branches = branches;
+    if (!(job->fd = create_anonymous_fd( &save_job_fd_ops, fd[0], &job->obj, 0 )))
+    {
+        release_object( job );
+        return 1;
+    }
+    set_fd_events( job->fd, POLLIN );
+
+    /* changes made from now on will mark the branches dirty again */
+    for (i = 0; i < save_branch_count; i++)
+        if (branches & (1 << i)) make_clean( save_branch_info[i].key );
+    save_job = job;
+    if (debug_level > 1) fprintf( stderr, "wineserver: registry save process %d started\n", (int)pid );
+    return 1;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
@@ -1977,8 +3090,18 @@ static void periodic_save( void *arg )
 
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
+    if (use_snapshots)
+    {
+        for (i = 0; i < save_branch_count; i++)
+            if (!save_branch_snapshot( i ))
+                save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        goto done;
+    }
+    /* if the previous save is still running, changes will be picked up by the next period */
+    if (background_save && (save_job || start_save_job())) goto done;
     for (i = 0; i < save_branch_count; i++)
         save_branch( save_branch_info[i].key, save_branch_info[i].path );
+done:
     if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
     set_periodic_save_timer();
 }
@@ -1995,10 +3118,14 @@ void flush_registry(void)
 {
     int i;
 
+    /* let a running save finish first so that it doesn't overwrite newer data */
+    wait_save_job();
+
     if (fchdir( config_dir_fd ) == -1) return;
     for (i = 0; i < save_branch_count; i++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (use_snapshots ? !flush_branch_snapshot( i ) :
+            !save_branch( save_branch_info[i].key, save_branch_info[i].path ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
                      save_branch_info[i].path );
@@ -2093,9 +3220,22 @@ DECL_HANDLER(delete_key)
 DECL_HANDLER(flush_key)
 {
     struct key *key = get_hkey_obj( req->hkey, 0 );
+    struct key *parent;
+    int i;
+
     if (key)
     {
-        /* we don't need to do anything here with the current implementation */
+        /* in snapshot mode, journal the branch right away since this is cheap */
+        for (i = 0; use_snapshots && i < save_branch_count; i++)
+        {
+            for (parent = key; parent; parent = parent->parent)
+                if (parent == save_branch_info[i].key) break;
+            if (!parent) continue;
+            if (fchdir( config_dir_fd ) == -1) break;
+            if (!save_branch_snapshot( i )) set_error( STATUS_REGISTRY_IO_FAILED );
+            if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+            break;
+        }
         release_object( key );
     }
 }
@@ -2184,6 +3324,7 @@ DECL_HANDLER(load_registry)
     struct key *key, *parent;
     struct token *token = thread_get_impersonation_token( current );
     struct unicode_str name;
+    int i;
 
     const LUID_AND_ATTRIBUTES privs[] =
     {
@@ -2205,6 +3346,8 @@ DECL_HANDLER(load_registry)
         if ((key = create_key( parent, &name, NULL, 0, KEY_WOW64_64KEY, 0, &dummy )))
         {
             load_registry( key, req->file );
+            /* the loaded keys are not marked as modified, so the journals can't describe them */
+            for (i = 0; i < save_branch_count; i++) snapshot_info[i].snapshot_stale = 1;
             release_object( key );
         }
         release_object( parent );
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -38,25 +39,29 @@
 
 struct semaphore
 {
-    struct object  obj;    /* object header */
-    unsigned int   count;  /* current count */
-    unsigned int   max;    /* maximum possible count */
+    struct object       obj;         /* object header */
+    struct inproc_sync *sync;        /* current and maximum count, possibly shared with the clients */
+    struct inproc_sync  local_sync;  /* storage for the state when not shared */
+    unsigned int        sync_index;  /* index of the state in the shared area */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static struct object_type *semaphore_get_type( struct object *obj );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -67,7 +72,7 @@ static const struct object_ops semaphore_ops =
     no_lookup_name,                /* lookup_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
@@ -87,8 +92,13 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
         if (get_error() != STATUS_OBJECT_NAME_EXISTS)
         {
             /* initialize it if it didn't already exist */
-            sem->count = initial;
-            sem->max   = max;
+            if (!(sem->sync = alloc_inproc_sync( &sem->obj, &sem->sync_index )))
+            {
+                memset( &sem->local_sync, 0, sizeof(sem->local_sync) );
+                sem->sync = &sem->local_sync;
+            }
+            sem->sync->u.s.value = initial;
+            sem->sync->max       = max;
             if (sd) default_set_sd( &sem->obj, sd, OWNER_SECURITY_INFORMATION|
                                                    GROUP_SECURITY_INFORMATION|
                                                    DACL_SECURITY_INFORMATION|
@@ -101,22 +111,31 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
-    if (prev) *prev = sem->count;
-    if (sem->count + count < sem->count || sem->count + count > sem->max)
-    {
-        set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
-        return 0;
-    }
-    else if (sem->count)
-    {
-        /* there cannot be any thread to wake up if the count is != 0 */
-        sem->count += count;
-    }
-    else
+    unsigned int current;
+
+    /* the clients may update the count concurrently as long as nobody is waiting */
+    do
     {
-        sem->count = count;
-        wake_up( &sem->obj, count );
-    }
+        current = sem->sync->u.s.value;
+        if (prev) *prev = current;
+        if (current + count < current || current + count > sem->sync->max)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+    } while (inproc_sync_cmpxchg_value( sem->sync, current + count, current ) != current);
+
+    /* there cannot be any thread to wake up if the count was != 0 */
+    if (!current) wake_up( &sem->obj, count );
+    return 1;
+}
+
+int get_semaphore_inproc_sync( struct object *obj, unsigned int *index )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+
+    if (obj->ops != &semaphore_ops || sem->sync == &sem->local_sync) return 0;
+    *index = sem->sync_index;
     return 1;
 }
 
@@ -124,7 +143,7 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d ", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d ", sem->sync->u.s.value, sem->sync->max );
     dump_object_name( &sem->obj );
     fputc( '\n', stderr );
 }
@@ -136,19 +155,36 @@ static struct object_type *semaphore_get_type( struct object *obj )
     return get_object_type( &str );
 }
 
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    return inproc_sync_add_queue( obj, entry, sem->sync );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    inproc_sync_remove_queue( obj, entry, sem->sync );
+}
+
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return (sem->sync->u.s.value > 0);
 }
 
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry )
 {
     struct semaphore *sem = (struct semaphore *)obj;
+    int count = sem->sync->u.s.value;
+
     assert( obj->ops == &semaphore_ops );
-    assert( sem->count );
-    sem->count--;
+    assert( count );
+    /* the clients leave the count alone while we have waiters */
+    inproc_sync_cmpxchg_value( sem->sync, count - 1, count );
 }
 
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access )
@@ -173,6 +209,14 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+
+    if (sem->sync != &sem->local_sync) free_inproc_sync( sem->sync_index );
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -246,8 +290,8 @@ DECL_HANDLER(query_semaphore)
     if ((sem = (struct semaphore *)get_handle_obj( current->process, req->handle,
                                                    SEMAPHORE_QUERY_STATE, &semaphore_ops )))
     {
-        reply->current = sem->count;
-        reply->max = sem->max;
+        reply->current = sem->sync->u.s.value;
+        reply->max = sem->sync->max;
         release_object( sem );
     }
 }
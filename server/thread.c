@@ -200,6 +200,7 @@ static inline void init_thread_structure( struct thread *thread )
     thread->exit_time     = 0;
 
     list_init( &thread->mutex_list );
+    thread->inproc_list = INPROC_SYNC_NO_LIST;
     list_init( &thread->system_apc );
     list_init( &thread->user_apc );
 
@@ -318,6 +319,7 @@ static void destroy_thread( struct object *obj )
     release_object( thread->process );
     if (thread->id) free_ptid( thread->id );
     if (thread->token) release_object( thread->token );
+    if (thread->inproc_list != INPROC_SYNC_NO_LIST) free_inproc_sync( thread->inproc_list );
 }
 
 /* dump a thread on stdout for debugging purposes */